@@ -0,0 +1,656 @@
+/*
+ * In-process microbenchmarks of the graph engine traversals, no server
+ * needed. Every run generates the same graph, so numbers are comparable
+ * across changes.
+ *
+ * Usage: graph_microbenchmark [<grid side>] [<sources>]
+ *        [local|interleave|replicate] [huge_pages] [<planner queries>]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "src/include/graph.h"
+
+using namespace GraphQueryEngine;
+using namespace std::chrono;
+
+namespace {
+
+// Cycle counter of the CPU where available, 0 elsewhere
+uint64_t Cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Road-network like graph: a side x side grid with edges in both directions
+ * and a few random shortcuts, with node ids shuffled the way clients tend to
+ * number nodes, i.e. with no relation to the structure
+ */
+std::vector<std::vector<uint32_t>> GenerateGraph(uint32_t side) {
+  uint32_t num_nodes = side * side;
+  std::mt19937 rng(42);
+  std::vector<uint32_t> id(num_nodes);
+  for (uint32_t u = 0; u < num_nodes; u++)
+    id[u] = u;
+  std::shuffle(id.begin(), id.end(), rng);
+
+  std::vector<std::vector<uint32_t>> adj_list(num_nodes);
+  auto add = [&](uint32_t u, uint32_t v) { adj_list[id[u]].push_back(id[v]); };
+  for (uint32_t row = 0; row < side; row++) {
+    for (uint32_t col = 0; col < side; col++) {
+      uint32_t u = row * side + col;
+      if (col + 1 < side) {
+        add(u, u + 1);
+        add(u + 1, u);
+      }
+      if (row + 1 < side) {
+        add(u, u + side);
+        add(u + side, u);
+      }
+    }
+  }
+  for (uint32_t i = 0; i < num_nodes / 100; i++)
+    add(rng() % num_nodes, rng() % num_nodes);
+  // Posted graphs come out of ingest with sorted neighbor lists
+  for (auto &neighbors : adj_list)
+    std::sort(neighbors.begin(), neighbors.end());
+  return adj_list;
+}
+
+struct BenchmarkResult {
+  double bytes_per_edge;
+  double build_ms;
+  double ns_per_edge;
+  double cycles_per_edge;
+  // Same traversals with the lists read from the spill file, cached by the
+  // kernel or dropped from its cache before every traversal
+  double out_of_core_ns_per_edge;
+  double cold_ns_per_edge;
+  double out_of_core_mb_per_traversal;
+};
+
+BenchmarkResult RunBfs(const std::vector<std::vector<uint32_t>> &adj_list,
+                       NodeOrder order, bool compress, uint32_t num_sources,
+                       const PlacementPolicy &placement) {
+  BenchmarkResult result;
+  auto start = steady_clock::now();
+  CsrAdjacency adjacency(adj_list);
+  NodePermutation permutation = ComputeNodeOrder(adjacency, order);
+  Graph graph(std::move(adjacency), "benchmark", 0, std::move(permutation),
+              compress, placement);
+  result.build_ms =
+      duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+
+  // Full single-source traversals from fixed client node ids
+  GraphVersionSharedPtr version = graph.Current();
+  result.bytes_per_edge =
+      double(version->AdjacencyBytes()) / version->NumEdges();
+  std::mt19937 rng(7);
+  uint64_t edges = 0;
+  uint64_t cycles = 0;
+  uint64_t nanos = 0;
+  for (uint32_t i = 0; i < num_sources; i++) {
+    uint32_t src = graph.Internal(rng() % graph.NumNodes());
+    auto begin = steady_clock::now();
+    uint64_t begin_cycles = Cycles();
+    std::vector<uint32_t> distances =
+        version->SingleSourceBfs(src, std::vector<uint32_t>());
+    cycles += Cycles() - begin_cycles;
+    nanos += duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+    edges += version->NumEdges();
+  }
+  result.ns_per_edge = double(nanos) / edges;
+  result.cycles_per_edge = double(cycles) / edges;
+
+  const char *path = "/tmp/graph_microbenchmark.spill";
+  graph.Spill(path, true);
+  ExternalAdjacencySharedPtr lists = graph.OutOfCore();
+  for (bool cold : {false, true}) {
+    rng.seed(7);
+    nanos = 0;
+    for (uint32_t i = 0; lists && i < num_sources; i++) {
+      uint32_t src = graph.Internal(rng() % graph.NumNodes());
+      if (cold) {
+        int fd = open(path, O_RDONLY);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+      }
+      auto begin = steady_clock::now();
+      std::vector<uint32_t> distances = lists->Bfs(src, lists->NumNodes(), 0);
+      nanos += duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+    }
+    (cold ? result.cold_ns_per_edge : result.out_of_core_ns_per_edge) =
+        double(nanos) / edges;
+  }
+  result.out_of_core_mb_per_traversal =
+      lists ? double(lists->ReadBytes()) / (1 << 20) / (2 * num_sources) : 0;
+  return result;
+}
+
+struct PlannerResult {
+  uint32_t queries = 0;
+  // Queries the landmark bounds answered without a traversal
+  uint32_t landmark_answers = 0;
+  // Queries where the planner picked the faster of the two traversals
+  uint32_t fastest_picks = 0;
+  uint32_t bounded_picks = 0;
+  // Total time of every query run with one traversal, with the planner's
+  // choice, and with the faster traversal of every query
+  double bfs_ms = 0;
+  double bounded_ms = 0;
+  double planner_ms = 0;
+  double best_ms = 0;
+};
+
+/*
+ * Time the traversals the query planner chooses between, for random pairs
+ * and for pairs a short random walk apart, on the grid with landmarks
+ * @param symmetric, whether the lists are made symmetric, so that the
+ *        traversal with arrays runs bidirectionally
+ * @param max_hops, hop limit of the queries, 0 for none
+ */
+PlannerResult RunPlanner(std::vector<std::vector<uint32_t>> adj_list,
+                         bool symmetric, uint32_t max_hops,
+                         uint32_t num_queries) {
+  const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+  if (symmetric) {
+    for (uint32_t u = 0; u < adj_list.size(); u++) {
+      for (uint32_t v : std::vector<uint32_t>(adj_list[u]))
+        adj_list[v].push_back(u);
+    }
+    for (auto &neighbors : adj_list) {
+      std::sort(neighbors.begin(), neighbors.end());
+      neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                      neighbors.end());
+    }
+  }
+  CsrAdjacency adjacency(adj_list);
+  if (symmetric)
+    adjacency.MarkSymmetric();
+  Graph graph(std::move(adjacency), "planner", 8);
+  GraphVersionSharedPtr version = graph.Current();
+  const GraphStatistics &statistics = version->Statistics();
+
+  PlannerResult result;
+  std::mt19937 rng(11);
+  auto time_ms = [](const steady_clock::time_point &begin) {
+    return duration_cast<nanoseconds>(steady_clock::now() - begin).count() /
+           1e6;
+  };
+  for (uint32_t i = 0; i < num_queries; i++) {
+    uint32_t src = rng() % version->NumNodes();
+    uint32_t dest = rng() % version->NumNodes();
+    // Every other query walks a few hops from the source
+    if (i % 2 == 1) {
+      dest = src;
+      for (uint32_t hop = rng() % 12; hop > 0; hop--) {
+        const std::vector<uint32_t> &next = adj_list[dest];
+        if (!next.empty())
+          dest = next[rng() % next.size()];
+      }
+    }
+    uint32_t lower = 0;
+    uint32_t upper = kUnreachable;
+    version->DistanceBounds(src, dest, &lower, &upper);
+    if (src == dest || lower == upper || lower == kUnreachable ||
+        (max_hops != 0 && lower > max_hops)) {
+      result.landmark_answers++;
+      continue;
+    }
+    result.queries++;
+
+    TraversalQuery query;
+    query.max_hops = max_hops;
+    query.symmetric = symmetric;
+    query.lower = lower;
+    query.upper = upper;
+    PlanChoice choice = QueryPlanner::Choose(statistics, query);
+
+    auto begin = steady_clock::now();
+    version->MinEdgeBfs(src, dest);
+    double bfs_ms = time_ms(begin);
+    uint32_t depth = max_hops == 0 ? upper : std::min(max_hops, upper);
+    begin = steady_clock::now();
+    version->MinEdgeBoundedBfs(src, dest, depth);
+    double bounded_ms = time_ms(begin);
+
+    bool bounded = choice.plan == BOUNDED_BFS_PLAN;
+    result.bounded_picks += bounded;
+    result.fastest_picks += bounded == (bounded_ms < bfs_ms);
+    result.bfs_ms += bfs_ms;
+    result.bounded_ms += bounded_ms;
+    result.planner_ms += bounded ? bounded_ms : bfs_ms;
+    result.best_ms += std::min(bfs_ms, bounded_ms);
+  }
+  return result;
+}
+
+struct ConstrainedResult {
+  // Edges allowed by the queries, out of all edges
+  double allowed_share = 0;
+  // Total time of the queries checking the label of every edge, walking
+  // the bitmap over plain lists, and testing it over compressed lists
+  double per_edge_ms = 0;
+  double plain_ms = 0;
+  double compressed_ms = 0;
+  bool agree = true;
+};
+
+/*
+ * Time label constrained queries on the grid with one of kEdgeLabels labels
+ * on every edge, allowing some of the labels
+ * @param allowed_labels, number of labels the queries allow
+ */
+ConstrainedResult RunConstrained(
+    const std::vector<std::vector<uint32_t>> &adj_list,
+    uint32_t allowed_labels, uint32_t num_queries) {
+  const uint32_t kEdgeLabels = 8;
+  const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+  std::mt19937 rng(13);
+  std::vector<uint32_t> labels;
+  for (const auto &neighbors : adj_list) {
+    for (size_t i = 0; i < neighbors.size(); i++)
+      labels.push_back(rng() % kEdgeLabels);
+  }
+  std::vector<uint32_t> allowed;
+  for (uint32_t label = 0; label < allowed_labels; label++)
+    allowed.push_back(label);
+
+  ConstrainedResult result;
+  std::vector<GraphVersionSharedPtr> versions;
+  std::vector<std::unique_ptr<Graph>> graphs;
+  for (bool compress : {false, true}) {
+    CsrAdjacency adjacency(adj_list);
+    adjacency.SetEdgeLabels(labels);
+    graphs.emplace_back(new Graph(std::move(adjacency), "constrained", 0,
+                                  NodePermutation(), compress));
+    versions.push_back(graphs.back()->Current());
+  }
+  Bitmap edges = versions[0]->EdgeLabels().Select(allowed, false);
+  result.allowed_share = double(edges.Count()) / edges.NumRows();
+
+  // The label of every edge read from the column as the traversal meets it
+  CsrAdjacency reference(adj_list);
+  reference.SetEdgeLabels(labels);
+  const PropertyColumn &column = reference.EdgeLabels();
+  std::vector<bool> allowed_value(kEdgeLabels, false);
+  for (uint32_t label : allowed)
+    allowed_value[label] = true;
+  auto per_edge_bfs = [&](uint32_t src, uint32_t dest) {
+    std::vector<uint32_t> distance(reference.NumNodes(), kUnreachable);
+    std::vector<uint32_t> frontier(1, src);
+    distance[src] = 0;
+    for (size_t i = 0; i < frontier.size() && distance[dest] == kUnreachable;
+         i++) {
+      uint32_t x = frontier[i];
+      uint32_t edge = reference.FirstEdge(x);
+      for (const uint32_t *it = reference.Begin(x); it != reference.End(x);
+           ++it, ++edge) {
+        if (!allowed_value[column.Get(edge)] || distance[*it] != kUnreachable)
+          continue;
+        distance[*it] = distance[x] + 1;
+        frontier.push_back(*it);
+      }
+    }
+    return distance[dest];
+  };
+
+  auto time_ms = [](const steady_clock::time_point &begin) {
+    return duration_cast<nanoseconds>(steady_clock::now() - begin).count() /
+           1e6;
+  };
+  for (uint32_t i = 0; i < num_queries; i++) {
+    uint32_t src = rng() % reference.NumNodes();
+    uint32_t dest = rng() % reference.NumNodes();
+    auto begin = steady_clock::now();
+    uint32_t expected = per_edge_bfs(src, dest);
+    result.per_edge_ms += time_ms(begin);
+    begin = steady_clock::now();
+    uint32_t plain = versions[0]->ConstrainedBfs(src, dest, &edges, nullptr, 0);
+    result.plain_ms += time_ms(begin);
+    begin = steady_clock::now();
+    uint32_t compressed =
+        versions[1]->ConstrainedBfs(src, dest, &edges, nullptr, 0);
+    result.compressed_ms += time_ms(begin);
+    result.agree = result.agree && plain == expected && compressed == expected;
+  }
+  return result;
+}
+
+struct DeadlineResult {
+  // Full traversals without a query control, and under one that never stops
+  double unchecked_ms = 0;
+  double checked_ms = 0;
+  // Longest time from the deadline to the return of a stopped traversal
+  double max_overrun_us = 0;
+  // Share of the nodes that stopped traversals left unexpanded
+  double saved_share = 0;
+};
+
+/*
+ * Time full traversals with and without a query control, then stop them at
+ * a deadline
+ * @param deadline_us, deadline of the stopped traversals after their start
+ */
+DeadlineResult RunDeadlines(const std::vector<std::vector<uint32_t>> &adj_list,
+                            uint32_t num_sources, uint32_t deadline_us) {
+  DeadlineResult result;
+  Graph graph(CsrAdjacency(adj_list), "deadlines", 0);
+  GraphVersionSharedPtr version = graph.Current();
+  std::mt19937 rng(49);
+  auto time_ms = [](const steady_clock::time_point &begin) {
+    return duration_cast<nanoseconds>(steady_clock::now() - begin).count() /
+           1e6;
+  };
+  for (uint32_t i = 0; i < num_sources; i++) {
+    uint32_t src = rng() % version->NumNodes();
+    auto begin = steady_clock::now();
+    version->SingleSourceBfs(src, std::vector<uint32_t>());
+    result.unchecked_ms += time_ms(begin);
+
+    QueryControl running;
+    {
+      ScopedQueryControl scope(&running);
+      begin = steady_clock::now();
+      version->SingleSourceBfs(src, std::vector<uint32_t>());
+      result.checked_ms += time_ms(begin);
+    }
+
+    QueryControl control(QueryControl::Clock::now() +
+                         microseconds(deadline_us));
+    ScopedQueryControl scope(&control);
+    version->SingleSourceBfs(src, std::vector<uint32_t>());
+    double overrun_us = duration_cast<nanoseconds>(QueryControl::Clock::now() -
+                                                   control.Deadline())
+                            .count() /
+                        1e3;
+    result.max_overrun_us = std::max(result.max_overrun_us, overrun_us);
+    result.saved_share +=
+        double(control.UnexpandedNodes()) / version->NumNodes() / num_sources;
+  }
+  return result;
+}
+
+struct SchedulingResult {
+  // Queries answered one after the other, their total and per query time
+  double query_ms = 0;
+  double avg_us = 0;
+  double p99_us = 0;
+  // Posts and deletes of the bulk load answered per second meanwhile
+  double bulk_per_s = 0;
+};
+
+// Request posting a random graph
+graph::Request RandomGraphRequest(const std::string &name, uint32_t num_nodes,
+                                  uint32_t num_edges, std::mt19937 &rng) {
+  graph::Request request;
+  request.set_request_type(graph::POST_GRAPH);
+  request.set_graph_name(name);
+  request.set_graph_total_nodes(num_nodes);
+  for (uint32_t i = 0; i < num_edges; i++) {
+    graph::Edges *edge = request.add_adjacency_list();
+    edge->set_src(rng() % num_nodes);
+    edge->set_dest(rng() % num_nodes);
+  }
+  return request;
+}
+
+/*
+ * Time minimum distance queries sent one after the other through the
+ * asynchronous API while a bulk load keeps the compute threads busy with
+ * posts and deletes of random graphs, the way perf_load_client does
+ * @param fair_queuing, whether the engine schedules by class and tenant
+ * @param bulk_in_flight, posts and deletes the load keeps queued
+ */
+SchedulingResult RunScheduling(bool fair_queuing, uint32_t num_queries,
+                               uint32_t bulk_in_flight) {
+  const uint32_t kComputeThreads = 4;
+  const uint32_t kQueryNodes = 20000;
+  const uint32_t kPostEdges = 20000;
+  GraphEngineOptions options;
+  options.compute_threads = kComputeThreads;
+  options.num_landmarks = 0;
+  options.scheduling.fair_queuing = fair_queuing;
+  GraphEngine engine(options);
+  std::mt19937 rng(50);
+  graph::Request query_graph =
+      RandomGraphRequest("queried", kQueryNodes, 4 * kQueryNodes, rng);
+  query_graph.set_tenant("app");
+  uint64_t graph_id = std::stoull(engine.ProcessRequest(query_graph));
+
+  // Every answered post of the load is followed by the delete of its
+  // graph, every delete by the next post
+  std::mutex load_mutex;
+  std::condition_variable load_cv;
+  bool stopping = false;
+  uint32_t in_flight = bulk_in_flight;
+  std::atomic<uint64_t> bulk_requests{0};
+  std::atomic<uint64_t> next_graph{0};
+  std::function<void(std::shared_ptr<graph::Request>)> send;
+  auto post = [&] {
+    uint64_t graph = next_graph++;
+    std::mt19937 graph_rng(graph);
+    send(std::make_shared<graph::Request>(RandomGraphRequest(
+        "load_" + std::to_string(graph), kQueryNodes, kPostEdges,
+        graph_rng)));
+  };
+  auto next = [&](const std::string &reply) {
+    bulk_requests++;
+    {
+      std::lock_guard<std::mutex> guard(load_mutex);
+      if (stopping || reply.compare(0, 6, "ERROR:") == 0) {
+        in_flight--;
+        load_cv.notify_all();
+        return;
+      }
+    }
+    if (reply.compare(0, 3, "OK,") == 0) {
+      post();
+      return;
+    }
+    std::shared_ptr<graph::Request> request =
+        std::make_shared<graph::Request>();
+    request->set_request_type(graph::DELETE_GRAPH);
+    request->mutable_delete_graph()->set_map_id(std::stoull(reply));
+    send(request);
+  };
+  send = [&](std::shared_ptr<graph::Request> request) {
+    request->set_tenant("loader");
+    engine.ProcessRequestAsync(
+        *request, [&, request](const std::string &reply) { next(reply); });
+  };
+  for (uint32_t i = 0; i < bulk_in_flight; i++)
+    post();
+
+  std::vector<double> latencies_us;
+  std::mutex reply_mutex;
+  std::condition_variable reply_cv;
+  auto begin = steady_clock::now();
+  for (uint32_t i = 0; i < num_queries; i++) {
+    graph::Request query;
+    query.set_request_type(graph::GET_MIN_DISTANCE);
+    query.set_tenant("app");
+    query.mutable_min_distance()->set_map_id(graph_id);
+    query.mutable_min_distance()->set_begin_node(rng() % kQueryNodes);
+    query.mutable_min_distance()->set_end_node(rng() % kQueryNodes);
+    bool answered = false;
+    auto sent = steady_clock::now();
+    engine.ProcessRequestAsync(query, [&](const std::string &) {
+      std::lock_guard<std::mutex> guard(reply_mutex);
+      answered = true;
+      reply_cv.notify_all();
+    });
+    std::unique_lock<std::mutex> lock(reply_mutex);
+    reply_cv.wait(lock, [&] { return answered; });
+    latencies_us.push_back(
+        duration_cast<nanoseconds>(steady_clock::now() - sent).count() / 1e3);
+  }
+  SchedulingResult result;
+  result.query_ms =
+      duration_cast<nanoseconds>(steady_clock::now() - begin).count() / 1e6;
+  result.bulk_per_s = bulk_requests.load() * 1e3 / result.query_ms;
+
+  std::unique_lock<std::mutex> lock(load_mutex);
+  stopping = true;
+  load_cv.wait(lock, [&] { return in_flight == 0; });
+  std::sort(latencies_us.begin(), latencies_us.end());
+  result.avg_us = result.query_ms * 1e3 / num_queries;
+  result.p99_us = latencies_us[latencies_us.size() * 99 / 100];
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t side = argc > 1 ? std::stoul(argv[1]) : 1000;
+  uint32_t num_sources = argc > 2 ? std::stoul(argv[2]) : 10;
+  // Every adjacency is placed, whatever its size
+  PlacementPolicy placement;
+  placement.min_bytes = 0;
+  std::string placement_name = argc > 3 ? argv[3] : "local";
+  if (placement_name.compare("interleave") == 0)
+    placement.placement = INTERLEAVE_PLACEMENT;
+  else if (placement_name.compare("replicate") == 0)
+    placement.placement = REPLICATE_PLACEMENT;
+  placement.huge_pages =
+      argc > 4 && std::string(argv[4]).compare("huge_pages") == 0;
+  uint32_t num_queries = argc > 5 ? std::stoul(argv[5]) : 400;
+
+  std::vector<std::vector<uint32_t>> adj_list = GenerateGraph(side);
+  uint64_t num_edges = 0;
+  for (const auto &neighbors : adj_list)
+    num_edges += neighbors.size();
+  std::cout << "Grid graph with " << adj_list.size() << " nodes and "
+            << num_edges << " edges, " << num_sources
+            << " full BFS traversals per node order and encoding, in memory"
+            << " and out of core, " << PlacementName(placement.placement)
+            << " placement on " << NumMemoryNodes() << " memory nodes"
+            << (placement.huge_pages ? " with huge pages" : "") << std::endl;
+
+  const std::pair<NodeOrder, const char *> orders[] = {
+      {ORIGINAL_ORDER, "original"},
+      {RCM_ORDER, "rcm"},
+      {DEGREE_ORDER, "degree"},
+      {GORDER, "gorder"}};
+  std::cout << std::left << std::setw(10) << "order" << std::setw(12)
+            << "encoding" << std::setw(12) << "bytes/edge" << std::setw(14)
+            << "build ms" << std::setw(14) << "ns/edge" << std::setw(14)
+            << "cycles/edge" << std::setw(14) << "ooc ns/edge"
+            << std::setw(14) << "cold ns/edge" << "ooc MB/bfs" << std::endl;
+  for (const auto &order : orders) {
+    for (bool compress : {false, true}) {
+      BenchmarkResult result =
+          RunBfs(adj_list, order.first, compress, num_sources, placement);
+      std::cout << std::left << std::fixed << std::setprecision(2)
+                << std::setw(10) << order.second << std::setw(12)
+                << (compress ? "compressed" : "plain") << std::setw(12)
+                << result.bytes_per_edge << std::setw(14) << result.build_ms
+                << std::setw(14) << result.ns_per_edge << std::setw(14)
+                << result.cycles_per_edge << std::setw(14)
+                << result.out_of_core_ns_per_edge << std::setw(14)
+                << result.cold_ns_per_edge
+                << result.out_of_core_mb_per_traversal << std::endl;
+    }
+  }
+
+  std::cout << num_queries
+            << " minimum distance queries, half of them a few hops apart,"
+            << " with and without a hop limit, traversal picked by the query"
+            << " planner" << std::endl;
+  std::cout << std::left << std::setw(12) << "lists" << std::setw(10)
+            << "max hops" << std::setw(10)
+            << "landmark" << std::setw(10) << "traversed" << std::setw(10)
+            << "bounded" << std::setw(10) << "fastest" << std::setw(12)
+            << "bfs ms" << std::setw(12) << "bounded ms" << std::setw(12)
+            << "planner ms" << "best ms" << std::endl;
+  for (bool symmetric : {false, true}) {
+    for (uint32_t max_hops : {0, 16}) {
+      PlannerResult result =
+          RunPlanner(adj_list, symmetric, max_hops, num_queries);
+      std::cout << std::left << std::fixed << std::setprecision(2)
+                << std::setw(12) << (symmetric ? "symmetric" : "directed")
+                << std::setw(10) << max_hops << std::setw(10)
+                << result.landmark_answers << std::setw(10) << result.queries
+                << std::setw(10) << result.bounded_picks << std::setw(10)
+                << result.fastest_picks << std::setw(12) << result.bfs_ms
+                << std::setw(12) << result.bounded_ms << std::setw(12)
+                << result.planner_ms << result.best_ms << std::endl;
+    }
+  }
+
+  uint32_t constrained_queries = std::max(1u, num_queries / 20);
+  std::cout << constrained_queries
+            << " label constrained queries between random nodes, edges"
+            << " labeled with one of 8 labels" << std::endl;
+  std::cout << std::left << std::setw(10) << "allowed" << std::setw(10)
+            << "edges" << std::setw(14) << "per edge ms" << std::setw(12)
+            << "bitmap ms" << std::setw(16) << "compressed ms" << "agree"
+            << std::endl;
+  for (uint32_t allowed_labels : {1, 4, 7}) {
+    ConstrainedResult result =
+        RunConstrained(adj_list, allowed_labels, constrained_queries);
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(10) << allowed_labels << std::setw(10)
+              << result.allowed_share << std::setw(14) << result.per_edge_ms
+              << std::setw(12) << result.plain_ms << std::setw(16)
+              << result.compressed_ms << (result.agree ? "yes" : "no")
+              << std::endl;
+  }
+
+  const uint32_t kDeadlineUs = 1000;
+  DeadlineResult deadlines = RunDeadlines(adj_list, num_sources, kDeadlineUs);
+  std::cout << num_sources
+            << " full BFS traversals without and under a query control, then"
+            << " stopped " << kDeadlineUs << " us after their start"
+            << std::endl;
+  std::cout << std::left << std::setw(14) << "unchecked ms" << std::setw(12)
+            << "checked ms" << std::setw(16) << "max overrun us"
+            << "unexpanded" << std::endl;
+  std::cout << std::left << std::fixed << std::setprecision(2)
+            << std::setw(14) << deadlines.unchecked_ms << std::setw(12)
+            << deadlines.checked_ms << std::setw(16)
+            << deadlines.max_overrun_us << deadlines.saved_share << std::endl;
+
+  const uint32_t kBulkInFlight = 16;
+  std::cout << num_queries
+            << " minimum distance queries one after the other on 4 compute"
+            << " threads, while " << kBulkInFlight
+            << " posts and deletes of 20000 edge graphs are queued"
+            << std::endl;
+  std::cout << std::left << std::setw(12) << "scheduling" << std::setw(12)
+            << "query ms" << std::setw(12) << "avg us" << std::setw(12)
+            << "p99 us" << "bulk/s" << std::endl;
+  for (bool fair_queuing : {false, true}) {
+    SchedulingResult result =
+        RunScheduling(fair_queuing, num_queries, kBulkInFlight);
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(12) << (fair_queuing ? "fair" : "fifo")
+              << std::setw(12) << result.query_ms << std::setw(12)
+              << result.avg_us << std::setw(12) << result.p99_us
+              << result.bulk_per_s << std::endl;
+  }
+  return 0;
+}
@@ -62,6 +62,9 @@ public:
     request.set_graph_name(graph_name);
     request.set_graph_total_nodes(num_nodes);
     request.set_request_type(graph::POST_GRAPH);
+    // The load storm is bulk work, queries of other tenants go first
+    request.set_priority(graph::BULK_PRIORITY);
+    request.set_tenant("perf_load_client");
 
     // Construct the adjacency list in protobuf format
     for (auto input_edge : adj_list) {
@@ -95,6 +98,8 @@ public:
   void DeleteGraphRequest(const uint64_t &graph_id) {
     Request request;
     request.set_request_type(graph::DELETE_GRAPH);
+    request.set_priority(graph::BULK_PRIORITY);
+    request.set_tenant("perf_load_client");
     request.mutable_delete_graph()->set_map_id(graph_id);
 
     // Call object to store rpc data
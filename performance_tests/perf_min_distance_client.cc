@@ -127,6 +127,7 @@ public:
                                    const uint32_t dest) {
     Request request;
     request.set_request_type(graph::GET_MIN_DISTANCE);
+    request.set_tenant("perf_min_distance_client");
     request.mutable_min_distance()->set_begin_node(src);
     request.mutable_min_distance()->set_end_node(dest);
     request.mutable_min_distance()->set_map_id(graph_id);
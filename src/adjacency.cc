@@ -0,0 +1,463 @@
+#include "src/include/adjacency.h"
+#include "src/include/binary_io.h"
+#include <algorithm>
+#include <limits>
+
+namespace GraphQueryEngine {
+
+namespace {
+constexpr uint32_t kEncodedPadding = CompressedNeighbors::kPadding;
+
+// Bytes group varint takes for a gap
+uint32_t GapLength(uint32_t gap) {
+  return gap < (1u << 8) ? 1 : gap < (1u << 16) ? 2 : gap < (1u << 24) ? 3 : 4;
+}
+
+// Gaps of a sorted neighbor list, the first one a zigzag encoded difference
+// to the node, which is small for graphs laid out for locality
+template <typename Emit>
+void ForEachGap(uint32_t node, const uint32_t *begin, const uint32_t *end,
+                Emit emit) {
+  uint32_t previous = node;
+  for (const uint32_t *it = begin; it != end; ++it) {
+    uint32_t gap = *it - previous;
+    if (it == begin)
+      gap = (gap << 1) ^ uint32_t(int32_t(gap) >> 31);
+    emit(gap);
+    previous = *it;
+  }
+}
+} // namespace
+
+CsrAdjacency::CsrAdjacency(
+    const std::vector<std::vector<uint32_t>> &adjacency_list) {
+  offsets.resize(adjacency_list.size() + 1, 0);
+  for (uint32_t u = 0; u < adjacency_list.size(); u++)
+    offsets[u + 1] = offsets[u] + adjacency_list[u].size();
+
+  targets.reserve(offsets.back());
+  sorted = true;
+  for (const auto &neighbors : adjacency_list) {
+    targets.insert(targets.end(), neighbors.begin(), neighbors.end());
+    sorted = sorted && std::is_sorted(neighbors.begin(), neighbors.end());
+  }
+}
+
+CsrAdjacency::CsrAdjacency(std::vector<uint32_t> offsets,
+                           std::vector<uint32_t> targets, bool sorted)
+    : offsets(std::move(offsets)), targets(std::move(targets)),
+      sorted(sorted) {}
+
+void CsrAdjacency::SetWeights(std::vector<uint32_t> weights) {
+  weight_type = INTEGER_WEIGHTS;
+  integer_weights = std::move(weights);
+  max_weight = 0;
+  for (uint32_t weight : integer_weights)
+    max_weight = std::max<double>(max_weight, weight);
+}
+
+void CsrAdjacency::SetWeights(std::vector<float> weights) {
+  weight_type = FLOAT_WEIGHTS;
+  float_weights = std::move(weights);
+  max_weight = 0;
+  for (float weight : float_weights)
+    max_weight = std::max<double>(max_weight, weight);
+}
+
+void CsrAdjacency::SetWeights(
+    const std::vector<std::vector<uint32_t>> &weights) {
+  weight_type = INTEGER_WEIGHTS;
+  integer_weights.clear();
+  integer_weights.reserve(targets.size());
+  for (const auto &node_weights : weights) {
+    integer_weights.insert(integer_weights.end(), node_weights.begin(),
+                           node_weights.end());
+  }
+  max_weight = 0;
+  for (uint32_t weight : integer_weights)
+    max_weight = std::max<double>(max_weight, weight);
+}
+
+void CsrAdjacency::SetWeights(const std::vector<std::vector<float>> &weights) {
+  weight_type = FLOAT_WEIGHTS;
+  float_weights.clear();
+  float_weights.reserve(targets.size());
+  for (const auto &node_weights : weights) {
+    float_weights.insert(float_weights.end(), node_weights.begin(),
+                         node_weights.end());
+  }
+  max_weight = 0;
+  for (float weight : float_weights)
+    max_weight = std::max<double>(max_weight, weight);
+}
+
+bool CsrAdjacency::HasEdge(uint32_t src, uint32_t dest) const {
+  if (encoding != PLAIN_TARGETS) {
+    // Sorted lists stop at the first neighbor that is not below dest
+    bool found = false;
+    ForEachNeighbor(src, [&](uint32_t neighbor) {
+      found = neighbor == dest;
+      return !found && (!sorted || neighbor < dest);
+    });
+    return found;
+  }
+  if (sorted)
+    return std::binary_search(Begin(src), End(src), dest);
+  return std::find(Begin(src), End(src), dest) != End(src);
+}
+
+void CsrAdjacency::Compress() {
+  if (encoding != PLAIN_TARGETS || !sorted)
+    return;
+  uint32_t num_nodes = NumNodes();
+  num_encoded_edges = NumEdges();
+  encoded.reserve(CompressedBytes() + kEncodedPadding);
+  // The index is filled in last, Degree and Begin read the plain lists until
+  // the adjacency counts as compressed
+  std::vector<uint64_t> blocks;
+  std::vector<uint32_t> positions(num_nodes);
+  for (uint32_t u = 0; u < num_nodes; u++) {
+    if (u % kIndexBlock == 0)
+      blocks.push_back(encoded.size());
+    positions[u] = encoded.size() - blocks.back();
+    for (uint32_t degree = Degree(u);; degree >>= 7) {
+      encoded.push_back(uint8_t(degree & 0x7f) | (degree >= 0x80 ? 0x80 : 0));
+      if (degree < 0x80)
+        break;
+    }
+    // Control byte of the current group, patched as its gaps come in
+    size_t control = 0;
+    uint32_t in_group = 0;
+    ForEachGap(u, Begin(u), End(u), [&](uint32_t gap) {
+      if (in_group == 0) {
+        control = encoded.size();
+        encoded.push_back(0);
+      }
+      uint32_t length = GapLength(gap);
+      encoded[control] |= (length - 1) << (2 * in_group);
+      for (uint32_t b = 0; b < length; b++)
+        encoded.push_back(uint8_t(gap >> (8 * b)));
+      in_group = (in_group + 1) % 4;
+    });
+  }
+  // A compressed adjacency has at least one block, even without nodes
+  if (blocks.empty())
+    blocks.push_back(0);
+  encoded.resize(encoded.size() + kEncodedPadding, 0);
+  block_offsets.swap(blocks);
+  byte_offsets.swap(positions);
+  encoding = COMPRESSED_TARGETS;
+  std::vector<uint32_t>().swap(targets);
+  // Edge offsets only locate weights and labels from now on
+  if (weight_type == UNWEIGHTED && edge_labels.Empty())
+    std::vector<uint32_t>().swap(offsets);
+}
+
+uint64_t CsrAdjacency::CompressedBytes() const {
+  if (Compressed())
+    return NeighborBytes();
+  uint32_t num_nodes = NumNodes();
+  uint64_t blocks = std::max<uint64_t>(
+      1, (uint64_t(num_nodes) + kIndexBlock - 1) / kIndexBlock);
+  uint64_t bytes = uint64_t(num_nodes) * sizeof(uint32_t) +
+                   blocks * sizeof(uint64_t);
+  for (uint32_t u = 0; u < num_nodes; u++) {
+    uint32_t degree = Degree(u);
+    bytes += (degree + 3) / 4;
+    for (; degree >= 0x80; degree >>= 7)
+      bytes++;
+    bytes++;
+    ForEachGap(u, Begin(u), End(u),
+               [&](uint32_t gap) { bytes += GapLength(gap); });
+  }
+  return bytes;
+}
+
+void CsrAdjacency::Narrow() {
+  if (encoding != PLAIN_TARGETS ||
+      NumNodes() >= std::numeric_limits<uint16_t>::max())
+    return;
+  narrow_targets.assign(targets.begin(), targets.end());
+  std::vector<uint32_t>().swap(targets);
+  encoding = NARROW_TARGETS;
+}
+
+uint64_t CsrAdjacency::NeighborBytes() const {
+  if (Compressed()) {
+    return encoded.size() + block_offsets.size() * sizeof(uint64_t) +
+           byte_offsets.size() * sizeof(uint32_t);
+  }
+  return offsets.size() * sizeof(uint32_t) + targets.size() * sizeof(uint32_t) +
+         narrow_targets.size() * sizeof(uint16_t);
+}
+
+uint64_t CsrAdjacency::Bytes() const {
+  uint64_t bytes = NeighborBytes() +
+                   integer_weights.size() * sizeof(uint32_t) +
+                   float_weights.size() * sizeof(float) + edge_labels.Bytes() +
+                   node_labels.Bytes();
+  // Edge offsets kept next to compressed lists to locate weights and labels
+  if (Compressed())
+    bytes += offsets.size() * sizeof(uint32_t);
+  return bytes;
+}
+
+void CsrAdjacency::Place(MemoryPlacement placement, bool huge_pages,
+                         uint32_t node) const {
+  auto place = [&](const auto &values) {
+    PlaceMemory(values.data(), values.size() * sizeof(values[0]), placement,
+                huge_pages, node);
+  };
+  place(offsets);
+  place(targets);
+  place(narrow_targets);
+  place(encoded);
+  place(block_offsets);
+  place(byte_offsets);
+  place(integer_weights);
+  place(float_weights);
+  edge_labels.Place(placement, huge_pages, node);
+  node_labels.Place(placement, huge_pages, node);
+}
+
+void CsrAdjacency::Save(std::ostream &out, uint64_t *lists_position) const {
+  // The lists of the encoding in use follow the size of their vector
+  auto mark_lists = [&](NeighborEncoding lists) {
+    if (lists_position != nullptr && encoding == lists)
+      *lists_position = uint64_t(out.tellp()) + sizeof(uint64_t);
+  };
+  WriteValue<uint32_t>(out, encoding);
+  WriteVector(out, offsets);
+  mark_lists(PLAIN_TARGETS);
+  WriteVector(out, targets);
+  mark_lists(NARROW_TARGETS);
+  WriteVector(out, narrow_targets);
+  WriteValue<uint8_t>(out, sorted);
+  WriteValue<uint8_t>(out, symmetric);
+  mark_lists(COMPRESSED_TARGETS);
+  WriteVector(out, encoded);
+  WriteVector(out, block_offsets);
+  WriteVector(out, byte_offsets);
+  WriteValue(out, num_encoded_edges);
+  WriteValue<uint32_t>(out, weight_type);
+  WriteVector(out, integer_weights);
+  WriteVector(out, float_weights);
+  WriteValue(out, max_weight);
+  edge_labels.Save(out);
+  node_labels.Save(out);
+}
+
+bool CsrAdjacency::Load(std::istream &in) {
+  uint32_t stored_encoding, stored_weight_type;
+  uint8_t stored_sorted, stored_symmetric;
+  if (!ReadValue(in, &stored_encoding) || !ReadVector(in, &offsets) ||
+      !ReadVector(in, &targets) || !ReadVector(in, &narrow_targets) ||
+      !ReadValue(in, &stored_sorted) || !ReadValue(in, &stored_symmetric) ||
+      !ReadVector(in, &encoded) || !ReadVector(in, &block_offsets) ||
+      !ReadVector(in, &byte_offsets) || !ReadValue(in, &num_encoded_edges) ||
+      !ReadValue(in, &stored_weight_type) ||
+      !ReadVector(in, &integer_weights) || !ReadVector(in, &float_weights) ||
+      !ReadValue(in, &max_weight) || !edge_labels.Load(in) ||
+      !node_labels.Load(in))
+    return false;
+  encoding = NeighborEncoding(stored_encoding);
+  sorted = stored_sorted != 0;
+  symmetric = stored_symmetric != 0;
+  weight_type = WeightType(stored_weight_type);
+  return true;
+}
+
+CsrAdjacency CsrAdjacency::Transpose() const {
+  CsrAdjacency result;
+  uint32_t num_nodes = NumNodes();
+  result.symmetric = symmetric;
+  result.offsets.assign(num_nodes + 1, 0);
+  for (uint32_t target : targets)
+    result.offsets[target + 1]++;
+  for (uint32_t u = 0; u < num_nodes; u++)
+    result.offsets[u + 1] += result.offsets[u];
+
+  // Counting sort by target, sources stay in increasing order
+  result.targets.resize(targets.size());
+  std::vector<uint32_t> position(result.offsets.begin(),
+                                 result.offsets.end() - 1);
+  for (uint32_t u = 0; u < num_nodes; u++) {
+    for (const uint32_t *it = Begin(u); it != End(u); ++it)
+      result.targets[position[*it]++] = u;
+  }
+  return result;
+}
+
+CsrAdjacency CsrAdjacency::Relabel(const std::vector<uint32_t> &new_ids) const {
+  uint32_t num_nodes = NumNodes();
+  std::vector<uint32_t> old_ids(num_nodes);
+  for (uint32_t u = 0; u < num_nodes; u++)
+    old_ids[new_ids[u]] = u;
+
+  CsrAdjacency result;
+  result.offsets.resize(num_nodes + 1, 0);
+  result.targets.reserve(targets.size());
+  result.sorted = true;
+  result.symmetric = symmetric;
+  result.weight_type = weight_type;
+  result.max_weight = max_weight;
+  std::vector<uint32_t> edge_label_values;
+  std::vector<uint32_t> node_label_values;
+  if (!node_labels.Empty())
+    node_label_values.resize(num_nodes);
+  std::vector<uint32_t> edges;
+  for (uint32_t v = 0; v < num_nodes; v++) {
+    uint32_t u = old_ids[v];
+    // Positions of the edges of u, in the order of their new targets
+    edges.resize(Degree(u));
+    for (uint32_t i = 0; i < edges.size(); i++)
+      edges[i] = offsets[u] + i;
+    std::sort(edges.begin(), edges.end(), [&](uint32_t a, uint32_t b) {
+      return new_ids[targets[a]] < new_ids[targets[b]];
+    });
+    for (uint32_t edge : edges) {
+      result.targets.push_back(new_ids[targets[edge]]);
+      if (weight_type == INTEGER_WEIGHTS)
+        result.integer_weights.push_back(integer_weights[edge]);
+      else if (weight_type == FLOAT_WEIGHTS)
+        result.float_weights.push_back(float_weights[edge]);
+      if (!edge_labels.Empty())
+        edge_label_values.push_back(edge_labels.Get(edge));
+    }
+    result.offsets[v + 1] = result.targets.size();
+    if (!node_labels.Empty())
+      node_label_values[v] = node_labels.Get(u);
+  }
+  if (!edge_labels.Empty())
+    result.SetEdgeLabels(edge_label_values);
+  if (!node_labels.Empty())
+    result.SetNodeLabels(node_label_values);
+  return result;
+}
+
+bool DeltaAdjacency::Apply(const CsrAdjacency &base, const EdgeEdit &edit) {
+  uint64_t key = EdgeKey(edit.src, edit.dest);
+  auto inserted_it = inserted.find(edit.src);
+
+  if (edit.insert) {
+    if (base.Weights() != UNWEIGHTED || !base.EdgeLabels().Empty())
+      return false;
+    // Re-inserting a removed base edge makes it visible again
+    if (removed.erase(key) != 0) {
+      if (--removals_per_node[edit.src] == 0)
+        removals_per_node.erase(edit.src);
+      log.push_back(edit);
+      return true;
+    }
+    if (base.HasEdge(edit.src, edit.dest))
+      return false;
+    if (inserted_it != inserted.end()) {
+      std::vector<uint32_t> &targets = inserted_it->second;
+      if (std::find(targets.begin(), targets.end(), edit.dest) != targets.end())
+        return false;
+    }
+    inserted[edit.src].push_back(edit.dest);
+    num_inserted++;
+    log.push_back(edit);
+    return true;
+  }
+
+  // Removal of an edge that only lives in the delta
+  if (inserted_it != inserted.end()) {
+    std::vector<uint32_t> &targets = inserted_it->second;
+    auto it = std::find(targets.begin(), targets.end(), edit.dest);
+    if (it != targets.end()) {
+      *it = targets.back();
+      targets.pop_back();
+      num_inserted--;
+      if (targets.empty())
+        inserted.erase(inserted_it);
+      log.push_back(edit);
+      return true;
+    }
+  }
+  if (!base.HasEdge(edit.src, edit.dest) || removed.count(key) != 0)
+    return false;
+  removed.insert(key);
+  removals_per_node[edit.src]++;
+  log.push_back(edit);
+  return true;
+}
+
+uint64_t DeltaAdjacency::Bytes() const {
+  uint64_t bytes = log.size() * sizeof(EdgeEdit) +
+                   removed.size() * sizeof(uint64_t) +
+                   removals_per_node.size() * 2 * sizeof(uint32_t);
+  for (const auto &entry : inserted)
+    bytes += sizeof(entry) + entry.second.size() * sizeof(uint32_t);
+  return bytes;
+}
+
+void DeltaAdjacency::Save(std::ostream &out) const { WriteVector(out, log); }
+
+bool DeltaAdjacency::Load(std::istream &in, const CsrAdjacency &base) {
+  std::vector<EdgeEdit> saved;
+  if (!ReadVector(in, &saved))
+    return false;
+  *this = DeltaAdjacency();
+  for (const EdgeEdit &edit : saved)
+    Apply(base, edit);
+  return true;
+}
+
+CsrAdjacency DeltaAdjacency::Compact(const CsrAdjacency &base) const {
+  CsrAdjacency result;
+  uint32_t num_nodes = base.NumNodes();
+  result.offsets.resize(num_nodes + 1, 0);
+  result.targets.reserve(base.NumEdges() + log.size());
+  result.weight_type = base.weight_type;
+  result.max_weight = base.max_weight;
+  result.sorted = base.sorted;
+  // Edits of symmetric adjacencies come in pairs, see Graph::ApplyEdits
+  result.symmetric = base.symmetric;
+  // Node labels stay, labeled edges are never inserted
+  result.node_labels = base.node_labels;
+  std::vector<uint32_t> edge_label_values;
+
+  std::vector<uint32_t> added_sorted;
+  for (uint32_t u = 0; u < num_nodes; u++) {
+    bool removals = HasRemovals(u);
+    uint32_t i = 0;
+    base.ForEachNeighbor(u, [&](uint32_t neighbor) {
+      uint32_t edge = i++;
+      if (removals && Removed(u, neighbor))
+        return true;
+      result.targets.push_back(neighbor);
+      // Weights follow their edges, inserted edges are never weighted
+      if (base.weight_type == INTEGER_WEIGHTS)
+        result.integer_weights.push_back(base.IntegerWeights(u)[edge]);
+      else if (base.weight_type == FLOAT_WEIGHTS)
+        result.float_weights.push_back(base.FloatWeights(u)[edge]);
+      if (!base.edge_labels.Empty())
+        edge_label_values.push_back(
+            base.edge_labels.Get(base.FirstEdge(u) + edge));
+      return true;
+    });
+    const std::vector<uint32_t> *added = Inserted(u);
+    if (added != nullptr && base.sorted) {
+      // Merge inserted edges into the sorted list, none of them is a
+      // duplicate of a base edge
+      added_sorted = *added;
+      std::sort(added_sorted.begin(), added_sorted.end());
+      size_t middle = result.targets.size();
+      result.targets.insert(result.targets.end(), added_sorted.begin(),
+                            added_sorted.end());
+      std::inplace_merge(result.targets.begin() + result.offsets[u],
+                         result.targets.begin() + middle,
+                         result.targets.end());
+    } else if (added != nullptr) {
+      result.targets.insert(result.targets.end(), added->begin(), added->end());
+    }
+    result.offsets[u + 1] = result.targets.size();
+  }
+  if (!base.edge_labels.Empty())
+    result.SetEdgeLabels(edge_label_values);
+  return result;
+}
+
+} // namespace GraphQueryEngine
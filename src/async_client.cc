@@ -16,6 +16,7 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <sys/stat.h>
@@ -40,34 +41,58 @@ using graph::Response;
 using grpc::Channel;
 using grpc::ClientAsyncResponseReader;
 using grpc::ClientContext;
+using grpc::ClientReader;
 using grpc::CompletionQueue;
 using grpc::Status;
 
 class GraphEngineClient {
 public:
-  explicit GraphEngineClient(std::shared_ptr<Channel> channel)
-      : stub_(GraphEngine::NewStub(channel)) {}
+  // @param deadline_ms, deadline of every request, 0 for none
+  // @param tenant, tenant every request is scheduled for, empty for none
+  // @param priority, scheduling class of every request, interactive or
+  //        bulk, empty to let the server class requests by type
+  explicit GraphEngineClient(std::shared_ptr<Channel> channel,
+                             uint32_t deadline_ms = 0,
+                             const std::string &tenant = "",
+                             const std::string &priority = "")
+      : stub_(GraphEngine::NewStub(channel)), deadline_ms_(deadline_ms),
+        tenant_(tenant), priority_(priority) {}
 
   // Assembles the client's payload and sends it to the server.
   void PostGraphRequest(const std::string &graph_name,
                         std::vector<GraphQueryEngine::Graph::Edge> &adj_list,
-                        const uint32_t &num_nodes) {
+                        const uint32_t &num_nodes,
+                        graph::WeightType weight_type = graph::UNWEIGHTED,
+                        graph::NodeOrder node_order = graph::ORIGINAL_ORDER,
+                        bool undirected = false, bool async_build = false,
+                        bool labeled_edges = false) {
 
     // Data we are sending to the server.
     Request request;
     request.set_graph_name(graph_name);
     request.set_graph_total_nodes(num_nodes);
     request.set_request_type(graph::POST_GRAPH);
+    request.set_weight_type(weight_type);
+    request.set_node_order(node_order);
+    request.set_undirected(undirected);
+    request.set_async_build(async_build);
+    request.set_labeled_edges(labeled_edges);
 
     // Construct the adjacency list in protobuf format
     for (auto input_edge : adj_list) {
       graph::Edges *edge = request.add_adjacency_list();
       edge->set_src(input_edge.src);
       edge->set_dest(input_edge.dest);
+      if (labeled_edges)
+        edge->set_label(input_edge.weight);
+      else if (weight_type == graph::INTEGER_WEIGHTS)
+        edge->set_weight(input_edge.weight);
+      else if (weight_type == graph::FLOAT_WEIGHTS)
+        edge->set_float_weight(input_edge.weight);
     }
 
     // Call object to store rpc data
-    AsyncClientCall *call = new AsyncClientCall;
+    AsyncClientCall *call = NewCall();
 
     // stub_->PrepareAsyncSayHello() creates an RPC object, returning
     // an instance to store in "call" but does not actually start the RPC
@@ -94,7 +119,7 @@ public:
     request.mutable_delete_graph()->set_map_id(graph_id);
 
     // Call object to store rpc data
-    AsyncClientCall *call = new AsyncClientCall;
+    AsyncClientCall *call = NewCall();
 
     // stub_->PrepareAsyncSayHello() creates an RPC object, returning
     // an instance to store in "call" but does not actually start the RPC
@@ -114,17 +139,29 @@ public:
   }
 
   // Assembles the client's payload for calculating the minimum distance between
-  // two nodes in a stored graph, identified by graph_id
+  // two nodes in a stored graph, identified by graph_id. Version 0 queries the
+  // latest version of the graph, max_hops 0 puts no limit on the distance.
+  // With explain set the reply names the plan that answered the query.
   void CalculateMinDistanceRequest(const uint64_t &graph_id, const uint32_t src,
-                                   const uint32_t dest) {
+                                   const uint32_t dest,
+                                   const uint64_t version = 0,
+                                   const uint32_t max_hops = 0,
+                                   const bool approximate = false,
+                                   const uint32_t max_bound_width = 0,
+                                   const bool explain = false) {
     Request request;
     request.set_request_type(graph::GET_MIN_DISTANCE);
     request.mutable_min_distance()->set_begin_node(src);
     request.mutable_min_distance()->set_end_node(dest);
     request.mutable_min_distance()->set_map_id(graph_id);
+    request.mutable_min_distance()->set_version(version);
+    request.mutable_min_distance()->set_max_hops(max_hops);
+    request.mutable_min_distance()->set_approximate(approximate);
+    request.mutable_min_distance()->set_max_bound_width(max_bound_width);
+    request.mutable_min_distance()->set_explain(explain);
 
     // Call object to store rpc data
-    AsyncClientCall *call = new AsyncClientCall;
+    AsyncClientCall *call = NewCall();
 
     // stub_->PrepareAsyncSayHello() creates an RPC object, returning
     // an instance to store in "call" but does not actually start the RPC
@@ -143,6 +180,232 @@ public:
     call->response_reader->Finish(&call->reply, &call->status, (void *)call);
   }
 
+  // Assembles the client's payload for inserting or removing edges of a stored
+  // graph and sends it to the server
+  void EditGraphRequest(const uint64_t &graph_id,
+                        std::vector<GraphQueryEngine::Graph::Edge> &edges,
+                        bool insert) {
+    Request request;
+    request.set_request_type(insert ? graph::ADD_EDGES : graph::REMOVE_EDGES);
+    request.mutable_update_graph()->set_map_id(graph_id);
+    for (auto input_edge : edges) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(input_edge.src);
+      edge->set_dest(input_edge.dest);
+    }
+
+    // Call object to store rpc data
+    AsyncClientCall *call = NewCall();
+    call->response_reader =
+        stub_->PrepareAsyncGraphEngineRequest(&call->context, request, &cq_);
+    call->response_reader->StartCall();
+    call->response_reader->Finish(&call->reply, &call->status, (void *)call);
+  }
+
+  // Assembles the client's payload for calculating the lowest total edge weight
+  // between two nodes in a stored weighted graph
+  void CalculateWeightedDistanceRequest(const uint64_t &graph_id,
+                                        const uint32_t src,
+                                        const uint32_t dest) {
+    Request request;
+    request.set_request_type(graph::GET_WEIGHTED_DISTANCE);
+    request.mutable_weighted_distance()->set_begin_node(src);
+    request.mutable_weighted_distance()->set_end_node(dest);
+    request.mutable_weighted_distance()->set_map_id(graph_id);
+
+    // Call object to store rpc data
+    AsyncClientCall *call = NewCall();
+    call->response_reader =
+        stub_->PrepareAsyncGraphEngineRequest(&call->context, request, &cq_);
+    call->response_reader->StartCall();
+    call->response_reader->Finish(&call->reply, &call->status, (void *)call);
+  }
+
+  // Assembles the client's payload for calculating the minimum distance
+  // between two nodes over the edges and nodes with allowed labels
+  void CalculateConstrainedDistanceRequest(
+      const uint64_t &graph_id, const uint32_t src, const uint32_t dest,
+      const std::vector<uint32_t> &edge_labels, bool avoid_edge_labels,
+      const std::vector<uint32_t> &node_labels, bool avoid_node_labels,
+      const uint32_t max_hops) {
+    Request request;
+    request.set_request_type(graph::GET_CONSTRAINED_DISTANCE);
+    graph::ConstrainedDistance *query = request.mutable_constrained_distance();
+    query->set_begin_node(src);
+    query->set_end_node(dest);
+    query->set_map_id(graph_id);
+    query->set_max_hops(max_hops);
+    for (uint32_t label : edge_labels)
+      query->add_edge_labels(label);
+    query->set_avoid_edge_labels(avoid_edge_labels);
+    for (uint32_t label : node_labels)
+      query->add_node_labels(label);
+    query->set_avoid_node_labels(avoid_node_labels);
+
+    // Call object to store rpc data
+    AsyncClientCall *call = NewCall();
+    call->response_reader =
+        stub_->PrepareAsyncGraphEngineRequest(&call->context, request, &cq_);
+    call->response_reader->StartCall();
+    call->response_reader->Finish(&call->reply, &call->status, (void *)call);
+  }
+
+  // Asks whether a graph posted with async_build is built yet
+  void GraphStatusRequest(const uint64_t &graph_id) {
+    Request request;
+    request.set_request_type(graph::GET_GRAPH_STATUS);
+    request.mutable_graph_status()->set_map_id(graph_id);
+
+    // Call object to store rpc data
+    AsyncClientCall *call = NewCall();
+    call->response_reader =
+        stub_->PrepareAsyncGraphEngineRequest(&call->context, request, &cq_);
+    call->response_reader->StartCall();
+    call->response_reader->Finish(&call->reply, &call->status, (void *)call);
+  }
+
+  // Submits an analytics job on a graph, the reply carries the job id. Jobs
+  // running past the time budget fail, 0 for no limit.
+  void SubmitJobRequest(const uint64_t &graph_id, graph::JobType job_type,
+                        uint32_t time_budget_ms = 0) {
+    Request request;
+    request.set_request_type(graph::SUBMIT_JOB);
+    request.mutable_job()->set_map_id(graph_id);
+    request.mutable_job()->set_job_type(job_type);
+    request.mutable_job()->set_time_budget_ms(time_budget_ms);
+
+    // Call object to store rpc data
+    AsyncClientCall *call = NewCall();
+    call->response_reader =
+        stub_->PrepareAsyncGraphEngineRequest(&call->context, request, &cq_);
+    call->response_reader->StartCall();
+    call->response_reader->Finish(&call->reply, &call->status, (void *)call);
+  }
+
+  // Asks whether an analytics job is finished
+  void JobStatusRequest(const uint64_t &job_id) {
+    Request request;
+    request.set_request_type(graph::GET_JOB_STATUS);
+    request.mutable_job()->set_job_id(job_id);
+
+    // Call object to store rpc data
+    AsyncClientCall *call = NewCall();
+    call->response_reader =
+        stub_->PrepareAsyncGraphEngineRequest(&call->context, request, &cq_);
+    call->response_reader->StartCall();
+    call->response_reader->Finish(&call->reply, &call->status, (void *)call);
+  }
+
+  // Fetches the result of a finished analytics job and prints the chunks
+  // streamed back by the server. Blocks until the stream is complete.
+  void JobResultRequest(const uint64_t &job_id) {
+    Request request;
+    request.set_request_type(graph::GET_JOB_RESULT);
+    request.mutable_job()->set_job_id(job_id);
+
+    ClientContext context;
+    SetCallOptions(&context);
+    std::unique_ptr<ClientReader<Response>> reader(
+        stub_->GraphEngineStreamRequest(&context, request));
+    Response chunk;
+    while (reader->Read(&chunk)) {
+      if (!chunk.message().empty())
+        std::cout << "Client received: " << chunk.message() << std::endl;
+      // Histograms carry the degrees, other jobs a value per node
+      for (int i = 0; i < chunk.scores_size(); i++) {
+        std::cout << "  " << chunk.chunk_offset() + i << ": "
+                  << chunk.scores(i) << std::endl;
+      }
+      for (int i = 0; i < chunk.distances_size(); i++) {
+        uint64_t key = chunk.nodes_size() > 0 ? chunk.nodes(i)
+                                              : chunk.chunk_offset() + i;
+        std::cout << "  " << key << ": " << chunk.distances(i) << std::endl;
+      }
+    }
+    Status status = reader->Finish();
+    if (!status.ok()) {
+      std::cout << "RPC failed: " << status.error_message() << std::endl;
+    }
+  }
+
+  // Requests the server statistics, e.g. the distance cache hit rate
+  void ServerStatsRequest() {
+    Request request;
+    request.set_request_type(graph::GET_SERVER_STATS);
+
+    // Call object to store rpc data
+    AsyncClientCall *call = NewCall();
+    call->response_reader =
+        stub_->PrepareAsyncGraphEngineRequest(&call->context, request, &cq_);
+    call->response_reader->StartCall();
+    call->response_reader->Finish(&call->reply, &call->status, (void *)call);
+  }
+
+  // Assembles the client's payload for calculating the distances from one node
+  // to many nodes (all nodes when dest_nodes is empty) and prints the chunks
+  // streamed back by the server. Blocks until the stream is complete.
+  void CalculateDistancesRequest(const uint64_t &graph_id, const uint32_t src,
+                                 const std::vector<uint32_t> &dest_nodes) {
+    Request request;
+    request.set_request_type(graph::GET_DISTANCES);
+    request.mutable_multi_distance()->set_begin_node(src);
+    request.mutable_multi_distance()->set_map_id(graph_id);
+    request.mutable_multi_distance()->set_all_nodes(dest_nodes.empty());
+    for (uint32_t dest : dest_nodes)
+      request.mutable_multi_distance()->add_end_nodes(dest);
+
+    ClientContext context;
+    SetCallOptions(&context);
+    std::unique_ptr<ClientReader<Response>> reader(
+        stub_->GraphEngineStreamRequest(&context, request));
+    Response chunk;
+    while (reader->Read(&chunk)) {
+      if (!chunk.message().empty())
+        std::cout << "Client received: " << chunk.message() << std::endl;
+      for (int i = 0; i < chunk.distances_size(); i++) {
+        uint64_t index = chunk.chunk_offset() + i;
+        uint64_t node = dest_nodes.empty() ? index : dest_nodes[index];
+        std::cout << "  " << src << " -> " << node << ": "
+                  << chunk.distances(i) << std::endl;
+      }
+    }
+    Status status = reader->Finish();
+    if (!status.ok()) {
+      std::cout << "RPC failed: " << status.error_message() << std::endl;
+    }
+  }
+
+  // Assembles the client's payload for listing the nodes within max_hops of a
+  // node (at most max_nodes of them, 0 for no limit) and prints the chunks
+  // streamed back by the server. Blocks until the stream is complete.
+  void NeighborhoodRequest(const uint64_t &graph_id, const uint32_t src,
+                           const uint32_t max_hops, const uint32_t max_nodes) {
+    Request request;
+    request.set_request_type(graph::GET_NEIGHBORHOOD);
+    request.mutable_neighborhood()->set_begin_node(src);
+    request.mutable_neighborhood()->set_map_id(graph_id);
+    request.mutable_neighborhood()->set_max_hops(max_hops);
+    request.mutable_neighborhood()->set_max_nodes(max_nodes);
+
+    ClientContext context;
+    SetCallOptions(&context);
+    std::unique_ptr<ClientReader<Response>> reader(
+        stub_->GraphEngineStreamRequest(&context, request));
+    Response chunk;
+    while (reader->Read(&chunk)) {
+      if (!chunk.message().empty())
+        std::cout << "Client received: " << chunk.message() << std::endl;
+      for (int i = 0; i < chunk.nodes_size(); i++) {
+        std::cout << "  " << src << " -> " << chunk.nodes(i) << ": "
+                  << chunk.distances(i) << std::endl;
+      }
+    }
+    Status status = reader->Finish();
+    if (!status.ok()) {
+      std::cout << "RPC failed: " << status.error_message() << std::endl;
+    }
+  }
+
   // Loop while listening for completed responses.
   // Prints out the response from the server.
   void AsyncCompleteRpc() {
@@ -164,12 +427,14 @@ public:
         response = call->reply.message();
         std::cout << "Client received: " << response << std::endl;
       } else {
-        std::cout << "RPC failed" << std::endl;
+        std::cout << "RPC failed: " << call->status.error_message()
+                  << std::endl;
       }
 
-      // Capture only the graph_id stored, exclude ERROR and OK
+      // Capture only the graph_id stored, exclude ERROR, NOT_READY and OK
       size_t found_error = response.find("ERROR");
-      if (found_error == std::string::npos) {
+      if (call->status.ok() && found_error == std::string::npos &&
+          response.find("NOT_READY") == std::string::npos) {
         size_t found_ok = response.find("OK");
         if (found_ok == std::string::npos) {
           graph_ids.push_back(std::stoull(response));
@@ -200,6 +465,26 @@ private:
     std::unique_ptr<ClientAsyncResponseReader<Response>> response_reader;
   };
 
+  // Give a request the deadline, tenant and priority of the client, the
+  // server schedules requests by the x-tenant and x-priority metadata
+  void SetCallOptions(ClientContext *context) const {
+    if (deadline_ms_ != 0) {
+      context->set_deadline(std::chrono::system_clock::now() +
+                            std::chrono::milliseconds(deadline_ms_));
+    }
+    if (!tenant_.empty())
+      context->AddMetadata("x-tenant", tenant_);
+    if (!priority_.empty())
+      context->AddMetadata("x-priority", priority_);
+  }
+
+  // Call object of a new request
+  AsyncClientCall *NewCall() const {
+    AsyncClientCall *call = new AsyncClientCall;
+    SetCallOptions(&call->context);
+    return call;
+  }
+
   // Out of the passed in Channel comes the stub, stored here, our view of the
   // server's exposed services.
   std::unique_ptr<GraphEngine::Stub> stub_;
@@ -207,10 +492,19 @@ private:
   // The producer-consumer queue we use to communicate asynchronously with the
   // gRPC runtime.
   CompletionQueue cq_;
+
+  // Deadline of every request in milliseconds, 0 for none
+  uint32_t deadline_ms_;
+  // Tenant and scheduling class of every request, empty for none
+  std::string tenant_;
+  std::string priority_;
 };
 
 int ProcessCliPost(GraphEngineClient &client, std::string &graph_name,
-                   std::string &file_path) {
+                   std::string &file_path,
+                   graph::NodeOrder node_order = graph::ORIGINAL_ORDER,
+                   bool undirected = false, bool async_build = false,
+                   bool labeled_edges = false) {
   // Check file-path is valid
   struct stat buffer;
   if (stat(file_path.c_str(), &buffer) == 0) {
@@ -224,6 +518,9 @@ int ProcessCliPost(GraphEngineClient &client, std::string &graph_name,
   int i = 1;
   uint32_t nodes = 0;
   std::vector<GraphQueryEngine::Graph::Edge> adj_list;
+  // Lines may carry a third column with the weight of the edge, or with its
+  // label for graphs posted labeled
+  graph::WeightType weight_type = graph::UNWEIGHTED;
   newfile.open(file_path.c_str(), std::ios::in);
   if (newfile.is_open()) {
     std::string tp;
@@ -250,20 +547,34 @@ int ProcessCliPost(GraphEngineClient &client, std::string &graph_name,
           return 0;
         }
         tp = tp.substr(it + 1, tp.length() - it);
+        double weight = 0;
         try {
-          dest_node = std::stoi(tp);
+          size_t used = 0;
+          dest_node = std::stoi(tp, &used);
+          tp = tp.substr(used);
+          if (tp.find_first_not_of(" \r") != std::string::npos) {
+            weight = std::stod(tp);
+            if (tp.find('.') != std::string::npos)
+              weight_type = graph::FLOAT_WEIGHTS;
+            else if (weight_type == graph::UNWEIGHTED)
+              weight_type = graph::INTEGER_WEIGHTS;
+          }
         } catch (...) {
           std::cout << "Invalid file format" << std::endl;
           return 0;
         }
-        adj_list.push_back(GraphQueryEngine::Graph::Edge(src_node, dest_node));
+        adj_list.push_back(
+            GraphQueryEngine::Graph::Edge(src_node, dest_node, weight));
         tp.clear();
       }
       i++;
     }
     newfile.close(); // close the file object.
   }
-  client.PostGraphRequest(graph_name, adj_list, nodes);
+  if (labeled_edges)
+    weight_type = graph::UNWEIGHTED;
+  client.PostGraphRequest(graph_name, adj_list, nodes, weight_type, node_order,
+                          undirected, async_build, labeled_edges);
 
   return 0;
 }
@@ -280,7 +591,40 @@ int ProcessCliInput(GraphEngineClient &client, std::string &input) {
     size_t it_n = input.find_first_of(" ");
     std::string graph_name = input.substr(0, it_n);
     input = input.substr(it_n + 1, input.length() - it_n);
-    return ProcessCliPost(client, graph_name, input);
+    // Extract the optional node order and direction after the file path
+    graph::NodeOrder node_order = graph::ORIGINAL_ORDER;
+    bool undirected = false;
+    bool async_build = false;
+    bool labeled_edges = false;
+    size_t it_o = input.find_first_of(" ");
+    std::string options;
+    if (it_o != std::string::npos) {
+      options = input.substr(it_o + 1);
+      input = input.substr(0, it_o);
+    }
+    while (!options.empty()) {
+      size_t it_t = options.find_first_of(" ");
+      std::string order = options.substr(0, it_t);
+      options = it_t == std::string::npos ? "" : options.substr(it_t + 1);
+      if (order.compare("undirected") == 0) {
+        undirected = true;
+      } else if (order.compare("async") == 0) {
+        async_build = true;
+      } else if (order.compare("labeled") == 0) {
+        labeled_edges = true;
+      } else if (order.compare("rcm") == 0) {
+        node_order = graph::RCM_ORDER;
+      } else if (order.compare("degree") == 0) {
+        node_order = graph::DEGREE_ORDER;
+      } else if (order.compare("gorder") == 0) {
+        node_order = graph::GORDER;
+      } else if (order.compare("original") != 0) {
+        std::cout << "Invalid node order, please check" << std::endl;
+        return 0;
+      }
+    }
+    return ProcessCliPost(client, graph_name, input, node_order, undirected,
+                          async_build, labeled_edges);
   } else if (command.compare("MIN_DISTANCE") == 0) {
     // Extract graph-id
     size_t it_g = input.find_first_of(" ");
@@ -304,16 +648,215 @@ int ProcessCliInput(GraphEngineClient &client, std::string &input) {
       return 0;
     }
     input = input.substr(it_s + 1, input.length() - it_s);
-    // Extract destination
+    // Extract destination and the optional version
     uint32_t dest_node = 0;
+    uint64_t version = 0;
     try {
-      dest_node = std::stoi(input);
+      size_t it_d = 0;
+      dest_node = std::stoi(input, &it_d);
+      if (input.find_first_not_of(" ", it_d) != std::string::npos)
+        version = std::stoull(input.substr(it_d));
     } catch (...) {
       std::cout << "Invalid command, please check" << std::endl;
       return 0;
     }
     // Make RPC call after extraction
-    client.CalculateMinDistanceRequest(id, src_node, dest_node);
+    client.CalculateMinDistanceRequest(id, src_node, dest_node, version);
+    return 0;
+  } else if (command.compare("WITHIN_HOPS") == 0) {
+    // Extract graph-id, source, destination and the hop limit
+    std::istringstream args(input);
+    uint64_t id = 0;
+    uint32_t src_node = 0;
+    uint32_t dest_node = 0;
+    uint32_t max_hops = 0;
+    if (!(args >> id >> src_node >> dest_node >> max_hops) || max_hops == 0) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    // Make RPC call after extraction
+    client.CalculateMinDistanceRequest(id, src_node, dest_node, 0, max_hops);
+    return 0;
+  } else if (command.compare("EXPLAIN_DISTANCE") == 0) {
+    // Extract graph-id, source, destination and the optional hop limit
+    std::istringstream args(input);
+    uint64_t id = 0;
+    uint32_t src_node = 0;
+    uint32_t dest_node = 0;
+    uint32_t max_hops = 0;
+    if (!(args >> id >> src_node >> dest_node)) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    std::string token;
+    if (args >> token) {
+      try {
+        max_hops = std::stoul(token);
+      } catch (...) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+    }
+    // Make RPC call after extraction
+    client.CalculateMinDistanceRequest(id, src_node, dest_node, 0, max_hops,
+                                       false, 0, true);
+    return 0;
+  } else if (command.compare("APPROX_DISTANCE") == 0) {
+    // Extract graph-id, source, destination and the optional bound width
+    std::istringstream args(input);
+    uint64_t id = 0;
+    uint32_t src_node = 0;
+    uint32_t dest_node = 0;
+    uint32_t max_bound_width = 0;
+    if (!(args >> id >> src_node >> dest_node)) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    std::string token;
+    if (args >> token) {
+      try {
+        max_bound_width = std::stoul(token);
+      } catch (...) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+    }
+    // Make RPC call after extraction
+    client.CalculateMinDistanceRequest(id, src_node, dest_node, 0, 0, true,
+                                       max_bound_width);
+    return 0;
+  } else if (command.compare("NEIGHBORHOOD") == 0) {
+    // Extract graph-id, source, hop limit and the optional node limit
+    std::istringstream args(input);
+    uint64_t id = 0;
+    uint32_t src_node = 0;
+    uint32_t max_hops = 0;
+    uint32_t max_nodes = 0;
+    if (!(args >> id >> src_node >> max_hops)) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    std::string token;
+    if (args >> token) {
+      try {
+        max_nodes = std::stoul(token);
+      } catch (...) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+    }
+    // Make RPC call after extraction
+    client.NeighborhoodRequest(id, src_node, max_hops, max_nodes);
+    return 0;
+  } else if (command.compare("WEIGHTED_DISTANCE") == 0) {
+    // Extract graph-id, source and destination
+    std::istringstream args(input);
+    uint64_t id = 0;
+    uint32_t src_node = 0;
+    uint32_t dest_node = 0;
+    if (!(args >> id >> src_node >> dest_node)) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    // Make RPC call after extraction
+    client.CalculateWeightedDistanceRequest(id, src_node, dest_node);
+    return 0;
+  } else if (command.compare("CONSTRAINED_DISTANCE") == 0) {
+    // Extract graph-id, source, destination and the constraints, each a
+    // keyword followed by a value
+    std::istringstream args(input);
+    uint64_t id = 0;
+    uint32_t src_node = 0;
+    uint32_t dest_node = 0;
+    if (!(args >> id >> src_node >> dest_node)) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    std::vector<uint32_t> edge_labels, node_labels;
+    bool avoid_edge_labels = false, avoid_node_labels = false;
+    uint32_t max_hops = 0;
+    std::string keyword, value;
+    while (args >> keyword) {
+      if (!(args >> value)) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+      // Labels are comma separated
+      std::vector<uint32_t> labels;
+      try {
+        std::istringstream list(value);
+        std::string label;
+        while (std::getline(list, label, ','))
+          labels.push_back(std::stoul(label));
+      } catch (...) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+      if (keyword.compare("edges") == 0 ||
+          keyword.compare("avoid_edges") == 0) {
+        edge_labels = labels;
+        avoid_edge_labels = keyword.compare("avoid_edges") == 0;
+      } else if (keyword.compare("nodes") == 0 ||
+                 keyword.compare("avoid_nodes") == 0) {
+        node_labels = labels;
+        avoid_node_labels = keyword.compare("avoid_nodes") == 0;
+      } else if (keyword.compare("hops") == 0 && labels.size() == 1) {
+        max_hops = labels[0];
+      } else {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+    }
+    // Make RPC call after extraction
+    client.CalculateConstrainedDistanceRequest(
+        id, src_node, dest_node, edge_labels, avoid_edge_labels, node_labels,
+        avoid_node_labels, max_hops);
+    return 0;
+  } else if (command.compare("DISTANCES") == 0) {
+    // Extract graph-id, source and the optional destinations
+    std::istringstream args(input);
+    std::string token;
+    std::vector<uint64_t> values;
+    while (args >> token) {
+      try {
+        values.push_back(std::stoull(token));
+      } catch (...) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+    }
+    if (values.size() < 2) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    std::vector<uint32_t> dest_nodes(values.begin() + 2, values.end());
+    // Make RPC call after extraction
+    client.CalculateDistancesRequest(values[0], values[1], dest_nodes);
+    return 0;
+  } else if (command.compare("ADD_EDGES") == 0 ||
+             command.compare("REMOVE_EDGES") == 0) {
+    // Extract graph-id and the (source, destination) pairs
+    std::istringstream args(input);
+    std::string token;
+    std::vector<uint64_t> values;
+    while (args >> token) {
+      try {
+        values.push_back(std::stoull(token));
+      } catch (...) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+    }
+    if (values.size() < 3 || values.size() % 2 == 0) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    std::vector<GraphQueryEngine::Graph::Edge> edges;
+    for (size_t i = 1; i < values.size(); i += 2)
+      edges.push_back(GraphQueryEngine::Graph::Edge(values[i], values[i + 1]));
+    // Make RPC call after extraction
+    client.EditGraphRequest(values[0], edges,
+                            command.compare("ADD_EDGES") == 0);
     return 0;
   } else if (command.compare("DELETE_GRAPH") == 0) {
     // Extract graph-id
@@ -327,6 +870,74 @@ int ProcessCliInput(GraphEngineClient &client, std::string &input) {
     // Make RPC call after extraction
     client.DeleteGraphRequest(id);
     return 0;
+  } else if (command.compare("SUBMIT_JOB") == 0) {
+    // Extract graph-id and job type
+    size_t it_g = input.find_first_of(" ");
+    uint64_t id = 0;
+    try {
+      id = std::stoull(input.substr(0, it_g));
+    } catch (...) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    std::string job = it_g == std::string::npos ? "" : input.substr(it_g + 1);
+    // Optional time budget after the job type
+    uint32_t time_budget_ms = 0;
+    size_t it_b = job.find_first_of(" ");
+    if (it_b != std::string::npos) {
+      try {
+        time_budget_ms = std::stoul(job.substr(it_b + 1));
+      } catch (...) {
+        std::cout << "Invalid command, please check" << std::endl;
+        return 0;
+      }
+      job = job.substr(0, it_b);
+    }
+    graph::JobType job_type;
+    if (job.compare("components") == 0) {
+      job_type = graph::CONNECTED_COMPONENTS;
+    } else if (job.compare("pagerank") == 0) {
+      job_type = graph::PAGERANK;
+    } else if (job.compare("degrees") == 0) {
+      job_type = graph::DEGREE_HISTOGRAM;
+    } else {
+      std::cout << "Invalid job type, please check" << std::endl;
+      return 0;
+    }
+    // Make RPC call after extraction
+    client.SubmitJobRequest(id, job_type, time_budget_ms);
+    return 0;
+  } else if (command.compare("JOB_STATUS") == 0 ||
+             command.compare("JOB_RESULT") == 0) {
+    // Extract job-id
+    uint64_t id = 0;
+    try {
+      id = std::stoull(input);
+    } catch (...) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    // Make RPC call after extraction
+    if (command.compare("JOB_STATUS") == 0)
+      client.JobStatusRequest(id);
+    else
+      client.JobResultRequest(id);
+    return 0;
+  } else if (command.compare("GRAPH_STATUS") == 0) {
+    // Extract graph-id
+    uint64_t id = 0;
+    try {
+      id = std::stoull(input);
+    } catch (...) {
+      std::cout << "Invalid command, please check" << std::endl;
+      return 0;
+    }
+    // Make RPC call after extraction
+    client.GraphStatusRequest(id);
+    return 0;
+  } else if (command.compare("STATS") == 0) {
+    client.ServerStatsRequest();
+    return 0;
   } else if (command.compare("QUIT") == 0) {
     return 1;
   } else {
@@ -343,8 +954,26 @@ int main(int argc, char **argv) {
   // are created. This channel models a connection to an endpoint (in this case,
   // localhost at port 50051). We indicate that the channel isn't authenticated
   // (use of InsecureChannelCredentials()).
-  GraphEngineClient graph_client(grpc::CreateChannel(
-      "localhost:50051", grpc::InsecureChannelCredentials()));
+  // With --deadline_ms=<n>, requests still running n ms after they were
+  // sent fail with DEADLINE_EXCEEDED and the server stops their traversals.
+  // --tenant=<name> and --priority=interactive|bulk tag every request for
+  // the scheduler of the server.
+  uint32_t deadline_ms = 0;
+  std::string tenant;
+  std::string priority;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 14, "--deadline_ms=") == 0)
+      deadline_ms = std::stoul(arg.substr(14));
+    else if (arg.compare(0, 9, "--tenant=") == 0)
+      tenant = arg.substr(9);
+    else if (arg.compare(0, 11, "--priority=") == 0)
+      priority = arg.substr(11);
+  }
+  GraphEngineClient graph_client(
+      grpc::CreateChannel("localhost:50051",
+                          grpc::InsecureChannelCredentials()),
+      deadline_ms, tenant, priority);
 
   // Spawn reader thread that loops indefinitely
   std::thread thread_ =
@@ -354,10 +983,43 @@ int main(int argc, char **argv) {
 
   std::cout << "Graph Engine CLI Usage: " << std::endl;
   std::cout << "<CMD> [options]" << std::endl;
-  std::cout << "POST_GRAPH <graph-name> <path-to-graph-file>" << std::endl;
-  std::cout << "MIN_DISTANCE <graph-id> <source_node> <destination_node>"
+  std::cout << "POST_GRAPH <graph-name> <path-to-graph-file> "
+               "[original|rcm|degree|gorder] [undirected] [async] [labeled]"
+            << std::endl;
+  std::cout << "MIN_DISTANCE <graph-id> <source_node> <destination_node> "
+               "[<version>]"
+            << std::endl;
+  std::cout << "WITHIN_HOPS <graph-id> <source_node> <destination_node> "
+               "<max_hops>"
+            << std::endl;
+  std::cout << "EXPLAIN_DISTANCE <graph-id> <source_node> <destination_node> "
+               "[<max_hops>]"
+            << std::endl;
+  std::cout << "NEIGHBORHOOD <graph-id> <source_node> <max_hops> [<max_nodes>]"
+            << std::endl;
+  std::cout << "APPROX_DISTANCE <graph-id> <source_node> <destination_node> "
+               "[<max_bound_width>]"
+            << std::endl;
+  std::cout << "WEIGHTED_DISTANCE <graph-id> <source_node> <destination_node>"
+            << std::endl;
+  std::cout << "CONSTRAINED_DISTANCE <graph-id> <source_node> "
+               "<destination_node> [edges|avoid_edges <label,...>] "
+               "[nodes|avoid_nodes <label,...>] [hops <max_hops>]"
+            << std::endl;
+  std::cout << "DISTANCES <graph-id> <source_node> [<destination_node> ...]"
+            << std::endl;
+  std::cout << "ADD_EDGES <graph-id> <source_node> <destination_node> ..."
+            << std::endl;
+  std::cout << "REMOVE_EDGES <graph-id> <source_node> <destination_node> ..."
             << std::endl;
   std::cout << "DELETE_GRAPH <graph-id>" << std::endl;
+  std::cout << "GRAPH_STATUS <graph-id>" << std::endl;
+  std::cout << "SUBMIT_JOB <graph-id> components|pagerank|degrees "
+               "[<time_budget_ms>]"
+            << std::endl;
+  std::cout << "JOB_STATUS <job-id>" << std::endl;
+  std::cout << "JOB_RESULT <job-id>" << std::endl;
+  std::cout << "STATS" << std::endl;
   std::cout << "QUIT" << std::endl << std::endl;
   std::cout << "Waiting on user input ..." << std::endl;
   while (1) {
@@ -13,8 +13,10 @@
  *
  */
 
+#include <chrono>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
 
@@ -34,6 +36,7 @@ using graph::Request;
 using graph::Response;
 using grpc::Server;
 using grpc::ServerAsyncResponseWriter;
+using grpc::ServerAsyncWriter;
 using grpc::ServerBuilder;
 using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
@@ -41,6 +44,9 @@ using grpc::Status;
 
 class ServerImpl final {
 public:
+  explicit ServerImpl(const GraphQueryEngine::GraphEngineOptions &options)
+      : options_(options) {}
+
   ~ServerImpl() {
     server_->Shutdown();
     // Always shutdown the completion queue after the server.
@@ -61,7 +67,8 @@ public:
     // with the gRPC runtime.
     cq_ = builder.AddCompletionQueue();
     // Initialize the graph service
-    graph_query_engine_ = std::make_shared<GraphQueryEngine::GraphEngine>();
+    graph_query_engine_ =
+        std::make_shared<GraphQueryEngine::GraphEngine>(options_);
     // Finally assemble the server.
     server_ = builder.BuildAndStart();
     std::cout << "Server listening on " << server_address << std::endl;
@@ -71,8 +78,104 @@ public:
   }
 
 private:
+  // Common interface of the per-RPC state machines, the completion queue tag
+  // of every event is a pointer to one of these.
+  class CallDataBase {
+  public:
+    virtual ~CallDataBase() = default;
+    // Advance the state machine, ok is the status of the completed event
+    virtual void Proceed(bool ok) = 0;
+  };
+
+  // Deadline and cancellation of an RPC, handed to the engine as the query
+  // control of its request. Its own tag completes once the RPC is done, the
+  // call data owning it is deleted once both that tag and the last event of
+  // the call completed.
+  class RpcControl : public CallDataBase {
+  public:
+    explicit RpcControl(CallDataBase *call) : call_(call) {}
+
+    // Ask for the done event, before the RPC is requested
+    void Watch(ServerContext *ctx) {
+      ctx_ = ctx;
+      ctx_->AsyncNotifyWhenDone(this);
+    }
+
+    // Control of the request received, with the deadline the client set
+    GraphQueryEngine::QueryControlSharedPtr Start() {
+      using std::chrono::system_clock;
+      using GraphQueryEngine::QueryControl;
+      system_clock::time_point deadline = ctx_->deadline();
+      system_clock::time_point now = system_clock::now();
+      // Clients without a deadline get one far in the future
+      if (deadline > now + std::chrono::hours(24 * 365)) {
+        control_ = std::make_shared<QueryControl>();
+      } else {
+        control_ = std::make_shared<QueryControl>(
+            QueryControl::Clock::now() +
+            std::chrono::duration_cast<QueryControl::Clock::duration>(
+                deadline - now));
+      }
+      return control_;
+    }
+
+    // The RPC is done, cancelled if the client went away before the reply
+    void Proceed(bool) override {
+      if (control_ && ctx_->IsCancelled())
+        control_->Cancel();
+      done_ = true;
+      if (finished_)
+        delete call_;
+    }
+
+    // The last event of the call completed, true if it may be deleted now
+    bool Finish() {
+      finished_ = true;
+      return done_;
+    }
+
+  private:
+    CallDataBase *call_;
+    ServerContext *ctx_ = nullptr;
+    GraphQueryEngine::QueryControlSharedPtr control_;
+    bool done_ = false;
+    bool finished_ = false;
+  };
+
+  // Status of a reply, queries stopped by their control fail with the
+  // reason so that clients can tell them from answers
+  static Status ReplyStatus(const std::string &message) {
+    switch (GraphQueryEngine::GraphEngine::StopOf(message)) {
+    case GraphQueryEngine::QUERY_CANCELLED:
+      return Status(grpc::StatusCode::CANCELLED, message);
+    case GraphQueryEngine::QUERY_DEADLINE_EXCEEDED:
+      return Status(grpc::StatusCode::DEADLINE_EXCEEDED, message);
+    default:
+      return Status::OK;
+    }
+  }
+
+  // Scheduling class and tenant of a request that only carries them in the
+  // x-priority (interactive or bulk) and x-tenant metadata of the call
+  static void ApplyMetadata(const ServerContext &ctx, Request *request) {
+    const auto &metadata = ctx.client_metadata();
+    auto tenant = metadata.find("x-tenant");
+    if (request->tenant().empty() && tenant != metadata.end())
+      request->set_tenant(
+          std::string(tenant->second.data(), tenant->second.size()));
+    auto priority = metadata.find("x-priority");
+    if (request->priority() == graph::AUTO_PRIORITY &&
+        priority != metadata.end()) {
+      std::string value(priority->second.data(), priority->second.size());
+      if (value.compare("interactive") == 0)
+        request->set_priority(graph::INTERACTIVE_PRIORITY);
+      else if (value.compare("bulk") == 0)
+        request->set_priority(graph::BULK_PRIORITY);
+    }
+  }
+
   // Class encompasing the state and logic needed to serve a request.
-  class CallData {
+  class CallData : public CallDataBase {
   public:
     // Take in the "service" instance (in this case representing an asynchronous
     // server) and the completion queue "cq" used for asynchronous communication
@@ -80,15 +183,18 @@ private:
     CallData(GraphEngine::AsyncService *service, ServerCompletionQueue *cq,
              GraphQueryEngine::GraphEngineSharedPtr graph_qe)
         : service_(service), cq_(cq), graph_qe_(graph_qe), responder_(&ctx_),
-          status_(CREATE) {
+          status_(CREATE), control_(this) {
       // Invoke the serving logic right away.
-      Proceed();
+      Proceed(true);
     }
 
-    void Proceed() {
+    void Proceed(bool ok) override {
+      // Finishing a cancelled RPC fails, the reply is dropped
+      GPR_ASSERT(ok || status_ == FINISH);
       if (status_ == CREATE) {
         // Make this instance progress to the PROCESS state.
         status_ = PROCESS;
+        control_.Watch(&ctx_);
 
         // As part of the initial CREATE state, we *request* that the system
         // start processing SayHello requests. In this request, "this" acts are
@@ -103,18 +209,29 @@ private:
         // part of its FINISH state.
         new CallData(service_, cq_, graph_qe_);
 
-        // The actual processing.
-        reply_.set_message(graph_qe_->ProcessRequest(request_));
+        // The actual processing, on the engine's compute pool in the class
+        // and for the tenant of the request. Nothing holds this thread
+        // meanwhile, the callback completes the RPC from the compute thread.
+        // Queries stop early once the deadline passed or the client
+        // cancelled.
+        ApplyMetadata(ctx_, &request_);
+        graph_qe_->ProcessRequestAsync(
+            request_,
+            [this](const std::string &message) {
+              reply_.set_message(message);
 
-        // And we are done! Let the gRPC runtime know we've finished, using the
-        // memory address of this instance as the uniquely identifying tag for
-        // the event.
-        status_ = FINISH;
-        responder_.Finish(reply_, Status::OK, this);
+              // And we are done! Let the gRPC runtime know we've finished,
+              // using the memory address of this instance as the uniquely
+              // identifying tag for the event.
+              status_ = FINISH;
+              responder_.Finish(reply_, ReplyStatus(message), this);
+            },
+            control_.Start());
       } else {
         GPR_ASSERT(status_ == FINISH);
-        // Once in the FINISH state, deallocate ourselves (CallData).
-        delete this;
+        // Once in the FINISH state and done, deallocate ourselves (CallData).
+        if (control_.Finish())
+          delete this;
       }
     }
 
@@ -142,12 +259,97 @@ private:
     // Let's implement a tiny state machine with the following states.
     enum CallStatus { CREATE, PROCESS, FINISH };
     CallStatus status_; // The current serving state.
+    // Deadline and cancellation of the RPC
+    RpcControl control_;
+  };
+
+  // State and logic needed to serve a request whose result is streamed back
+  // in chunks. Chunks are packed one at a time, the next one only once the
+  // previous write has completed.
+  class StreamCallData : public CallDataBase {
+  public:
+    StreamCallData(GraphEngine::AsyncService *service,
+                   ServerCompletionQueue *cq,
+                   GraphQueryEngine::GraphEngineSharedPtr graph_qe)
+        : service_(service), cq_(cq), graph_qe_(graph_qe), writer_(&ctx_),
+          status_(CREATE), control_(this) {
+      Proceed(true);
+    }
+
+    void Proceed(bool ok) override {
+      if (status_ == CREATE) {
+        status_ = PROCESS;
+        control_.Watch(&ctx_);
+        service_->RequestGraphEngineStreamRequest(&ctx_, &request_, &writer_,
+                                                  cq_, cq_, this);
+      } else if (status_ == PROCESS) {
+        // The server is shutting down, no request was received
+        if (!ok) {
+          status_ = FINISH;
+          if (control_.Finish())
+            delete this;
+          return;
+        }
+        new StreamCallData(service_, cq_, graph_qe_);
+
+        ApplyMetadata(ctx_, &request_);
+        graph_qe_->ProcessStreamRequestAsync(
+            request_,
+            [this](GraphQueryEngine::StreamResultSharedPtr result) {
+              result_ = result;
+              // Stopped queries have nothing to stream
+              Status status = ReplyStatus(result_->message);
+              if (!status.ok()) {
+                status_ = FINISH;
+                writer_.Finish(status, this);
+                return;
+              }
+              status_ = WRITE;
+              // Every result carries at least one chunk with its message
+              result_->NextChunk(&chunk_);
+              writer_.Write(chunk_, this);
+            },
+            control_.Start());
+      } else if (status_ == WRITE) {
+        // A failed write means the client went away, stop streaming
+        if (ok && result_->NextChunk(&chunk_)) {
+          writer_.Write(chunk_, this);
+          return;
+        }
+        status_ = FINISH;
+        writer_.Finish(ok ? Status::OK : Status::CANCELLED, this);
+      } else {
+        GPR_ASSERT(status_ == FINISH);
+        if (control_.Finish())
+          delete this;
+      }
+    }
+
+  private:
+    GraphEngine::AsyncService *service_;
+    ServerCompletionQueue *cq_;
+    GraphQueryEngine::GraphEngineSharedPtr graph_qe_;
+    ServerContext ctx_;
+
+    // What we get from the client.
+    Request request_;
+    // Result of the request, packed into chunk_ one write at a time.
+    GraphQueryEngine::StreamResultSharedPtr result_;
+    Response chunk_;
+
+    // The means to stream back to the client.
+    ServerAsyncWriter<Response> writer_;
+
+    enum CallStatus { CREATE, PROCESS, WRITE, FINISH };
+    CallStatus status_;
+    RpcControl control_;
   };
 
   // This can be run in multiple threads if needed.
   void HandleRpcs() {
     // Spawn a new CallData instance to serve new clients.
     new CallData(&service_, cq_.get(), graph_query_engine_);
+    new StreamCallData(&service_, cq_.get(), graph_query_engine_);
     void *tag; // uniquely identifies a request.
     bool ok;
     while (true) {
@@ -157,8 +359,7 @@ private:
       // The return value of Next should always be checked. This return value
       // tells us whether there is any kind of event or cq_ is shutting down.
       GPR_ASSERT(cq_->Next(&tag, &ok));
-      GPR_ASSERT(ok);
-      static_cast<CallData *>(tag)->Proceed();
+      static_cast<CallDataBase *>(tag)->Proceed(ok);
     }
   }
 
@@ -166,10 +367,120 @@ private:
   GraphEngine::AsyncService service_;
   std::unique_ptr<Server> server_;
   GraphQueryEngine::GraphEngineSharedPtr graph_query_engine_;
+  GraphQueryEngine::GraphEngineOptions options_;
 };
 
+// Parse --flag=value command line options into the engine options
+bool ParseServerFlags(int argc, char **argv,
+                      GraphQueryEngine::GraphEngineOptions *options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    size_t eq = arg.find('=');
+    std::string name = arg.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    try {
+      if (name.compare("--distance_cache_mb") == 0) {
+        options->distance_cache_bytes = std::stoull(value) << 20;
+      } else if (name.compare("--compute_threads") == 0) {
+        options->compute_threads = std::stoul(value);
+      } else if (name.compare("--build_threads") == 0) {
+        options->build_threads = std::stoul(value);
+      } else if (name.compare("--analytics_threads") == 0) {
+        options->analytics_threads = std::stoul(value);
+      } else if (name.compare("--background_nice") == 0) {
+        options->background_nice = std::stoi(value);
+      } else if (name.compare("--fair_queuing") == 0) {
+        options->scheduling.fair_queuing =
+            value.empty() || value.compare("true") == 0;
+      } else if (name.compare("--interactive_weight") == 0) {
+        options->scheduling.interactive_weight = std::stoul(value);
+      } else if (name.compare("--bulk_weight") == 0) {
+        options->scheduling.bulk_weight = std::stoul(value);
+      } else if (name.compare("--interactive_reserved_threads") == 0) {
+        options->scheduling.interactive_reserved_threads = std::stoul(value);
+      } else if (name.compare("--tenant_max_running") == 0) {
+        options->scheduling.tenant_max_running = std::stoul(value);
+      } else if (name.compare("--delta_stepping_threads") == 0) {
+        options->delta_stepping_threads = std::stoul(value);
+      } else if (name.compare("--delta_stepping_teams") == 0) {
+        options->delta_stepping_teams = std::stoul(value);
+      } else if (name.compare("--delta_stepping_min_edges") == 0) {
+        options->delta_stepping_min_edges = std::stoull(value);
+      } else if (name.compare("--landmarks") == 0) {
+        options->num_landmarks = std::stoul(value);
+      } else if (name.compare("--ingest_threads") == 0) {
+        options->ingest_threads = std::stoul(value);
+      } else if (name.compare("--drop_self_loops") == 0) {
+        options->drop_self_loops = value.empty() || value.compare("true") == 0;
+      } else if (name.compare("--adjacency_encoding") == 0) {
+        if (value.compare("plain") == 0)
+          options->adjacency_encoding = GraphQueryEngine::PLAIN_ADJACENCY;
+        else if (value.compare("compressed") == 0)
+          options->adjacency_encoding = GraphQueryEngine::COMPRESSED_ADJACENCY;
+        else if (value.compare("auto") == 0)
+          options->adjacency_encoding = GraphQueryEngine::AUTO_ADJACENCY;
+        else
+          throw std::invalid_argument(value);
+      } else if (name.compare("--compression_min_mb") == 0) {
+        options->compression_min_bytes = std::stoull(value) << 20;
+      } else if (name.compare("--memory_budget_mb") == 0) {
+        options->memory_budget_bytes = std::stoull(value) << 20;
+      } else if (name.compare("--spill_dir") == 0) {
+        if (value.empty())
+          throw std::invalid_argument(value);
+        options->spill_directory = value;
+      } else if (name.compare("--out_of_core") == 0) {
+        options->out_of_core = value.empty() || value.compare("true") == 0;
+      } else if (name.compare("--numa_placement") == 0) {
+        if (value.compare("local") == 0)
+          options->placement.placement = GraphQueryEngine::LOCAL_PLACEMENT;
+        else if (value.compare("interleave") == 0)
+          options->placement.placement =
+              GraphQueryEngine::INTERLEAVE_PLACEMENT;
+        else if (value.compare("replicate") == 0)
+          options->placement.placement = GraphQueryEngine::REPLICATE_PLACEMENT;
+        else
+          throw std::invalid_argument(value);
+      } else if (name.compare("--huge_pages") == 0) {
+        options->placement.huge_pages =
+            value.empty() || value.compare("true") == 0;
+      } else if (name.compare("--placement_min_mb") == 0) {
+        options->placement.min_bytes = std::stoull(value) << 20;
+      } else {
+        std::cout << "Unknown flag " << arg << std::endl;
+        return false;
+      }
+    } catch (...) {
+      std::cout << "Invalid value for flag " << arg << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
 int main(int argc, char **argv) {
-  ServerImpl server;
+  GraphQueryEngine::GraphEngineOptions options;
+  if (!ParseServerFlags(argc, argv, &options)) {
+    std::cout << "Usage: async_server [--distance_cache_mb=<MB>] "
+                 "[--compute_threads=<N>] [--delta_stepping_threads=<N>] "
+                 "[--delta_stepping_teams=<N>] [--delta_stepping_min_edges=<N>] "
+                 "[--landmarks=<N>] "
+                 "[--ingest_threads=<N>] [--drop_self_loops] "
+                 "[--adjacency_encoding=plain|compressed|auto] "
+                 "[--compression_min_mb=<MB>] [--memory_budget_mb=<MB>] "
+                 "[--spill_dir=<path>] [--out_of_core] "
+                 "[--numa_placement=local|interleave|replicate] "
+                 "[--huge_pages] [--placement_min_mb=<MB>] "
+                 "[--build_threads=<N>] [--analytics_threads=<N>] "
+                 "[--background_nice=<N>] [--fair_queuing=true|false] "
+                 "[--interactive_weight=<N>] [--bulk_weight=<N>] "
+                 "[--interactive_reserved_threads=<N>] "
+                 "[--tenant_max_running=<N>]"
+              << std::endl;
+    return 1;
+  }
+
+  ServerImpl server(options);
   server.Run();
 
   return 0;
@@ -0,0 +1,100 @@
+#include "src/include/graph.h"
+#include <limits>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+namespace {
+/*
+ * Visit the out-going neighbors of a node over the edges in a set. Plain
+ * lists walk the set bits of the edges of the node, compressed lists have
+ * to be decoded in full and test the bit of every edge.
+ */
+template <typename NodeId, typename Visit>
+bool ForEachNeighborIn(const PlainNeighbors<NodeId> &neighbors,
+                       const CsrAdjacency &, uint32_t node,
+                       const Bitmap &edges, Visit visit) {
+  return neighbors.ForEachNeighborIn(node, edges, visit);
+}
+
+template <typename Visit>
+bool ForEachNeighborIn(const CompressedNeighbors &neighbors,
+                       const CsrAdjacency &adjacency, uint32_t node,
+                       const Bitmap &edges, Visit visit) {
+  uint32_t edge = adjacency.FirstEdge(node);
+  return neighbors.ForEachNeighbor(node, [&](uint32_t next) {
+    return !edges.Test(edge++) || visit(next);
+  });
+}
+} // namespace
+
+uint32_t GraphVersion::ConstrainedBfs(uint32_t src, uint32_t dest,
+                                      const Bitmap *edges, const Bitmap *nodes,
+                                      uint32_t max_hops) const {
+  if (nodes != nullptr && (!nodes->Test(src) || !nodes->Test(dest)))
+    return std::numeric_limits<uint32_t>::max();
+  // The subgraph reaches no more than the whole graph does
+  if (!MayReach(src, dest))
+    return std::numeric_limits<uint32_t>::max();
+  return Local().Dispatch([&](const auto &neighbors) {
+    return this->ConstrainedBfs(neighbors, src, dest, edges, nodes, max_hops);
+  });
+}
+
+template <typename Neighbors>
+uint32_t GraphVersion::ConstrainedBfs(const Neighbors &neighbors, uint32_t src,
+                                      uint32_t dest, const Bitmap *edges,
+                                      const Bitmap *nodes,
+                                      uint32_t max_hops) const {
+  typedef typename Neighbors::Node Node;
+  if (src == dest)
+    return 0;
+
+  const CsrAdjacency &local = Local();
+  Bitmap visited(NumNodes());
+  std::vector<Node> frontier(1, src);
+  std::vector<Node> next_frontier;
+  visited.Set(src);
+  uint32_t depth = 0;
+  bool found = false;
+  QueryCheckpoint checkpoint(NumNodes());
+  auto discover = [&](uint32_t next) {
+    if (visited.Test(next) || (nodes != nullptr && !nodes->Test(next)))
+      return true;
+    if (next == dest) {
+      found = true;
+      return false;
+    }
+    visited.Set(next);
+    next_frontier.push_back(next);
+    return true;
+  };
+
+  // Level by level, the depth of dest is known once a level discovers it
+  while (!frontier.empty() && (max_hops == 0 || depth < max_hops)) {
+    depth++;
+    next_frontier.clear();
+    for (uint32_t x : frontier) {
+      if (checkpoint.Stop())
+        return std::numeric_limits<uint32_t>::max();
+      if (edges == nullptr) {
+        ForEachNeighbor(neighbors, x, discover);
+      } else {
+        // Edge labeled graphs take no inserted edges, only removals are
+        // merged in
+        bool removals = delta.HasRemovals(x);
+        ForEachNeighborIn(neighbors, local, x, *edges, [&](uint32_t next) {
+          if (removals && delta.Removed(x, next))
+            return true;
+          return discover(next);
+        });
+      }
+      if (found)
+        return depth;
+    }
+    frontier.swap(next_frontier);
+  }
+  return std::numeric_limits<uint32_t>::max();
+}
+
+} // namespace GraphQueryEngine
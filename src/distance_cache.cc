@@ -0,0 +1,206 @@
+#include "src/include/distance_cache.h"
+#include "src/include/binary_io.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace GraphQueryEngine {
+
+namespace {
+constexpr uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+} // namespace
+
+DistanceArray::DistanceArray(const std::vector<uint32_t> &distances)
+    : num_nodes(distances.size()) {
+  uint32_t max_distance = 0;
+  for (uint32_t distance : distances) {
+    if (distance != kUnreachable)
+      max_distance = std::max(max_distance, distance);
+  }
+
+  // The largest value of every width is reserved for unreachable nodes
+  if (max_distance < std::numeric_limits<uint8_t>::max())
+    width = sizeof(uint8_t);
+  else if (max_distance < std::numeric_limits<uint16_t>::max())
+    width = sizeof(uint16_t);
+  else
+    width = sizeof(uint32_t);
+
+  data.resize(size_t(num_nodes) * width);
+  for (uint32_t i = 0; i < num_nodes; i++) {
+    if (width == sizeof(uint8_t)) {
+      data[i] = distances[i] == kUnreachable
+                    ? std::numeric_limits<uint8_t>::max()
+                    : distances[i];
+    } else if (width == sizeof(uint16_t)) {
+      uint16_t value = distances[i] == kUnreachable
+                           ? std::numeric_limits<uint16_t>::max()
+                           : distances[i];
+      std::memcpy(&data[size_t(i) * width], &value, width);
+    } else {
+      std::memcpy(&data[size_t(i) * width], &distances[i], width);
+    }
+  }
+}
+
+uint32_t DistanceArray::Get(uint32_t node) const {
+  if (width == sizeof(uint8_t)) {
+    uint8_t value = data[node];
+    return value == std::numeric_limits<uint8_t>::max() ? kUnreachable : value;
+  }
+  if (width == sizeof(uint16_t)) {
+    uint16_t value;
+    std::memcpy(&value, &data[size_t(node) * width], width);
+    return value == std::numeric_limits<uint16_t>::max() ? kUnreachable
+                                                          : value;
+  }
+  uint32_t value;
+  std::memcpy(&value, &data[size_t(node) * width], width);
+  return value;
+}
+
+std::vector<uint32_t> DistanceArray::Decode() const {
+  std::vector<uint32_t> distances(num_nodes);
+  for (uint32_t i = 0; i < num_nodes; i++)
+    distances[i] = Get(i);
+  return distances;
+}
+
+void DistanceArray::Save(std::ostream &out) const {
+  WriteValue(out, num_nodes);
+  WriteValue(out, width);
+  WriteVector(out, data);
+}
+
+bool DistanceArray::Load(std::istream &in) {
+  return ReadValue(in, &num_nodes) && ReadValue(in, &width) &&
+         ReadVector(in, &data);
+}
+
+size_t DistanceCache::CacheKeyHash::operator()(const CacheKey &key) const {
+  // 64-bit mix of both fields, graph ids are already hash values
+  uint64_t h = key.graph_id ^ (uint64_t(key.src) * 0x9e3779b97f4a7c15ULL);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+DistanceCache::DistanceCache(size_t capacity_bytes)
+    : capacity_bytes(capacity_bytes), doorkeeper(kDoorkeeperSlots, 0) {}
+
+DistanceArraySharedPtr DistanceCache::Lookup(uint64_t graph_id, uint32_t src,
+                                             uint64_t version) {
+  std::lock_guard<std::mutex> guard(cache_mutex);
+  auto it = slots.find(CacheKey{graph_id, src});
+  if (it == slots.end() || ring[it->second].version != version) {
+    stats.misses++;
+    return nullptr;
+  }
+  stats.hits++;
+  ring[it->second].referenced = true;
+  return ring[it->second].distances;
+}
+
+bool DistanceCache::Admit(uint64_t graph_id, uint32_t src) {
+  // Zero marks an empty doorkeeper slot, keep the tag odd
+  uint64_t tag = CacheKeyHash()(CacheKey{graph_id, src}) | 1;
+  std::lock_guard<std::mutex> guard(cache_mutex);
+  uint64_t &slot = doorkeeper[tag % kDoorkeeperSlots];
+  if (slot == tag) {
+    slot = 0;
+    return true;
+  }
+  slot = tag;
+  return false;
+}
+
+bool DistanceCache::Admitted(uint64_t graph_id, uint32_t src) {
+  uint64_t tag = CacheKeyHash()(CacheKey{graph_id, src}) | 1;
+  std::lock_guard<std::mutex> guard(cache_mutex);
+  return doorkeeper[tag % kDoorkeeperSlots] == tag;
+}
+
+void DistanceCache::Insert(uint64_t graph_id, uint32_t src, uint64_t version,
+                           DistanceArraySharedPtr distances) {
+  size_t entry_bytes = distances->Bytes() + kEntryOverhead;
+  if (entry_bytes > capacity_bytes)
+    return;
+
+  std::lock_guard<std::mutex> guard(cache_mutex);
+  CacheKey key{graph_id, src};
+  auto it = slots.find(key);
+  bool referenced = false;
+  if (it != slots.end()) {
+    // Concurrent misses of the same source may both try to insert
+    if (ring[it->second].version >= version)
+      return;
+    // A newer version takes over the slot, and its reference bit
+    referenced = ring[it->second].referenced;
+    RemoveSlot(it->second);
+  }
+
+  MakeRoom(entry_bytes);
+  slots[key] = ring.size();
+  ring.push_back(Entry{key, version, distances, referenced});
+  used_bytes += entry_bytes;
+  stats.insertions++;
+}
+
+void DistanceCache::InvalidateGraph(uint64_t graph_id) {
+  std::lock_guard<std::mutex> guard(cache_mutex);
+  // Walk backwards, RemoveSlot moves the last entry into the freed slot
+  for (size_t slot = ring.size(); slot-- > 0;) {
+    if (ring[slot].key.graph_id == graph_id) {
+      RemoveSlot(slot);
+      stats.invalidations++;
+    }
+  }
+}
+
+std::vector<std::pair<uint32_t, DistanceArraySharedPtr>>
+DistanceCache::GraphEntries(uint64_t graph_id, uint64_t version) {
+  std::lock_guard<std::mutex> guard(cache_mutex);
+  std::vector<std::pair<uint32_t, DistanceArraySharedPtr>> entries;
+  for (const Entry &entry : ring) {
+    if (entry.key.graph_id == graph_id && entry.version == version)
+      entries.push_back(std::make_pair(entry.key.src, entry.distances));
+  }
+  return entries;
+}
+
+DistanceCacheStats DistanceCache::Stats() {
+  std::lock_guard<std::mutex> guard(cache_mutex);
+  DistanceCacheStats result = stats;
+  result.entries = ring.size();
+  result.bytes = used_bytes;
+  result.capacity_bytes = capacity_bytes;
+  return result;
+}
+
+void DistanceCache::MakeRoom(size_t bytes_needed) {
+  while (!ring.empty() && used_bytes + bytes_needed > capacity_bytes) {
+    if (hand >= ring.size())
+      hand = 0;
+    // Referenced entries get a second chance
+    if (ring[hand].referenced) {
+      ring[hand].referenced = false;
+      hand++;
+      continue;
+    }
+    RemoveSlot(hand);
+    stats.evictions++;
+  }
+}
+
+void DistanceCache::RemoveSlot(size_t slot) {
+  used_bytes -= ring[slot].distances->Bytes() + kEntryOverhead;
+  slots.erase(ring[slot].key);
+  if (slot != ring.size() - 1) {
+    ring[slot] = std::move(ring.back());
+    slots[ring[slot].key] = slot;
+  }
+  ring.pop_back();
+}
+
+} // namespace GraphQueryEngine
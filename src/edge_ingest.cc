@@ -0,0 +1,199 @@
+#include "src/include/edge_ingest.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+namespace {
+// Bits sorted per radix pass
+constexpr uint32_t kRadixBits = 8;
+constexpr uint32_t kRadixBuckets = 1 << kRadixBits;
+
+// Slice [begin, end) of size items handled by a member of the team
+void MemberRange(size_t size, uint32_t member, uint32_t members,
+                 size_t *begin, size_t *end) {
+  *begin = size * member / members;
+  *end = size * (member + 1) / members;
+}
+
+/*
+ * Stable LSD radix sort of keys, carrying a payload along
+ * @param key_bits, number of low bits that can be set in the keys
+ */
+void RadixSort(std::vector<uint64_t> &keys, std::vector<uint32_t> &payload,
+               uint32_t key_bits, ThreadTeam &team) {
+  size_t size = keys.size();
+  uint32_t members = team.Size();
+  std::vector<uint64_t> key_buffer(size);
+  std::vector<uint32_t> payload_buffer(size);
+  // Bucket counts of every member, then the position of its next item
+  std::vector<size_t> counts(size_t(members) * kRadixBuckets);
+
+  for (uint32_t shift = 0; shift < key_bits; shift += kRadixBits) {
+    std::fill(counts.begin(), counts.end(), 0);
+    team.Run([&](uint32_t member) {
+      size_t begin, end;
+      MemberRange(size, member, members, &begin, &end);
+      size_t *member_counts = &counts[size_t(member) * kRadixBuckets];
+      for (size_t i = begin; i < end; i++)
+        member_counts[(keys[i] >> shift) & (kRadixBuckets - 1)]++;
+    });
+
+    // Positions in (bucket, member) order keep the sort stable
+    size_t total = 0;
+    for (uint32_t bucket = 0; bucket < kRadixBuckets; bucket++) {
+      for (uint32_t member = 0; member < members; member++) {
+        size_t &count = counts[size_t(member) * kRadixBuckets + bucket];
+        size_t bucket_count = count;
+        count = total;
+        total += bucket_count;
+      }
+    }
+
+    team.Run([&](uint32_t member) {
+      size_t begin, end;
+      MemberRange(size, member, members, &begin, &end);
+      size_t *member_counts = &counts[size_t(member) * kRadixBuckets];
+      for (size_t i = begin; i < end; i++) {
+        size_t position =
+            member_counts[(keys[i] >> shift) & (kRadixBuckets - 1)]++;
+        key_buffer[position] = keys[i];
+        payload_buffer[position] = payload[i];
+      }
+    });
+    keys.swap(key_buffer);
+    payload.swap(payload_buffer);
+  }
+}
+} // namespace
+
+std::string IngestEdges(
+    const google::protobuf::RepeatedPtrField<graph::Edges> &edges,
+    uint32_t num_nodes, WeightType weight_type, bool labeled,
+    bool drop_self_loops, bool undirected, ThreadTeam &team,
+    CsrAdjacency *adjacency) {
+  size_t num_posted = edges.size();
+  // An undirected edge is sorted in as both of its directions
+  size_t copies = undirected ? 2 : 1;
+  size_t num_edges = num_posted * copies;
+  uint32_t members = team.Size();
+
+  // Key of an edge is (source, target) packed into the bits node ids need
+  uint32_t node_bits = 1;
+  while (node_bits < 32 && (uint64_t(1) << node_bits) < num_nodes)
+    node_bits++;
+  const uint64_t target_mask = (uint64_t(1) << node_bits) - 1;
+
+  std::vector<uint64_t> keys(num_edges);
+  std::vector<uint32_t> order(num_edges);
+  std::atomic<bool> invalid_node{false};
+  std::atomic<bool> negative_weight{false};
+  team.Run([&](uint32_t member) {
+    size_t begin, end;
+    MemberRange(num_posted, member, members, &begin, &end);
+    for (size_t i = begin; i < end; i++) {
+      const graph::Edges &edge = edges.Get(i);
+      if (edge.src() >= num_nodes || edge.dest() >= num_nodes)
+        invalid_node = true;
+      if (weight_type == FLOAT_WEIGHTS && !(edge.float_weight() >= 0))
+        negative_weight = true;
+      keys[copies * i] = (uint64_t(edge.src()) << node_bits) | edge.dest();
+      order[copies * i] = i;
+      if (undirected) {
+        keys[2 * i + 1] = (uint64_t(edge.dest()) << node_bits) | edge.src();
+        order[2 * i + 1] = i;
+      }
+    }
+  });
+  if (invalid_node)
+    return "ERROR: Node not present in graph";
+  if (negative_weight)
+    return "ERROR: Edge weights must not be negative";
+
+  RadixSort(keys, order, 2 * node_bits, team);
+
+  // The first edge of every run of duplicates is kept
+  auto kept = [&](size_t i) {
+    if (i > 0 && keys[i] == keys[i - 1])
+      return false;
+    return !drop_self_loops || (keys[i] >> node_bits) != (keys[i] & target_mask);
+  };
+  std::vector<size_t> kept_before(members + 1, 0);
+  team.Run([&](uint32_t member) {
+    size_t begin, end;
+    MemberRange(num_edges, member, members, &begin, &end);
+    size_t count = 0;
+    for (size_t i = begin; i < end; i++)
+      count += kept(i);
+    kept_before[member + 1] = count;
+  });
+  for (uint32_t member = 0; member < members; member++)
+    kept_before[member + 1] += kept_before[member];
+
+  // Collapse the runs, the lowest weight of a run wins
+  size_t num_kept = kept_before[members];
+  if (num_kept > kMaxAdjacencyEdges)
+    return "ERROR: Graph would store more than " +
+           std::to_string(kMaxAdjacencyEdges) + " edges";
+  std::vector<uint32_t> targets(num_kept);
+  std::vector<uint32_t> integer_weights(
+      weight_type == INTEGER_WEIGHTS ? num_kept : 0);
+  std::vector<float> float_weights(weight_type == FLOAT_WEIGHTS ? num_kept : 0);
+  std::vector<uint32_t> labels(labeled ? num_kept : 0);
+  std::atomic<bool> conflicting_labels{false};
+  team.Run([&](uint32_t member) {
+    size_t begin, end;
+    MemberRange(num_edges, member, members, &begin, &end);
+    size_t position = kept_before[member];
+    for (size_t i = begin; i < end; i++) {
+      if (!kept(i))
+        continue;
+      targets[position] = keys[i] & target_mask;
+      if (weight_type == INTEGER_WEIGHTS) {
+        uint32_t weight = edges.Get(order[i]).weight();
+        for (size_t j = i + 1; j < num_edges && keys[j] == keys[i]; j++)
+          weight = std::min(weight, edges.Get(order[j]).weight());
+        integer_weights[position] = weight;
+      } else if (weight_type == FLOAT_WEIGHTS) {
+        float weight = edges.Get(order[i]).float_weight();
+        for (size_t j = i + 1; j < num_edges && keys[j] == keys[i]; j++)
+          weight = std::min(weight, edges.Get(order[j]).float_weight());
+        float_weights[position] = weight;
+      }
+      if (labeled) {
+        uint32_t label = edges.Get(order[i]).label();
+        for (size_t j = i + 1; j < num_edges && keys[j] == keys[i]; j++) {
+          if (edges.Get(order[j]).label() != label)
+            conflicting_labels = true;
+        }
+        labels[position] = label;
+      }
+      position++;
+    }
+  });
+  if (conflicting_labels)
+    return "ERROR: Duplicate edges with different labels";
+
+  // Kept keys are sorted by source, count them into the offsets
+  std::vector<uint32_t> offsets(size_t(num_nodes) + 1, 0);
+  for (size_t i = 0; i < num_edges; i++) {
+    if (kept(i))
+      offsets[(keys[i] >> node_bits) + 1]++;
+  }
+  for (uint32_t u = 0; u < num_nodes; u++)
+    offsets[u + 1] += offsets[u];
+
+  *adjacency = CsrAdjacency(std::move(offsets), std::move(targets), true);
+  if (undirected)
+    adjacency->MarkSymmetric();
+  if (weight_type == INTEGER_WEIGHTS)
+    adjacency->SetWeights(std::move(integer_weights));
+  else if (weight_type == FLOAT_WEIGHTS)
+    adjacency->SetWeights(std::move(float_weights));
+  if (labeled)
+    adjacency->SetEdgeLabels(labels);
+  return "";
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,194 @@
+#include "src/include/external_adjacency.h"
+#include "src/include/query_control.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <unistd.h>
+
+namespace GraphQueryEngine {
+
+constexpr uint64_t ExternalAdjacency::kBatchBytes;
+constexpr uint64_t ExternalAdjacency::kMaxGapBytes;
+
+ExternalAdjacency::ExternalAdjacency(const CsrAdjacency &adjacency,
+                                     DeltaAdjacency delta, uint64_t version,
+                                     const std::string &path,
+                                     uint64_t lists_position)
+    : encoding(adjacency.encoding), num_nodes(adjacency.NumNodes()),
+      version(version), delta(std::move(delta)),
+      lists_position(lists_position) {
+  if (encoding == COMPRESSED_TARGETS) {
+    block_offsets = adjacency.block_offsets;
+    byte_offsets = adjacency.byte_offsets;
+    lists_bytes = adjacency.encoded.size();
+  } else {
+    offsets = adjacency.offsets;
+    lists_bytes = encoding == NARROW_TARGETS
+                      ? adjacency.narrow_targets.size() * sizeof(uint16_t)
+                      : adjacency.targets.size() * sizeof(uint32_t);
+  }
+  fd = open(path.c_str(), O_RDONLY);
+}
+
+ExternalAdjacency::~ExternalAdjacency() {
+  if (fd >= 0)
+    close(fd);
+}
+
+uint64_t ExternalAdjacency::Bytes() const {
+  return offsets.size() * sizeof(uint32_t) +
+         block_offsets.size() * sizeof(uint64_t) +
+         byte_offsets.size() * sizeof(uint32_t) + delta.Bytes();
+}
+
+uint64_t ExternalAdjacency::ListBegin(uint32_t node) const {
+  switch (encoding) {
+  case COMPRESSED_TARGETS:
+    return block_offsets[node / CompressedNeighbors::kIndexBlock] +
+           byte_offsets[node];
+  case NARROW_TARGETS:
+    return uint64_t(offsets[node]) * sizeof(uint16_t);
+  default:
+    return uint64_t(offsets[node]) * sizeof(uint32_t);
+  }
+}
+
+uint64_t ExternalAdjacency::ListEnd(uint32_t node) const {
+  if (node + 1 < num_nodes)
+    return ListBegin(node + 1);
+  // Compressed lists are followed by their padding
+  return encoding == COMPRESSED_TARGETS
+             ? lists_bytes - CompressedNeighbors::kPadding
+             : lists_bytes;
+}
+
+bool ExternalAdjacency::Read(uint64_t begin, uint64_t end,
+                             std::vector<uint8_t> *buffer) const {
+  // Compressed lists are decoded with 4 byte loads, the padding after the
+  // last list keeps them in the file
+  if (encoding == COMPRESSED_TARGETS)
+    end = std::min(end + CompressedNeighbors::kPadding, lists_bytes);
+  buffer->resize(end - begin + CompressedNeighbors::kPadding);
+  uint64_t done = 0;
+  while (done < end - begin) {
+    ssize_t count = pread(fd, buffer->data() + done, end - begin - done,
+                          lists_position + begin + done);
+    if (count <= 0)
+      return false;
+    done += count;
+  }
+  reads++;
+  read_bytes += done;
+  return true;
+}
+
+template <typename Visit>
+bool ExternalAdjacency::ForEachNeighbor(const uint8_t *list, uint32_t node,
+                                        Visit visit) const {
+  bool removals = delta.HasRemovals(node);
+  auto visit_base = [&](uint32_t next) {
+    if (removals && delta.Removed(node, next))
+      return true;
+    return visit(next);
+  };
+
+  // Lists sit at any byte of the buffer, ids are copied out
+  bool completed = true;
+  if (encoding == COMPRESSED_TARGETS) {
+    completed = CompressedNeighbors::DecodeList(list, node, visit_base);
+  } else if (encoding == NARROW_TARGETS) {
+    for (uint32_t i = 0; i < offsets[node + 1] - offsets[node] && completed;
+         i++) {
+      uint16_t next;
+      std::memcpy(&next, list + i * sizeof(next), sizeof(next));
+      completed = visit_base(next);
+    }
+  } else {
+    for (uint32_t i = 0; i < offsets[node + 1] - offsets[node] && completed;
+         i++) {
+      uint32_t next;
+      std::memcpy(&next, list + i * sizeof(next), sizeof(next));
+      completed = visit_base(next);
+    }
+  }
+  if (!completed)
+    return false;
+
+  const std::vector<uint32_t> *inserted = delta.Inserted(node);
+  if (inserted == nullptr)
+    return true;
+  for (uint32_t next : *inserted) {
+    if (!visit(next))
+      return false;
+  }
+  return true;
+}
+
+std::vector<uint32_t> ExternalAdjacency::Bfs(uint32_t src, uint32_t dest,
+                                             uint32_t max_hops) const {
+  const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> distance(num_nodes, kUnreachable);
+  distance[src] = 0;
+  if (src == dest)
+    return distance;
+  traversals++;
+
+  std::vector<uint32_t> frontier(1, src);
+  std::vector<uint32_t> next_frontier;
+  std::vector<uint8_t> buffer;
+  bool found = false;
+  QueryCheckpoint checkpoint(num_nodes);
+  for (uint32_t depth = 0;
+       !frontier.empty() && !found && (max_hops == 0 || depth < max_hops);
+       depth++) {
+    auto visit = [&](uint32_t next) {
+      if (distance[next] != kUnreachable)
+        return true;
+      distance[next] = depth + 1;
+      next_frontier.push_back(next);
+      found = next == dest;
+      return !found;
+    };
+
+    // Lists are laid out in node order, a sorted level reads the file
+    // front to back
+    std::sort(frontier.begin(), frontier.end());
+    next_frontier.clear();
+    size_t first = 0;
+    while (first < frontier.size() && !found) {
+      // Grow the batch while the next list starts close to its end
+      uint64_t begin = ListBegin(frontier[first]);
+      uint64_t end = ListEnd(frontier[first]);
+      size_t last = first + 1;
+      while (last < frontier.size()) {
+        uint64_t next_end = ListEnd(frontier[last]);
+        if (ListBegin(frontier[last]) > end + kMaxGapBytes ||
+            next_end - begin > kBatchBytes)
+          break;
+        end = next_end;
+        last++;
+      }
+      if (last < frontier.size()) {
+        posix_fadvise(fd, lists_position + ListBegin(frontier[last]),
+                      kBatchBytes, POSIX_FADV_WILLNEED);
+      }
+
+      if (!Read(begin, end, &buffer))
+        return std::vector<uint32_t>();
+      for (size_t i = first; i < last && !found; i++) {
+        // A stopped query discards the distances
+        if (checkpoint.Stop())
+          return distance;
+        uint32_t node = frontier[i];
+        ForEachNeighbor(buffer.data() + (ListBegin(node) - begin), node,
+                        visit);
+      }
+      first = last;
+    }
+    frontier.swap(next_frontier);
+  }
+  return distance;
+}
+
+} // namespace GraphQueryEngine
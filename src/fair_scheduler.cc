@@ -0,0 +1,124 @@
+#include "src/include/fair_scheduler.h"
+#include "src/include/worker_pool.h"
+#include <algorithm>
+
+namespace GraphQueryEngine {
+
+void FairScheduler::Submit(TaskClass task_class, const std::string &tenant,
+                           double cost, std::function<void()> task) {
+  if (!policy.fair_queuing) {
+    pool->Submit(std::move(task));
+    return;
+  }
+  uint32_t weight = task_class == INTERACTIVE_TASK ? policy.interactive_weight
+                                                   : policy.bulk_weight;
+  std::lock_guard<std::mutex> guard(mutex);
+  Flow &flow = flows[FlowKey(task_class, tenant)];
+  Task queued_task;
+  queued_task.run = std::move(task);
+  queued_task.start_tag = std::max(virtual_time, flow.finish_tag);
+  queued_task.queued = Clock::now();
+  flow.finish_tag =
+      queued_task.start_tag + std::max(cost, 1.0) / std::max(weight, 1u);
+  flow.tasks.push_back(std::move(queued_task));
+  queued++;
+  Dispatch();
+}
+
+void FairScheduler::Dispatch() {
+  uint32_t threads = pool->NumThreads();
+  uint32_t bulk_threads = threads > policy.interactive_reserved_threads
+                              ? threads - policy.interactive_reserved_threads
+                              : threads;
+  while (running < threads) {
+    auto best = flows.end();
+    for (auto it = flows.begin(); it != flows.end();) {
+      Flow &flow = it->second;
+      // Idle flows are only kept while their finish tag is ahead of the
+      // virtual time, later tasks of the flow start from it anyway
+      if (flow.tasks.empty()) {
+        if (flow.finish_tag <= virtual_time)
+          it = flows.erase(it);
+        else
+          ++it;
+        continue;
+      }
+      TaskClass task_class = it->first.first;
+      const std::string &tenant = it->first.second;
+      if (task_class == BULK_TASK &&
+          class_running[BULK_TASK] >= bulk_threads) {
+        ++it;
+        continue;
+      }
+      auto tenant_it = tenant_running.find(tenant);
+      if (policy.tenant_max_running != 0 && tenant_it != tenant_running.end() &&
+          tenant_it->second >= policy.tenant_max_running) {
+        if (!flow.tasks.front().limited) {
+          flow.tasks.front().limited = true;
+          tenant_limited++;
+        }
+        ++it;
+        continue;
+      }
+      if (best == flows.end() || flow.tasks.front().start_tag <
+                                     best->second.tasks.front().start_tag)
+        best = it;
+      ++it;
+    }
+    if (best == flows.end())
+      return;
+
+    TaskClass task_class = best->first.first;
+    std::string tenant = best->first.second;
+    Task task = std::move(best->second.tasks.front());
+    best->second.tasks.pop_front();
+    virtual_time = std::max(virtual_time, task.start_tag);
+    queued--;
+    running++;
+    class_running[task_class]++;
+    tenant_running[tenant]++;
+
+    uint64_t wait_micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                              task.queued)
+            .count();
+    ClassStats &stats = class_stats[task_class];
+    stats.started++;
+    stats.wait_micros += wait_micros;
+    stats.max_wait_micros = std::max(stats.max_wait_micros, wait_micros);
+
+    std::function<void()> run = std::move(task.run);
+    pool->Submit([this, task_class, tenant, run]() mutable {
+      Run(task_class, tenant, std::move(run));
+    });
+  }
+}
+
+void FairScheduler::Run(TaskClass task_class, const std::string &tenant,
+                        std::function<void()> task) {
+  task();
+  std::lock_guard<std::mutex> guard(mutex);
+  running--;
+  class_running[task_class]--;
+  auto it = tenant_running.find(tenant);
+  if (--it->second == 0)
+    tenant_running.erase(it);
+  Dispatch();
+}
+
+FairScheduler::ClassStats FairScheduler::Stats(TaskClass task_class) {
+  std::lock_guard<std::mutex> guard(mutex);
+  return class_stats[task_class];
+}
+
+uint64_t FairScheduler::Queued() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return queued;
+}
+
+uint64_t FairScheduler::TenantLimited() {
+  std::lock_guard<std::mutex> guard(mutex);
+  return tenant_limited;
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,313 @@
+#include "src/include/graph.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+namespace GraphQueryEngine {
+
+namespace {
+// Neighbors of every node linked before the largest component is sampled
+constexpr uint32_t kNeighborRounds = 2;
+// Nodes sampled to find the largest component
+constexpr uint32_t kComponentSamples = 1024;
+
+// Nodes handled by a member of a team, contiguous so that members write
+// separate cache lines
+uint32_t RangeBegin(uint32_t num_nodes, uint32_t member, uint32_t members) {
+  return uint64_t(num_nodes) * member / members;
+}
+
+// Checkpoint of a member over its range, the members inherit the query
+// control of the job and leave the phase early once it stopped
+QueryCheckpoint RangeCheckpoint(uint32_t num_nodes, uint32_t member,
+                                uint32_t members) {
+  return QueryCheckpoint(RangeBegin(num_nodes, member + 1, members) -
+                         RangeBegin(num_nodes, member, members));
+}
+
+/*
+ * Join the trees of two nodes, hooking the larger root under the smaller,
+ * so that the root of a tree is its smallest node
+ */
+void Link(std::atomic<uint32_t> *component, uint32_t u, uint32_t v) {
+  uint32_t first = component[u].load(std::memory_order_relaxed);
+  uint32_t second = component[v].load(std::memory_order_relaxed);
+  while (first != second) {
+    uint32_t high = std::max(first, second);
+    uint32_t low = std::min(first, second);
+    uint32_t parent = component[high].load(std::memory_order_relaxed);
+    // Already joined, or high is a root that this call hooks
+    if (parent == low)
+      break;
+    if (parent == high &&
+        component[high].compare_exchange_strong(parent, low,
+                                                std::memory_order_relaxed))
+      break;
+    first = component[component[high].load(std::memory_order_relaxed)].load(
+        std::memory_order_relaxed);
+    second = component[low].load(std::memory_order_relaxed);
+  }
+}
+
+// Point the nodes of a range straight at their roots
+void Compress(std::atomic<uint32_t> *component, uint32_t begin,
+              uint32_t end) {
+  for (uint32_t node = begin; node < end; node++) {
+    uint32_t parent = component[node].load(std::memory_order_relaxed);
+    uint32_t grandparent = component[parent].load(std::memory_order_relaxed);
+    while (parent != grandparent) {
+      component[node].store(grandparent, std::memory_order_relaxed);
+      parent = grandparent;
+      grandparent = component[parent].load(std::memory_order_relaxed);
+    }
+  }
+}
+} // namespace
+
+std::vector<uint32_t> GraphVersion::ConnectedComponents(
+    ThreadTeam &team) const {
+  uint32_t num_nodes = NumNodes();
+  uint32_t members = team.Size();
+  std::unique_ptr<std::atomic<uint32_t>[]> component(
+      new std::atomic<uint32_t>[num_nodes]);
+  for (uint32_t node = 0; node < num_nodes; node++)
+    component[node].store(node, std::memory_order_relaxed);
+  auto compress = [&](uint32_t member) {
+    Compress(component.get(), RangeBegin(num_nodes, member, members),
+             RangeBegin(num_nodes, member + 1, members));
+  };
+
+  adjacency->Dispatch([&](const auto &neighbors) {
+    // Linking a few neighbors of every node already joins most of every
+    // large component
+    for (uint32_t round = 0; round < kNeighborRounds; round++) {
+      team.Run([&](uint32_t member) {
+        QueryCheckpoint checkpoint =
+            RangeCheckpoint(num_nodes, member, members);
+        uint32_t end = RangeBegin(num_nodes, member + 1, members);
+        for (uint32_t node = RangeBegin(num_nodes, member, members);
+             node < end && !checkpoint.Stop(); node++) {
+          uint32_t index = 0;
+          this->ForEachNeighbor(neighbors, node, [&](uint32_t next) {
+            if (index++ < round)
+              return true;
+            Link(component.get(), node, next);
+            return false;
+          });
+        }
+      });
+      // Labels of a stopped job are discarded
+      if (QueryControl::CurrentStopped())
+        return;
+      team.Run(compress);
+    }
+
+    // The rest of the edges only matter outside the largest component.
+    // Undirected graphs find the edges from it at their other end, directed
+    // graphs have no in-going lists to do so and link every edge.
+    uint32_t largest = num_nodes;
+    if (Undirected() && num_nodes > 0) {
+      std::mt19937 rng(num_nodes);
+      std::unordered_map<uint32_t, uint32_t> samples;
+      uint32_t most = 0;
+      for (uint32_t i = 0; i < kComponentSamples; i++) {
+        uint32_t root =
+            component[rng() % num_nodes].load(std::memory_order_relaxed);
+        if (++samples[root] > most) {
+          most = samples[root];
+          largest = root;
+        }
+      }
+    }
+    team.Run([&](uint32_t member) {
+      QueryCheckpoint checkpoint = RangeCheckpoint(num_nodes, member, members);
+      uint32_t end = RangeBegin(num_nodes, member + 1, members);
+      for (uint32_t node = RangeBegin(num_nodes, member, members);
+           node < end && !checkpoint.Stop(); node++) {
+        if (component[node].load(std::memory_order_relaxed) == largest)
+          continue;
+        uint32_t index = 0;
+        this->ForEachNeighbor(neighbors, node, [&](uint32_t next) {
+          if (index++ >= kNeighborRounds)
+            Link(component.get(), node, next);
+          return true;
+        });
+      }
+    });
+    team.Run(compress);
+  });
+
+  std::vector<uint32_t> labels(num_nodes);
+  for (uint32_t node = 0; node < num_nodes; node++)
+    labels[node] = component[node].load(std::memory_order_relaxed);
+  return labels;
+}
+
+std::vector<double> GraphVersion::PageRank(double damping,
+                                           uint32_t max_iterations,
+                                           double tolerance, ThreadTeam &team,
+                                           uint32_t *iterations) const {
+  uint32_t num_nodes = NumNodes();
+  uint32_t members = team.Size();
+  *iterations = 0;
+  if (num_nodes == 0)
+    return std::vector<double>();
+
+  std::vector<uint32_t> degree(num_nodes, 0);
+  // In-going neighbors of every node. Undirected graphs pull from their
+  // own lists, directed ones from a transpose including pending edits.
+  std::vector<uint64_t> in_offsets;
+  std::vector<uint32_t> in_sources;
+  std::vector<double> rank(num_nodes, 1.0 / num_nodes);
+  std::vector<double> contribution(num_nodes);
+  std::vector<double> dangling(members);
+  std::vector<double> change(members);
+
+  adjacency->Dispatch([&](const auto &neighbors) {
+    std::unique_ptr<std::atomic<uint32_t>[]> in_degree;
+    if (!Undirected()) {
+      in_degree.reset(new std::atomic<uint32_t>[num_nodes]);
+      for (uint32_t node = 0; node < num_nodes; node++)
+        in_degree[node].store(0, std::memory_order_relaxed);
+    }
+    team.Run([&](uint32_t member) {
+      uint32_t end = RangeBegin(num_nodes, member + 1, members);
+      for (uint32_t node = RangeBegin(num_nodes, member, members); node < end;
+           node++) {
+        this->ForEachNeighbor(neighbors, node, [&](uint32_t next) {
+          degree[node]++;
+          if (in_degree)
+            in_degree[next].fetch_add(1, std::memory_order_relaxed);
+          return true;
+        });
+      }
+    });
+
+    if (in_degree) {
+      in_offsets.resize(num_nodes + 1, 0);
+      for (uint32_t node = 0; node < num_nodes; node++) {
+        in_offsets[node + 1] =
+            in_offsets[node] + in_degree[node].load(std::memory_order_relaxed);
+      }
+      in_sources.resize(in_offsets.back());
+      // Counts go down to 0 as the slots of every list are claimed, lists
+      // are sorted afterwards so that sums are added in the same order
+      team.Run([&](uint32_t member) {
+        uint32_t end = RangeBegin(num_nodes, member + 1, members);
+        for (uint32_t node = RangeBegin(num_nodes, member, members);
+             node < end; node++) {
+          this->ForEachNeighbor(neighbors, node, [&](uint32_t next) {
+            uint32_t slot =
+                in_degree[next].fetch_sub(1, std::memory_order_relaxed) - 1;
+            in_sources[in_offsets[next] + slot] = node;
+            return true;
+          });
+        }
+      });
+      team.Run([&](uint32_t member) {
+        uint32_t end = RangeBegin(num_nodes, member + 1, members);
+        for (uint32_t node = RangeBegin(num_nodes, member, members);
+             node < end; node++) {
+          std::sort(in_sources.begin() + in_offsets[node],
+                    in_sources.begin() + in_offsets[node + 1]);
+        }
+      });
+    }
+
+    while (*iterations < max_iterations) {
+      team.Run([&](uint32_t member) {
+        double sum = 0;
+        uint32_t end = RangeBegin(num_nodes, member + 1, members);
+        for (uint32_t node = RangeBegin(num_nodes, member, members);
+             node < end; node++) {
+          if (degree[node] == 0) {
+            contribution[node] = 0;
+            sum += rank[node];
+          } else {
+            contribution[node] = rank[node] / degree[node];
+          }
+        }
+        dangling[member] = sum;
+      });
+      double dangling_rank = 0;
+      for (double sum : dangling)
+        dangling_rank += sum;
+      double base = (1 - damping + damping * dangling_rank) / num_nodes;
+
+      team.Run([&](uint32_t member) {
+        QueryCheckpoint checkpoint =
+            RangeCheckpoint(num_nodes, member, members);
+        double sum_change = 0;
+        uint32_t end = RangeBegin(num_nodes, member + 1, members);
+        for (uint32_t node = RangeBegin(num_nodes, member, members);
+             node < end && !checkpoint.Stop(); node++) {
+          double sum = 0;
+          if (in_offsets.empty()) {
+            this->ForEachNeighbor(neighbors, node, [&](uint32_t next) {
+              sum += contribution[next];
+              return true;
+            });
+          } else {
+            for (uint64_t i = in_offsets[node]; i < in_offsets[node + 1]; i++)
+              sum += contribution[in_sources[i]];
+          }
+          double next_rank = base + damping * sum;
+          sum_change += std::fabs(next_rank - rank[node]);
+          rank[node] = next_rank;
+        }
+        change[member] = sum_change;
+      });
+      // Ranks of a stopped job are discarded
+      if (QueryControl::CurrentStopped())
+        break;
+      (*iterations)++;
+      double total_change = 0;
+      for (double sum : change)
+        total_change += sum;
+      if (total_change < tolerance)
+        break;
+    }
+  });
+  return rank;
+}
+
+std::vector<uint64_t> GraphVersion::DegreeHistogram(ThreadTeam &team) const {
+  uint32_t num_nodes = NumNodes();
+  uint32_t members = team.Size();
+  std::vector<std::vector<uint64_t>> counts(members);
+  team.Run([&](uint32_t member) {
+    std::vector<uint64_t> &histogram = counts[member];
+    QueryCheckpoint checkpoint = RangeCheckpoint(num_nodes, member, members);
+    uint32_t end = RangeBegin(num_nodes, member + 1, members);
+    for (uint32_t node = RangeBegin(num_nodes, member, members);
+         node < end && !checkpoint.Stop(); node++) {
+      // Only edited nodes need their lists walked
+      uint32_t degree = 0;
+      if (delta.HasRemovals(node) || delta.Inserted(node) != nullptr) {
+        ForEachNeighbor(node, [&](uint32_t) {
+          degree++;
+          return true;
+        });
+      } else {
+        degree = adjacency->Degree(node);
+      }
+      if (degree >= histogram.size())
+        histogram.resize(degree + 1, 0);
+      histogram[degree]++;
+    }
+  });
+
+  std::vector<uint64_t> histogram;
+  for (const std::vector<uint64_t> &partial : counts) {
+    if (partial.size() > histogram.size())
+      histogram.resize(partial.size(), 0);
+    for (size_t degree = 0; degree < partial.size(); degree++)
+      histogram[degree] += partial[degree];
+  }
+  return histogram;
+}
+
+} // namespace GraphQueryEngine
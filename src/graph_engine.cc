@@ -1,122 +1,2294 @@
 #include "src/include/graph.h"
+#include "src/include/binary_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <limits>
 #include <queue>
+#include <unordered_set>
+#include <utility>
 
 namespace GraphQueryEngine {
 
-uint32_t Graph::MinEdgeBfs(int src, int dest) {
+namespace {
+// Direction-optimizing BFS goes bottom-up once the edges of the frontier
+// exceed 1/kTopDownAlpha of the edges left to explore, and back top-down
+// once the frontier holds fewer than 1/kBottomUpBeta of the nodes
+constexpr uint64_t kTopDownAlpha = 14;
+constexpr uint64_t kBottomUpBeta = 24;
+// Leads every spill file, files of other programs are never read back
+constexpr uint32_t kSpillMagic = 0x4c495053;
+// Reply to requests for a graph posted with async_build and not built yet
+const char kNotReady[] = "NOT_READY: Graph is still being built";
+// Replies to queries stopped by their control, by QueryStop
+const char *const kStopReplies[] = {"", "ERROR: Request cancelled",
+                                    "ERROR: Deadline exceeded"};
+// Posted or edited edges costing as much as a query in the fair queuing of
+// the compute threads
+constexpr double kEdgesPerTaskCost = 4096;
+
+// Error of requests that found no version of a graph, graphs traversed out
+// of core only answer hop distance queries
+std::string VersionError(const GraphSharedPtr &graph) {
+  return graph->OutOfCore()
+             ? "ERROR: Request not supported on graphs traversed out of core"
+             : "ERROR: Graph version not available";
+}
+} // namespace
+
+uint32_t GraphVersion::MinEdgeBfs(uint32_t src, uint32_t dest) const {
+  return Bfs(src, dest, false);
+}
+
+uint32_t GraphVersion::MinEdgeDagBfs(uint32_t src, uint32_t dest) const {
+  return Bfs(src, dest, true);
+}
+
+uint32_t GraphVersion::MinEdgeForest(uint32_t src, uint32_t dest) const {
+  // Pending edits may have broken the forest, traverse until compacted
+  if (Structure() != DIRECTED_FOREST && Structure() != UNDIRECTED_FOREST)
+    return Bfs(src, dest, false);
+  return indexes->structure_index.ForestDistance(src, dest);
+}
+
+uint32_t GraphVersion::Bfs(uint32_t src, uint32_t dest, bool prune) const {
+  return Local().Dispatch([&](const auto &neighbors) {
+    return this->Bfs(neighbors, src, dest, prune);
+  });
+}
+
+template <typename Neighbors>
+uint32_t GraphVersion::Bfs(const Neighbors &neighbors, uint32_t src,
+                           uint32_t dest, bool prune) const {
+  typedef typename Neighbors::Node Node;
+  const Node kUnreached = std::numeric_limits<Node>::max();
+
+  // The indexes only describe the edges they were built from
+  bool indexed = IndexesCurrent();
+  prune = prune && indexed;
+  const ReachabilityIndex &reachability_index = indexes->reachability_index;
+
+  // Unreachable pairs are answered by the index without a traversal
+  if (indexed && !reachability_index.MayReach(src, dest))
+    return std::numeric_limits<uint32_t>::max();
+  if (adjacency->Symmetric())
+    return BidirectionalBfs(neighbors, src, dest);
+
   // Initialize visited vector as false
   std::vector<bool> visited;
-  visited.resize(num_nodes, false);
+  visited.resize(NumNodes(), false);
 
-  // Initialize distances as 0
-  std::vector<uint32_t> distance;
-  distance.resize(num_nodes, std::numeric_limits<uint32_t>::max());
+  // Initialize distances as unreached
+  std::vector<Node> distance;
+  distance.resize(NumNodes(), kUnreached);
 
   // queue to do BFS.
-  std::queue<uint32_t> Q;
+  std::queue<Node> Q;
   distance[src] = 0;
 
   Q.push(src);
   visited[src] = true;
+  QueryCheckpoint checkpoint(NumNodes());
   while (!Q.empty()) {
-    int x = Q.front();
+    uint32_t x = Q.front();
     Q.pop();
+    // Distances are final once a node is discovered, stop at dest. A
+    // stopped query discards the distance.
+    if (x == dest || checkpoint.Stop())
+      break;
 
-    for (int i = 0; i < adjacency_list[x].size(); i++) {
-      if (visited[adjacency_list[x][i]])
-        continue;
+    ForEachNeighbor(neighbors, x, [&](uint32_t next) {
+      if (visited[next])
+        return true;
+      // On a DAG, component ids are a topological order, nodes past dest
+      // or outside its interval labels can never lead to it
+      if (prune && !reachability_index.MayReach(next, dest))
+        return true;
+
+      // update distance for next
+      distance[next] = distance[x] + 1;
+      Q.push(next);
+      visited[next] = true;
+      return true;
+    });
+  }
+  return distance[dest] == kUnreached ? std::numeric_limits<uint32_t>::max()
+                                      : distance[dest];
+}
+
+template <typename Neighbors>
+uint32_t GraphVersion::BidirectionalBfs(const Neighbors &neighbors,
+                                        uint32_t src, uint32_t dest) const {
+  typedef typename Neighbors::Node Node;
+  if (src == dest)
+    return 0;
 
-      // update distance for i
-      distance[adjacency_list[x][i]] = distance[x] + 1;
-      Q.push(adjacency_list[x][i]);
-      visited[adjacency_list[x][i]] = 1;
+  // Search every node was discovered by, 1 from src, 2 from dest
+  std::vector<uint8_t> side(NumNodes(), 0);
+  std::vector<Node> frontier[2] = {std::vector<Node>(1, src),
+                                   std::vector<Node>(1, dest)};
+  std::vector<Node> next_frontier;
+  uint32_t depth[2] = {0, 0};
+  side[src] = 1;
+  side[dest] = 2;
+  QueryCheckpoint checkpoint(NumNodes());
+  while (!frontier[0].empty() && !frontier[1].empty()) {
+    uint32_t s = frontier[0].size() <= frontier[1].size() ? 0 : 1;
+    uint8_t own = s + 1;
+    // Meeting a node of the other search closes a shortest path, both
+    // searches completed their previous levels without meeting
+    bool met = false;
+    next_frontier.clear();
+    for (uint32_t x : frontier[s]) {
+      if (checkpoint.Stop())
+        return std::numeric_limits<uint32_t>::max();
+      ForEachNeighbor(neighbors, x, [&](uint32_t next) {
+        if (side[next] == own)
+          return true;
+        if (side[next] != 0) {
+          met = true;
+          return false;
+        }
+        side[next] = own;
+        next_frontier.push_back(next);
+        return true;
+      });
+      if (met)
+        return depth[0] + depth[1] + 1;
     }
+    depth[s]++;
+    frontier[s].swap(next_frontier);
   }
-  return distance[dest];
+  return std::numeric_limits<uint32_t>::max();
 }
 
-std::string GraphEngine::PostGraphRequest(graph::Request &request) {
-  // Parse Adjacency List
-  std::vector<GraphQueryEngine::Graph::Edge> edges;
-  for (int i = 0; i < request.adjacency_list_size(); i++) {
-    const graph::Edges &edge_pb = request.adjacency_list(i);
-    GraphQueryEngine::Graph::Edge edge(edge_pb.src(), edge_pb.dest());
-    edges.push_back(edge);
+template <typename Neighbors, typename Visit>
+void GraphVersion::BoundedBfs(const Neighbors &neighbors, uint32_t src,
+                              uint32_t max_hops, Visit visit) const {
+  typedef typename Neighbors::Node Node;
+  std::unordered_set<Node> visited;
+  visited.insert(src);
+  std::vector<Node> frontier(1, src);
+  std::vector<Node> next_frontier;
+  bool done = false;
+  QueryCheckpoint checkpoint(NumNodes());
+  for (uint32_t depth = 1; depth <= max_hops && !frontier.empty() && !done;
+       depth++) {
+    next_frontier.clear();
+    for (uint32_t x : frontier) {
+      done = checkpoint.Stop();
+      if (done)
+        break;
+      ForEachNeighbor(neighbors, x, [&](uint32_t next) {
+        if (!visited.insert(next).second)
+          return true;
+        if (!visit(next, depth)) {
+          done = true;
+          return false;
+        }
+        next_frontier.push_back(next);
+        return true;
+      });
+      if (done)
+        break;
+    }
+    frontier.swap(next_frontier);
   }
+}
 
-  // Get total number of nodes
-  uint32_t num_nodes = request.graph_total_nodes();
+uint32_t GraphVersion::MinEdgeBoundedBfs(uint32_t src, uint32_t dest,
+                                         uint32_t max_hops) const {
+  if (src == dest)
+    return 0;
+  uint32_t distance = std::numeric_limits<uint32_t>::max();
+  Local().Dispatch([&](const auto &neighbors) {
+    this->BoundedBfs(neighbors, src, max_hops,
+                     [&](uint32_t node, uint32_t depth) {
+                       if (node != dest)
+                         return true;
+                       distance = depth;
+                       return false;
+                     });
+  });
+  return distance;
+}
+
+bool GraphVersion::Neighborhood(uint32_t src, uint32_t max_hops,
+                                uint32_t max_nodes,
+                                std::vector<uint32_t> *nodes,
+                                std::vector<uint32_t> *distances) const {
+  nodes->assign(1, src);
+  distances->assign(1, 0);
+  bool truncated = max_nodes == 1;
+  if (truncated)
+    return true;
+  Local().Dispatch([&](const auto &neighbors) {
+    this->BoundedBfs(neighbors, src, max_hops,
+                     [&](uint32_t node, uint32_t depth) {
+                       nodes->push_back(node);
+                       distances->push_back(depth);
+                       truncated =
+                           max_nodes != 0 && nodes->size() >= max_nodes;
+                       return !truncated;
+                     });
+  });
+  return truncated;
+}
+
+std::vector<uint32_t>
+GraphVersion::SingleSourceBfs(uint32_t src,
+                              const std::vector<uint32_t> &targets) const {
+  return Local().Dispatch([&](const auto &neighbors) {
+    return this->SingleSourceBfs(neighbors, src, targets);
+  });
+}
+
+template <typename Neighbors>
+std::vector<uint32_t>
+GraphVersion::SingleSourceBfs(const Neighbors &neighbors, uint32_t src,
+                              const std::vector<uint32_t> &targets) const {
+  if (targets.empty() && adjacency->Symmetric())
+    return DirectionOptimizingBfs(neighbors, src);
 
-  // Build Adjacency List
-  std::vector<std::vector<uint32_t>> adj_list;
-  adj_list.resize(num_nodes);
-  for (auto edge : edges) {
-    adj_list[edge.src].push_back(edge.dest);
+  std::vector<uint32_t> distance(NumNodes(),
+                                 std::numeric_limits<uint32_t>::max());
+  distance[src] = 0;
+
+  // Targets that may still be reached, the traversal stops once none is left
+  std::vector<bool> pending;
+  size_t remaining = 0;
+  if (!targets.empty()) {
+    pending.resize(NumNodes(), false);
+    for (uint32_t target : targets) {
+      if (target != src && !pending[target] && MayReach(src, target)) {
+        pending[target] = true;
+        remaining++;
+      }
+    }
+    if (remaining == 0)
+      return distance;
   }
 
-  // Compute hash value based on the graph_name to handle collisions
-  std::string graph_name = request.graph_name();
+  std::queue<typename Neighbors::Node> Q;
+  Q.push(src);
+  bool done = false;
+  QueryCheckpoint checkpoint(NumNodes());
+  while (!Q.empty() && !done) {
+    uint32_t x = Q.front();
+    Q.pop();
+    // Distances of a stopped traversal are partial, see CacheDistances
+    if (checkpoint.Stop())
+      break;
 
-  // Build Graph
-  GraphSharedPtr graph_shared_ptr =
-      std::make_shared<Graph>(num_nodes, adj_list, graph_name);
+    ForEachNeighbor(neighbors, x, [&](uint32_t next) {
+      if (distance[next] != std::numeric_limits<uint32_t>::max())
+        return true;
+
+      distance[next] = distance[x] + 1;
+      if (remaining != 0 && pending[next] && --remaining == 0) {
+        done = true;
+        return false;
+      }
+      Q.push(next);
+      return true;
+    });
+  }
+  return distance;
+}
+
+template <typename Neighbors>
+std::vector<uint32_t>
+GraphVersion::DirectionOptimizingBfs(const Neighbors &neighbors,
+                                     uint32_t src) const {
+  const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+  uint32_t num_nodes = NumNodes();
+  std::vector<uint32_t> distance(num_nodes, kUnreachable);
+  distance[src] = 0;
+
+  std::vector<typename Neighbors::Node> frontier(1, src);
+  std::vector<typename Neighbors::Node> next_frontier;
+  // Edges out of the frontier, and out of nodes not explored yet
+  uint64_t frontier_edges = adjacency->Degree(src);
+  uint64_t unexplored_edges = NumEdges();
+  bool bottom_up = false;
+  QueryCheckpoint checkpoint(num_nodes);
+  for (uint32_t depth = 0; !frontier.empty(); depth++) {
+    unexplored_edges -= std::min(unexplored_edges, frontier_edges);
+    if (!bottom_up)
+      bottom_up = frontier_edges > unexplored_edges / kTopDownAlpha;
+    else
+      bottom_up = frontier.size() >= num_nodes / kBottomUpBeta;
+
+    next_frontier.clear();
+    if (bottom_up) {
+      // Frontier nodes are the ones at the current depth
+      for (uint32_t v = 0; v < num_nodes; v++) {
+        if (distance[v] != kUnreachable)
+          continue;
+        if (checkpoint.Stop())
+          return distance;
+        ForEachNeighbor(neighbors, v, [&](uint32_t parent) {
+          if (distance[parent] != depth)
+            return true;
+          distance[v] = depth + 1;
+          next_frontier.push_back(v);
+          return false;
+        });
+      }
+    } else {
+      for (uint32_t x : frontier) {
+        if (checkpoint.Stop())
+          return distance;
+        ForEachNeighbor(neighbors, x, [&](uint32_t next) {
+          if (distance[next] != kUnreachable)
+            return true;
+          distance[next] = depth + 1;
+          next_frontier.push_back(next);
+          return true;
+        });
+      }
+    }
+
+    frontier_edges = 0;
+    for (uint32_t node : next_frontier)
+      frontier_edges += adjacency->Degree(node);
+    frontier.swap(next_frontier);
+  }
+  return distance;
+}
+
+bool GraphVersion::RepairDistances(uint32_t src,
+                                   std::vector<uint32_t> &distances,
+                                   const std::vector<EdgeEdit> &edits) const {
+  const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+  if (src >= distances.size() || distances[src] != 0)
+    return false;
+
+  // Removing an edge that no shortest path uses leaves every distance as is,
+  // anything else would need the in-going edges to find the new parents
+  for (const EdgeEdit &edit : edits) {
+    if (!edit.insert && distances[edit.src] != kUnreachable &&
+        distances[edit.src] + 1 == distances[edit.dest])
+      return false;
+  }
+
+  // Inserted edges can only shorten distances, push them outward in the
+  // order of the new distances
+  typedef std::pair<uint32_t, uint32_t> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      Q;
+  for (const EdgeEdit &edit : edits) {
+    if (!edit.insert || distances[edit.src] == kUnreachable ||
+        distances[edit.src] + 1 >= distances[edit.dest])
+      continue;
+    // The edge may have been removed again later in the batch
+    bool present = false;
+    ForEachNeighbor(edit.src, [&](uint32_t next) {
+      present = next == edit.dest;
+      return !present;
+    });
+    if (!present)
+      continue;
+    distances[edit.dest] = distances[edit.src] + 1;
+    Q.push(std::make_pair(distances[edit.dest], edit.dest));
+  }
+
+  while (!Q.empty()) {
+    QueueEntry top = Q.top();
+    Q.pop();
+    if (top.first != distances[top.second])
+      continue;
+    ForEachNeighbor(top.second, [&](uint32_t next) {
+      if (top.first + 1 < distances[next]) {
+        distances[next] = top.first + 1;
+        Q.push(std::make_pair(distances[next], next));
+      }
+      return true;
+    });
+  }
+  return true;
+}
+
+constexpr size_t Graph::kMinCompactionEdits;
+
+Graph::Graph(std::vector<std::vector<uint32_t>> adj_list, std::string name)
+    : Graph(CsrAdjacency(adj_list), name) {}
+
+Graph::Graph(CsrAdjacency csr, std::string name, uint32_t num_landmarks,
+             NodePermutation permutation, bool compress,
+             PlacementPolicy placement)
+    : num_nodes(csr.NumNodes()), graph_name(name),
+      num_landmarks(num_landmarks), permutation(std::move(permutation)),
+      compress(compress), placement(placement) {
+  std::shared_ptr<CsrAdjacency> adjacency =
+      this->permutation.Empty()
+          ? std::make_shared<CsrAdjacency>(std::move(csr))
+          : std::make_shared<CsrAdjacency>(
+                csr.Relabel(this->permutation.to_internal));
+  // Indexes are built on the plain neighbor lists, before they are
+  // compressed or narrowed
+  std::shared_ptr<const GraphIndexes> indexes =
+      std::make_shared<GraphIndexes>(*adjacency, num_landmarks);
+  if (compress)
+    adjacency->Compress();
+  adjacency->Narrow();
+  std::shared_ptr<const AdjacencyReplicas> replicas = Place(adjacency);
+  std::lock_guard<std::mutex> guard(write_mutex);
+  Publish(std::make_shared<GraphVersion>(1, adjacency, DeltaAdjacency(),
+                                         indexes, replicas));
+}
+
+std::shared_ptr<const AdjacencyReplicas>
+Graph::Place(const std::shared_ptr<const CsrAdjacency> &adjacency) const {
+  if (adjacency->Bytes() < placement.min_bytes)
+    return nullptr;
+  if (placement.placement != REPLICATE_PLACEMENT || NumMemoryNodes() == 1) {
+    adjacency->Place(placement.placement, placement.huge_pages);
+    return nullptr;
+  }
+
+  // The adjacency serves the first memory node, every other node gets a
+  // copy. Copies are first touched by this thread and then moved.
+  std::shared_ptr<AdjacencyReplicas> replicas =
+      std::make_shared<AdjacencyReplicas>(MemoryNodeIdLimit());
+  bool first = true;
+  for (uint32_t node = 0; node < replicas->size(); node++) {
+    if (!MemoryNodeOnline(node))
+      continue;
+    (*replicas)[node] =
+        first ? adjacency : std::make_shared<CsrAdjacency>(*adjacency);
+    (*replicas)[node]->Place(REPLICATE_PLACEMENT, placement.huge_pages, node);
+    first = false;
+  }
+  return replicas;
+}
+
+uint32_t GraphVersion::NumReplicas() const {
+  if (!replicas)
+    return 0;
+  uint32_t copies = 0;
+  for (const auto &replica : *replicas)
+    copies += replica && replica != adjacency;
+  return copies;
+}
+
+Graph::~Graph() {
+  if (!spill_path.empty())
+    std::remove(spill_path.c_str());
+}
+
+void Graph::Publish(std::shared_ptr<GraphVersion> version) {
+  publications++;
+  version->previous = current;
+  GraphVersionSharedPtr published_version = version;
+  std::atomic_store(&current, published_version);
+
+  // Drop the oldest retained version, it lives on while queries use it
+  retained.push_back(published_version);
+  if (retained.size() > kRetainedVersions)
+    retained.pop_front();
+  published.erase(
+      std::remove_if(published.begin(), published.end(),
+                     [](const std::weak_ptr<const GraphVersion> &weak) {
+                       return weak.expired();
+                     }),
+      published.end());
+  published.push_back(published_version);
+}
+
+GraphVersionSharedPtr Graph::Current() {
+  GraphVersionSharedPtr latest = Resident();
+  if (latest)
+    return latest;
+  std::lock_guard<std::mutex> guard(write_mutex);
+  return LatestLocked();
+}
+
+GraphVersionSharedPtr Graph::LatestLocked() {
+  // Graphs traversed out of core do not fit the memory budget
+  if (current || spill_path.empty() || spilled_publication == 0 || external)
+    return current;
+
+  auto start = std::chrono::steady_clock::now();
+  std::ifstream in(spill_path, std::ios::binary);
+  uint32_t magic = 0;
+  uint64_t version;
+  std::shared_ptr<CsrAdjacency> adjacency = std::make_shared<CsrAdjacency>();
+  DeltaAdjacency delta;
+  std::shared_ptr<GraphIndexes> indexes = std::make_shared<GraphIndexes>();
+  if (!ReadValue(in, &magic) || magic != kSpillMagic ||
+      !ReadValue(in, &version) || !adjacency->Load(in) ||
+      !delta.Load(in, *adjacency) || !indexes->Load(in))
+    return nullptr;
+  std::shared_ptr<const AdjacencyReplicas> replicas = Place(adjacency);
+  Publish(std::make_shared<GraphVersion>(version, adjacency, std::move(delta),
+                                         indexes, replicas));
+  // The file still holds the latest version until the next edit
+  spilled_publication = publications;
+
+  uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  fault_ins++;
+  fault_in_micros += micros;
+  if (micros > max_fault_in_micros)
+    max_fault_in_micros = micros;
+  return current;
+}
+
+bool Graph::Spill(const std::string &path, bool out_of_core) {
+  std::lock_guard<std::mutex> guard(write_mutex);
+  // A compaction publishes on top of the latest version, let it finish
+  if (!current || compaction_pending)
+    return false;
+
+  if (spill_path.empty())
+    spill_path = path;
+  if (spilled_publication != publications) {
+    spilled_publication = 0;
+    std::ofstream out(spill_path, std::ios::binary | std::ios::trunc);
+    WriteValue(out, kSpillMagic);
+    WriteValue(out, current->version);
+    current->adjacency->Save(out, &spill_lists_position);
+    current->delta.Save(out);
+    current->indexes->Save(out);
+    out.flush();
+    if (!out) {
+      std::remove(spill_path.c_str());
+      return false;
+    }
+    spill_file_bytes = out.tellp();
+    spilled_publication = publications;
+  }
+
+  if (out_of_core) {
+    ExternalAdjacencySharedPtr lists = std::make_shared<ExternalAdjacency>(
+        *current->adjacency, current->delta, current->version, spill_path,
+        spill_lists_position);
+    if (!lists->Valid())
+      return false;
+    std::atomic_store(&external, lists);
+  }
+  std::atomic_store(&current, GraphVersionSharedPtr());
+  retained.clear();
+  return true;
+}
+
+uint64_t Graph::Bytes() const {
+  GraphVersionSharedPtr latest = Resident();
+  uint64_t bytes = (permutation.to_internal.size() +
+                    permutation.to_external.size()) *
+                   sizeof(uint32_t);
+  if (latest)
+    return bytes + latest->Bytes();
+  ExternalAdjacencySharedPtr lists = OutOfCore();
+  return lists ? bytes + lists->Bytes() : bytes;
+}
+
+GraphVersionSharedPtr Graph::Version(uint64_t version) {
+  // Walk back from the latest version, newer versions come first
+  GraphVersionSharedPtr candidate = Current();
+  while (candidate && candidate->Version() > version)
+    candidate = candidate->previous.lock();
+  if (candidate && candidate->Version() == version)
+    return candidate;
+  return nullptr;
+}
+
+uint32_t Graph::ApplyEdits(const std::vector<EdgeEdit> &edits,
+                           uint64_t *version, std::vector<EdgeEdit> *applied,
+                           std::string *error) {
+  std::lock_guard<std::mutex> guard(write_mutex);
+  GraphVersionSharedPtr latest = LatestLocked();
+  *version = latest ? latest->Version() : 0;
+  if (!latest)
+    return 0;
+
+  // Copy on write, the delta of the latest version stays untouched
+  DeltaAdjacency delta = latest->delta;
+  // Undirected graphs take every edit in both directions, so that the
+  // adjacency stays its own reverse
+  bool symmetric = latest->adjacency->Symmetric();
+  uint32_t changed = 0;
+  for (const EdgeEdit &edit : edits) {
+    bool edit_changed = false;
+    for (uint32_t direction = 0; direction < (symmetric ? 2 : 1); direction++) {
+      EdgeEdit directed = edit;
+      if (direction == 1) {
+        if (edit.src == edit.dest)
+          break;
+        std::swap(directed.src, directed.dest);
+      }
+      if (!delta.Apply(*latest->adjacency, directed))
+        continue;
+      edit_changed = true;
+      if (applied != nullptr)
+        applied->push_back(directed);
+    }
+    changed += edit_changed;
+  }
+  if (changed == 0)
+    return 0;
+  // The batch is dropped as a whole, a compaction could not store it
+  if (delta.NumEdges(*latest->adjacency) > kMaxAdjacencyEdges) {
+    if (applied != nullptr)
+      applied->clear();
+    if (error != nullptr)
+      *error = "ERROR: Graph would store more than " +
+               std::to_string(kMaxAdjacencyEdges) + " edges";
+    return 0;
+  }
 
+  *version = latest->Version() + 1;
+  Publish(std::make_shared<GraphVersion>(*version, latest->adjacency,
+                                         std::move(delta), latest->indexes,
+                                         latest->replicas));
+  return changed;
+}
+
+bool Graph::NeedsCompaction() const {
+  GraphVersionSharedPtr latest = Resident();
+  if (!latest)
+    return false;
+  size_t threshold = std::max<uint64_t>(
+      kMinCompactionEdits, latest->adjacency->NumEdges() / kCompactionRatio);
+  return latest->delta.Log().size() >= threshold;
+}
+
+void Graph::Compact() {
+  // Build the new adjacency and indexes while queries and edits go on
+  GraphVersionSharedPtr snapshot = Current();
+  if (!snapshot) {
+    compaction_pending = false;
+    return;
+  }
+  std::shared_ptr<CsrAdjacency> adjacency =
+      std::make_shared<CsrAdjacency>(snapshot->delta.Compact(*snapshot->adjacency));
+  std::shared_ptr<const GraphIndexes> indexes =
+      std::make_shared<GraphIndexes>(*adjacency, num_landmarks);
+  if (compress)
+    adjacency->Compress();
+  adjacency->Narrow();
+  std::shared_ptr<const AdjacencyReplicas> replicas = Place(adjacency);
+
+  {
+    std::lock_guard<std::mutex> guard(write_mutex);
+    // Edits published during the rebuild move over to the new delta
+    GraphVersionSharedPtr latest = current;
+    const std::vector<EdgeEdit> &log = latest->delta.Log();
+    DeltaAdjacency remaining;
+    for (size_t i = snapshot->delta.Log().size(); i < log.size(); i++)
+      remaining.Apply(*adjacency, log[i]);
+    Publish(std::make_shared<GraphVersion>(latest->Version(), adjacency,
+                                           std::move(remaining), indexes,
+                                           replicas));
+  }
+  compaction_pending = false;
+}
+
+uint32_t Graph::LiveVersions() {
+  std::lock_guard<std::mutex> guard(write_mutex);
+  uint32_t live = 0;
+  for (const std::weak_ptr<const GraphVersion> &weak : published) {
+    if (!weak.expired())
+      live++;
+  }
+  return live;
+}
+
+bool StreamResult::NextChunk(graph::Response *chunk) {
+  size_t num_entries = std::max(distances.size(), scores.size());
+  if (started && next_entry >= num_entries)
+    return false;
+
+  chunk->Clear();
+  if (!started) {
+    chunk->set_message(message);
+    started = true;
+  }
+
+  size_t end = std::min(num_entries, next_entry + kChunkSize);
+  chunk->set_chunk_offset(next_entry);
+  if (!scores.empty()) {
+    chunk->mutable_scores()->Reserve(end - next_entry);
+    for (size_t i = next_entry; i < end; i++)
+      chunk->add_scores(scores[i]);
+  } else {
+    chunk->mutable_distances()->Reserve(end - next_entry);
+    for (size_t i = next_entry; i < end; i++)
+      chunk->add_distances(distances[i]);
+  }
+  if (!nodes.empty()) {
+    chunk->mutable_nodes()->Reserve(end - next_entry);
+    for (size_t i = next_entry; i < end; i++)
+      chunk->add_nodes(nodes[i]);
+  }
+  next_entry = end;
+  return true;
+}
+
+std::string GraphEngine::PostGraphRequest(graph::Request &request) {
   // Compute the hash value from graph name to generate graph id
+  std::string graph_name = request.graph_name();
   uint64_t hash_val = hash_fn(graph_name);
 
+  if (request.async_build()) {
+    uint64_t ticket;
+    // Reserve the id, so that the graph cannot be posted twice meanwhile
+    {
+      std::lock_guard<std::mutex> guard(graph_db_mutex);
+      auto build = builds.find(hash_val);
+      if (graph_db.count(hash_val) != 0 ||
+          (build != builds.end() && !build->second.failed)) {
+        return "ERROR: Graph already in DB";
+      }
+      builds[hash_val] = GraphBuild();
+      builds[hash_val].ticket = ++build_tickets;
+      ticket = build_tickets;
+    }
+    async_builds++;
+
+    // The build owns the payload, the RPC completes right away
+    std::shared_ptr<graph::Request> payload =
+        std::make_shared<graph::Request>();
+    payload->Swap(&request);
+    build_pool.Submit([this, payload, hash_val, ticket]() mutable {
+      auto start = std::chrono::steady_clock::now();
+      GraphSharedPtr graph;
+      std::string error = BuildGraph(*payload, &graph);
+      payload.reset();
+      build_micros += std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+      finished_builds++;
+      FinishBuild(hash_val, ticket, graph, error);
+    });
+    return std::to_string(hash_val);
+  }
+
+  GraphSharedPtr graph_shared_ptr;
+  std::string error = BuildGraph(request, &graph_shared_ptr);
+  if (!error.empty())
+    return error;
+
   // Lock the graph db to check for duplicate graphs with hash_val
   {
     std::lock_guard<std::mutex> guard(graph_db_mutex);
     auto it = graph_db.find(hash_val);
-    if (it == graph_db.end()) {
+    auto build = builds.find(hash_val);
+    if (it == graph_db.end() &&
+        (build == builds.end() || build->second.failed)) {
       // If there are no duplicates add to graph DB
       graph_db.insert(std::make_pair(hash_val, graph_shared_ptr));
+      if (build != builds.end())
+        builds.erase(build);
     } else {
       return "ERROR: Graph already in DB";
     }
   }
+  write_epoch++;
+  graph_shared_ptr->Touch(++access_clock);
+  EnforceMemoryBudget(graph_shared_ptr);
 
   return std::to_string(hash_val);
 }
 
+void GraphEngine::FinishBuild(uint64_t graph_id, uint64_t ticket,
+                              GraphSharedPtr graph, const std::string &error) {
+  std::vector<std::function<void()>> waiters;
+  {
+    std::lock_guard<std::mutex> guard(graph_db_mutex);
+    // Deleted while it was being built, and maybe posted again
+    auto build = builds.find(graph_id);
+    if (build == builds.end() || build->second.ticket != ticket)
+      return;
+    waiters.swap(build->second.waiters);
+    if (graph) {
+      graph_db.insert(std::make_pair(graph_id, graph));
+      builds.erase(build);
+    } else {
+      build->second.failed = true;
+      build->second.error = error;
+    }
+  }
+  if (graph) {
+    write_epoch++;
+    graph->Touch(++access_clock);
+    EnforceMemoryBudget(graph);
+  } else {
+    failed_builds++;
+  }
+  for (auto &waiter : waiters)
+    waiter();
+}
+
+std::string GraphEngine::BuildGraph(graph::Request &request,
+                                    GraphSharedPtr *graph) {
+  // Get total number of nodes
+  uint32_t num_nodes = request.graph_total_nodes();
+  if (request.node_labels_size() != 0 &&
+      uint64_t(request.node_labels_size()) != num_nodes)
+    return "ERROR: Node labels must match the number of nodes";
+
+  WeightType weight_type = UNWEIGHTED;
+  if (request.weight_type() == graph::INTEGER_WEIGHTS)
+    weight_type = INTEGER_WEIGHTS;
+  else if (request.weight_type() == graph::FLOAT_WEIGHTS)
+    weight_type = FLOAT_WEIGHTS;
+
+  // Validate, sort and deduplicate the edges, small graphs are not worth
+  // waking up a team for
+  uint32_t ingest_threads = 1;
+  if (uint64_t(request.adjacency_list_size()) >=
+      options.parallel_ingest_min_edges)
+    ingest_threads = std::max<uint32_t>(1, options.ingest_threads);
+  ThreadTeam team(ingest_threads, options.background_nice);
+  CsrAdjacency adjacency;
+  std::string error =
+      IngestEdges(request.adjacency_list(), num_nodes, weight_type,
+                  request.labeled_edges(), options.drop_self_loops,
+                  request.undirected(), team, &adjacency);
+  if (!error.empty())
+    return error;
+  if (request.node_labels_size() != 0) {
+    adjacency.SetNodeLabels(std::vector<uint32_t>(
+        request.node_labels().begin(), request.node_labels().end()));
+  }
+
+  // Lay the nodes out for cache locality, clients keep their node ids
+  NodeOrder order = ORIGINAL_ORDER;
+  switch (request.node_order()) {
+  case graph::RCM_ORDER:
+    order = RCM_ORDER;
+    break;
+  case graph::DEGREE_ORDER:
+    order = DEGREE_ORDER;
+    break;
+  case graph::GORDER:
+    order = GORDER;
+    break;
+  default:
+    break;
+  }
+  NodePermutation permutation = ComputeNodeOrder(adjacency, order);
+
+  // Trade traversal speed for memory on large graphs only
+  bool compress = false;
+  if (options.adjacency_encoding == COMPRESSED_ADJACENCY) {
+    compress = true;
+  } else if (options.adjacency_encoding == AUTO_ADJACENCY &&
+             adjacency.NeighborBytes() >= options.compression_min_bytes) {
+    compress = 4 * adjacency.CompressedBytes() <= 3 * adjacency.NeighborBytes();
+  }
+
+  // Build Graph
+  *graph = std::make_shared<Graph>(std::move(adjacency), request.graph_name(),
+                                   options.num_landmarks,
+                                   std::move(permutation), compress,
+                                   options.placement);
+  return "";
+}
+
+GraphSharedPtr GraphEngine::FindGraph(uint64_t graph_id) {
+  GraphSharedPtr graph;
+  {
+    std::lock_guard<std::mutex> guard(graph_db_mutex);
+    auto it = graph_db.find(graph_id);
+    if (it == graph_db.end())
+      return nullptr;
+    graph = it->second;
+  }
+  graph->Touch(++access_clock);
+
+  // Read a spilled graph back now, which may push colder graphs out
+  if (!graph->Resident() && graph->Current())
+    EnforceMemoryBudget(graph);
+  return graph;
+}
+
+void GraphEngine::EnforceMemoryBudget(const GraphSharedPtr &keep) {
+  if (options.memory_budget_bytes == 0)
+    return;
+  std::lock_guard<std::mutex> budget_guard(budget_mutex);
+
+  // Stamps are taken once, queries keep touching the graphs meanwhile
+  struct Candidate {
+    uint64_t last_access;
+    uint64_t graph_id;
+    GraphSharedPtr graph;
+  };
+  std::vector<Candidate> candidates;
+  uint64_t resident_bytes = 0;
+  {
+    std::lock_guard<std::mutex> guard(graph_db_mutex);
+    for (const auto &entry : graph_db) {
+      candidates.push_back(
+          Candidate{entry.second->LastAccess(), entry.first, entry.second});
+    }
+  }
+  for (const Candidate &candidate : candidates)
+    resident_bytes += candidate.graph->Bytes();
+  if (resident_bytes <= options.memory_budget_bytes)
+    return;
+
+  // Least recently queried graphs go first
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.last_access < b.last_access;
+            });
+  for (const Candidate &candidate : candidates) {
+    if (resident_bytes <= options.memory_budget_bytes)
+      break;
+    uint64_t bytes = candidate.graph->Bytes();
+    // Graphs that alone exceed the budget are never read back, not even the
+    // one just posted
+    bool out_of_core = options.out_of_core &&
+                       bytes > options.memory_budget_bytes;
+    if ((candidate.graph == keep && !out_of_core) ||
+        !candidate.graph->Resident())
+      continue;
+    std::string path = options.spill_directory + "/graph_" +
+                       std::to_string(candidate.graph_id) + "_" +
+                       std::to_string(spill_files++) + ".spill";
+    if (!candidate.graph->Spill(path, out_of_core))
+      continue;
+    resident_bytes -= bytes - candidate.graph->Bytes();
+    spills++;
+  }
+}
+
 std::string GraphEngine::DeleteGraphRequest(graph::Request &request) {
   // Parse graph id from the request
   uint64_t hash_id = request.delete_graph().map_id();
+  std::vector<std::function<void()>> waiters;
   // Lock the graph db to check for the graph with hash_id
   {
     std::lock_guard<std::mutex> guard(graph_db_mutex);
     auto it = graph_db.find(hash_id);
-    if (it != graph_db.end()) {
+    auto build = builds.find(hash_id);
+    if (build != builds.end()) {
+      // The build runs to its end but its graph is dropped
+      waiters.swap(build->second.waiters);
+      builds.erase(build);
+    } else if (it != graph_db.end()) {
       graph_db.erase(it);
+      // Drop cached distances under the same lock, so that a graph posted
+      // again under the same id never sees them
+      distance_cache.InvalidateGraph(hash_id);
     } else {
       return "ERROR: Graph not present in DB";
     }
   }
+  write_epoch++;
+  // Waiting requests find no graph
+  for (auto &waiter : waiters)
+    waiter();
   return "OK, deleted graph with ID: " + std::to_string(hash_id);
 }
 
+std::string GraphEngine::GraphStatusRequest(graph::Request &request) {
+  uint64_t graph_id = request.graph_status().map_id();
+  std::lock_guard<std::mutex> guard(graph_db_mutex);
+  auto build = builds.find(graph_id);
+  if (build != builds.end() && build->second.failed) {
+    // Errors of the build start with "ERROR: "
+    return "ERROR: Graph build failed, " + build->second.error.substr(7);
+  }
+  if (build != builds.end())
+    return "NOT_READY: Graph " + std::to_string(graph_id) +
+           " is still being built";
+  if (graph_db.find(graph_id) != graph_db.end())
+    return "OK, graph " + std::to_string(graph_id) + " is ready";
+  return "ERROR: Graph not present in DB";
+}
+
+std::string GraphEngine::SubmitJobRequest(graph::Request &request) {
+  const graph::AnalyticsJob &job = request.job();
+  GraphSharedPtr graph = FindGraph(job.map_id());
+  if (!graph) {
+    return "ERROR: Graph not present in DB";
+  }
+  if (graph->OutOfCore()) {
+    return VersionError(graph);
+  }
+  if (job.damping() < 0 || job.damping() >= 1 || job.tolerance() < 0) {
+    return "ERROR: Invalid PageRank parameters";
+  }
+
+  uint64_t job_id;
+  {
+    std::lock_guard<std::mutex> guard(jobs_mutex);
+    job_id = ++last_job_id;
+    jobs[job_id] = JobState();
+    submitted_jobs++;
+  }
+  analytics_pool.Submit(
+      [this, job_id, graph, job] { RunJob(job_id, graph, job); });
+  return "OK, submitted job with ID: " + std::to_string(job_id);
+}
+
+void GraphEngine::RunJob(uint64_t job_id, GraphSharedPtr graph,
+                         const graph::AnalyticsJob &job) {
+  {
+    std::lock_guard<std::mutex> guard(jobs_mutex);
+    jobs[job_id].running = true;
+  }
+  auto start = std::chrono::steady_clock::now();
+  StreamResultSharedPtr result = std::make_shared<StreamResult>();
+  // Jobs run on the version that is latest when they start
+  GraphVersionSharedPtr version = graph->Current();
+  uint32_t num_nodes = graph->NumNodes();
+  ThreadTeam team(options.analytics_threads);
+  // The budget counts from the start of the job, not its submission. The
+  // members of the team poll the control of the job.
+  std::unique_ptr<QueryControl> control;
+  if (job.time_budget_ms() != 0) {
+    control.reset(new QueryControl(
+        start + std::chrono::milliseconds(job.time_budget_ms())));
+  }
+  ScopedQueryControl scope(control.get());
+  if (!version) {
+    result->message = VersionError(graph);
+  } else if (job.job_type() == graph::CONNECTED_COMPONENTS) {
+    std::vector<uint32_t> labels = version->ConnectedComponents(team);
+    // Components are named by their smallest client node id
+    std::vector<uint32_t> smallest(num_nodes,
+                                   std::numeric_limits<uint32_t>::max());
+    std::vector<uint32_t> sizes(num_nodes, 0);
+    for (uint32_t node = 0; node < num_nodes; node++) {
+      smallest[labels[node]] =
+          std::min(smallest[labels[node]], graph->External(node));
+      sizes[labels[node]]++;
+    }
+    result->distances.resize(num_nodes);
+    for (uint32_t node = 0; node < num_nodes; node++)
+      result->distances[node] = smallest[labels[graph->Internal(node)]];
+    uint32_t components = 0;
+    uint32_t largest = 0;
+    for (uint32_t node = 0; node < num_nodes; node++) {
+      components += sizes[node] == 0 ? 0 : 1;
+      largest = std::max(largest, sizes[node]);
+    }
+    result->message = "OK, found " + std::to_string(components) +
+                      " connected components, the largest has " +
+                      std::to_string(largest) + " nodes";
+  } else if (job.job_type() == graph::PAGERANK) {
+    uint32_t iterations;
+    std::vector<double> ranks = version->PageRank(
+        job.damping() == 0 ? 0.85 : job.damping(),
+        job.max_iterations() == 0 ? 20 : job.max_iterations(),
+        job.tolerance() == 0 ? 1e-6 : job.tolerance(), team, &iterations);
+    result->scores.resize(num_nodes);
+    for (uint32_t node = 0; node < num_nodes; node++)
+      result->scores[node] = ranks[graph->Internal(node)];
+    result->message = "OK, computed PageRank in " +
+                      std::to_string(iterations) + " iterations";
+  } else if (job.job_type() == graph::DEGREE_HISTOGRAM) {
+    std::vector<uint64_t> histogram = version->DegreeHistogram(team);
+    uint64_t edges = 0;
+    for (uint32_t degree = 0; degree < histogram.size(); degree++) {
+      if (histogram[degree] == 0)
+        continue;
+      result->nodes.push_back(degree);
+      result->distances.push_back(histogram[degree]);
+      edges += histogram[degree] * degree;
+    }
+    result->message =
+        "OK, computed out-degree histogram, max degree " +
+        std::to_string(histogram.empty() ? 0 : histogram.size() - 1) +
+        ", average degree " +
+        std::to_string(double(edges) / std::max(1u, num_nodes));
+  } else {
+    result->message = "ERROR: Unknown job type";
+  }
+  if (QueryControl::CurrentStopped()) {
+    *result = StreamResult();
+    result->message = "ERROR: Time budget of " +
+                      std::to_string(job.time_budget_ms()) + " ms exceeded";
+  }
+  job_micros += std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  if (result->message.compare(0, 6, "ERROR:") == 0)
+    failed_jobs++;
+
+  std::lock_guard<std::mutex> guard(jobs_mutex);
+  JobState &state = jobs[job_id];
+  state.running = false;
+  state.result = result;
+  finished_jobs.push_back(job_id);
+  if (finished_jobs.size() > kRetainedJobs) {
+    jobs.erase(finished_jobs.front());
+    finished_jobs.pop_front();
+  }
+}
+
+std::string GraphEngine::JobStatusRequest(graph::Request &request) {
+  uint64_t job_id = request.job().job_id();
+  std::lock_guard<std::mutex> guard(jobs_mutex);
+  auto it = jobs.find(job_id);
+  if (it == jobs.end()) {
+    return "ERROR: Job not present";
+  }
+  const JobState &state = it->second;
+  if (!state.result) {
+    return "NOT_READY: Job " + std::to_string(job_id) + " is " +
+           (state.running ? "running" : "queued");
+  }
+  // Strip the "OK, " or "ERROR: " of the result
+  const std::string &message = state.result->message;
+  if (message.compare(0, 6, "ERROR:") == 0) {
+    return "ERROR: Job " + std::to_string(job_id) + " failed, " +
+           message.substr(7);
+  }
+  return "OK, job " + std::to_string(job_id) + " is done, " +
+         message.substr(4);
+}
+
+void GraphEngine::JobResultRequest(graph::Request &request,
+                                   StreamResult &result) {
+  uint64_t job_id = request.job().job_id();
+  StreamResultSharedPtr finished;
+  {
+    std::lock_guard<std::mutex> guard(jobs_mutex);
+    auto it = jobs.find(job_id);
+    if (it == jobs.end()) {
+      result.message = "ERROR: Job not present";
+      return;
+    }
+    finished = it->second.result;
+  }
+  if (!finished) {
+    result.message =
+        "NOT_READY: Job " + std::to_string(job_id) + " is not finished";
+    return;
+  }
+  // Results stay for later fetches, every fetch streams its own copy
+  result.message = finished->message;
+  result.distances = finished->distances;
+  result.nodes = finished->nodes;
+  result.scores = finished->scores;
+}
+
+bool GraphEngine::QueriedGraph(const graph::Request &request,
+                               uint64_t *graph_id) {
+  switch (request.request_type()) {
+  case graph::GET_MIN_DISTANCE:
+    *graph_id = request.min_distance().map_id();
+    return true;
+  case graph::GET_DISTANCES:
+    *graph_id = request.multi_distance().map_id();
+    return true;
+  case graph::ADD_EDGES:
+  case graph::REMOVE_EDGES:
+    *graph_id = request.update_graph().map_id();
+    return true;
+  case graph::GET_WEIGHTED_DISTANCE:
+    *graph_id = request.weighted_distance().map_id();
+    return true;
+  case graph::GET_CONSTRAINED_DISTANCE:
+    *graph_id = request.constrained_distance().map_id();
+    return true;
+  case graph::GET_NEIGHBORHOOD:
+    *graph_id = request.neighborhood().map_id();
+    return true;
+  case graph::SUBMIT_JOB:
+    *graph_id = request.job().map_id();
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool GraphEngine::GraphBuilding(const graph::Request &request) {
+  uint64_t graph_id;
+  if (!QueriedGraph(request, &graph_id))
+    return false;
+  std::lock_guard<std::mutex> guard(graph_db_mutex);
+  auto build = builds.find(graph_id);
+  return build != builds.end() && !build->second.failed;
+}
+
+bool GraphEngine::WaitForBuild(const graph::Request &request,
+                               std::function<void()> retry) {
+  uint64_t graph_id;
+  if (!request.wait_ready() || !QueriedGraph(request, &graph_id))
+    return false;
+  std::lock_guard<std::mutex> guard(graph_db_mutex);
+  auto build = builds.find(graph_id);
+  if (build == builds.end() || build->second.failed)
+    return false;
+  build->second.waiters.push_back(std::move(retry));
+  return true;
+}
+
 std::string GraphEngine::MinDistanceGraphRequest(graph::Request &request) {
   // Parse graph id, source and destination node from request
   uint64_t graph_id = request.min_distance().map_id();
   uint32_t source_node = request.min_distance().begin_node();
   uint32_t end_node = request.min_distance().end_node();
-  // Lock the graph db to check for the graph
+
+  // Hold a reference and traverse outside the lock, queries run on an
+  // immutable version of the graph
+  GraphSharedPtr graph = FindGraph(graph_id);
+  if (!graph) {
+    return "ERROR: Graph not present in DB";
+  }
+
+  // Version 0 stands for the latest version
+  uint64_t version_number = request.min_distance().version();
+  GraphVersionSharedPtr version = version_number == 0
+                                      ? graph->Current()
+                                      : graph->Version(version_number);
+  ExternalAdjacencySharedPtr out_of_core =
+      version ? nullptr : graph->OutOfCore();
+  if (!version && !(out_of_core && (version_number == 0 ||
+                                    version_number == out_of_core->Version()))) {
+    return "ERROR: Graph version not available";
+  }
+
+  if (source_node >= graph->NumNodes() || end_node >= graph->NumNodes()) {
+    return "ERROR: Node not present in graph";
+  }
+
+  // Traversals run on internal node ids
+  uint32_t src = graph->Internal(source_node);
+  uint32_t dest = graph->Internal(end_node);
+
+  if (out_of_core) {
+    // No index is kept for lists read from disk, approximate queries get
+    // the exact distance
+    std::vector<uint32_t> distance =
+        out_of_core->Bfs(src, dest, request.min_distance().max_hops());
+    if (distance.empty()) {
+      return "ERROR: Graph could not be read from disk";
+    }
+    std::string value = std::to_string(distance[dest]);
+    if (request.min_distance().approximate()) {
+      return "OK, estimated minimum distance between " +
+             std::to_string(source_node) + " " + std::to_string(end_node) +
+             " to be " + value + ", bounds " + value + " " + value;
+    }
+    return "OK, found minimum distance between " +
+           std::to_string(source_node) + " " + std::to_string(end_node) +
+           " to be " + value +
+           (request.min_distance().explain() ? ", plan out_of_core_bfs" : "");
+  }
+
+  if (request.min_distance().approximate()) {
+    // Paths through a landmark are real paths, the upper bound is the
+    // estimate
+    uint32_t lower, upper;
+    ApproximateDistance(graph_id, graph, version, src, dest,
+                        request.min_distance().max_bound_width(), &lower,
+                        &upper);
+    return "OK, estimated minimum distance between " +
+           std::to_string(source_node) + " " + std::to_string(end_node) +
+           " to be " + std::to_string(upper) + ", bounds " +
+           std::to_string(lower) + " " + std::to_string(upper);
+  }
+
+  PlanChoice choice;
+  uint32_t min_dist = ComputeMinDistance(graph_id, graph, version, src, dest,
+                                         request.min_distance().max_hops(),
+                                         &choice);
+  std::string reply = "OK, found minimum distance between " +
+                      std::to_string(source_node) + " " +
+                      std::to_string(end_node) + " to be " +
+                      std::to_string(min_dist);
+  if (request.min_distance().explain()) {
+    reply += ", plan " + std::string(PlanName(choice.plan)) +
+             ", estimated cost " + std::to_string(uint64_t(choice.cost));
+  }
+  return reply;
+}
+
+uint32_t GraphEngine::ComputeMinDistance(uint64_t graph_id,
+                                         const GraphSharedPtr &graph,
+                                         const GraphVersionSharedPtr &version,
+                                         uint32_t src, uint32_t dest,
+                                         uint32_t max_hops,
+                                         PlanChoice *explain) {
+  const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+  // Distances past the hop limit are reported as unreachable
+  auto bounded = [max_hops, kUnreachable](uint32_t distance) {
+    return max_hops != 0 && distance > max_hops ? kUnreachable : distance;
+  };
+  PlanChoice choice;
+  auto answer = [&](QueryPlan plan, uint32_t distance) {
+    choice.plan = plan;
+    plan_counts[plan]++;
+    if (explain != nullptr)
+      *explain = choice;
+    return distance;
+  };
+
+  // Plans that cost no traversal come first, at a nominal cost of 1
+  choice.cost = 1;
+  GraphStructure structure = version->Structure();
+  if (structure == DIRECTED_FOREST || structure == UNDIRECTED_FOREST)
+    return answer(FOREST_PLAN, bounded(version->MinEdgeForest(src, dest)));
+  if (src == dest)
+    return answer(SAME_NODE_PLAN, 0);
+  if (!version->MayReach(src, dest))
+    return answer(REACHABILITY_PLAN, kUnreachable);
+
+  DistanceArraySharedPtr cached =
+      distance_cache.Lookup(graph_id, src, version->Version());
+  if (cached)
+    return answer(CACHED_PLAN, bounded(cached->Get(dest)));
+
+  // Landmark bounds that meet are the distance, a lower bound past the hop
+  // limit rules the destination out
+  uint32_t lower = 0;
+  uint32_t upper = kUnreachable;
+  if (version->DistanceBounds(src, dest, &lower, &upper)) {
+    if (lower == upper || lower == kUnreachable)
+      return answer(LANDMARK_PLAN, bounded(lower));
+    if (max_hops != 0 && lower > max_hops)
+      return answer(LANDMARK_PLAN, kUnreachable);
+  } else {
+    lower = 0;
+    upper = kUnreachable;
+  }
+
+  // Hot sources get their full distance array cached. Bounded queries only
+  // use arrays that are already there, a full traversal is what they are
+  // meant to avoid.
+  if (max_hops == 0 && distance_cache.Admit(graph_id, src)) {
+    cached = CacheDistances(graph_id, graph, version, src);
+    choice.cost = version->NumNodes() + double(version->NumEdges());
+    return answer(CACHE_FILL_PLAN, cached->Get(dest));
+  }
+
+  // Otherwise the cheapest traversal for the shape of the graph
+  TraversalQuery query;
+  query.max_hops = max_hops;
+  query.symmetric = version->Undirected();
+  query.dag = structure == DAG;
+  query.lower = lower;
+  query.upper = upper;
+  choice = QueryPlanner::Choose(version->Statistics(), query);
+  switch (choice.plan) {
+  case BOUNDED_BFS_PLAN:
+    return answer(choice.plan, bounded(version->MinEdgeBoundedBfs(
+                                   src, dest, choice.max_hops)));
+  case DAG_BFS_PLAN:
+    return answer(choice.plan, bounded(version->MinEdgeDagBfs(src, dest)));
+  default:
+    return answer(choice.plan, bounded(version->MinEdgeBfs(src, dest)));
+  }
+}
+
+void GraphEngine::ApproximateDistance(uint64_t graph_id,
+                                      const GraphSharedPtr &graph,
+                                      const GraphVersionSharedPtr &version,
+                                      uint32_t src, uint32_t dest,
+                                      uint32_t max_bound_width,
+                                      uint32_t *lower_bound,
+                                      uint32_t *upper_bound) {
+  const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+  approximate_queries++;
+
+  // Exact answers that cost no traversal come first
+  uint32_t &lower = *lower_bound;
+  uint32_t &upper = *upper_bound;
+  bool known = true;
+  DistanceArraySharedPtr cached;
+  GraphStructure structure = version->Structure();
+  if (structure == DIRECTED_FOREST || structure == UNDIRECTED_FOREST) {
+    lower = upper = version->MinEdgeForest(src, dest);
+  } else if (!version->MayReach(src, dest)) {
+    lower = upper = kUnreachable;
+  } else if ((cached = distance_cache.Lookup(graph_id, src,
+                                             version->Version()))) {
+    lower = upper = cached->Get(dest);
+  } else {
+    known = version->DistanceBounds(src, dest, &lower, &upper);
+  }
+
+  // Bounds that are too wide, or none at all, escalate to the exact engine.
+  // An unknown upper bound is only acceptable if no width was asked for.
+  bool too_wide =
+      max_bound_width != 0 && lower != upper &&
+      (upper == kUnreachable || upper - lower > max_bound_width);
+  if (!known || too_wide) {
+    approximate_escalations++;
+    lower = upper = ComputeMinDistance(graph_id, graph, version, src, dest, 0);
+  }
+}
+
+DistanceArraySharedPtr
+GraphEngine::CacheDistances(uint64_t graph_id, const GraphSharedPtr &graph,
+                            const GraphVersionSharedPtr &version,
+                            uint32_t src) {
+  DistanceArraySharedPtr distances = std::make_shared<DistanceArray>(
+      version->SingleSourceBfs(src, std::vector<uint32_t>()));
+  // A stopped traversal left distances unset, its query is not answered
+  if (QueryControl::CurrentStopped())
+    return distances;
+
+  // Only insert while the graph is still the one posted under graph_id,
+  // DeleteGraphRequest invalidates the cache under the same lock
+  std::lock_guard<std::mutex> guard(graph_db_mutex);
+  auto it = graph_db.find(graph_id);
+  if (it != graph_db.end() && it->second == graph)
+    distance_cache.Insert(graph_id, src, version->Version(), distances);
+  return distances;
+}
+
+void GraphEngine::MultiDistanceGraphRequest(
+    graph::Request &request, StreamResult &result,
+    DistanceArraySharedPtr precomputed) {
+  // Parse graph id, source and destination nodes from request
+  const graph::MultiDistance &query = request.multi_distance();
+  uint64_t graph_id = query.map_id();
+  uint32_t source_node = query.begin_node();
+  std::vector<uint32_t> targets(query.end_nodes().begin(),
+                                query.end_nodes().end());
+
+  // Hold a reference and traverse outside the lock, queries run on an
+  // immutable version of the graph
+  GraphSharedPtr graph = FindGraph(graph_id);
+  if (!graph) {
+    result.message = "ERROR: Graph not present in DB";
+    return;
+  }
+
+  // Version 0 stands for the latest version
+  GraphVersionSharedPtr version = query.version() == 0
+                                      ? graph->Current()
+                                      : graph->Version(query.version());
+  ExternalAdjacencySharedPtr out_of_core =
+      version ? nullptr : graph->OutOfCore();
+  if (!version && !(out_of_core && (query.version() == 0 ||
+                                    query.version() == out_of_core->Version()))) {
+    result.message = "ERROR: Graph version not available";
+    return;
+  }
+
+  if (targets.empty() && !query.all_nodes()) {
+    result.message = "ERROR: No destination nodes requested";
+    return;
+  }
+  if (source_node >= graph->NumNodes()) {
+    result.message = "ERROR: Node not present in graph";
+    return;
+  }
+  // Traversals run on internal node ids
+  for (uint32_t &target : targets) {
+    if (target >= graph->NumNodes()) {
+      result.message = "ERROR: Node not present in graph";
+      return;
+    }
+    target = graph->Internal(target);
+  }
+  uint32_t src = graph->Internal(source_node);
+
+  if (out_of_core) {
+    // Distances are not cached, the cache holds graphs kept in memory
+    std::vector<uint32_t> distance =
+        out_of_core->Bfs(src, out_of_core->NumNodes(), 0);
+    if (distance.empty()) {
+      result.message = "ERROR: Graph could not be read from disk";
+      return;
+    }
+    if (targets.empty()) {
+      result.distances.resize(distance.size());
+      for (uint32_t node = 0; node < distance.size(); node++)
+        result.distances[node] = distance[graph->Internal(node)];
+    } else {
+      result.distances.reserve(targets.size());
+      for (uint32_t target : targets)
+        result.distances.push_back(distance[target]);
+    }
+  } else if (!targets.empty() && (version->Structure() == DIRECTED_FOREST ||
+                           version->Structure() == UNDIRECTED_FOREST)) {
+    // Forest distances come from the LCA index, no traversal needed
+    result.distances.reserve(targets.size());
+    for (uint32_t target : targets)
+      result.distances.push_back(version->MinEdgeForest(src, target));
+  } else {
+    // A request for all nodes computes the full array anyway, cache it
+    DistanceArraySharedPtr cached =
+        precomputed && precomputed->Size() == graph->NumNodes()
+            ? precomputed
+            : distance_cache.Lookup(graph_id, src, version->Version());
+    if (!cached && (targets.empty() || distance_cache.Admit(graph_id, src)))
+      cached = CacheDistances(graph_id, graph, version, src);
+
+    if (cached && targets.empty()) {
+      // Distances of all nodes are sent in the order of client ids
+      result.distances.resize(cached->Size());
+      for (uint32_t node = 0; node < cached->Size(); node++)
+        result.distances[node] = cached->Get(graph->Internal(node));
+    } else if (cached) {
+      result.distances.reserve(targets.size());
+      for (uint32_t target : targets)
+        result.distances.push_back(cached->Get(target));
+    } else {
+      std::vector<uint32_t> distance = version->SingleSourceBfs(src, targets);
+      result.distances.reserve(targets.size());
+      for (uint32_t target : targets)
+        result.distances.push_back(distance[target]);
+    }
+  }
+
+  result.message = "OK, found " + std::to_string(result.distances.size()) +
+                   " distances from " + std::to_string(source_node);
+}
+
+void GraphEngine::NeighborhoodGraphRequest(graph::Request &request,
+                                           StreamResult &result) {
+  // Parse graph id, source node and limits from request
+  const graph::Neighborhood &query = request.neighborhood();
+  uint64_t graph_id = query.map_id();
+  uint32_t source_node = query.begin_node();
+
+  GraphSharedPtr graph = FindGraph(graph_id);
+  if (!graph) {
+    result.message = "ERROR: Graph not present in DB";
+    return;
+  }
+
+  // Version 0 stands for the latest version
+  GraphVersionSharedPtr version = query.version() == 0
+                                      ? graph->Current()
+                                      : graph->Version(query.version());
+  if (!version) {
+    result.message = VersionError(graph);
+    return;
+  }
+  if (source_node >= graph->NumNodes()) {
+    result.message = "ERROR: Node not present in graph";
+    return;
+  }
+
+  bool truncated = version->Neighborhood(
+      graph->Internal(source_node), query.max_hops(), query.max_nodes(),
+      &result.nodes, &result.distances);
+  for (uint32_t &node : result.nodes)
+    node = graph->External(node);
+  result.message = "OK, found " + std::to_string(result.nodes.size()) +
+                   " nodes within " + std::to_string(query.max_hops()) +
+                   " hops of " + std::to_string(source_node) +
+                   (truncated ? ", truncated" : "");
+}
+
+DistanceArraySharedPtr GraphEngine::SourceDistances(uint64_t graph_id,
+                                                   uint32_t src) {
+  GraphSharedPtr graph = FindGraph(graph_id);
+  if (!graph || src >= graph->NumNodes())
+    return nullptr;
+  src = graph->Internal(src);
+
+  GraphVersionSharedPtr version = graph->Current();
+  if (!version)
+    return nullptr;
+  DistanceArraySharedPtr cached =
+      distance_cache.Lookup(graph_id, src, version->Version());
+  if (cached)
+    return cached;
+  return CacheDistances(graph_id, graph, version, src);
+}
+
+bool GraphEngine::SharesSourceDistances(const graph::Request &request) {
+  const graph::MultiDistance &query = request.multi_distance();
+  GraphSharedPtr graph = FindGraph(query.map_id());
+  if (!graph || query.begin_node() >= graph->NumNodes())
+    return false;
+  // Graphs traversed out of core are never cached
+  GraphVersionSharedPtr version = graph->Current();
+  if (!version)
+    return false;
+  if (query.end_nodes_size() == 0)
+    return query.all_nodes();
+  if (version->Structure() == DIRECTED_FOREST ||
+      version->Structure() == UNDIRECTED_FOREST)
+    return false;
+  return distance_cache.Admitted(query.map_id(),
+                                 graph->Internal(query.begin_node()));
+}
+
+std::string GraphEngine::EditGraphRequest(graph::Request &request,
+                                          bool insert) {
+  // Parse graph id from the request
+  uint64_t graph_id = request.update_graph().map_id();
+  GraphSharedPtr graph = FindGraph(graph_id);
+  if (!graph) {
+    return "ERROR: Graph not present in DB";
+  }
+
+  GraphVersionSharedPtr latest = graph->Current();
+  if (!latest) {
+    return VersionError(graph);
+  }
+  if (insert && latest->Weights() != UNWEIGHTED) {
+    return "ERROR: Edges cannot be added to a weighted graph";
+  }
+  if (insert && !latest->EdgeLabels().Empty()) {
+    return "ERROR: Edges cannot be added to a graph with edge labels";
+  }
+
+  // Parse the edges, a batch is applied as a whole or not at all
+  std::vector<EdgeEdit> edits;
+  edits.reserve(request.adjacency_list_size());
+  for (int i = 0; i < request.adjacency_list_size(); i++) {
+    const graph::Edges &edge_pb = request.adjacency_list(i);
+    if (edge_pb.src() >= graph->NumNodes() ||
+        edge_pb.dest() >= graph->NumNodes()) {
+      return "ERROR: Node not present in graph";
+    }
+    edits.push_back(EdgeEdit{graph->Internal(edge_pb.src()),
+                             graph->Internal(edge_pb.dest()), insert});
+  }
+
+  uint64_t version;
+  std::vector<EdgeEdit> applied;
+  std::string error;
+  uint32_t changed = graph->ApplyEdits(edits, &version, &applied, &error);
+  if (!error.empty())
+    return error;
+  if (changed != 0)
+    RepairCachedDistances(graph_id, graph, version, applied);
+  write_epoch++;
+
+  // Fold a large delta into the adjacency in the background
+  if (graph->NeedsCompaction() && graph->TryStartCompaction()) {
+    scheduler.Submit(BULK_TASK, request.tenant(), 1, [this, graph] {
+      graph->Compact();
+      compactions++;
+      EnforceMemoryBudget(graph);
+    });
+  }
+
+  return "OK, " + std::string(insert ? "added " : "removed ") +
+         std::to_string(changed) + " edges of graph with ID: " +
+         std::to_string(graph_id) + ", version " + std::to_string(version);
+}
+
+std::unique_ptr<ThreadTeam> GraphEngine::AcquireDeltaSteppingTeam() {
   {
+    std::lock_guard<std::mutex> guard(teams_mutex);
+    if (!idle_teams.empty()) {
+      std::unique_ptr<ThreadTeam> team = std::move(idle_teams.back());
+      idle_teams.pop_back();
+      return team;
+    }
+    if (num_teams >= options.delta_stepping_teams)
+      return nullptr;
+    num_teams++;
+  }
+  return std::unique_ptr<ThreadTeam>(
+      new ThreadTeam(options.delta_stepping_threads));
+}
+
+void GraphEngine::ReleaseDeltaSteppingTeam(std::unique_ptr<ThreadTeam> team) {
+  std::lock_guard<std::mutex> guard(teams_mutex);
+  idle_teams.push_back(std::move(team));
+}
+
+std::string GraphEngine::WeightedDistanceGraphRequest(graph::Request &request) {
+  // Parse graph id, source and destination node from request
+  const graph::WeightedDistance &query = request.weighted_distance();
+  uint64_t graph_id = query.map_id();
+  uint32_t source_node = query.begin_node();
+  uint32_t end_node = query.end_node();
+
+  GraphSharedPtr graph = FindGraph(graph_id);
+  if (!graph) {
+    return "ERROR: Graph not present in DB";
+  }
+
+  // Version 0 stands for the latest version
+  GraphVersionSharedPtr version = query.version() == 0
+                                      ? graph->Current()
+                                      : graph->Version(query.version());
+  if (!version) {
+    return VersionError(graph);
+  }
+  if (source_node >= graph->NumNodes() || end_node >= graph->NumNodes()) {
+    return "ERROR: Node not present in graph";
+  }
+  if (version->Weights() == UNWEIGHTED) {
+    return "ERROR: Graph has no edge weights";
+  }
+
+  // Large graphs are worth the threads of the delta-stepping engine, as
+  // long as a team is idle
+  std::unique_ptr<ThreadTeam> team;
+  if (version->NumEdges() >= options.delta_stepping_min_edges &&
+      options.delta_stepping_threads > 1) {
+    team = AcquireDeltaSteppingTeam();
+    if (team)
+      delta_stepping_queries++;
+    else
+      delta_stepping_fallbacks++;
+  }
+  double distance = version->WeightedDistance(
+      graph->Internal(source_node), graph->Internal(end_node), team.get());
+  if (team)
+    ReleaseDeltaSteppingTeam(std::move(team));
+
+  std::string value;
+  if (distance == std::numeric_limits<double>::infinity())
+    value = "inf";
+  else if (version->Weights() == INTEGER_WEIGHTS)
+    value = std::to_string(uint64_t(distance));
+  else
+    value = std::to_string(distance);
+  return "OK, found weighted distance between " + std::to_string(source_node) +
+         " " + std::to_string(end_node) + " to be " + value;
+}
+
+std::string
+GraphEngine::ConstrainedDistanceGraphRequest(graph::Request &request) {
+  // Parse graph id, source and destination node from request
+  const graph::ConstrainedDistance &query = request.constrained_distance();
+  uint64_t graph_id = query.map_id();
+  uint32_t source_node = query.begin_node();
+  uint32_t end_node = query.end_node();
+
+  GraphSharedPtr graph = FindGraph(graph_id);
+  if (!graph) {
+    return "ERROR: Graph not present in DB";
+  }
+
+  // Version 0 stands for the latest version
+  GraphVersionSharedPtr version = query.version() == 0
+                                      ? graph->Current()
+                                      : graph->Version(query.version());
+  if (!version) {
+    return VersionError(graph);
+  }
+  if (source_node >= graph->NumNodes() || end_node >= graph->NumNodes()) {
+    return "ERROR: Node not present in graph";
+  }
+
+  // A column is only filtered on if the query constrains it, the filters
+  // are unions of the bitmaps of the labels
+  bool edges_constrained =
+      query.edge_labels_size() != 0 || query.avoid_edge_labels();
+  bool nodes_constrained =
+      query.node_labels_size() != 0 || query.avoid_node_labels();
+  if (edges_constrained && version->EdgeLabels().Empty()) {
+    return "ERROR: Graph has no edge labels";
+  }
+  if (nodes_constrained && version->NodeLabels().Empty()) {
+    return "ERROR: Graph has no node labels";
+  }
+  Bitmap edges, nodes;
+  if (edges_constrained) {
+    edges = version->EdgeLabels().Select(
+        std::vector<uint32_t>(query.edge_labels().begin(),
+                              query.edge_labels().end()),
+        query.avoid_edge_labels());
+  }
+  if (nodes_constrained) {
+    nodes = version->NodeLabels().Select(
+        std::vector<uint32_t>(query.node_labels().begin(),
+                              query.node_labels().end()),
+        query.avoid_node_labels());
+  }
+
+  constrained_queries++;
+  uint32_t distance = version->ConstrainedBfs(
+      graph->Internal(source_node), graph->Internal(end_node),
+      edges_constrained ? &edges : nullptr,
+      nodes_constrained ? &nodes : nullptr, query.max_hops());
+  return "OK, found constrained minimum distance between " +
+         std::to_string(source_node) + " " + std::to_string(end_node) +
+         " to be " + std::to_string(distance);
+}
+
+void GraphEngine::RepairCachedDistances(uint64_t graph_id,
+                                        const GraphSharedPtr &graph,
+                                        uint64_t version,
+                                        const std::vector<EdgeEdit> &applied) {
+  // Entries of older versions are never hit again and age out of the cache
+  GraphVersionSharedPtr repaired_version = graph->Version(version);
+  if (!repaired_version)
+    return;
+  for (const auto &entry : distance_cache.GraphEntries(graph_id, version - 1)) {
+    std::vector<uint32_t> distances = entry.second->Decode();
+    if (!repaired_version->RepairDistances(entry.first, distances, applied)) {
+      distance_repair_drops++;
+      continue;
+    }
+    DistanceArraySharedPtr repaired =
+        std::make_shared<DistanceArray>(distances);
     std::lock_guard<std::mutex> guard(graph_db_mutex);
     auto it = graph_db.find(graph_id);
-    if (it != graph_db.end()) {
-      uint32_t min_dist = it->second->MinEdgeBfs(source_node, end_node);
-      return "OK, found minimum distance between " +
-             std::to_string(source_node) + " " + std::to_string(end_node) +
-             " to be " + std::to_string(min_dist);
-    } else {
-      return "ERROR: Graph not present in DB";
+    if (it == graph_db.end() || it->second != graph)
+      return;
+    distance_cache.Insert(graph_id, entry.first, version, repaired);
+    distance_repairs++;
+  }
+}
+
+std::string GraphEngine::ServerStatsRequest() {
+  DistanceCacheStats cache = distance_cache.Stats();
+  uint64_t lookups = cache.hits + cache.misses;
+  double hit_rate = lookups == 0 ? 0.0 : double(cache.hits) / lookups;
+
+  uint64_t num_graphs;
+  std::vector<std::pair<uint64_t, GraphSharedPtr>> graphs;
+  uint64_t pending_builds = 0;
+  {
+    std::lock_guard<std::mutex> guard(graph_db_mutex);
+    num_graphs = graph_db.size();
+    graphs.assign(graph_db.begin(), graph_db.end());
+    for (const auto &build : builds)
+      pending_builds += build.second.failed ? 0 : 1;
+  }
+  uint64_t built = finished_builds.load();
+  uint64_t pending_jobs = 0;
+  uint64_t jobs_done = 0;
+  {
+    std::lock_guard<std::mutex> guard(jobs_mutex);
+    for (const auto &job : jobs)
+      pending_jobs += job.second.result ? 0 : 1;
+    jobs_done = submitted_jobs.load() - pending_jobs;
+  }
+
+  // Graphs with a single live version are left out of the per graph list
+  uint64_t live_versions = 0;
+  std::string graph_versions;
+  uint64_t sketch_bytes = 0;
+  std::string graph_sketches;
+  std::string graph_statistics;
+  std::string label_columns;
+  uint64_t adjacency_bytes = 0;
+  std::string graph_adjacencies;
+  uint64_t resident_bytes = 0;
+  uint64_t spilled_graphs = 0;
+  uint64_t spilled_bytes = 0;
+  uint64_t fault_ins = 0;
+  uint64_t fault_in_micros = 0;
+  uint64_t max_fault_in_micros = 0;
+  uint64_t out_of_core_graphs = 0;
+  uint64_t out_of_core_traversals = 0;
+  uint64_t out_of_core_reads = 0;
+  uint64_t out_of_core_read_bytes = 0;
+  uint64_t replicas = 0;
+  uint64_t replica_bytes = 0;
+  for (const auto &entry : graphs) {
+    fault_ins += entry.second->FaultIns();
+    fault_in_micros += entry.second->FaultInMicros();
+    max_fault_in_micros =
+        std::max(max_fault_in_micros, entry.second->MaxFaultInMicros());
+    resident_bytes += entry.second->Bytes();
+    uint32_t live = entry.second->LiveVersions();
+    live_versions += live;
+    if (live > 1) {
+      graph_versions += (graph_versions.empty() ? "" : ",") +
+                        std::to_string(entry.first) + ":" +
+                        std::to_string(live);
     }
+
+    // Stats never read spilled graphs back
+    GraphVersionSharedPtr version = entry.second->Resident();
+    if (!version) {
+      spilled_graphs++;
+      spilled_bytes += entry.second->SpilledBytes();
+      ExternalAdjacencySharedPtr lists = entry.second->OutOfCore();
+      if (lists) {
+        out_of_core_graphs++;
+        out_of_core_traversals += lists->Traversals();
+        out_of_core_reads += lists->Reads();
+        out_of_core_read_bytes += lists->ReadBytes();
+      }
+      continue;
+    }
+    adjacency_bytes += version->AdjacencyBytes();
+    replicas += version->NumReplicas();
+    replica_bytes += version->NumReplicas() * version->AdjacencyBytes();
+    graph_adjacencies +=
+        (graph_adjacencies.empty() ? "" : ",") + std::to_string(entry.first) +
+        ":" + (version->Compressed() ? "compressed" : "plain") + ":" +
+        std::to_string(double(version->AdjacencyBytes()) /
+                       std::max<uint64_t>(1, version->NumEdges())) +
+        ":" + std::to_string(version->NodeIdBits());
+
+    const LandmarkSketch &sketch = version->Sketch();
+    sketch_bytes += sketch.Bytes();
+    if (!sketch.Empty()) {
+      graph_sketches += (graph_sketches.empty() ? "" : ",") +
+                        std::to_string(entry.first) + ":" +
+                        std::to_string(sketch.Bytes()) + ":" +
+                        std::to_string(sketch.BuildMicros());
+    }
+
+    const GraphStatistics &statistics = version->Statistics();
+    graph_statistics +=
+        (graph_statistics.empty() ? "" : ",") + std::to_string(entry.first) +
+        ":" + std::to_string(statistics.num_nodes) + ":" +
+        std::to_string(statistics.num_edges) + ":" +
+        std::to_string(statistics.average_degree) + ":" +
+        std::to_string(statistics.max_degree) + ":" +
+        std::to_string(statistics.diameter_estimate) + ":" +
+        std::to_string(statistics.num_components) + ":" +
+        std::to_string(statistics.largest_component);
+
+    const PropertyColumn &edge_labels = version->EdgeLabels();
+    const PropertyColumn &node_labels = version->NodeLabels();
+    if (!edge_labels.Empty() || !node_labels.Empty()) {
+      label_columns += (label_columns.empty() ? "" : ",") +
+                       std::to_string(entry.first) + ":" +
+                       std::to_string(edge_labels.NumValues()) + ":" +
+                       std::to_string(node_labels.NumValues()) + ":" +
+                       std::to_string(edge_labels.Bytes() + node_labels.Bytes());
+    }
+  }
+
+  std::string query_plans;
+  for (int plan = 0; plan < NUM_QUERY_PLANS; plan++) {
+    uint64_t count = plan_counts[plan].load();
+    if (count != 0) {
+      query_plans += (query_plans.empty() ? "" : ",") +
+                     std::string(PlanName(QueryPlan(plan))) + ":" +
+                     std::to_string(count);
+    }
+  }
+
+  FairScheduler::ClassStats interactive = scheduler.Stats(INTERACTIVE_TASK);
+  FairScheduler::ClassStats bulk = scheduler.Stats(BULK_TASK);
+
+  return "OK, graphs=" + std::to_string(num_graphs) +
+         " live_graph_versions=" + std::to_string(live_versions) +
+         " multi_version_graphs=" +
+         (graph_versions.empty() ? "none" : graph_versions) +
+         " compute_threads=" + std::to_string(compute_pool.NumThreads()) +
+         " coalesced_queries=" + std::to_string(query_flights.Coalesced()) +
+         " coalesced_source_traversals=" +
+         std::to_string(source_flights.Coalesced()) +
+         " compactions=" + std::to_string(compactions.load()) +
+         " build_threads=" + std::to_string(build_pool.NumThreads()) +
+         " async_graph_builds=" + std::to_string(async_builds.load()) +
+         " graph_builds_pending=" + std::to_string(pending_builds) +
+         " graph_build_failures=" + std::to_string(failed_builds.load()) +
+         " graph_build_avg_micros=" +
+         std::to_string(built == 0 ? 0 : build_micros.load() / built) +
+         " analytics_threads=" + std::to_string(options.analytics_threads) +
+         " analytics_jobs=" + std::to_string(submitted_jobs.load()) +
+         " analytics_jobs_pending=" + std::to_string(pending_jobs) +
+         " analytics_job_failures=" + std::to_string(failed_jobs.load()) +
+         " analytics_job_avg_micros=" +
+         std::to_string(jobs_done == 0 ? 0 : job_micros.load() / jobs_done) +
+         " resident_graph_bytes=" + std::to_string(resident_bytes) +
+         " memory_budget_bytes=" + std::to_string(options.memory_budget_bytes) +
+         " spilled_graphs=" + std::to_string(spilled_graphs) +
+         " spilled_graph_bytes=" + std::to_string(spilled_bytes) +
+         " graph_spills=" + std::to_string(spills.load()) +
+         " graph_fault_ins=" + std::to_string(fault_ins) +
+         " graph_fault_in_avg_micros=" +
+         std::to_string(fault_ins == 0 ? 0 : fault_in_micros / fault_ins) +
+         " graph_fault_in_max_micros=" + std::to_string(max_fault_in_micros) +
+         " out_of_core_graphs=" + std::to_string(out_of_core_graphs) +
+         " out_of_core_traversals=" + std::to_string(out_of_core_traversals) +
+         " out_of_core_reads=" + std::to_string(out_of_core_reads) +
+         " out_of_core_read_bytes=" + std::to_string(out_of_core_read_bytes) +
+         " memory_nodes=" + std::to_string(NumMemoryNodes()) +
+         " memory_placement=" + PlacementName(options.placement.placement) +
+         " adjacency_replicas=" + std::to_string(replicas) +
+         " adjacency_replica_bytes=" + std::to_string(replica_bytes) +
+         " huge_page_bytes=" + std::to_string(HugePageBytes()) +
+         " adjacency_bytes=" + std::to_string(adjacency_bytes) +
+         " adjacencies=" +
+         (graph_adjacencies.empty() ? "none" : graph_adjacencies) +
+         " landmark_sketch_bytes=" + std::to_string(sketch_bytes) +
+         " landmark_sketches=" +
+         (graph_sketches.empty() ? "none" : graph_sketches) +
+         " graph_statistics=" +
+         (graph_statistics.empty() ? "none" : graph_statistics) +
+         " query_plans=" + (query_plans.empty() ? "none" : query_plans) +
+         " label_columns=" + (label_columns.empty() ? "none" : label_columns) +
+         " constrained_queries=" + std::to_string(constrained_queries.load()) +
+         " delta_stepping_queries=" +
+         std::to_string(delta_stepping_queries.load()) +
+         " delta_stepping_fallbacks=" +
+         std::to_string(delta_stepping_fallbacks.load()) +
+         " cancelled_queries=" + std::to_string(cancelled_queries.load()) +
+         " deadline_exceeded_queries=" +
+         std::to_string(deadline_exceeded_queries.load()) +
+         " queries_stopped_before_start=" +
+         std::to_string(queries_stopped_before_start.load()) +
+         " stopped_traversals=" + std::to_string(stopped_traversals.load()) +
+         " stopped_expanded_nodes=" +
+         std::to_string(stopped_expanded_nodes.load()) +
+         " stopped_unexpanded_nodes=" +
+         std::to_string(stopped_unexpanded_nodes.load()) +
+         " fair_queuing=" +
+         (options.scheduling.fair_queuing ? "on" : "off") +
+         " scheduler_queued=" + std::to_string(scheduler.Queued()) +
+         " interactive_tasks=" + std::to_string(interactive.started) +
+         " interactive_avg_wait_micros=" +
+         std::to_string(interactive.started == 0
+                            ? 0
+                            : interactive.wait_micros / interactive.started) +
+         " interactive_max_wait_micros=" +
+         std::to_string(interactive.max_wait_micros) +
+         " bulk_tasks=" + std::to_string(bulk.started) +
+         " bulk_avg_wait_micros=" +
+         std::to_string(bulk.started == 0 ? 0
+                                          : bulk.wait_micros / bulk.started) +
+         " bulk_max_wait_micros=" + std::to_string(bulk.max_wait_micros) +
+         " tenant_limited_tasks=" + std::to_string(scheduler.TenantLimited()) +
+         " approximate_queries=" + std::to_string(approximate_queries.load()) +
+         " approximate_escalations=" +
+         std::to_string(approximate_escalations.load()) +
+         " distance_cache_hits=" + std::to_string(cache.hits) +
+         " distance_cache_misses=" + std::to_string(cache.misses) +
+         " distance_cache_hit_rate=" + std::to_string(hit_rate) +
+         " distance_cache_entries=" + std::to_string(cache.entries) +
+         " distance_cache_bytes=" + std::to_string(cache.bytes) +
+         " distance_cache_capacity_bytes=" +
+         std::to_string(cache.capacity_bytes) +
+         " distance_cache_insertions=" + std::to_string(cache.insertions) +
+         " distance_cache_evictions=" + std::to_string(cache.evictions) +
+         " distance_cache_invalidations=" + std::to_string(cache.invalidations) +
+         " distance_cache_repairs=" + std::to_string(distance_repairs.load()) +
+         " distance_cache_repair_drops=" +
+         std::to_string(distance_repair_drops.load());
+}
+
+StreamResultSharedPtr
+GraphEngine::ProcessStreamRequest(graph::Request &request) {
+  StreamResultSharedPtr result = std::make_shared<StreamResult>();
+  if (GraphBuilding(request)) {
+    result->message = kNotReady;
+    return result;
+  }
+  switch (request.request_type()) {
+  case graph::GET_DISTANCES:
+    MultiDistanceGraphRequest(request, *result);
+    break;
+  case graph::GET_NEIGHBORHOOD:
+    NeighborhoodGraphRequest(request, *result);
+    break;
+  case graph::GET_JOB_RESULT:
+    JobResultRequest(request, *result);
+    break;
+  default:
+    // Everything else fits a single message
+    result->message = ProcessRequest(request);
+    break;
+  }
+  return result;
+}
+
+QueryStop GraphEngine::StopOf(const std::string &reply) {
+  for (uint32_t stop = QUERY_CANCELLED; stop <= QUERY_DEADLINE_EXCEEDED;
+       stop++) {
+    if (reply == kStopReplies[stop])
+      return QueryStop(stop);
+  }
+  return QUERY_RUNNING;
+}
+
+bool GraphEngine::Controlled(const graph::Request &request) {
+  switch (request.request_type()) {
+  case graph::GET_MIN_DISTANCE:
+  case graph::GET_DISTANCES:
+  case graph::GET_WEIGHTED_DISTANCE:
+  case graph::GET_NEIGHBORHOOD:
+  case graph::GET_CONSTRAINED_DISTANCE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+QueryStop GraphEngine::RunControlled(QueryControl *control,
+                                     const std::function<void()> &run) {
+  if (control == nullptr) {
+    run();
+    return QUERY_RUNNING;
+  }
+  // Requests queue for a compute thread, the client may be gone already
+  QueryStop stop = control->Check();
+  if (stop != QUERY_RUNNING) {
+    queries_stopped_before_start++;
+    return stop;
   }
+  {
+    ScopedQueryControl scope(control);
+    run();
+  }
+  stop = control->Stopped();
+  if (stop != QUERY_RUNNING) {
+    stopped_traversals += control->StoppedTraversals();
+    stopped_expanded_nodes += control->ExpandedNodes();
+    stopped_unexpanded_nodes += control->UnexpandedNodes();
+  }
+  return stop;
+}
+
+std::string GraphEngine::StopReply(QueryStop stop) {
+  if (stop == QUERY_CANCELLED)
+    cancelled_queries++;
+  else
+    deadline_exceeded_queries++;
+  return kStopReplies[stop];
+}
+
+void GraphEngine::Schedule(const graph::Request &request,
+                           std::function<void()> task) {
+  TaskClass task_class = INTERACTIVE_TASK;
+  if (request.priority() == graph::BULK_PRIORITY ||
+      (request.priority() == graph::AUTO_PRIORITY &&
+       (request.request_type() == graph::POST_GRAPH ||
+        request.request_type() == graph::ADD_EDGES ||
+        request.request_type() == graph::REMOVE_EDGES)))
+    task_class = BULK_TASK;
+  scheduler.Submit(task_class, request.tenant(),
+                   1 + request.adjacency_list_size() / kEdgesPerTaskCost,
+                   std::move(task));
+}
+
+void GraphEngine::FlightReply(graph::Request &request,
+                              const RequestCallback &done,
+                              const QueryControlSharedPtr &control,
+                              const std::string &reply) {
+  if (StopOf(reply) == QUERY_RUNNING) {
+    done(reply);
+    return;
+  }
+  QueryStop stop = control ? control->Check() : QUERY_RUNNING;
+  if (stop != QUERY_RUNNING) {
+    done(StopReply(stop));
+    return;
+  }
+  // Stopped by the control of the request that started the computation
+  ProcessRequestAsync(request, done, control);
+}
+
+void GraphEngine::SourceFlightReply(graph::Request &request,
+                                    const StreamCallback &done,
+                                    const QueryControlSharedPtr &control,
+                                    const DistanceArraySharedPtr &distances) {
+  if (distances) {
+    StreamResultSharedPtr result = std::make_shared<StreamResult>();
+    MultiDistanceGraphRequest(request, *result, distances);
+    done(result);
+    return;
+  }
+  QueryStop stop = control ? control->Check() : QUERY_RUNNING;
+  if (stop != QUERY_RUNNING) {
+    StreamResultSharedPtr result = std::make_shared<StreamResult>();
+    result->message = StopReply(stop);
+    done(result);
+    return;
+  }
+  // Stopped by the control of the request that started the traversal, or
+  // the graph is gone and the request is answered on its own
+  ProcessStreamRequestAsync(request, done, control);
+}
+
+void GraphEngine::ProcessRequestAsync(graph::Request &request,
+                                      RequestCallback done,
+                                      QueryControlSharedPtr control) {
+  graph::Request *pending = &request;
+  if (WaitForBuild(request, [this, pending, done, control] {
+        ProcessRequestAsync(*pending, done, control);
+      }))
+    return;
+  if (!Controlled(request))
+    control = nullptr;
+  if (request.request_type() != graph::GET_MIN_DISTANCE &&
+      request.request_type() != graph::GET_WEIGHTED_DISTANCE) {
+    Schedule(request, [this, pending, done, control] {
+      std::string reply;
+      QueryStop stop = RunControlled(
+          control.get(), [&] { reply = ProcessRequest(*pending); });
+      done(stop == QUERY_RUNNING ? reply : StopReply(stop));
+    });
+    return;
+  }
+
+  // Identical queries attach to the computation already in flight, unless a
+  // write completed after it started
+  std::string key =
+      request.SerializeAsString() + std::to_string(write_epoch.load());
+  if (!query_flights.Join(key, [this, pending, done,
+                                control](const std::string &reply) {
+        FlightReply(*pending, done, control, reply);
+      }))
+    return;
+  Schedule(request, [this, pending, key, control] {
+    std::string reply;
+    QueryStop stop = RunControlled(control.get(),
+                                   [&] { reply = ProcessRequest(*pending); });
+    query_flights.Complete(key,
+                           stop == QUERY_RUNNING ? reply : kStopReplies[stop]);
+  });
+}
+
+void GraphEngine::ProcessStreamRequestAsync(graph::Request &request,
+                                            StreamCallback done,
+                                            QueryControlSharedPtr control) {
+  graph::Request *pending = &request;
+  if (WaitForBuild(request, [this, pending, done, control] {
+        ProcessStreamRequestAsync(*pending, done, control);
+      }))
+    return;
+  if (!Controlled(request))
+    control = nullptr;
+  // Requests for an older version cannot reuse the latest distances, nor
+  // requests for a graph not built yet. Targeted requests only share a full
+  // traversal once their source is worth caching.
+  if (request.request_type() != graph::GET_DISTANCES ||
+      request.multi_distance().version() != 0 || GraphBuilding(request) ||
+      !SharesSourceDistances(request)) {
+    Schedule(request, [this, pending, done, control] {
+      StreamResultSharedPtr result;
+      QueryStop stop = RunControlled(
+          control.get(), [&] { result = ProcessStreamRequest(*pending); });
+      if (stop != QUERY_RUNNING) {
+        result = std::make_shared<StreamResult>();
+        result->message = StopReply(stop);
+      }
+      done(result);
+    });
+    return;
+  }
+  QueryStop stop = control ? control->Check() : QUERY_RUNNING;
+  if (stop != QUERY_RUNNING) {
+    queries_stopped_before_start++;
+    StreamResultSharedPtr result = std::make_shared<StreamResult>();
+    result->message = StopReply(stop);
+    done(result);
+    return;
+  }
+
+  // Requests from the same source share one full traversal, every waiter
+  // then extracts its own targets from the distance array
+  uint64_t graph_id = request.multi_distance().map_id();
+  uint32_t source_node = request.multi_distance().begin_node();
+  std::string key = std::to_string(graph_id) + ":" +
+                    std::to_string(source_node) + ":" +
+                    std::to_string(write_epoch.load());
+  bool leader = source_flights.Join(
+      key, [this, pending, done,
+            control](const DistanceArraySharedPtr &distances) {
+        SourceFlightReply(*pending, done, control, distances);
+      });
+  if (!leader)
+    return;
+  Schedule(request, [this, key, graph_id, source_node, control] {
+    DistanceArraySharedPtr distances;
+    QueryStop stop = RunControlled(control.get(), [&] {
+      distances = SourceDistances(graph_id, source_node);
+    });
+    source_flights.Complete(key, stop == QUERY_RUNNING ? distances : nullptr);
+  });
 }
 
 std::string GraphEngine::ProcessRequest(graph::Request &request) {
+  if (GraphBuilding(request))
+    return kNotReady;
   // Process the RequestType
   switch (request.request_type()) {
   case graph::POST_GRAPH:
@@ -125,6 +2297,26 @@ std::string GraphEngine::ProcessRequest(graph::Request &request) {
     return DeleteGraphRequest(request);
   case graph::GET_MIN_DISTANCE:
     return MinDistanceGraphRequest(request);
+  case graph::GET_DISTANCES:
+  case graph::GET_NEIGHBORHOOD:
+  case graph::GET_JOB_RESULT:
+    return "ERROR: Request type is only served by GraphEngineStreamRequest";
+  case graph::GET_SERVER_STATS:
+    return ServerStatsRequest();
+  case graph::ADD_EDGES:
+    return EditGraphRequest(request, true);
+  case graph::REMOVE_EDGES:
+    return EditGraphRequest(request, false);
+  case graph::GET_WEIGHTED_DISTANCE:
+    return WeightedDistanceGraphRequest(request);
+  case graph::GET_CONSTRAINED_DISTANCE:
+    return ConstrainedDistanceGraphRequest(request);
+  case graph::GET_GRAPH_STATUS:
+    return GraphStatusRequest(request);
+  case graph::SUBMIT_JOB:
+    return SubmitJobRequest(request);
+  case graph::GET_JOB_STATUS:
+    return JobStatusRequest(request);
   default:
     return "ERROR";
   }
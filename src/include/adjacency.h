@@ -0,0 +1,512 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "src/include/memory_placement.h"
+#include "src/include/property_columns.h"
+
+namespace GraphQueryEngine {
+
+// Edges an adjacency can store, its edge offsets are 32 bit. Undirected
+// graphs store both directions of every edge.
+constexpr uint64_t kMaxAdjacencyEdges = UINT32_MAX;
+
+// Kind of weights carried by the edges of a graph
+enum WeightType {
+  // Only hop counts are meaningful
+  UNWEIGHTED,
+  // Non-negative integer weights
+  INTEGER_WEIGHTS,
+  // Non-negative float weights
+  FLOAT_WEIGHTS
+};
+
+/*
+ * Plain neighbor lists with node ids of type NodeId, the lists of all nodes
+ * back to back. Traversals are instantiated per view type, so their inner
+ * loops never branch on the width of the ids.
+ */
+template <typename NodeId>
+class PlainNeighbors {
+  public:
+    // Narrowest type holding every node id, and a hop count below the number
+    // of nodes, of the adjacency
+    typedef NodeId Node;
+
+    PlainNeighbors(const uint32_t* offsets, const NodeId* targets)
+      : offsets(offsets), targets(targets) {}
+
+    /*
+     * Visit the out-going neighbors of a node in order
+     * @param visit, returns false to stop the iteration
+     * @return false if visit stopped the iteration
+     */
+    template <typename Visit>
+    bool ForEachNeighbor(uint32_t node, Visit visit) const {
+      const NodeId* end = targets + offsets[node + 1];
+      for (const NodeId* it = targets + offsets[node]; it != end; ++it) {
+        if (!visit(uint32_t(*it)))
+          return false;
+      }
+      return true;
+    }
+
+    /*
+     * Visit the out-going neighbors of a node over the edges in a set only,
+     * skipping the edges outside it a bitmap word at a time
+     * @param edges, set of edge positions, see CsrAdjacency::FirstEdge
+     * @param visit, returns false to stop the iteration
+     * @return false if visit stopped the iteration
+     */
+    template <typename Visit>
+    bool ForEachNeighborIn(uint32_t node, const Bitmap& edges,
+                           Visit visit) const {
+      return edges.ForEachSetRow(offsets[node], offsets[node + 1],
+                                 [&](uint64_t edge, uint64_t) {
+                                   return visit(uint32_t(targets[edge]));
+                                 });
+    }
+
+  private:
+    const uint32_t* offsets;
+    const NodeId* targets;
+};
+
+/*
+ * Gap encoded neighbor lists: the degree of the node as a varint, then the
+ * gaps packed with group varint, one control byte holding the byte lengths
+ * of the next 4 gaps. The first gap is a zigzag encoded difference to the
+ * node itself.
+ */
+class CompressedNeighbors {
+  public:
+    typedef uint32_t Node;
+    // Lists per entry of the block index
+    static constexpr uint32_t kIndexBlock = 64;
+    // Zero bytes after the last list, decoding loads 4 bytes per gap
+    static constexpr uint32_t kPadding = 4;
+
+    CompressedNeighbors(const uint8_t* encoded, const uint64_t* block_offsets,
+                        const uint32_t* byte_offsets)
+      : encoded(encoded), block_offsets(block_offsets),
+        byte_offsets(byte_offsets) {}
+
+    /*
+     * Start of the list of a node
+     * @param degree, receives the degree of the node
+     * @return the first control byte of the list
+     */
+    const uint8_t* DecodeDegree(uint32_t node, uint32_t* degree) const {
+      return ReadDegree(encoded + block_offsets[node / kIndexBlock] +
+                            byte_offsets[node],
+                        degree);
+    }
+
+    // Visit the out-going neighbors of a node, decoding them group by group
+    template <typename Visit>
+    bool ForEachNeighbor(uint32_t node, Visit visit) const {
+      return DecodeList(encoded + block_offsets[node / kIndexBlock] +
+                            byte_offsets[node],
+                        node, visit);
+    }
+
+    // Read the varint degree leading a list, returns the first control byte
+    static const uint8_t* ReadDegree(const uint8_t* in, uint32_t* degree) {
+      *degree = 0;
+      for (uint32_t shift = 0;; shift += 7) {
+        uint8_t byte = *in++;
+        *degree |= uint32_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+          return in;
+      }
+    }
+
+    /*
+     * Visit the neighbors of a node from its encoded list, also for lists
+     * read into a buffer of their own, which must be followed by kPadding
+     * bytes
+     * @param list, start of the list of the node
+     */
+    template <typename Visit>
+    static bool DecodeList(const uint8_t* list, uint32_t node, Visit visit) {
+      uint32_t degree;
+      const uint8_t* in = ReadDegree(list, &degree);
+      uint32_t neighbor = node;
+      for (uint32_t i = 0; i < degree; i += 4) {
+        uint32_t control = *in++;
+        uint32_t count = std::min<uint32_t>(degree - i, 4);
+        for (uint32_t j = 0; j < count; j++) {
+          // Little-endian load of 4 bytes masked to the length of the gap,
+          // the stream is padded so that the last load stays in bounds
+          uint32_t length = ((control >> (2 * j)) & 3) + 1;
+          uint32_t gap;
+          std::memcpy(&gap, in, sizeof(gap));
+          gap &= 0xffffffffu >> (32 - 8 * length);
+          in += length;
+          if (i + j == 0)
+            gap = (gap >> 1) ^ (0u - (gap & 1));
+          neighbor += gap;
+          if (!visit(neighbor))
+            return false;
+        }
+      }
+      return true;
+    }
+
+  private:
+    const uint8_t* encoded;
+    // Position of the list of every kIndexBlock-th node in encoded, and of
+    // every list relative to the position of its block
+    const uint64_t* block_offsets;
+    const uint32_t* byte_offsets;
+};
+
+// How the neighbor lists of a CsrAdjacency are stored
+enum NeighborEncoding {
+  // 32 bit node ids, the form every adjacency is built in
+  PLAIN_TARGETS,
+  // 16 bit node ids, for graphs with fewer than 2^16 - 1 nodes
+  NARROW_TARGETS,
+  // Gap encoded, see CompressedNeighbors
+  COMPRESSED_TARGETS
+};
+
+/*
+ * Read-optimized adjacency in compressed sparse row form, the out-going
+ * neighbors of node u are targets[offsets[u] .. offsets[u + 1]). Edge
+ * weights, if any, are kept in an array parallel to targets, so that
+ * unweighted traversals never touch them.
+ *
+ * Adjacencies are built, indexed and edited with 32 bit targets. Once built
+ * they can be narrowed to 16 bit targets if the node ids fit, or, if sorted,
+ * compressed (see CompressedNeighbors). Lists are then only read through
+ * views, which Dispatch hands to a traversal once, so the traversal is
+ * compiled for the storage at hand. Compressed lists are found through the
+ * position of every kIndexBlock-th list plus a 32 bit position of every list
+ * within its block, edge offsets are only kept for weighted and edge
+ * labeled adjacencies, to find the weights and labels.
+ *
+ * Labels of the edges and of the nodes are property columns, the edge
+ * column parallel to targets like the weights.
+ */
+class CsrAdjacency {
+  public:
+    CsrAdjacency() = default;
+    /*
+     * Build from per-node neighbor lists
+     * @param adjacency_list, out-going edges of every node
+     */
+    explicit CsrAdjacency(const std::vector<std::vector<uint32_t>>& adjacency_list);
+    /*
+     * Take over ready CSR arrays
+     * @param offsets, position of the first neighbor of every node, plus the
+     *        total count
+     * @param targets, neighbors of all nodes, back to back
+     * @param sorted, whether every neighbor list is sorted
+     */
+    CsrAdjacency(std::vector<uint32_t> offsets, std::vector<uint32_t> targets,
+                 bool sorted);
+    ~CsrAdjacency() = default;
+
+    uint32_t NumNodes() const {
+      if (Compressed())
+        return byte_offsets.size();
+      return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+    uint64_t NumEdges() const {
+      if (Compressed())
+        return num_encoded_edges;
+      return offsets.empty() ? 0 : offsets.back();
+    }
+    uint32_t Degree(uint32_t node) const {
+      if (Compressed()) {
+        uint32_t degree;
+        CompressedView().DecodeDegree(node, &degree);
+        return degree;
+      }
+      return offsets[node + 1] - offsets[node];
+    }
+    // Neighbors of a node, only for adjacencies with plain 32 bit targets
+    const uint32_t* Begin(uint32_t node) const {
+      return targets.data() + offsets[node];
+    }
+    const uint32_t* End(uint32_t node) const {
+      return targets.data() + offsets[node + 1];
+    }
+
+    /*
+     * Run a traversal on the view of the neighbor lists, a PlainNeighbors
+     * or CompressedNeighbors
+     * @param kernel, invoked once with the view
+     * @return what kernel returns
+     */
+    template <typename Kernel>
+    auto Dispatch(Kernel kernel) const {
+      switch (encoding) {
+      case NARROW_TARGETS:
+        return kernel(PlainNeighbors<uint16_t>(offsets.data(),
+                                               narrow_targets.data()));
+      case COMPRESSED_TARGETS:
+        return kernel(CompressedView());
+      default:
+        return kernel(PlainNeighbors<uint32_t>(offsets.data(), targets.data()));
+      }
+    }
+
+    /*
+     * Visit the out-going neighbors of a node in order, whatever their
+     * storage. Traversals visiting many nodes should Dispatch instead.
+     * @param visit, returns false to stop the iteration
+     * @return false if visit stopped the iteration
+     */
+    template <typename Visit>
+    bool ForEachNeighbor(uint32_t node, Visit visit) const {
+      return Dispatch([&](const auto& neighbors) {
+        return neighbors.ForEachNeighbor(node, visit);
+      });
+    }
+
+    // Whether the edge src -> dest is present
+    bool HasEdge(uint32_t src, uint32_t dest) const;
+
+    // Adjacency with every edge reversed, i.e. the in-going neighbors of
+    // every node. Weights and labels are not carried over, the adjacency
+    // must have plain 32 bit targets.
+    CsrAdjacency Transpose() const;
+
+    /*
+     * Adjacency with the nodes renumbered, neighbor lists are sorted by the
+     * new ids and weights and labels follow their edges and nodes. The
+     * adjacency must have plain 32 bit targets.
+     * @param new_ids, new id of every node
+     */
+    CsrAdjacency Relabel(const std::vector<uint32_t>& new_ids) const;
+
+    /*
+     * Attach weights to the edges
+     * @param weights, weight of every out-going edge of every node, in the
+     *        order of the adjacency list the adjacency was built from
+     */
+    void SetWeights(const std::vector<std::vector<uint32_t>>& weights);
+    void SetWeights(const std::vector<std::vector<float>>& weights);
+    /*
+     * Attach weights to the edges
+     * @param weights, weight of every edge, parallel to the targets
+     */
+    void SetWeights(std::vector<uint32_t> weights);
+    void SetWeights(std::vector<float> weights);
+    /*
+     * Attach labels to the edges
+     * @param labels, label of every edge, parallel to the targets
+     */
+    void SetEdgeLabels(const std::vector<uint32_t>& labels) {
+      edge_labels = PropertyColumn(labels);
+    }
+    /*
+     * Attach labels to the nodes
+     * @param labels, label of every node
+     */
+    void SetNodeLabels(const std::vector<uint32_t>& labels) {
+      node_labels = PropertyColumn(labels);
+    }
+
+    // Whether every neighbor list is sorted, which lets HasEdge binary search
+    bool Sorted() const { return sorted; }
+
+    // Whether every edge is present in both directions, i.e. the adjacency of
+    // an undirected graph is also its own reverse adjacency
+    bool Symmetric() const { return symmetric; }
+    // Declare the adjacency symmetric, the caller built it that way
+    void MarkSymmetric() { symmetric = true; }
+
+    /*
+     * Replace the plain targets with their group varint encoding. Unsorted
+     * adjacencies have no small gaps and are left as they are.
+     */
+    void Compress();
+    /*
+     * Replace the plain targets with 16 bit ones if every node id and hop
+     * count fits, i.e. the graph has fewer than 2^16 - 1 nodes
+     */
+    void Narrow();
+    NeighborEncoding Encoding() const { return encoding; }
+    bool Compressed() const { return encoding == COMPRESSED_TARGETS; }
+    // Bits of a node id in the neighbor lists, 0 for compressed lists
+    uint32_t NodeIdBits() const {
+      return encoding == NARROW_TARGETS ? 16
+             : encoding == PLAIN_TARGETS ? 32 : 0;
+    }
+    // Bytes plain neighbor lists would take compressed, position index
+    // included
+    uint64_t CompressedBytes() const;
+    // Bytes of the neighbor lists and of the index locating them, as stored
+    uint64_t NeighborBytes() const;
+    // Bytes of the whole adjacency, weights and labels included
+    uint64_t Bytes() const;
+
+    /*
+     * Place the arrays of the adjacency in memory, see PlaceMemory. Done
+     * once the adjacency is final, i.e. compressed or narrowed.
+     * @param node, memory node of a replica
+     */
+    void Place(MemoryPlacement placement, bool huge_pages,
+               uint32_t node = 0) const;
+
+    /*
+     * Write the adjacency as stored, in the binary form of binary_io.h
+     * @param lists_position, if set, receives the stream position of the
+     *        neighbor lists as stored, see ExternalAdjacency
+     */
+    void Save(std::ostream& out, uint64_t* lists_position = nullptr) const;
+    // Replace the adjacency with one written by Save, false if the stream
+    // ended early
+    bool Load(std::istream& in);
+
+    WeightType Weights() const { return weight_type; }
+    // Weights of the out-going edges of a node, in the order of its neighbors
+    const uint32_t* IntegerWeights(uint32_t node) const {
+      return integer_weights.data() + offsets[node];
+    }
+    const float* FloatWeights(uint32_t node) const {
+      return float_weights.data() + offsets[node];
+    }
+    // Largest edge weight, 0 for unweighted adjacencies
+    double MaxWeight() const { return max_weight; }
+
+    // Labels of the edges, rows are edge positions, empty if unlabeled
+    const PropertyColumn& EdgeLabels() const { return edge_labels; }
+    // Labels of the nodes, empty if unlabeled
+    const PropertyColumn& NodeLabels() const { return node_labels; }
+    // Position of the first out-going edge of a node in the arrays parallel
+    // to targets
+    uint32_t FirstEdge(uint32_t node) const { return offsets[node]; }
+
+  private:
+    friend class DeltaAdjacency;
+    friend class ExternalAdjacency;
+
+    static constexpr uint32_t kIndexBlock = CompressedNeighbors::kIndexBlock;
+
+    CompressedNeighbors CompressedView() const {
+      return CompressedNeighbors(encoded.data(), block_offsets.data(),
+                                 byte_offsets.data());
+    }
+
+    NeighborEncoding encoding = PLAIN_TARGETS;
+    // Position of the first neighbor of every node, plus the total count
+    std::vector<uint32_t> offsets;
+    // Neighbors of all nodes, back to back, as 32 or 16 bit ids
+    std::vector<uint32_t> targets;
+    std::vector<uint16_t> narrow_targets;
+    bool sorted = false;
+    bool symmetric = false;
+    // Encoded neighbor lists replacing targets once compressed, and their
+    // index, see CompressedNeighbors
+    std::vector<uint8_t> encoded;
+    std::vector<uint64_t> block_offsets;
+    std::vector<uint32_t> byte_offsets;
+    uint64_t num_encoded_edges = 0;
+    // Edge weights parallel to targets, only the one of weight_type is set
+    WeightType weight_type = UNWEIGHTED;
+    std::vector<uint32_t> integer_weights;
+    std::vector<float> float_weights;
+    double max_weight = 0;
+    PropertyColumn edge_labels;
+    PropertyColumn node_labels;
+};
+
+// A single edge insertion or removal
+struct EdgeEdit {
+  uint32_t src;
+  uint32_t dest;
+  bool insert;
+};
+
+/*
+ * Overflow structure of the edits applied to a CsrAdjacency since it was
+ * built. Inserted edges are kept per source node, removed base edges in a
+ * hash set. Edits are also logged in order, so that edits which arrive while
+ * a compaction is folding the delta into a new base can be replayed on top
+ * of it.
+ */
+class DeltaAdjacency {
+  public:
+    DeltaAdjacency() = default;
+    ~DeltaAdjacency() = default;
+
+    /*
+     * Apply an edit on top of a base adjacency. Weighted and edge labeled
+     * adjacencies only take removals, an inserted edge would have no weight
+     * or label.
+     * @param base, the adjacency this delta belongs to
+     * @param edit, the edge to insert or remove
+     * @return false if the edit did not change the set of edges
+     */
+    bool Apply(const CsrAdjacency& base, const EdgeEdit& edit);
+
+    /*
+     * Fold the delta into its base
+     * @param base, the adjacency this delta belongs to
+     * @return a new base holding the edges of base plus delta, not
+     *         compressed
+     */
+    CsrAdjacency Compact(const CsrAdjacency& base) const;
+
+    bool Empty() const { return log.empty(); }
+    // Edges of the base plus the inserted ones minus the removed ones
+    uint64_t NumEdges(const CsrAdjacency& base) const {
+      return base.NumEdges() + num_inserted - removed.size();
+    }
+    // Edits applied since the base was built, in order
+    const std::vector<EdgeEdit>& Log() const { return log; }
+    // Approximate bytes of the log, inserted and removed edges
+    uint64_t Bytes() const;
+
+    // Write the log of the delta in the binary form of binary_io.h
+    void Save(std::ostream& out) const;
+    /*
+     * Rebuild a delta written by Save by replaying its log
+     * @param base, the adjacency the delta belonged to when it was saved
+     * @return false if the stream ended early
+     */
+    bool Load(std::istream& in, const CsrAdjacency& base);
+
+    // Whether some base edges of the node were removed
+    bool HasRemovals(uint32_t node) const {
+      return !removals_per_node.empty() &&
+             removals_per_node.find(node) != removals_per_node.end();
+    }
+    // Whether the base edge src -> dest was removed
+    bool Removed(uint32_t src, uint32_t dest) const {
+      return removed.find(EdgeKey(src, dest)) != removed.end();
+    }
+    // Edges inserted from a node, nullptr if none
+    const std::vector<uint32_t>* Inserted(uint32_t node) const {
+      if (inserted.empty())
+        return nullptr;
+      auto it = inserted.find(node);
+      return it == inserted.end() ? nullptr : &it->second;
+    }
+
+  private:
+    static uint64_t EdgeKey(uint32_t src, uint32_t dest) {
+      return (uint64_t(src) << 32) | dest;
+    }
+
+    // Effective edits in the order they were applied
+    std::vector<EdgeEdit> log;
+    // Edges inserted on top of the base, per source node
+    std::unordered_map<uint32_t, std::vector<uint32_t>> inserted;
+    uint64_t num_inserted = 0;
+    // Base edges that were removed, and how many per source node
+    std::unordered_set<uint64_t> removed;
+    std::unordered_map<uint32_t, uint32_t> removals_per_node;
+};
+
+} // end GraphQueryEngine
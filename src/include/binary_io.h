@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+/*
+ * Raw binary form of engine state, used to spill graphs to disk. Values are
+ * written in host byte order and layout, files are only read back by the
+ * server that wrote them. Readers return false once the stream failed, e.g.
+ * on a truncated file.
+ */
+template <typename T>
+void WriteValue(std::ostream& out, const T& value) {
+  static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void WriteVector(std::ostream& out, const std::vector<T>& values) {
+  static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+  WriteValue<uint64_t>(out, values.size());
+  out.write(reinterpret_cast<const char*>(values.data()),
+            values.size() * sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::istream& in, T* value) {
+  static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+  in.read(reinterpret_cast<char*>(value), sizeof(T));
+  return bool(in);
+}
+
+template <typename T>
+bool ReadVector(std::istream& in, std::vector<T>* values) {
+  static_assert(std::is_trivially_copyable<T>::value, "raw values only");
+  uint64_t size;
+  if (!ReadValue(in, &size))
+    return false;
+  values->resize(size);
+  in.read(reinterpret_cast<char*>(values->data()), size * sizeof(T));
+  return bool(in);
+}
+
+} // end GraphQueryEngine
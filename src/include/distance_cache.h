@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+/*
+ * Distances from one source to every node of a graph, stored with the
+ * narrowest element width that fits the largest finite distance. The largest
+ * value of the width stands for an unreachable node.
+ */
+class DistanceArray {
+  public:
+    /*
+     * Encode a distance vector
+     * @param distances, distances indexed by node, unreachable nodes are
+     *        std::numeric_limits<uint32_t>::max()
+     */
+    explicit DistanceArray(const std::vector<uint32_t>& distances);
+    // Empty array, to Load into
+    DistanceArray() : num_nodes(0), width(sizeof(uint8_t)) {}
+    ~DistanceArray() = default;
+
+    // Distance to a node, std::numeric_limits<uint32_t>::max() if unreachable
+    uint32_t Get(uint32_t node) const;
+
+    uint32_t Size() const { return num_nodes; }
+
+    // Decode every distance, std::numeric_limits<uint32_t>::max() if
+    // unreachable
+    std::vector<uint32_t> Decode() const;
+
+    // Bytes used by the encoded distances
+    size_t Bytes() const { return data.size(); }
+
+    // Write the encoded distances in the binary form of binary_io.h
+    void Save(std::ostream& out) const;
+    // Replace the array with one written by Save, false if the stream ended
+    // early
+    bool Load(std::istream& in);
+
+  private:
+    // Number of nodes covered by the array
+    uint32_t num_nodes;
+    // Width of every element in bytes, 1, 2 or 4
+    uint32_t width;
+    // Encoded distances
+    std::vector<uint8_t> data;
+};
+
+using DistanceArraySharedPtr = std::shared_ptr<const DistanceArray>;
+
+// Counters reported by the distance cache
+struct DistanceCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;
+  uint64_t evictions = 0;
+  uint64_t invalidations = 0;
+  uint64_t entries = 0;
+  uint64_t bytes = 0;
+  uint64_t capacity_bytes = 0;
+};
+
+/*
+ * Memory bounded cache of completed single-source distance arrays, keyed by
+ * graph id and source node. Every entry is tagged with the graph version it
+ * was computed on and only answers lookups for that version. Entries are
+ * evicted with the CLOCK algorithm.
+ *
+ * A source is only admitted after it missed twice within the recent past,
+ * tracked by a small doorkeeper table, so that one-off queries keep using the
+ * cheaper early-terminating BFS and do not flush the hot sources out.
+ */
+class DistanceCache {
+  public:
+    explicit DistanceCache(size_t capacity_bytes);
+    ~DistanceCache() = default;
+
+    /*
+     * Look up the distance array of a source
+     * @param version, version of the graph the distances are needed for
+     * @return the cached distances, nullptr on a miss
+     */
+    DistanceArraySharedPtr Lookup(uint64_t graph_id, uint32_t src,
+                                  uint64_t version);
+
+    /*
+     * Record a miss for a source and decide whether its full distance array
+     * should be computed and inserted
+     * @return true if the source missed recently and should be cached
+     */
+    bool Admit(uint64_t graph_id, uint32_t src);
+    // Whether the next Admit of a source admits it, without recording a miss
+    bool Admitted(uint64_t graph_id, uint32_t src);
+
+    /*
+     * Insert the distance array of a source, evicting cold entries until it
+     * fits. Arrays larger than the whole cache are not inserted. An entry of
+     * an older version of the graph is replaced.
+     * @param version, version of the graph the distances were computed on
+     */
+    void Insert(uint64_t graph_id, uint32_t src, uint64_t version,
+                DistanceArraySharedPtr distances);
+
+    /*
+     * Entries of a graph computed on a given version
+     * @return pairs of source node and distances
+     */
+    std::vector<std::pair<uint32_t, DistanceArraySharedPtr>>
+    GraphEntries(uint64_t graph_id, uint64_t version);
+
+    /*
+     * Drop every entry of a graph
+     * @param graph_id, id of the deleted graph
+     */
+    void InvalidateGraph(uint64_t graph_id);
+
+    DistanceCacheStats Stats();
+
+  private:
+    // Fixed cost of an entry on top of its distance array
+    static constexpr size_t kEntryOverhead = 64;
+    // Number of slots of the doorkeeper table
+    static constexpr size_t kDoorkeeperSlots = 4096;
+
+    struct CacheKey {
+      uint64_t graph_id;
+      uint32_t src;
+      bool operator==(const CacheKey& other) const {
+        return graph_id == other.graph_id && src == other.src;
+      }
+    };
+    struct CacheKeyHash {
+      size_t operator()(const CacheKey& key) const;
+    };
+    // Slot of the CLOCK ring
+    struct Entry {
+      CacheKey key;
+      // Version of the graph the distances belong to
+      uint64_t version;
+      DistanceArraySharedPtr distances;
+      // Set on every hit, cleared when the hand sweeps over the entry
+      bool referenced;
+    };
+
+    // Evict entries until bytes_needed more bytes fit in the capacity
+    void MakeRoom(size_t bytes_needed);
+    void RemoveSlot(size_t slot);
+
+    // Mutex to guard the cache against concurrent queries
+    std::mutex cache_mutex;
+    size_t capacity_bytes;
+    size_t used_bytes = 0;
+    // CLOCK ring and the position of its hand
+    std::vector<Entry> ring;
+    size_t hand = 0;
+    // Position of every key in the ring
+    std::unordered_map<CacheKey, size_t, CacheKeyHash> slots;
+    // Hashes of recently missed keys
+    std::vector<uint64_t> doorkeeper;
+    DistanceCacheStats stats;
+};
+
+} // end GraphQueryEngine
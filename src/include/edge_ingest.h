@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "src/include/adjacency.h"
+#include "src/include/worker_pool.h"
+
+#ifdef BAZEL_BUILD
+#include "protos/graph.grpc.pb.h"
+#else
+#include "graph.grpc.pb.h"
+#endif
+
+namespace GraphQueryEngine {
+
+/*
+ * Validate the edges of a posted graph and build its adjacency. Edges are
+ * radix sorted by (source, target) by all members of the team, then runs of
+ * duplicate edges are collapsed into one edge with the lowest weight, which
+ * is the only one a shortest path can use. Duplicates must agree on their
+ * label, a label constrained path could otherwise take either.
+ * @param edges, edges of the POST_GRAPH request
+ * @param num_nodes, number of nodes of the graph
+ * @param weight_type, which weight of the edges the graph keeps
+ * @param labeled, whether the graph keeps the labels of the edges
+ * @param drop_self_loops, whether to drop edges from a node to itself
+ * @param undirected, whether every edge stands for both directions, the
+ *        adjacency then holds both and is marked symmetric
+ * @param team, threads sharing the work
+ * @param adjacency, receives the adjacency, neighbor lists sorted
+ * @return an error message for invalid edges, empty on success
+ */
+std::string IngestEdges(
+    const google::protobuf::RepeatedPtrField<graph::Edges>& edges,
+    uint32_t num_nodes, WeightType weight_type, bool labeled,
+    bool drop_self_loops, bool undirected, ThreadTeam& team,
+    CsrAdjacency* adjacency);
+
+} // end GraphQueryEngine
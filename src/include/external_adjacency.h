@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/include/adjacency.h"
+
+namespace GraphQueryEngine {
+
+/*
+ * Neighbor lists of a spilled graph, read from its spill file by
+ * traversals instead of reading the whole graph back (semi-external
+ * memory). Only the position of every list and the pending edits stay in
+ * memory, traversals keep their node state in memory as usual.
+ *
+ * BFS runs level by level. The lists of a level are read in file order,
+ * which is node order, and lists lying close together are read with a
+ * single pread of up to kBatchBytes. The next batch is hinted to the kernel
+ * for readahead while the current one is decoded.
+ */
+class ExternalAdjacency {
+  public:
+    /*
+     * Open the lists of an adjacency saved to a spill file
+     * @param adjacency, the adjacency that was saved, only the positions of
+     *        its lists are kept
+     * @param delta, edits pending on top of the adjacency
+     * @param version, number of the version that was saved
+     * @param path, the spill file
+     * @param lists_position, position of the lists in the file, see
+     *        CsrAdjacency::Save
+     */
+    ExternalAdjacency(const CsrAdjacency& adjacency, DeltaAdjacency delta,
+                      uint64_t version, const std::string& path,
+                      uint64_t lists_position);
+    ~ExternalAdjacency();
+
+    // Whether the spill file could be opened
+    bool Valid() const { return fd >= 0; }
+    uint64_t Version() const { return version; }
+    uint32_t NumNodes() const { return num_nodes; }
+    // Bytes kept in memory, list positions and pending edits
+    uint64_t Bytes() const;
+
+    /*
+     * Hop distances from a node, reading the lists of every level in
+     * batches
+     * @param src, source node
+     * @param dest, the traversal stops once it is reached, NumNodes() to
+     *        reach every node
+     * @param max_hops, depth at which the traversal stops, 0 for no limit
+     * @return distances indexed by node, std::numeric_limits<uint32_t>::max()
+     *         for nodes that are unreachable or were not reached. Empty if
+     *         the spill file could not be read.
+     */
+    std::vector<uint32_t> Bfs(uint32_t src, uint32_t dest,
+                              uint32_t max_hops) const;
+
+    // Traversals run, pread calls and bytes read by them
+    uint64_t Traversals() const { return traversals; }
+    uint64_t Reads() const { return reads; }
+    uint64_t ReadBytes() const { return read_bytes; }
+
+  private:
+    // Largest read covering the lists of several nodes
+    static constexpr uint64_t kBatchBytes = 1 << 20;
+    // Lists closer than this are read together, along with the lists
+    // between them that are not needed
+    static constexpr uint64_t kMaxGapBytes = 64 << 10;
+
+    // Byte range of the list of a node, relative to the first list
+    uint64_t ListBegin(uint32_t node) const;
+    uint64_t ListEnd(uint32_t node) const;
+    // Read the lists in [begin, end) into buffer, false on an I/O error
+    bool Read(uint64_t begin, uint64_t end, std::vector<uint8_t>* buffer) const;
+    /*
+     * Visit the neighbors of a node, the list plus the pending edits
+     * @param list, the list of the node as read from the file
+     * @param visit, returns false to stop the iteration
+     */
+    template <typename Visit>
+    bool ForEachNeighbor(const uint8_t* list, uint32_t node,
+                         Visit visit) const;
+
+    NeighborEncoding encoding;
+    uint32_t num_nodes;
+    uint64_t version;
+    DeltaAdjacency delta;
+    int fd = -1;
+    // Position of the first list in the file and bytes of all lists,
+    // padding included
+    uint64_t lists_position;
+    uint64_t lists_bytes;
+    // Position of the lists of plain adjacencies, in neighbors
+    std::vector<uint32_t> offsets;
+    // Position of the lists of compressed adjacencies, see
+    // CompressedNeighbors
+    std::vector<uint64_t> block_offsets;
+    std::vector<uint32_t> byte_offsets;
+
+    mutable std::atomic<uint64_t> traversals{0};
+    mutable std::atomic<uint64_t> reads{0};
+    mutable std::atomic<uint64_t> read_bytes{0};
+};
+
+using ExternalAdjacencySharedPtr = std::shared_ptr<const ExternalAdjacency>;
+
+} // end GraphQueryEngine
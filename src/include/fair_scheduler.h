@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace GraphQueryEngine {
+
+class WorkerPool;
+
+// Scheduling class of a task on the compute threads
+enum TaskClass {
+  // Queries and lookups a client waits for
+  INTERACTIVE_TASK,
+  // Posts, edits and compactions, which may wait for idle threads
+  BULK_TASK,
+  NUM_TASK_CLASSES
+};
+
+struct SchedulingPolicy {
+  // Whether tasks are queued by class and tenant, otherwise they run in
+  // submission order
+  bool fair_queuing = true;
+  // Shares of the compute threads every class gets while several are queued
+  uint32_t interactive_weight = 8;
+  uint32_t bulk_weight = 1;
+  // Compute threads bulk tasks leave to interactive ones, bulk tasks take
+  // every thread if there are no more threads than this
+  uint32_t interactive_reserved_threads = 1;
+  // Tasks of one tenant running at once, 0 for no limit
+  uint32_t tenant_max_running = 0;
+};
+
+/*
+ * Start-time fair queuing of the tasks of a worker pool. Every class and
+ * tenant pair is a flow with the weight of its class: a task is tagged with
+ * the virtual time it may start, the later of the current virtual time and
+ * the finish tag of the previous task of its flow, which advances by the cost
+ * of the task over the weight. Tasks are handed to the pool only when a
+ * thread is idle, the one with the smallest start tag first, so that the
+ * order is decided when a thread frees up instead of when tasks arrive.
+ * Bulk tasks never take the reserved threads and tenants at their limit
+ * wait, whatever their tags.
+ */
+class FairScheduler {
+  public:
+    /*
+     * @param pool, the threads running the tasks, not used before the first
+     *        Submit and expected to outlive the tasks it runs
+     * @param policy, the weights and limits
+     */
+    FairScheduler(WorkerPool* pool, const SchedulingPolicy& policy)
+      : pool(pool), policy(policy) {}
+
+    /*
+     * Queue a task
+     * @param task_class, the class weighting the task
+     * @param tenant, the tenant the task is limited and accounted for
+     * @param cost, the work of the task in units of a small query
+     * @param task, the work to run
+     */
+    void Submit(TaskClass task_class, const std::string& tenant, double cost,
+                std::function<void()> task);
+
+    struct ClassStats {
+      // Tasks started and the time they were queued, in microseconds
+      uint64_t started = 0;
+      uint64_t wait_micros = 0;
+      uint64_t max_wait_micros = 0;
+    };
+    ClassStats Stats(TaskClass task_class);
+    // Tasks queued and not started yet
+    uint64_t Queued();
+    // Tasks that waited for other tasks of their tenant to finish
+    uint64_t TenantLimited();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Task {
+      std::function<void()> run;
+      double start_tag;
+      Clock::time_point queued;
+      // Whether the task was passed over for the limit of its tenant
+      bool limited = false;
+    };
+    // Tasks of one class and tenant, in submission order
+    struct Flow {
+      std::deque<Task> tasks;
+      // Finish tag of the last task queued
+      double finish_tag = 0;
+    };
+    typedef std::pair<TaskClass, std::string> FlowKey;
+
+    // Hand queued tasks to idle threads, with mutex held
+    void Dispatch();
+    // Run a task on a pool thread and dispatch the next one once it is done
+    void Run(TaskClass task_class, const std::string& tenant,
+             std::function<void()> task);
+
+    WorkerPool* pool;
+    SchedulingPolicy policy;
+
+    // Guards the state below
+    std::mutex mutex;
+    std::map<FlowKey, Flow> flows;
+    // Start tag of the last task started
+    double virtual_time = 0;
+    uint64_t queued = 0;
+    uint32_t running = 0;
+    uint32_t class_running[NUM_TASK_CLASSES] = {};
+    std::map<std::string, uint32_t> tenant_running;
+    ClassStats class_stats[NUM_TASK_CLASSES];
+    uint64_t tenant_limited = 0;
+};
+
+} // end GraphQueryEngine
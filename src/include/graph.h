@@ -1,11 +1,30 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <map>
 #include <vector>
 #include <functional>
 #include <string>
+#include <memory>
 #include <mutex>
 
+#include "src/include/adjacency.h"
+#include "src/include/binary_io.h"
+#include "src/include/distance_cache.h"
+#include "src/include/edge_ingest.h"
+#include "src/include/external_adjacency.h"
+#include "src/include/fair_scheduler.h"
+#include "src/include/landmark_sketch.h"
+#include "src/include/memory_placement.h"
+#include "src/include/node_order.h"
+#include "src/include/query_control.h"
+#include "src/include/query_planner.h"
+#include "src/include/reachability.h"
+#include "src/include/singleflight.h"
+#include "src/include/structure_index.h"
+#include "src/include/worker_pool.h"
+
 #ifdef BAZEL_BUILD
 #include "protos/graph.grpc.pb.h"
 #else
@@ -16,58 +35,887 @@ using graph::Request;
 
 namespace GraphQueryEngine {
 
+// Indexes of a read-optimized adjacency, shared by the versions built on it
+struct GraphIndexes {
+  GraphIndexes(const CsrAdjacency& adjacency, uint32_t num_landmarks) {
+    reachability_index.Build(adjacency);
+    structure_index.Build(adjacency, reachability_index);
+    landmark_sketch.Build(adjacency, num_landmarks);
+    statistics =
+        CollectStatistics(adjacency, reachability_index, landmark_sketch);
+  }
+  // Empty indexes, to Load into
+  GraphIndexes() = default;
+
+  uint64_t Bytes() const {
+    return reachability_index.Bytes() + structure_index.Bytes() +
+           landmark_sketch.Bytes();
+  }
+  // Write the indexes in the binary form of binary_io.h
+  void Save(std::ostream& out) const {
+    reachability_index.Save(out);
+    structure_index.Save(out);
+    landmark_sketch.Save(out);
+    WriteValue(out, statistics);
+  }
+  // Replace the indexes with ones written by Save, false if the stream
+  // ended early
+  bool Load(std::istream& in) {
+    return reachability_index.Load(in) && structure_index.Load(in) &&
+           landmark_sketch.Load(in) && ReadValue(in, &statistics);
+  }
+
+  // SCC and interval labels to reject unreachable queries without a BFS
+  ReachabilityIndex reachability_index;
+  // Forest/DAG classification and the LCA index of forests
+  StructureIndex structure_index;
+  // Landmark distances bounding approximate queries
+  LandmarkSketch landmark_sketch;
+  // Shape of the adjacency, for the query planner
+  GraphStatistics statistics;
+};
+
+// Copies of an adjacency indexed by memory node, nullptr for nodes offline
+using AdjacencyReplicas = std::vector<std::shared_ptr<const CsrAdjacency>>;
+
+/*
+ * Immutable snapshot of a graph. Queries hold a reference to the version
+ * that was current when they started and run on it without any lock, the
+ * version is freed once the last query using it lets go.
+ */
+class GraphVersion {
+  public:
+    GraphVersion(uint64_t version,
+                 std::shared_ptr<const CsrAdjacency> adjacency,
+                 DeltaAdjacency delta,
+                 std::shared_ptr<const GraphIndexes> indexes,
+                 std::shared_ptr<const AdjacencyReplicas> replicas = nullptr)
+      : version(version), adjacency(std::move(adjacency)),
+        delta(std::move(delta)), indexes(std::move(indexes)),
+        replicas(std::move(replicas)) {}
+    ~GraphVersion() = default;
+
+    /*
+     * Compute minimum edges between src and dest nodes
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @return uint32_t number of minimum edges between src & dest
+     */
+    uint32_t MinEdgeBfs(uint32_t src, uint32_t dest) const;
+
+    /*
+     * Compute minimum edges on a DAG, pruning every node that comes after
+     * dest in topological order or cannot reach it according to the
+     * reachability index
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @return uint32_t number of minimum edges between src & dest
+     */
+    uint32_t MinEdgeDagBfs(uint32_t src, uint32_t dest) const;
+
+    /*
+     * Compute minimum edges on a forest in O(1) from the LCA index
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @return uint32_t number of minimum edges between src & dest
+     */
+    uint32_t MinEdgeForest(uint32_t src, uint32_t dest) const;
+
+    /*
+     * Compute minimum edges between src and dest, expanding nodes only up to
+     * a depth so that the cost is bounded by the size of the neighborhood
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @param max_hops, depth at which the traversal stops
+     * @return uint32_t number of minimum edges between src & dest, or
+     *         std::numeric_limits<uint32_t>::max() if dest is further away
+     */
+    uint32_t MinEdgeBoundedBfs(uint32_t src, uint32_t dest,
+                               uint32_t max_hops) const;
+
+    /*
+     * Collect the nodes within a number of hops of src, nearest first
+     * @param src, uint32_t representation of source node, included at 0
+     * @param max_hops, depth at which the traversal stops
+     * @param max_nodes, stop once this many nodes were found, 0 for no limit
+     * @param nodes, receives the nodes found
+     * @param distances, receives the hop distance of every node found
+     * @return true if max_nodes cut the neighborhood short
+     */
+    bool Neighborhood(uint32_t src, uint32_t max_hops, uint32_t max_nodes,
+                      std::vector<uint32_t>* nodes,
+                      std::vector<uint32_t>* distances) const;
+
+    /*
+     * Compute minimum edges from src to many nodes with a single traversal
+     * @param src, uint32_t representation of source node
+     * @param targets, nodes whose distance is needed, all nodes if empty.
+     *        The traversal stops once every target has been reached.
+     * @return distances indexed by node, std::numeric_limits<uint32_t>::max()
+     *         for nodes that are unreachable or were not needed
+     */
+    std::vector<uint32_t> SingleSourceBfs(
+        uint32_t src, const std::vector<uint32_t>& targets) const;
+
+    /*
+     * Bring the distances of a source up to date with edits, pushing
+     * decreased distances outward from the heads of inserted edges instead
+     * of running a new traversal
+     * @param src, source node the distances belong to
+     * @param distances, distances on the version the edits were applied to,
+     *        updated in place to the distances on this version
+     * @param edits, effective edits that lead from that version to this one
+     * @return false if a removed edge was on a shortest path, the distances
+     *         may have grown and have to be recomputed, or if they are not
+     *         the distances of src
+     */
+    bool RepairDistances(uint32_t src, std::vector<uint32_t>& distances,
+                         const std::vector<EdgeEdit>& edits) const;
+
+    /*
+     * Structure of the graph detected when its adjacency was built. Pending
+     * edits invalidate the structure, the graph is then general.
+     */
+    GraphStructure Structure() const {
+      return IndexesCurrent() ? indexes->structure_index.Structure()
+                              : GENERAL_GRAPH;
+    }
+
+    // False if dest is provably unreachable from src, see ReachabilityIndex
+    bool MayReach(uint32_t src, uint32_t dest) const {
+      return !IndexesCurrent() ||
+             indexes->reachability_index.MayReach(src, dest);
+    }
+
+    /*
+     * Bound the hop distance between src and dest from the landmark sketch,
+     * without a traversal
+     * @param lower, receives a lower bound
+     * @param upper, receives an upper bound
+     * @return false if there is no sketch or pending edits made it stale
+     */
+    bool DistanceBounds(uint32_t src, uint32_t dest, uint32_t* lower,
+                        uint32_t* upper) const {
+      if (!IndexesCurrent() || indexes->landmark_sketch.Empty())
+        return false;
+      indexes->landmark_sketch.Bounds(src, dest, lower, upper);
+      return true;
+    }
+
+    // Landmark sketch of the adjacency, for reporting
+    const LandmarkSketch& Sketch() const { return indexes->landmark_sketch; }
+    // Statistics of the adjacency, pending edits left out
+    const GraphStatistics& Statistics() const { return indexes->statistics; }
+
+    /*
+     * Lowest total edge weight between src and dest. Integer weights run a
+     * Dijkstra over a radix heap, float weights over a binary heap.
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @param team, threads of the parallel delta-stepping engine for large
+     *        graphs, nullptr to run the sequential Dijkstra
+     * @return the distance, std::numeric_limits<double>::infinity() if
+     *         unreachable. Integer distances are exact up to 2^53.
+     */
+    double WeightedDistance(uint32_t src, uint32_t dest,
+                            ThreadTeam* team) const;
+
+    /*
+     * Compute minimum edges between src and dest over a subgraph given by
+     * bitmaps of the label columns, see src/constrained_distance.cc
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @param edges, edge positions that may be followed, see
+     *        CsrAdjacency::FirstEdge, nullptr to follow every edge
+     * @param nodes, nodes that may be passed through, endpoints included,
+     *        nullptr to allow every node
+     * @param max_hops, depth at which the traversal stops, 0 for none
+     * @return uint32_t number of minimum edges between src & dest, or
+     *         std::numeric_limits<uint32_t>::max() if unreachable
+     */
+    uint32_t ConstrainedBfs(uint32_t src, uint32_t dest, const Bitmap* edges,
+                            const Bitmap* nodes, uint32_t max_hops) const;
+
+    /*
+     * Weakly connected components with the Afforest algorithm: a few
+     * neighbors of every node are linked first, then the remaining edges of
+     * the nodes outside the largest component found so far
+     * @param team, threads linking the edges
+     * @return component of every node, the smallest node of the component
+     */
+    std::vector<uint32_t> ConnectedComponents(ThreadTeam& team) const;
+
+    /*
+     * PageRank by power iteration, pulling the ranks of the in-going
+     * neighbors of every node. Nodes without out-going edges spread their
+     * rank over all nodes.
+     * @param damping, probability of following an edge rather than jumping
+     * @param max_iterations, iterations at most
+     * @param tolerance, stop once the ranks changed less than this in sum
+     * @param team, threads updating the ranks
+     * @param iterations, receives the number of iterations run
+     * @return rank of every node, the ranks sum up to 1
+     */
+    std::vector<double> PageRank(double damping, uint32_t max_iterations,
+                                 double tolerance, ThreadTeam& team,
+                                 uint32_t* iterations) const;
+
+    /*
+     * Out-going degrees of the nodes, pending edits included
+     * @param team, threads counting the degrees
+     * @return number of nodes of every degree, indexed by degree
+     */
+    std::vector<uint64_t> DegreeHistogram(ThreadTeam& team) const;
+
+    uint32_t NumNodes() const { return adjacency->NumNodes(); }
+    uint64_t NumEdges() const { return adjacency->NumEdges(); }
+    // Edges stored once the delta is folded into the adjacency
+    uint64_t NumStoredEdges() const { return delta.NumEdges(*adjacency); }
+    WeightType Weights() const { return adjacency->Weights(); }
+    // Labels of the edges and of the nodes, empty columns if the graph was
+    // posted without them
+    const PropertyColumn& EdgeLabels() const {
+      return adjacency->EdgeLabels();
+    }
+    const PropertyColumn& NodeLabels() const {
+      return adjacency->NodeLabels();
+    }
+    // Whether the graph was posted undirected, edges go both ways
+    bool Undirected() const { return adjacency->Symmetric(); }
+    // Whether the neighbor lists are stored compressed
+    bool Compressed() const { return adjacency->Compressed(); }
+    // Bits of a node id in the neighbor lists, 0 if compressed
+    uint32_t NodeIdBits() const { return adjacency->NodeIdBits(); }
+    // Bytes of the adjacency, weights included, the delta left out
+    uint64_t AdjacencyBytes() const { return adjacency->Bytes(); }
+    // Bytes of the adjacency and its replicas, delta and indexes
+    uint64_t Bytes() const {
+      return adjacency->Bytes() * (1 + NumReplicas()) + delta.Bytes() +
+             indexes->Bytes();
+    }
+    // Copies of the adjacency on other memory nodes than the adjacency
+    uint32_t NumReplicas() const;
+
+    // Number of the version, incremented by every batch of edits that
+    // changed the edges. Compactions keep the number.
+    uint64_t Version() const { return version; }
+
+  private:
+    friend class Graph;
+
+    /*
+     * Breadth first search shared by the general and DAG engines
+     * @param prune, skip nodes that the reachability index rules out
+     */
+    uint32_t Bfs(uint32_t src, uint32_t dest, bool prune) const;
+    // Bfs and SingleSourceBfs compiled for a view of the neighbor lists, the
+    // queue and hop counts use the node id type of the view
+    template <typename Neighbors>
+    uint32_t Bfs(const Neighbors& neighbors, uint32_t src, uint32_t dest,
+                 bool prune) const;
+    template <typename Neighbors>
+    std::vector<uint32_t> SingleSourceBfs(
+        const Neighbors& neighbors, uint32_t src,
+        const std::vector<uint32_t>& targets) const;
+
+    /*
+     * Point to point BFS of undirected graphs, growing the smaller of the
+     * frontiers around src and dest a level at a time until they meet. The
+     * neighbor lists serve both searches.
+     */
+    template <typename Neighbors>
+    uint32_t BidirectionalBfs(const Neighbors& neighbors, uint32_t src,
+                              uint32_t dest) const;
+    /*
+     * Full BFS of undirected graphs that switches to bottom-up steps while
+     * the frontier is large: every undiscovered node then looks for a parent
+     * among its neighbors, which are also its in-going neighbors, and stops
+     * at the first one found
+     */
+    template <typename Neighbors>
+    std::vector<uint32_t> DirectionOptimizingBfs(const Neighbors& neighbors,
+                                                 uint32_t src) const;
+
+    /*
+     * Level by level traversal that never expands nodes at max_hops. Visited
+     * nodes are kept in a hash set, so nothing is sized by the whole graph.
+     * @param neighbors, view of the neighbor lists
+     * @param visit, invoked with every discovered node and its depth,
+     *        returns false to stop the traversal
+     */
+    template <typename Neighbors, typename Visit>
+    void BoundedBfs(const Neighbors& neighbors, uint32_t src,
+                    uint32_t max_hops, Visit visit) const;
+
+    // Whether the indexes describe the current edges, i.e. no pending edits
+    bool IndexesCurrent() const { return delta.Empty(); }
+
+    // Adjacency traversed by the calling thread, the replica on its memory
+    // node if the adjacency is replicated
+    const CsrAdjacency& Local() const {
+      if (!replicas)
+        return *adjacency;
+      uint32_t node = CurrentMemoryNode();
+      return node < replicas->size() && (*replicas)[node]
+                 ? *(*replicas)[node]
+                 : *adjacency;
+    }
+
+    // Weighted engines, see src/weighted_distance.cc
+    uint64_t IntegerDijkstra(uint32_t src, uint32_t dest) const;
+    double FloatDijkstra(uint32_t src, uint32_t dest) const;
+    template <typename Weight>
+    double DeltaStepping(uint32_t src, uint32_t dest, ThreadTeam& team) const;
+    /*
+     * Visit the out-going edges of a node with their weights
+     * @param visit, invoked with the neighbor and the weight of the edge
+     */
+    template <typename Weight, typename Visit>
+    void ForEachWeightedNeighbor(uint32_t node, Visit visit) const;
+
+    // ConstrainedBfs compiled for a view of the neighbor lists
+    template <typename Neighbors>
+    uint32_t ConstrainedBfs(const Neighbors& neighbors, uint32_t src,
+                            uint32_t dest, const Bitmap* edges,
+                            const Bitmap* nodes, uint32_t max_hops) const;
+
+    /*
+     * Visit the out-going neighbors of a node, adjacency plus delta
+     * @param neighbors, view of the neighbor lists of the adjacency
+     * @param visit, returns false to stop the iteration
+     */
+    template <typename Neighbors, typename Visit>
+    void ForEachNeighbor(const Neighbors& neighbors, uint32_t node,
+                         Visit visit) const {
+      bool removals = delta.HasRemovals(node);
+      bool completed = neighbors.ForEachNeighbor(node, [&](uint32_t next) {
+        if (removals && delta.Removed(node, next))
+          return true;
+        return visit(next);
+      });
+      if (!completed)
+        return;
+      const std::vector<uint32_t>* inserted = delta.Inserted(node);
+      if (inserted == nullptr)
+        return;
+      for (uint32_t next : *inserted) {
+        if (!visit(next))
+          return;
+      }
+    }
+
+    // Same for a single node, without a view at hand
+    template <typename Visit>
+    void ForEachNeighbor(uint32_t node, Visit visit) const {
+      adjacency->Dispatch([&](const auto& neighbors) {
+        this->ForEachNeighbor(neighbors, node, visit);
+      });
+    }
+
+    uint64_t version;
+    // Read-optimized adjacency, shared with the versions built on it
+    std::shared_ptr<const CsrAdjacency> adjacency;
+    // Edits applied since the adjacency was built
+    DeltaAdjacency delta;
+    // Indexes of the adjacency, stale while the delta is not empty
+    std::shared_ptr<const GraphIndexes> indexes;
+    // Copies of the adjacency per memory node, one of them the adjacency
+    // itself, shared like it. nullptr if the graph is not replicated.
+    std::shared_ptr<const AdjacencyReplicas> replicas;
+    // Version this one replaced, kept only while something else holds it
+    std::weak_ptr<const GraphVersion> previous;
+};
+
+using GraphVersionSharedPtr = std::shared_ptr<const GraphVersion>;
+
+/*
+ * A posted graph. Every edit publishes a new immutable GraphVersion with an
+ * atomic pointer swap, so queries never wait for writers and always see a
+ * consistent graph. Writers are serialized among themselves only.
+ */
 class Graph {
   public:
-    Graph(int nodes, std::vector<std::vector<uint32_t>> adj_list, std::string name)
-      : num_nodes(nodes), adjacency_list(adj_list), graph_name(name) {}
-    ~Graph() = default;
+    Graph(std::vector<std::vector<uint32_t>> adj_list, std::string name);
+    /*
+     * Build from a ready adjacency, e.g. one with edge weights
+     * @param adjacency, out-going edges of every node
+     * @param name, name of the graph
+     * @param num_landmarks, landmarks of the sketch for approximate queries,
+     *        also used when compactions rebuild the indexes
+     * @param permutation, layout of the nodes in memory, the adjacency is
+     *        relabeled to internal ids with it
+     * @param compress, whether the adjacency is stored compressed, also for
+     *        the adjacencies built by compactions
+     * @param placement, memory placement of the adjacency and of the
+     *        adjacencies built by compactions or read back from disk
+     */
+    Graph(CsrAdjacency adjacency, std::string name,
+          uint32_t num_landmarks = 0,
+          NodePermutation permutation = NodePermutation(),
+          bool compress = false,
+          PlacementPolicy placement = PlacementPolicy());
+    // Removes the spill file, if any
+    ~Graph();
     class Edge {
       public:
         Edge(int in_src, int in_dest)
           :src(in_src), dest(in_dest){}
+        Edge(int in_src, int in_dest, double in_weight)
+          :src(in_src), dest(in_dest), weight(in_weight){}
         int src;
         int dest;
+        // Weight of the edge, ignored for unweighted graphs
+        double weight = 0;
 
         ~Edge() = default;
     };
 
     /*
-     * Compute minimum edges between src and dest nodes
-     * @param src, uint32_t representation of source node
-     * @param dest, uint32_t representation of destination node
-     * @return uint32_t number of minimum edges between src & dest
+     * The latest version of the graph, read back from the spill file if the
+     * graph was spilled
+     * @return nullptr if a spilled graph could not be read back or is
+     *         traversed out of core
+     */
+    GraphVersionSharedPtr Current();
+    // The latest version if the graph is in memory, nullptr if spilled
+    GraphVersionSharedPtr Resident() const {
+      return std::atomic_load(&current);
+    }
+
+    /*
+     * A specific version of the graph, for repeatable results
+     * @param version, number of the version
+     * @return nullptr if the version is no longer available
+     */
+    GraphVersionSharedPtr Version(uint64_t version);
+
+    /*
+     * Insert or remove edges and publish the result as a new version. Edits
+     * of undirected graphs apply to both directions of the edge.
+     * @param edits, edges to insert or remove, in order
+     * @param version, receives the number of the latest version
+     * @param applied, if set, receives the directed edits that changed the
+     *        edges
+     * @param error, if set, receives an error if the edits were rejected
+     *        because the graph would store more than kMaxAdjacencyEdges
+     * @return uint32_t number of edits that changed the set of edges, 0 if
+     *         a spilled graph could not be read back or the edits were
+     *         rejected
+     */
+    uint32_t ApplyEdits(const std::vector<EdgeEdit>& edits, uint64_t* version,
+                        std::vector<EdgeEdit>* applied = nullptr,
+                        std::string* error = nullptr);
+
+    // Whether the delta grew large enough to be folded into the adjacency
+    bool NeedsCompaction() const;
+
+    // Claim the pending compaction, false if one is already scheduled
+    bool TryStartCompaction() { return !compaction_pending.exchange(true); }
+
+    /*
+     * Fold the delta into a new read-optimized adjacency and rebuild the
+     * indexes, then publish them under the same version number. Edits that
+     * arrive during the rebuild are replayed on top of the new adjacency.
+     */
+    void Compact();
+
+    // Number of versions still referenced by queries or retained
+    uint32_t LiveVersions();
+
+    /*
+     * Write the latest version to disk and drop the versions the graph
+     * holds, they are freed once the queries running on them finish. The
+     * next access reads the latest version back, older versions are no
+     * longer available then.
+     * @param path, file to write. A graph spilled before keeps its file,
+     *        which is only rewritten if the graph changed since.
+     * @param out_of_core, whether the graph is never read back, traversals
+     *        read its neighbor lists from the file instead
+     * @return false if the graph is already spilled, is being compacted or
+     *         the file could not be written
+     */
+    bool Spill(const std::string& path, bool out_of_core = false);
+    // Neighbor lists of a graph traversed out of core, nullptr otherwise
+    ExternalAdjacencySharedPtr OutOfCore() const {
+      return std::atomic_load(&external);
+    }
+    // Bytes in memory, the latest version or the positions of the lists
+    // traversed out of core, plus the node permutation
+    uint64_t Bytes() const;
+    // Bytes of the spill file if the graph is spilled, 0 otherwise
+    uint64_t SpilledBytes() const {
+      return Resident() ? 0 : spill_file_bytes.load();
+    }
+    // Stamp of the last query, the engine spills the graphs queried least
+    // recently first
+    void Touch(uint64_t stamp) { last_access = stamp; }
+    uint64_t LastAccess() const { return last_access; }
+    // Times the graph was read back from disk, and the time it took
+    uint64_t FaultIns() const { return fault_ins; }
+    uint64_t FaultInMicros() const { return fault_in_micros; }
+    uint64_t MaxFaultInMicros() const { return max_fault_in_micros; }
+
+    uint32_t NumNodes() const { return num_nodes; }
+
+    /*
+     * Translate between the node ids of clients and the internal ids that
+     * versions, indexes and cached distances use. Both are the identity
+     * unless the graph was posted with a node order.
      */
-    uint32_t MinEdgeBfs(int src, int dest);
+    uint32_t Internal(uint32_t node) const {
+      return permutation.Internal(node);
+    }
+    uint32_t External(uint32_t node) const {
+      return permutation.External(node);
+    }
 
   private:
+    // Latest versions that stay available to queries naming them
+    static constexpr size_t kRetainedVersions = 8;
+    // Minimum number of pending edits before a compaction is worth it
+    static constexpr size_t kMinCompactionEdits = 1024;
+    // Pending edits trigger a compaction once they reach 1/kCompactionRatio
+    // of the edges in the adjacency
+    static constexpr uint64_t kCompactionRatio = 8;
+
+    // Make a version the current one, the caller holds write_mutex
+    void Publish(std::shared_ptr<GraphVersion> version);
+    // The latest version, read back from the spill file if the graph is
+    // spilled, the caller holds write_mutex
+    GraphVersionSharedPtr LatestLocked();
+    /*
+     * Place a final adjacency in memory as the placement policy says
+     * @return copies of the adjacency per memory node, nullptr unless the
+     *         adjacency is replicated
+     */
+    std::shared_ptr<const AdjacencyReplicas> Place(
+        const std::shared_ptr<const CsrAdjacency>& adjacency) const;
+
     // Total number of nodes in the graph
     uint32_t num_nodes;
-    // Adjacency list of edges for graph
-    std::vector<std::vector<uint32_t>> adjacency_list;
     // Name of the graph
     std::string graph_name;
+    // Landmarks of the sketch built with the indexes
+    uint32_t num_landmarks;
+    // Internal ids of the nodes, fixed when the graph is posted
+    NodePermutation permutation;
+    // Whether adjacencies are compressed once their indexes are built
+    bool compress;
+    PlacementPolicy placement;
+    // Latest version, only accessed through std::atomic_load/atomic_store
+    GraphVersionSharedPtr current;
+    // Serializes edits and the publication of compactions
+    std::mutex write_mutex;
+    // Latest versions, newest last, guarded by write_mutex
+    std::deque<GraphVersionSharedPtr> retained;
+    // Every version published and possibly still alive, guarded by write_mutex
+    std::vector<std::weak_ptr<const GraphVersion>> published;
+    // Set while a compaction is scheduled or running
+    std::atomic<bool> compaction_pending{false};
+    // Number of versions published, guarded by write_mutex
+    uint64_t publications = 0;
+    // Spill file, and the publication it holds, 0 if it holds none,
+    // guarded by write_mutex
+    std::string spill_path;
+    uint64_t spilled_publication = 0;
+    // Position of the neighbor lists in the spill file
+    uint64_t spill_lists_position = 0;
+    // Set once the graph is traversed out of core, only accessed through
+    // std::atomic_load/atomic_store
+    ExternalAdjacencySharedPtr external;
+    std::atomic<uint64_t> spill_file_bytes{0};
+    std::atomic<uint64_t> last_access{0};
+    std::atomic<uint64_t> fault_ins{0};
+    std::atomic<uint64_t> fault_in_micros{0};
+    std::atomic<uint64_t> max_fault_in_micros{0};
 
 };
 
 using GraphSharedPtr = std::shared_ptr<Graph>;
 
+/*
+ * Result of a streamed request. Entries are packed into response chunks on
+ * demand, so that neither side has to hold one huge response message.
+ */
+class StreamResult {
+  public:
+    // Maximum number of entries packed into a single response chunk
+    static constexpr size_t kChunkSize = 16384;
+
+    // Status of the operation, sent along with the first chunk
+    std::string message;
+    // Result entries, nodes is left empty when entries follow the order of
+    // the requested nodes
+    std::vector<uint32_t> distances;
+    std::vector<uint32_t> nodes;
+    // Floating point entries, e.g. PageRank, sent instead of distances
+    std::vector<float> scores;
+
+    /*
+     * Pack the next chunk of the result
+     * @param chunk, response message to fill
+     * @return false once every entry has been sent
+     */
+    bool NextChunk(graph::Response* chunk);
+
+  private:
+    // Index of the first entry of the next chunk
+    size_t next_entry = 0;
+    // Whether the first chunk carrying the message was sent
+    bool started = false;
+};
+
+using StreamResultSharedPtr = std::shared_ptr<StreamResult>;
+
+// Tunables of the graph engine, set from the server command line
+// How posted graphs store their neighbor lists
+enum AdjacencyEncoding {
+  // 4 bytes per edge, fastest traversals
+  PLAIN_ADJACENCY,
+  // Group varint encoded gaps, decoded while traversing
+  COMPRESSED_ADJACENCY,
+  // Compressed when the graph is large and compresses well
+  AUTO_ADJACENCY
+};
+
+struct GraphEngineOptions {
+  // Memory bound of the single-source distance cache
+  size_t distance_cache_bytes = 256 << 20;
+  // Number of threads running requests for the asynchronous API
+  uint32_t compute_threads = std::thread::hardware_concurrency();
+  // Weighted queries on graphs with at least this many edges run the
+  // parallel delta-stepping engine instead of Dijkstra
+  uint64_t delta_stepping_min_edges = 1 << 20;
+  // Number of threads of a delta-stepping query
+  uint32_t delta_stepping_threads = std::thread::hardware_concurrency();
+  // Teams of delta-stepping threads kept by the engine, weighted queries
+  // arriving while every team is busy run Dijkstra on their own thread
+  uint32_t delta_stepping_teams = 1;
+  // Landmarks of the sketch built for every posted graph, 0 disables
+  // approximate queries
+  uint32_t num_landmarks = 8;
+  // Posted graphs with at least this many edges are sorted and deduplicated
+  // by a team of ingest threads
+  uint64_t parallel_ingest_min_edges = 1 << 16;
+  // Number of threads of a parallel ingest
+  uint32_t ingest_threads = std::thread::hardware_concurrency();
+  // Whether posted edges from a node to itself are dropped
+  bool drop_self_loops = false;
+  // Storage of the neighbor lists of posted graphs
+  AdjacencyEncoding adjacency_encoding = AUTO_ADJACENCY;
+  // With AUTO_ADJACENCY, graphs whose neighbor lists take at least this many
+  // bytes are compressed if that saves a quarter of the bytes, smaller ones
+  // are worth the faster traversals
+  uint64_t compression_min_bytes = 64 << 20;
+  // Bytes posted graphs may take in memory before the least recently
+  // queried ones are spilled to disk, 0 for no limit
+  uint64_t memory_budget_bytes = 0;
+  // Directory spilled graphs are written to
+  std::string spill_directory = "/tmp";
+  // Whether graphs that alone exceed the memory budget are traversed from
+  // their spill file instead of being read back
+  bool out_of_core = false;
+  // NUMA and huge page placement of the adjacencies of large graphs
+  PlacementPolicy placement;
+  // Number of threads building graphs posted with async_build
+  uint32_t build_threads = 2;
+  // Number of threads of an analytics job, jobs run one at a time
+  uint32_t analytics_threads = 2;
+  // Order of the requests queued for the compute threads
+  SchedulingPolicy scheduling;
+  // Nice value of the build, analytics and ingest threads, so that they
+  // run on the cores queries leave idle
+  int background_nice = 10;
+};
+
+// Completion callbacks of the asynchronous request API
+using RequestCallback = std::function<void(const std::string&)>;
+using StreamCallback = std::function<void(StreamResultSharedPtr)>;
+
 class GraphEngine {
 
   public:
+    GraphEngine() : GraphEngine(GraphEngineOptions()) {}
+    explicit GraphEngine(const GraphEngineOptions& options)
+      : options(options), distance_cache(options.distance_cache_bytes),
+        scheduler(&compute_pool, options.scheduling),
+        compute_pool(options.compute_threads),
+        build_pool(options.build_threads, options.background_nice),
+        analytics_pool(1, options.background_nice) {}
     ~GraphEngine() = default;
-    
+
     std::string ProcessRequest(graph::Request& request);
+    /*
+     * Process a request whose result is streamed back in chunks. Requests
+     * without a bulk result are answered with a single chunk.
+     * @param request, the request to process
+     * @return the result to be packed into response chunks
+     */
+    StreamResultSharedPtr ProcessStreamRequest(graph::Request& request);
+    /*
+     * Process a request on the compute pool without blocking the caller.
+     * Identical minimum distance and weighted distance queries in flight are
+     * coalesced into a single computation.
+     * @param request, the request to process, must stay valid until done
+     *        is invoked
+     * @param done, invoked on a compute thread with the response message
+     * @param control, deadline and cancellation of the request, queries
+     *        that stopped are answered with the reason, see StopOf
+     */
+    void ProcessRequestAsync(graph::Request& request, RequestCallback done,
+                             QueryControlSharedPtr control = nullptr);
+    /*
+     * Streamed counterpart of ProcessRequestAsync. Concurrent one-to-many
+     * requests from the same source share a single traversal, which obeys
+     * the deadline and cancellation of the request that started it. If
+     * that request stops it, the requests sharing it start their own
+     * traversal, and only completed distance arrays are cached.
+     * @param request, the request to process, must stay valid until done
+     *        is invoked
+     * @param done, invoked on a compute thread with the result
+     * @param control, deadline and cancellation of the request
+     */
+    void ProcessStreamRequestAsync(graph::Request& request,
+                                   StreamCallback done,
+                                   QueryControlSharedPtr control = nullptr);
+    /*
+     * Why a reply reports that its request stopped
+     * @return QUERY_RUNNING for replies of requests that were answered
+     */
+    static QueryStop StopOf(const std::string& reply);
   private:
+    /*
+     * Whether a request is a query that honours its control. Writes and
+     * requests that only look up state always run to completion.
+     */
+    static bool Controlled(const graph::Request& request);
+    /*
+     * Run a request under its control, the traversals it runs stop once the
+     * control stops. Requests whose control already stopped do not start.
+     * @param control, the control, nullptr to run without one
+     * @param run, processes the request
+     * @return why the request stopped, QUERY_RUNNING if it was answered
+     */
+    QueryStop RunControlled(QueryControl* control,
+                            const std::function<void()>& run);
+    // Reply to a request that stopped, counting it
+    std::string StopReply(QueryStop stop);
+    /*
+     * Queue the processing of a request on the compute threads, in the
+     * scheduling class and for the tenant of the request
+     * @param task, processes the request
+     */
+    void Schedule(const graph::Request& request, std::function<void()> task);
+    /*
+     * Hand the reply of a coalesced query to one of the requests attached to
+     * it. The control of the request that started the computation governs
+     * it, requests it stopped for while their own control is still running
+     * start over.
+     */
+    void FlightReply(graph::Request& request, const RequestCallback& done,
+                     const QueryControlSharedPtr& control,
+                     const std::string& reply);
+    /*
+     * Answer a one-to-many request attached to a shared source traversal.
+     * Like FlightReply, requests the traversal was stopped for while their
+     * own control is still running start over.
+     * @param distances, distances from the source, nullptr if the traversal
+     *        was stopped or the graph is gone
+     */
+    void SourceFlightReply(graph::Request& request, const StreamCallback& done,
+                           const QueryControlSharedPtr& control,
+                           const DistanceArraySharedPtr& distances);
     /*
      * Hash function to generate graph-ids based on graph names
      */
     std::hash<std::string> hash_fn;
     /*
      * Post graph request to submit a graph to server
-     * @param request, contains type of request, number of nodes and adjancency list
+     * @param request, contains type of request, number of nodes and adjancency list.
+     *        With async_build, its payload is moved to the build and the
+     *        graph id is returned right away.
      * @return returns a string indicating the state of operation
      */
     std::string PostGraphRequest(graph::Request& request);
+    /*
+     * Validate the edges of a posted graph and build it, indexes included
+     * @param request, the post request
+     * @param graph, receives the graph
+     * @return an error message, empty on success
+     */
+    std::string BuildGraph(graph::Request& request, GraphSharedPtr* graph);
+    /*
+     * Make a graph built in the background available to queries and
+     * resubmit the requests waiting for it
+     * @param graph_id, id of the graph
+     * @param ticket, ticket of the build, see GraphBuild
+     * @param graph, the graph, nullptr if the build failed
+     * @param error, why the build failed
+     */
+    void FinishBuild(uint64_t graph_id, uint64_t ticket, GraphSharedPtr graph,
+                     const std::string& error);
+    /*
+     * Report whether a graph posted with async_build is built
+     * @param request, consists of the graph id
+     * @return returns a string indicating the state of the graph
+     */
+    std::string GraphStatusRequest(graph::Request& request);
+    /*
+     * Queue an analytics job on a posted graph
+     * @param request, consists of graph id, job type and its parameters
+     * @return returns a string with the job id, or an error
+     */
+    std::string SubmitJobRequest(graph::Request& request);
+    /*
+     * Run a queued job on the latest version of its graph and keep its
+     * result until enough later jobs finished
+     * @param job_id, id of the job
+     * @param graph, the graph of the job
+     * @param job, job type and parameters
+     */
+    void RunJob(uint64_t job_id, GraphSharedPtr graph,
+                const graph::AnalyticsJob& job);
+    /*
+     * Report whether a job is queued, running or finished
+     * @param request, consists of the job id
+     * @return returns a string indicating the state of the job
+     */
+    std::string JobStatusRequest(graph::Request& request);
+    /*
+     * Hand out the result of a finished job
+     * @param request, consists of the job id
+     * @param result, filled with the result of the job
+     */
+    void JobResultRequest(graph::Request& request, StreamResult& result);
+    /*
+     * Graph named by a query or an edit
+     * @param graph_id, receives the id of the graph
+     * @return false for requests not naming a graph
+     */
+    static bool QueriedGraph(const graph::Request& request, uint64_t* graph_id);
+    // Whether the graph named by a request is still being built
+    bool GraphBuilding(const graph::Request& request);
+    /*
+     * Hold a request with wait_ready until its graph is built
+     * @param retry, runs the request again once the graph is built
+     * @return false if the request does not wait, it runs now
+     */
+    bool WaitForBuild(const graph::Request& request,
+                      std::function<void()> retry);
+    /*
+     * Look up a posted graph and stamp it as queried. A spilled graph is
+     * read back from disk, spilling colder graphs if that exceeds the
+     * memory budget.
+     * @return nullptr if no graph is posted under graph_id
+     */
+    GraphSharedPtr FindGraph(uint64_t graph_id);
+    /*
+     * Spill the least recently queried graphs to disk until the graphs in
+     * memory fit the memory budget
+     * @param keep, graph that stays in memory, the one just posted, read
+     *        back or compacted
+     */
+    void EnforceMemoryBudget(const GraphSharedPtr& keep);
     /*
      * Delete graph request to delete a graph from server
      * @param request, consisting the graph id to be deleted
@@ -82,11 +930,230 @@ class GraphEngine {
      * @return returns a string indicating the state of operation
      */
     std::string MinDistanceGraphRequest(graph::Request& request);
+    /*
+     * Estimate the minimum distance between 2 valid nodes of a graph from
+     * its landmark sketch, falling back to an exact answer when the bounds
+     * are wider than requested or the sketch is not usable
+     * @param max_bound_width, widest acceptable upper - lower bound, 0 to
+     *        accept any bounds
+     * @param lower, receives the lower bound
+     * @param upper, receives the upper bound, which is also the estimate
+     */
+    void ApproximateDistance(uint64_t graph_id, const GraphSharedPtr& graph,
+                             const GraphVersionSharedPtr& version,
+                             uint32_t src, uint32_t dest,
+                             uint32_t max_bound_width, uint32_t* lower,
+                             uint32_t* upper);
+    /*
+     * Compute distances from one node to a list of nodes, or to all nodes,
+     * of a posted graph with a single traversal
+     * @param request, consists of graph id, source and destination nodes
+     * @param result, filled with one distance per requested node
+     * @param precomputed, distances of the source computed by a coalesced
+     *        request, if any
+     */
+    void MultiDistanceGraphRequest(graph::Request& request,
+                                   StreamResult& result,
+                                   DistanceArraySharedPtr precomputed = nullptr);
+    /*
+     * Collect the nodes within a number of hops of a node, with their
+     * distances, stopping the traversal at that depth
+     * @param request, consists of graph id, source node, hop and node limits
+     * @param result, filled with the nodes found and their distances
+     */
+    void NeighborhoodGraphRequest(graph::Request& request,
+                                  StreamResult& result);
+    /*
+     * Report server statistics such as distance cache hit rate and memory
+     * @return returns a string of space separated key=value pairs
+     */
+    std::string ServerStatsRequest();
+    /*
+     * Compute the minimum distance between 2 valid nodes of a graph with the
+     * fastest engine for the graph, consulting the distance cache
+     * @param graph_id, id of the graph in graph db
+     * @param graph, the graph itself
+     * @param version, the version of the graph to query
+     * @param max_hops, distances beyond it are reported as unreachable and
+     *        never traversed, 0 for no limit
+     * @param explain, if set, receives the plan that answered the query
+     */
+    uint32_t ComputeMinDistance(uint64_t graph_id, const GraphSharedPtr& graph,
+                                const GraphVersionSharedPtr& version,
+                                uint32_t src, uint32_t dest,
+                                uint32_t max_hops,
+                                PlanChoice* explain = nullptr);
+    /*
+     * Compute the full distance array of a source and insert it into the
+     * distance cache, unless the graph was deleted in the meantime
+     */
+    DistanceArraySharedPtr CacheDistances(uint64_t graph_id,
+                                          const GraphSharedPtr& graph,
+                                          const GraphVersionSharedPtr& version,
+                                          uint32_t src);
+    /*
+     * Full distance array of a source, from the cache or a new traversal
+     * @param src, client id of the source, the array is indexed by
+     *        internal node ids
+     * @return nullptr if the graph or the source does not exist
+     */
+    DistanceArraySharedPtr SourceDistances(uint64_t graph_id, uint32_t src);
+    /*
+     * Whether a one-to-many request is answered from the full distance array
+     * of its source, shared with concurrent requests from the same source:
+     * requests for all nodes, and requests for targets whose source the
+     * distance cache admits. Other targeted requests stop once their targets
+     * are reached, forests answer them from their index.
+     */
+    bool SharesSourceDistances(const graph::Request& request);
+    /*
+     * Compute the lowest total edge weight between 2 nodes of a posted
+     * weighted graph
+     * @param request, consists of graph id, source and destination nodes
+     * @return returns a string indicating the state of operation
+     */
+    std::string WeightedDistanceGraphRequest(graph::Request& request);
+    /*
+     * Compute minimum edges between 2 nodes of a posted graph over the
+     * edges and nodes whose labels the query allows
+     * @param request, consists of graph id, source and destination nodes
+     *        and the allowed or avoided labels
+     * @return returns a string indicating the state of operation
+     */
+    std::string ConstrainedDistanceGraphRequest(graph::Request& request);
+    /*
+     * Insert or remove edges of a posted graph in place
+     * @param request, consists of graph id and the edges to edit
+     * @param insert, whether the edges are inserted or removed
+     * @return returns a string indicating the state of operation
+     */
+    std::string EditGraphRequest(graph::Request& request, bool insert);
+    /*
+     * Take an idle delta-stepping team, starting one while fewer than
+     * delta_stepping_teams are running
+     * @return the team, nullptr if every team is busy
+     */
+    std::unique_ptr<ThreadTeam> AcquireDeltaSteppingTeam();
+    // Return a team taken with AcquireDeltaSteppingTeam
+    void ReleaseDeltaSteppingTeam(std::unique_ptr<ThreadTeam> team);
+    /*
+     * Carry the cached distance arrays of the version before an edit over
+     * to the version the edit published
+     * @param version, the version published by the edit
+     * @param applied, the effective edits of the version
+     */
+    void RepairCachedDistances(uint64_t graph_id, const GraphSharedPtr& graph,
+                               uint64_t version,
+                               const std::vector<EdgeEdit>& applied);
+    // Tunables the engine was created with
+    GraphEngineOptions options;
     // Mutex to guard graphdb against concurrent operations
     std::mutex graph_db_mutex;
     // graph db consisting of the graph id as key and the graph
     // as the value
     std::map<uint64_t, GraphSharedPtr> graph_db;
+    // Bumped after every change to graph db or to a graph, so that requests
+    // arriving after a write never join a flight that started before it
+    std::atomic<uint64_t> write_epoch{0};
+    // Number of delta compactions run in the background
+    std::atomic<uint64_t> compactions{0};
+    // Clock stamping graph accesses, to find the least recently queried
+    std::atomic<uint64_t> access_clock{0};
+    // Serializes memory budget enforcement
+    std::mutex budget_mutex;
+    // Graphs spilled to disk, and spill files named so far
+    std::atomic<uint64_t> spills{0};
+    std::atomic<uint64_t> spill_files{0};
+    // Approximate queries answered from the sketch, and the ones escalated
+    // to an exact traversal
+    std::atomic<uint64_t> approximate_queries{0};
+    std::atomic<uint64_t> approximate_escalations{0};
+    // Label constrained queries traversed
+    std::atomic<uint64_t> constrained_queries{0};
+    // Queries stopped by their control, and the ones stopped before they
+    // started
+    std::atomic<uint64_t> cancelled_queries{0};
+    std::atomic<uint64_t> deadline_exceeded_queries{0};
+    std::atomic<uint64_t> queries_stopped_before_start{0};
+    // Traversals that stopped, with the nodes they expanded and the nodes
+    // they could still have expanded, a bound of the work saved
+    std::atomic<uint64_t> stopped_traversals{0};
+    std::atomic<uint64_t> stopped_expanded_nodes{0};
+    std::atomic<uint64_t> stopped_unexpanded_nodes{0};
+    // Minimum distance queries answered by every plan
+    std::atomic<uint64_t> plan_counts[NUM_QUERY_PLANS] = {};
+    // Weighted queries run by a delta-stepping team, and the ones that
+    // found every team busy and ran Dijkstra
+    std::atomic<uint64_t> delta_stepping_queries{0};
+    std::atomic<uint64_t> delta_stepping_fallbacks{0};
+    // Idle delta-stepping teams and the teams started, started on first use
+    // and kept until the engine is destroyed, guarded by teams_mutex.
+    // Declared before the compute pool whose tasks borrow them.
+    std::mutex teams_mutex;
+    std::vector<std::unique_ptr<ThreadTeam>> idle_teams;
+    uint32_t num_teams = 0;
+    // Cached distance arrays repaired after edits, and the ones dropped
+    // because a removed edge was on a shortest path
+    std::atomic<uint64_t> distance_repairs{0};
+    std::atomic<uint64_t> distance_repair_drops{0};
+    // Completed single-source distance arrays of hot sources
+    DistanceCache distance_cache;
+    // Minimum distance queries in flight, keyed by the serialized request
+    Singleflight<std::string> query_flights;
+    // Single-source traversals in flight, keyed by graph id and source
+    Singleflight<DistanceArraySharedPtr> source_flights;
+    // Graph posted with async_build, from the reply until it is in graph db
+    struct GraphBuild {
+      // Tells the build apart from a later post of the same graph
+      uint64_t ticket = 0;
+      // Set along with the error once the build failed, the entry then
+      // stays until the graph is deleted or posted again
+      bool failed = false;
+      std::string error;
+      // Requests with wait_ready, resubmitted once the build is over
+      std::vector<std::function<void()>> waiters;
+    };
+    // Builds by graph id, and tickets handed out, guarded by graph_db_mutex
+    std::map<uint64_t, GraphBuild> builds;
+    uint64_t build_tickets = 0;
+    // Graphs posted with async_build, builds that ran to their end, the
+    // ones that failed, and the time the builds took
+    std::atomic<uint64_t> async_builds{0};
+    std::atomic<uint64_t> finished_builds{0};
+    std::atomic<uint64_t> failed_builds{0};
+    std::atomic<uint64_t> build_micros{0};
+    // Analytics job, from its submission until its result is dropped
+    struct JobState {
+      bool running = false;
+      // Result of a finished job, its message starts with "ERROR: " if the
+      // job failed, nullptr until then
+      StreamResultSharedPtr result;
+    };
+    // Finished jobs whose results are kept, older results are dropped
+    static constexpr size_t kRetainedJobs = 64;
+    // Jobs by id, finished jobs oldest first and the last id handed out,
+    // guarded by jobs_mutex
+    std::mutex jobs_mutex;
+    std::map<uint64_t, JobState> jobs;
+    std::deque<uint64_t> finished_jobs;
+    uint64_t last_job_id = 0;
+    // Jobs submitted, the ones that failed, and the time the jobs took
+    std::atomic<uint64_t> submitted_jobs{0};
+    std::atomic<uint64_t> failed_jobs{0};
+    std::atomic<uint64_t> job_micros{0};
+    // Requests waiting for a compute thread, by class and tenant. Declared
+    // before the compute pool, whose tasks dispatch the next requests until
+    // its threads are joined.
+    FairScheduler scheduler;
+    // Threads running asynchronous requests. Declared after the state they
+    // use so that it is destroyed, and its threads joined, before it.
+    WorkerPool compute_pool;
+    // Threads building graphs posted with async_build, joined before the
+    // compute pool that waiting requests are resubmitted to
+    WorkerPool build_pool;
+    // Single thread running analytics jobs one after the other, so that
+    // they take at most analytics_threads cores from queries
+    WorkerPool analytics_pool;
 };
 
 using GraphEngineSharedPtr = std::shared_ptr<GraphEngine>;
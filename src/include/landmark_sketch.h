@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "src/include/adjacency.h"
+#include "src/include/distance_cache.h"
+
+namespace GraphQueryEngine {
+
+/*
+ * Landmark sketch of a graph for approximate hop distances.
+ *
+ * A few landmark nodes keep their BFS distances to and from every node. By
+ * the triangle inequality, d(s, l) + d(l, t) bounds d(s, t) from above and
+ * d(l, t) - d(l, s) and d(s, l) - d(t, l) bound it from below, so a query is
+ * answered from 4 lookups per landmark without touching the adjacency.
+ * Landmarks are the nodes of highest degree, preferring nodes that no
+ * earlier landmark reaches or is reached from, so that every component of
+ * the graph gets bounds. Undirected graphs keep a single array per landmark,
+ * distances to a landmark are the distances from it.
+ */
+class LandmarkSketch {
+  public:
+    LandmarkSketch() = default;
+    ~LandmarkSketch() = default;
+
+    /*
+     * Pick the landmarks and run their forward and backward traversals
+     * @param adjacency, out-going edges of every node in the graph
+     * @param num_landmarks, number of landmarks, 0 leaves the sketch empty
+     */
+    void Build(const CsrAdjacency& adjacency, uint32_t num_landmarks);
+
+    bool Empty() const { return landmarks.empty(); }
+
+    /*
+     * Bound the hop distance from src to dest
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @param lower, receives a lower bound, std::numeric_limits<uint32_t>::max()
+     *        if dest is provably unreachable
+     * @param upper, receives an upper bound, std::numeric_limits<uint32_t>::max()
+     *        if no landmark connects src to dest
+     */
+    void Bounds(uint32_t src, uint32_t dest, uint32_t* lower,
+                uint32_t* upper) const;
+
+    uint32_t NumLandmarks() const { return landmarks.size(); }
+    // Largest finite distance from a landmark to a node, a lower bound of
+    // the diameter, 0 if the sketch is empty
+    uint32_t Eccentricity() const;
+    // Bytes used by the distances of all landmarks
+    size_t Bytes() const;
+    // Time it took to build the sketch
+    uint64_t BuildMicros() const { return build_micros; }
+
+    // Write the sketch in the binary form of binary_io.h
+    void Save(std::ostream& out) const;
+    // Replace the sketch with one written by Save, false if the stream ended
+    // early
+    bool Load(std::istream& in);
+
+  private:
+    // Landmark nodes, in the order they were picked
+    std::vector<uint32_t> landmarks;
+    // Distances from every landmark to every node
+    std::vector<DistanceArray> from_landmark;
+    // Distances from every node to every landmark, empty if symmetric
+    std::vector<DistanceArray> to_landmark;
+    // Whether the graph is undirected, from_landmark then serves both ways
+    bool symmetric = false;
+    uint64_t build_micros = 0;
+};
+
+} // end GraphQueryEngine
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+namespace GraphQueryEngine {
+
+// Where the arrays of large graphs live on machines with several memory
+// (NUMA) nodes
+enum MemoryPlacement {
+  // Wherever the thread that built them runs, the kernel default
+  LOCAL_PLACEMENT,
+  // Pages spread round-robin over all memory nodes
+  INTERLEAVE_PLACEMENT,
+  // A copy of the neighbor lists on every memory node, traversals read the
+  // copy of the node they run on
+  REPLICATE_PLACEMENT
+};
+
+struct PlacementPolicy {
+  MemoryPlacement placement = LOCAL_PLACEMENT;
+  // Whether the arrays are backed by transparent huge pages
+  bool huge_pages = false;
+  // Adjacencies smaller than this are left where they were allocated
+  uint64_t min_bytes = 64 << 20;
+};
+
+/*
+ * Placement of memory already allocated, through the mbind and madvise
+ * system calls, no NUMA library needed. Every call is a hint: it does
+ * nothing where the kernel does not support it, and the policies spanning
+ * nodes do nothing on machines with a single memory node.
+ */
+
+// Number of memory nodes online, 1 if the machine does not report them
+uint32_t NumMemoryNodes();
+// Highest id of a memory node online plus one, ids may have gaps
+uint32_t MemoryNodeIdLimit();
+// Whether a memory node is online
+bool MemoryNodeOnline(uint32_t node);
+// Memory node of the CPU the calling thread runs on, 0 if unknown
+uint32_t CurrentMemoryNode();
+
+/*
+ * Move the whole pages of an array as a placement says, and back them by
+ * transparent huge pages
+ * @param data, first byte of the array
+ * @param bytes, size of the array
+ * @param placement, LOCAL_PLACEMENT leaves the pages where they are,
+ *        REPLICATE_PLACEMENT binds them to node
+ * @param huge_pages, whether to collapse the pages into huge pages
+ * @param node, memory node of a replica
+ */
+void PlaceMemory(const void* data, uint64_t bytes, MemoryPlacement placement,
+                 bool huge_pages, uint32_t node = 0);
+
+// Bytes of the process backed by transparent huge pages, 0 if unknown
+uint64_t HugePageBytes();
+
+// Name of a placement, as on the server command line
+const char* PlacementName(MemoryPlacement placement);
+
+} // end GraphQueryEngine
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "src/include/adjacency.h"
+
+namespace GraphQueryEngine {
+
+// Layout of the nodes of a graph in memory, chosen when it is posted
+enum NodeOrder {
+  // Keep the ids the client posted
+  ORIGINAL_ORDER,
+  // Reverse Cuthill-McKee: BFS order with low degree neighbors first,
+  // reversed, which keeps the neighbors of a node close to each other
+  RCM_ORDER,
+  // Nodes of highest degree first, so that hubs share cache lines
+  DEGREE_ORDER,
+  // Gorder: greedily place next the node sharing the most neighbors with
+  // the last few placed nodes
+  GORDER
+};
+
+/*
+ * Relabeling of the nodes of a graph. Traversals run on internal ids, the
+ * engine translates the ids of requests and results at the boundary so that
+ * clients never see the internal ones. Empty for the identity.
+ */
+struct NodePermutation {
+  // Internal id of every client-visible node
+  std::vector<uint32_t> to_internal;
+  // Client-visible id of every internal node
+  std::vector<uint32_t> to_external;
+
+  bool Empty() const { return to_internal.empty(); }
+  uint32_t Internal(uint32_t node) const {
+    return to_internal.empty() ? node : to_internal[node];
+  }
+  uint32_t External(uint32_t node) const {
+    return to_external.empty() ? node : to_external[node];
+  }
+};
+
+/*
+ * Compute a cache friendly layout of the nodes of a graph
+ * @param adjacency, out-going edges of every node, in client ids
+ * @param order, the layout to compute
+ * @return the permutation, empty for ORIGINAL_ORDER
+ */
+NodePermutation ComputeNodeOrder(const CsrAdjacency& adjacency,
+                                 NodeOrder order);
+
+} // end GraphQueryEngine
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "src/include/memory_placement.h"
+
+namespace GraphQueryEngine {
+
+/*
+ * Set of rows of a column, one bit per row packed in 64 bit words. Bits
+ * past the last row are always clear. Whole bitmaps are combined with plain
+ * word loops, which compilers vectorize.
+ */
+class Bitmap {
+  public:
+    Bitmap() = default;
+    // Bitmap of num_rows clear bits
+    explicit Bitmap(uint64_t num_rows)
+      : num_rows(num_rows), words((num_rows + 63) / 64, 0) {}
+
+    uint64_t NumRows() const { return num_rows; }
+    void Set(uint64_t row) { words[row / 64] |= uint64_t(1) << (row % 64); }
+    bool Test(uint64_t row) const {
+      return (words[row / 64] >> (row % 64)) & 1;
+    }
+
+    // Add the rows of a bitmap of as many rows
+    void Or(const Bitmap& other);
+    // Complement the set, rows past the last stay clear
+    void Flip();
+    // Number of rows in the set
+    uint64_t Count() const;
+    size_t Bytes() const { return words.size() * sizeof(uint64_t); }
+
+    /*
+     * Visit the rows of [begin, end) in the set, in order, taking them a
+     * word at a time so that rows outside the set cost nothing
+     * @param visit, called with every row and its offset from begin,
+     *        returns false to stop the iteration
+     * @return false if visit stopped the iteration
+     */
+    template <typename Visit>
+    bool ForEachSetRow(uint64_t begin, uint64_t end, Visit visit) const {
+      if (begin >= end)
+        return true;
+      uint64_t last = (end - 1) / 64;
+      for (uint64_t word = begin / 64; word <= last; word++) {
+        uint64_t bits = words[word];
+        if (word == begin / 64)
+          bits &= ~uint64_t(0) << (begin % 64);
+        if (word == last && end % 64 != 0)
+          bits &= ~(~uint64_t(0) << (end % 64));
+        while (bits != 0) {
+          uint64_t row = word * 64 + __builtin_ctzll(bits);
+          if (!visit(row, row - begin))
+            return false;
+          bits &= bits - 1;
+        }
+      }
+      return true;
+    }
+
+    void Place(MemoryPlacement placement, bool huge_pages,
+               uint32_t node) const;
+    // Write the bitmap in the binary form of binary_io.h
+    void Save(std::ostream& out) const;
+    // Replace the bitmap with one written by Save, false if the stream ended
+    // early
+    bool Load(std::istream& in);
+
+  private:
+    uint64_t num_rows = 0;
+    std::vector<uint64_t> words;
+};
+
+/*
+ * Categorical property of every node or every edge of a graph, e.g. the
+ * link class of an edge. Values are dictionary encoded: the code of every
+ * row is stored column-wise with the narrowest width that fits the number
+ * of distinct values. Columns with at most kMaxBitmaps distinct values also
+ * keep a bitmap of the rows of every value, so that filters combine bitmaps
+ * instead of reading the codes.
+ */
+class PropertyColumn {
+  public:
+    static constexpr uint32_t kMaxBitmaps = 64;
+
+    // Empty column, for graphs posted without the property
+    PropertyColumn() = default;
+    /*
+     * Encode a column
+     * @param values, value of every row
+     */
+    explicit PropertyColumn(const std::vector<uint32_t>& values);
+
+    bool Empty() const { return num_rows == 0; }
+    uint64_t NumRows() const { return num_rows; }
+    // Number of distinct values
+    uint32_t NumValues() const { return values.size(); }
+    // Whether filters are answered from bitmaps
+    bool Indexed() const { return !bitmaps.empty(); }
+
+    // Value of a row
+    uint32_t Get(uint64_t row) const;
+    // Value of every row
+    std::vector<uint32_t> Decode() const;
+
+    /*
+     * Rows whose value is one of a set of values
+     * @param selected, values to select, values not in the column select no
+     *        row
+     * @param exclude, select the rows whose value is none of them instead
+     */
+    Bitmap Select(const std::vector<uint32_t>& selected, bool exclude) const;
+
+    // Bytes of the codes, the dictionary and the bitmaps
+    size_t Bytes() const;
+
+    void Place(MemoryPlacement placement, bool huge_pages,
+               uint32_t node) const;
+    // Write the column in the binary form of binary_io.h
+    void Save(std::ostream& out) const;
+    // Replace the column with one written by Save, false if the stream ended
+    // early
+    bool Load(std::istream& in);
+
+  private:
+    // Code of a row, the position of its value in values
+    uint32_t Code(uint64_t row) const;
+
+    uint64_t num_rows = 0;
+    // Width of every code in bytes, 1, 2 or 4
+    uint32_t width = sizeof(uint8_t);
+    std::vector<uint8_t> codes;
+    // Distinct values in increasing order
+    std::vector<uint32_t> values;
+    // Rows of every value, empty if there are too many values
+    std::vector<Bitmap> bitmaps;
+};
+
+} // end GraphQueryEngine
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace GraphQueryEngine {
+
+// Why a request stopped before it was answered
+enum QueryStop {
+  QUERY_RUNNING,
+  // The client cancelled the request or went away
+  QUERY_CANCELLED,
+  // The deadline of the request passed
+  QUERY_DEADLINE_EXCEEDED
+};
+
+/*
+ * Deadline and cancellation of a single request, shared by the transport,
+ * which cancels it once the client is gone, and the computation serving it.
+ * The control is installed for the thread running the request with
+ * ScopedQueryControl, ThreadTeam members inherit it for their phases.
+ * Traversals poll it through a QueryCheckpoint and return early once it
+ * stopped, the engine then replies with the reason and drops the partial
+ * result.
+ */
+class QueryControl {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Control without a deadline, stopped only by Cancel
+    QueryControl() = default;
+    explicit QueryControl(Clock::time_point deadline)
+      : deadline(deadline), has_deadline(true) {}
+
+    // Ask the request to stop, from any thread
+    void Cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+    /*
+     * Whether the request has to stop, reading the clock if it has a
+     * deadline. Once stopped the request stays stopped for the first reason
+     * found, so that every member of a team agrees on it.
+     */
+    QueryStop Check();
+    // Reason found by the last Check, without reading the clock
+    QueryStop Stopped() const { return stop.load(std::memory_order_relaxed); }
+
+    bool HasDeadline() const { return has_deadline; }
+    Clock::time_point Deadline() const { return deadline; }
+
+    /*
+     * Account for a traversal that stopped
+     * @param expanded, nodes it expanded before it stopped
+     * @param unexpanded, nodes it could still have expanded, an upper bound
+     *        of the work saved
+     */
+    void RecordStop(uint64_t expanded, uint64_t unexpanded);
+    uint64_t StoppedTraversals() const { return stopped_traversals.load(); }
+    uint64_t ExpandedNodes() const { return expanded_nodes.load(); }
+    uint64_t UnexpandedNodes() const { return unexpanded_nodes.load(); }
+
+    // Control installed for the calling thread, nullptr if none
+    static QueryControl* Current();
+    // Whether the control of the calling thread, if any, stopped
+    static bool CurrentStopped() {
+      QueryControl* control = Current();
+      return control != nullptr && control->Stopped() != QUERY_RUNNING;
+    }
+
+  private:
+    Clock::time_point deadline;
+    bool has_deadline = false;
+    std::atomic<bool> cancelled{false};
+    std::atomic<QueryStop> stop{QUERY_RUNNING};
+    std::atomic<uint64_t> stopped_traversals{0};
+    std::atomic<uint64_t> expanded_nodes{0};
+    std::atomic<uint64_t> unexpanded_nodes{0};
+};
+using QueryControlSharedPtr = std::shared_ptr<QueryControl>;
+
+// Control installed for the calling thread for the lifetime of the scope
+class ScopedQueryControl {
+  public:
+    // @param control, the control to install, nullptr for none
+    explicit ScopedQueryControl(QueryControl* control);
+    // Restores the control installed before
+    ~ScopedQueryControl();
+
+    ScopedQueryControl(const ScopedQueryControl&) = delete;
+    ScopedQueryControl& operator=(const ScopedQueryControl&) = delete;
+
+  private:
+    QueryControl* previous;
+};
+
+/*
+ * Poll of the control of the calling thread, kept on the stack of a
+ * traversal and counted once per expanded node. The control is only checked
+ * every kCheckInterval nodes, so that reading the clock stays out of the
+ * inner loop, and costs a single branch without a control. Fork-join
+ * computations count the nodes of a whole phase on the calling thread, or
+ * poll a checkpoint of their own in every member.
+ */
+class QueryCheckpoint {
+  public:
+    static constexpr uint32_t kCheckInterval = 1024;
+
+    // @param total, nodes the traversal expands at most
+    explicit QueryCheckpoint(uint64_t total)
+      : control(QueryControl::Current()), total(total) {}
+
+    // Count expanded nodes, true if the traversal has to stop
+    bool Stop(uint64_t nodes = 1) {
+      if (control == nullptr)
+        return false;
+      if (stopped)
+        return true;
+      expanded += nodes;
+      if (expanded < next_check)
+        return false;
+      return Poll();
+    }
+
+  private:
+    // Check the control, recording the stop the first time
+    bool Poll();
+
+    QueryControl* control;
+    uint64_t total;
+    uint64_t expanded = 0;
+    uint64_t next_check = kCheckInterval;
+    bool stopped = false;
+};
+
+} // end GraphQueryEngine
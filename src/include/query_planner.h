@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+
+#include "src/include/adjacency.h"
+#include "src/include/landmark_sketch.h"
+#include "src/include/reachability.h"
+
+namespace GraphQueryEngine {
+
+// Depths of the neighborhood growth profile
+constexpr uint32_t kProfileDepths = 64;
+
+// Shape of a graph, collected when its indexes are built
+struct GraphStatistics {
+  uint32_t num_nodes = 0;
+  uint64_t num_edges = 0;
+  double average_degree = 0;
+  uint32_t max_degree = 0;
+  // Largest distance from a landmark, 0 without a landmark sketch
+  uint32_t diameter_estimate = 0;
+  // Strongly connected components, and nodes of the largest one
+  uint32_t num_components = 0;
+  uint32_t largest_component = 0;
+  // Average nodes within every number of hops of a few sampled nodes, up
+  // to the depth at which a sample grew too large to follow further
+  float ball_sizes[kProfileDepths] = {};
+  uint32_t profile_depth = 0;
+};
+
+/*
+ * Collect the statistics of an adjacency, reading the rest from its indexes
+ * @param adjacency, out-going edges of every node in the graph, with plain
+ *        neighbor lists
+ * @param reachability_index, components of the adjacency
+ * @param landmark_sketch, landmark distances of the adjacency
+ */
+GraphStatistics CollectStatistics(const CsrAdjacency& adjacency,
+                                  const ReachabilityIndex& reachability_index,
+                                  const LandmarkSketch& landmark_sketch);
+
+// Ways to answer a minimum distance query, cheapest first
+enum QueryPlan {
+  // Source and destination are the same node
+  SAME_NODE_PLAN,
+  // Distance from the LCA index of a forest
+  FOREST_PLAN,
+  // Unreachable according to the reachability index
+  REACHABILITY_PLAN,
+  // Distance array of the source in the distance cache
+  CACHED_PLAN,
+  // Landmark bounds that meet, or rule out the hop limit
+  LANDMARK_PLAN,
+  // Full traversal from a hot source, kept in the distance cache
+  CACHE_FILL_PLAN,
+  // Traversal with a visited hash set, expanding only up to a hop limit
+  BOUNDED_BFS_PLAN,
+  // Traversal with visited arrays sized by the graph
+  BFS_PLAN,
+  // Same, skipping nodes that the reachability index of a DAG rules out
+  DAG_BFS_PLAN,
+  // Frontiers grown from both ends of an undirected graph
+  BIDIRECTIONAL_BFS_PLAN,
+  NUM_QUERY_PLANS
+};
+
+// Name of a plan, as reported by explain and STATS
+const char* PlanName(QueryPlan plan);
+
+// What is known about a query that needs a traversal
+struct TraversalQuery {
+  // Hop limit of the query, 0 for none
+  uint32_t max_hops = 0;
+  // Whether the neighbor lists serve as in-going lists too
+  bool symmetric = false;
+  // Whether the graph is a DAG with a current reachability index
+  bool dag = false;
+  // Landmark bounds of the distance, upper is
+  // std::numeric_limits<uint32_t>::max() if unknown
+  uint32_t lower = 0;
+  uint32_t upper = 0;
+};
+
+// Traversal picked for a query
+struct PlanChoice {
+  QueryPlan plan = BFS_PLAN;
+  // Estimated cost, in edges scanned by a traversal with visited arrays
+  double cost = 0;
+  // Depth at which BOUNDED_BFS_PLAN stops, the distance is known to be no
+  // larger or the query does not look further
+  uint32_t max_hops = 0;
+};
+
+/*
+ * Cost based choice among the traversals valid for a query. The size of
+ * the part of the graph a traversal explores before it reaches the
+ * destination is estimated from the growth profile and the components,
+ * the distance itself from the landmark bounds. Traversals
+ * with visited arrays pay for arrays sized by the graph, the bounded
+ * traversal pays more per node for its hash set but nothing up front.
+ */
+class QueryPlanner {
+  public:
+    // Cost of a node of the visited arrays, cleared before every traversal
+    static constexpr double kArrayNodeCost = 0.25;
+    // Cost of a node visit with the hash set, relative to the arrays
+    static constexpr double kHashNodeCost = 6;
+    // Share of a traversal left after the DAG pruning
+    static constexpr double kDagPruning = 0.5;
+
+    /*
+     * Pick the cheapest traversal valid for a query
+     * @param statistics, statistics of the graph
+     * @param query, what is known about the query
+     */
+    static PlanChoice Choose(const GraphStatistics& statistics,
+                             const TraversalQuery& query);
+
+    /*
+     * Estimated nodes within a number of hops of a node, past the growth
+     * profile at the growth rate of its last depth
+     * @param statistics, statistics of the graph
+     * @param hops, radius of the ball
+     * @param symmetric, whether the graph is undirected, reachable nodes
+     *        then lie in a single component
+     */
+    static double BallSize(const GraphStatistics& statistics, double hops,
+                           bool symmetric);
+};
+
+} // end GraphQueryEngine
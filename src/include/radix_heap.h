@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+/*
+ * Monotone priority queue over integer keys. Keys pushed are never smaller
+ * than the last key popped, which holds for Dijkstra with non-negative
+ * weights. Entries are kept in 65 buckets by the highest bit in which their
+ * key differs from the last popped key, so every entry moves to a lower
+ * bucket at most 64 times and push/pop cost O(1) amortized per bit.
+ */
+template <typename Value>
+class RadixHeap {
+  public:
+    RadixHeap() : buckets(kNumBuckets) {}
+    ~RadixHeap() = default;
+
+    bool Empty() const { return size == 0; }
+
+    /*
+     * Insert an entry
+     * @param key, priority, not smaller than the last key popped
+     * @param value, payload returned along with the key
+     */
+    void Push(uint64_t key, Value value) {
+      buckets[Bucket(key ^ last)].push_back(std::make_pair(key, value));
+      size++;
+    }
+
+    // Remove and return an entry of minimum key, the heap must not be empty
+    std::pair<uint64_t, Value> Pop() {
+      if (buckets[0].empty()) {
+        uint32_t i = 1;
+        while (buckets[i].empty())
+          i++;
+        // The new minimum splits the bucket over lower buckets
+        uint64_t minimum = buckets[i][0].first;
+        for (const auto &entry : buckets[i])
+          minimum = entry.first < minimum ? entry.first : minimum;
+        last = minimum;
+        for (const auto &entry : buckets[i])
+          buckets[Bucket(entry.first ^ last)].push_back(entry);
+        buckets[i].clear();
+      }
+      std::pair<uint64_t, Value> top = buckets[0].back();
+      buckets[0].pop_back();
+      size--;
+      return top;
+    }
+
+  private:
+    static constexpr uint32_t kNumBuckets = 65;
+
+    // Bucket 0 holds keys equal to last, bucket b keys whose highest
+    // differing bit is b - 1
+    static uint32_t Bucket(uint64_t difference) {
+      return difference == 0 ? 0 : 64 - __builtin_clzll(difference);
+    }
+
+    std::vector<std::vector<std::pair<uint64_t, Value>>> buckets;
+    // Last key popped
+    uint64_t last = 0;
+    size_t size = 0;
+};
+
+} // end GraphQueryEngine
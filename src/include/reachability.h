@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "src/include/adjacency.h"
+
+namespace GraphQueryEngine {
+
+/*
+ * Reachability index built once when a graph is posted.
+ *
+ * Strongly connected components are computed with an iterative Tarjan pass
+ * and the condensed DAG is labelled GRAIL-style: every component receives
+ * `kNumIntervalLabels` post-order intervals, one per randomized DFS over the
+ * DAG. If `u` reaches `v`, the interval of `v` is nested in the interval of
+ * `u` for every traversal, so a single non-nested interval proves `v` is
+ * unreachable from `u` in O(1). Nested intervals only mean "maybe reachable"
+ * and the caller has to fall back to a traversal.
+ */
+class ReachabilityIndex {
+  public:
+    ReachabilityIndex() = default;
+    ~ReachabilityIndex() = default;
+
+    /*
+     * Build the SCC decomposition and interval labels for a graph
+     * @param adjacency, out-going edges of every node in the graph
+     */
+    void Build(const CsrAdjacency& adjacency);
+
+    /*
+     * Check whether dest can possibly be reached from src
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @return false if dest is provably unreachable from src, true otherwise
+     */
+    bool MayReach(uint32_t src, uint32_t dest) const;
+
+    /*
+     * Strongly connected component of a node. Components are numbered in
+     * reverse topological order of the condensed DAG, i.e. an edge between
+     * two different components always goes from a higher to a lower id.
+     */
+    uint32_t Component(uint32_t node) const { return component[node]; }
+
+    uint32_t NumComponents() const { return num_components; }
+
+    // Bytes of the components and labels
+    uint64_t Bytes() const;
+    // Write the index in the binary form of binary_io.h
+    void Save(std::ostream& out) const;
+    // Replace the index with one written by Save, false if the stream ended
+    // early
+    bool Load(std::istream& in);
+
+  private:
+    // Number of randomized interval labels kept per component
+    static constexpr uint32_t kNumIntervalLabels = 3;
+
+    void BuildComponents(const CsrAdjacency& adjacency);
+    void BuildCondensedDag(const CsrAdjacency& adjacency);
+    void BuildIntervalLabels();
+
+    // Total number of strongly connected components
+    uint32_t num_components = 0;
+    // Component id of every node
+    std::vector<uint32_t> component;
+    // Condensed DAG in CSR form, indexed by component id
+    std::vector<uint32_t> dag_offsets;
+    std::vector<uint32_t> dag_targets;
+    // Interval labels, kNumIntervalLabels (low, post) pairs per component
+    std::vector<uint32_t> label_low;
+    std::vector<uint32_t> label_post;
+};
+
+} // end GraphQueryEngine
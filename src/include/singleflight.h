@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+/*
+ * Coalesces identical computations that are in flight at the same time.
+ * The first caller of a key becomes the leader and runs the computation,
+ * later callers only attach a callback and are completed with the leader's
+ * result, without starting work of their own or blocking a thread.
+ */
+template <typename Value>
+class Singleflight {
+  public:
+    using Callback = std::function<void(const Value&)>;
+
+    /*
+     * Attach a callback to the flight of a key
+     * @param key, identity of the computation
+     * @param callback, invoked with the result once the flight completes
+     * @return true if no flight was in progress, the caller is the leader and
+     *         has to run the computation and Complete() the key
+     */
+    bool Join(const std::string& key, Callback callback) {
+      std::lock_guard<std::mutex> guard(flights_mutex);
+      auto it = flights.find(key);
+      if (it != flights.end()) {
+        it->second.push_back(std::move(callback));
+        coalesced++;
+        return false;
+      }
+      flights[key].push_back(std::move(callback));
+      return true;
+    }
+
+    /*
+     * Complete the flight of a key, invoking every attached callback
+     * @param key, identity of the computation
+     * @param value, the result of the computation
+     */
+    void Complete(const std::string& key, const Value& value) {
+      std::vector<Callback> waiters;
+      {
+        std::lock_guard<std::mutex> guard(flights_mutex);
+        auto it = flights.find(key);
+        if (it == flights.end())
+          return;
+        waiters.swap(it->second);
+        flights.erase(it);
+      }
+      // Callers joining from now on start a new flight
+      for (auto& waiter : waiters)
+        waiter(value);
+    }
+
+    // Number of callers served by another caller's computation
+    uint64_t Coalesced() {
+      std::lock_guard<std::mutex> guard(flights_mutex);
+      return coalesced;
+    }
+
+  private:
+    // Mutex to guard the flights against concurrent callers
+    std::mutex flights_mutex;
+    // Callbacks waiting on every key in flight
+    std::unordered_map<std::string, std::vector<Callback>> flights;
+    uint64_t coalesced = 0;
+};
+
+} // end GraphQueryEngine
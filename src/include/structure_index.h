@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "src/include/adjacency.h"
+#include "src/include/reachability.h"
+
+namespace GraphQueryEngine {
+
+// Shape of a posted graph, decides which distance engine answers queries
+enum GraphStructure {
+  // Arbitrary directed graph, answered by BFS
+  GENERAL_GRAPH,
+  // Directed acyclic graph, answered by a topologically pruned BFS
+  DAG,
+  // Every node has at most one parent and there are no cycles
+  DIRECTED_FOREST,
+  // Every edge is posted in both directions and there are no cycles
+  UNDIRECTED_FOREST
+};
+
+/*
+ * Classification of a graph plus the specialized index of its structure.
+ *
+ * Forests keep an Euler tour of every tree and a sparse table of minimum
+ * depths over the tour, which answers lowest common ancestor queries and
+ * therefore hop distances in O(1). DAGs reuse the topological order that the
+ * reachability index already provides, so no extra state is needed.
+ */
+class StructureIndex {
+  public:
+    StructureIndex() = default;
+    ~StructureIndex() = default;
+
+    /*
+     * Classify the graph and build the index for its structure
+     * @param adjacency, out-going edges of every node in the graph
+     * @param reachability_index, SCCs of the same graph
+     */
+    void Build(const CsrAdjacency& adjacency,
+               const ReachabilityIndex& reachability_index);
+
+    GraphStructure Structure() const { return structure; }
+
+    /*
+     * Hop distance between two nodes of a forest
+     * @param src, uint32_t representation of source node
+     * @param dest, uint32_t representation of destination node
+     * @return uint32_t number of edges between src & dest, or
+     *         std::numeric_limits<uint32_t>::max() if unreachable
+     */
+    uint32_t ForestDistance(uint32_t src, uint32_t dest) const;
+
+    // Bytes of the forest index, 0 for other structures
+    uint64_t Bytes() const;
+    // Write the index in the binary form of binary_io.h
+    void Save(std::ostream& out) const;
+    // Replace the index with one written by Save, false if the stream ended
+    // early
+    bool Load(std::istream& in);
+
+  private:
+    /*
+     * Root every tree, record the Euler tour and build the sparse table
+     * @param children, children of every node in the rooted forest
+     * @param roots, root of every tree in the forest
+     */
+    void BuildForest(const std::vector<std::vector<uint32_t>>& children,
+                     const std::vector<uint32_t>& roots);
+    uint32_t Lca(uint32_t u, uint32_t v) const;
+
+    GraphStructure structure = GENERAL_GRAPH;
+    // Depth of every node below the root of its tree
+    std::vector<uint32_t> depth;
+    // Root of the tree every node belongs to
+    std::vector<uint32_t> tree_root;
+    // Position of the first visit of every node in the Euler tour
+    std::vector<uint32_t> first_visit;
+    // Sparse table over the Euler tour, level j holds the node of minimum
+    // depth in every window of 2^j tour positions
+    std::vector<std::vector<uint32_t>> sparse_table;
+};
+
+} // end GraphQueryEngine
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+class QueryControl;
+
+// Set the nice value of the calling thread, which Linux keeps per thread
+void SetThreadNice(int nice);
+
+/*
+ * Fixed size pool of compute threads running tasks in submission order.
+ * Keeps traversals off the completion queue thread of the server, so that
+ * requests waiting for a result do not hold a thread.
+ */
+class WorkerPool {
+  public:
+    /*
+     * @param num_threads, threads of the pool, at least one is started
+     * @param nice, nice value of the threads, positive values leave the
+     *        cores to other threads of the process while they need them
+     */
+    explicit WorkerPool(uint32_t num_threads, int nice = 0);
+    // Runs the tasks still queued and joins the threads
+    ~WorkerPool();
+
+    /*
+     * Queue a task for execution on one of the pool threads
+     * @param task, the work to run
+     */
+    void Submit(std::function<void()> task);
+
+    uint32_t NumThreads() const { return workers.size(); }
+
+  private:
+    void WorkerLoop(int nice);
+
+    // Mutex and condition variable guarding the task queue
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<std::function<void()>> tasks;
+    // Set once the pool is being destroyed
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+/*
+ * Team of threads running fork-join phases of a single data parallel
+ * computation, such as the buckets of delta-stepping. The calling thread
+ * takes part as member 0, the other members wait between phases. Members
+ * run a phase under the query control of the calling thread.
+ */
+class ThreadTeam {
+  public:
+    // @param nice, nice value of the members other than the calling thread
+    explicit ThreadTeam(uint32_t num_threads, int nice = 0);
+    ~ThreadTeam();
+
+    /*
+     * Run a phase on every member and wait until all of them are done
+     * @param task, invoked with the member index, 0 .. Size() - 1
+     */
+    void Run(const std::function<void(uint32_t)>& task);
+
+    uint32_t Size() const { return members.size() + 1; }
+
+  private:
+    void MemberLoop(uint32_t member, int nice);
+
+    // Mutex and condition variables guarding the phase state
+    std::mutex phase_mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    // Task of the current phase and the number of members still running it
+    const std::function<void(uint32_t)>* task = nullptr;
+    // Query control of the thread that started the current phase
+    QueryControl* control = nullptr;
+    uint64_t phase = 0;
+    uint32_t running = 0;
+    // Set once the team is being destroyed
+    bool stopping = false;
+    std::vector<std::thread> members;
+};
+
+} // end GraphQueryEngine
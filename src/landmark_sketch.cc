@@ -0,0 +1,187 @@
+#include "src/include/landmark_sketch.h"
+#include "src/include/binary_io.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <queue>
+
+namespace GraphQueryEngine {
+
+namespace {
+constexpr uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+
+// Hop distances from src to every node
+std::vector<uint32_t> Distances(const CsrAdjacency &adjacency, uint32_t src) {
+  std::vector<uint32_t> distance(adjacency.NumNodes(), kUnreachable);
+  std::queue<uint32_t> Q;
+  distance[src] = 0;
+  Q.push(src);
+  while (!Q.empty()) {
+    uint32_t x = Q.front();
+    Q.pop();
+    for (const uint32_t *it = adjacency.Begin(x); it != adjacency.End(x); ++it) {
+      if (distance[*it] != kUnreachable)
+        continue;
+      distance[*it] = distance[x] + 1;
+      Q.push(*it);
+    }
+  }
+  return distance;
+}
+} // namespace
+
+void LandmarkSketch::Build(const CsrAdjacency &adjacency,
+                           uint32_t num_landmarks) {
+  auto start = std::chrono::steady_clock::now();
+  landmarks.clear();
+  from_landmark.clear();
+  to_landmark.clear();
+  symmetric = adjacency.Symmetric();
+  uint32_t num_nodes = adjacency.NumNodes();
+  num_landmarks = std::min(num_landmarks, num_nodes);
+  if (num_landmarks == 0)
+    return;
+
+  // The adjacency of an undirected graph is its own reverse
+  CsrAdjacency transposed;
+  if (!symmetric)
+    transposed = adjacency.Transpose();
+  const CsrAdjacency &reverse = symmetric ? adjacency : transposed;
+
+  // Candidates by decreasing total degree, ties by node id
+  std::vector<uint32_t> candidates(num_nodes);
+  for (uint32_t u = 0; u < num_nodes; u++)
+    candidates[u] = u;
+  auto degree = [&](uint32_t u) {
+    return uint64_t(adjacency.Degree(u)) + reverse.Degree(u);
+  };
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [&](uint32_t a, uint32_t b) { return degree(a) > degree(b); });
+
+  // Nodes related to some landmark already, and landmarks already picked
+  std::vector<bool> covered(num_nodes, false);
+  std::vector<bool> picked(num_nodes, false);
+  size_t next_uncovered = 0;
+  size_t next_any = 0;
+  while (landmarks.size() < num_landmarks) {
+    while (next_uncovered < num_nodes && covered[candidates[next_uncovered]])
+      next_uncovered++;
+    uint32_t landmark;
+    if (next_uncovered < num_nodes) {
+      landmark = candidates[next_uncovered];
+    } else {
+      while (picked[candidates[next_any]])
+        next_any++;
+      landmark = candidates[next_any];
+    }
+    picked[landmark] = true;
+    landmarks.push_back(landmark);
+
+    std::vector<uint32_t> from = Distances(adjacency, landmark);
+    for (uint32_t u = 0; u < num_nodes; u++) {
+      if (from[u] != kUnreachable)
+        covered[u] = true;
+    }
+    from_landmark.emplace_back(from);
+    if (symmetric)
+      continue;
+    std::vector<uint32_t> to = Distances(reverse, landmark);
+    for (uint32_t u = 0; u < num_nodes; u++) {
+      if (to[u] != kUnreachable)
+        covered[u] = true;
+    }
+    to_landmark.emplace_back(to);
+  }
+
+  build_micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+}
+
+void LandmarkSketch::Bounds(uint32_t src, uint32_t dest, uint32_t *lower,
+                            uint32_t *upper) const {
+  if (src == dest) {
+    *lower = *upper = 0;
+    return;
+  }
+  uint32_t low = 1;
+  uint32_t high = kUnreachable;
+  for (size_t i = 0; i < landmarks.size(); i++) {
+    const DistanceArray &to = symmetric ? from_landmark[i] : to_landmark[i];
+    uint32_t from_src = from_landmark[i].Get(src);
+    uint32_t from_dest = from_landmark[i].Get(dest);
+    uint32_t src_to = to.Get(src);
+    uint32_t dest_to = to.Get(dest);
+
+    // A path src -> dest would extend the landmark's paths, so a landmark
+    // reaching src but not dest, or reached from dest but not from src,
+    // proves dest unreachable
+    if ((from_src != kUnreachable && from_dest == kUnreachable) ||
+        (dest_to != kUnreachable && src_to == kUnreachable)) {
+      *lower = *upper = kUnreachable;
+      return;
+    }
+
+    if (src_to != kUnreachable && from_dest != kUnreachable)
+      high = std::min<uint64_t>(high, uint64_t(src_to) + from_dest);
+    if (from_src != kUnreachable && from_dest > from_src)
+      low = std::max(low, from_dest - from_src);
+    if (dest_to != kUnreachable && src_to > dest_to)
+      low = std::max(low, src_to - dest_to);
+  }
+  *lower = low;
+  *upper = high;
+}
+
+uint32_t LandmarkSketch::Eccentricity() const {
+  uint32_t eccentricity = 0;
+  for (const DistanceArray &distances : from_landmark) {
+    for (uint32_t node = 0; node < distances.Size(); node++) {
+      uint32_t distance = distances.Get(node);
+      if (distance != kUnreachable)
+        eccentricity = std::max(eccentricity, distance);
+    }
+  }
+  return eccentricity;
+}
+
+size_t LandmarkSketch::Bytes() const {
+  size_t bytes = 0;
+  for (const DistanceArray &distances : from_landmark)
+    bytes += distances.Bytes();
+  for (const DistanceArray &distances : to_landmark)
+    bytes += distances.Bytes();
+  return bytes;
+}
+
+void LandmarkSketch::Save(std::ostream &out) const {
+  WriteVector(out, landmarks);
+  WriteValue<uint8_t>(out, symmetric);
+  WriteValue(out, build_micros);
+  for (const DistanceArray &distances : from_landmark)
+    distances.Save(out);
+  for (const DistanceArray &distances : to_landmark)
+    distances.Save(out);
+}
+
+bool LandmarkSketch::Load(std::istream &in) {
+  uint8_t stored_symmetric;
+  if (!ReadVector(in, &landmarks) || !ReadValue(in, &stored_symmetric) ||
+      !ReadValue(in, &build_micros))
+    return false;
+  symmetric = stored_symmetric != 0;
+  // Symmetric sketches keep no distances to the landmarks
+  from_landmark.assign(landmarks.size(), DistanceArray());
+  to_landmark.assign(symmetric ? 0 : landmarks.size(), DistanceArray());
+  for (DistanceArray &distances : from_landmark) {
+    if (!distances.Load(in))
+      return false;
+  }
+  for (DistanceArray &distances : to_landmark) {
+    if (!distances.Load(in))
+      return false;
+  }
+  return true;
+}
+
+} // namespace GraphQueryEngine
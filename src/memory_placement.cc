@@ -0,0 +1,130 @@
+#include "src/include/memory_placement.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace GraphQueryEngine {
+
+namespace {
+// Memory policies of the mbind system call, see mbind(2)
+constexpr int kPolicyBind = 2;
+constexpr int kPolicyInterleave = 3;
+constexpr unsigned kMoveFlag = 1 << 1;
+// madvise advice missing from older headers, synchronous collapse into
+// huge pages (Linux 6.1)
+constexpr int kAdviseCollapse = 25;
+// Node masks are a single word, more nodes are left out of placements
+constexpr uint32_t kMaxMemoryNodes = 64;
+constexpr uint64_t kHugePageBytes = 2 << 20;
+
+// Memory nodes online, from a list such as "0-1,4"
+uint64_t OnlineNodeMask() {
+  static const uint64_t mask = [] {
+    std::ifstream in("/sys/devices/system/node/online");
+    std::string list;
+    uint64_t nodes = 0;
+    if (!std::getline(in, list))
+      return uint64_t(1);
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+      size_t dash = range.find('-');
+      try {
+        uint32_t first = std::stoul(range.substr(0, dash));
+        uint32_t last = dash == std::string::npos
+                            ? first
+                            : std::stoul(range.substr(dash + 1));
+        for (uint32_t node = first; node <= last && node < kMaxMemoryNodes;
+             node++)
+          nodes |= uint64_t(1) << node;
+      } catch (...) {
+        return uint64_t(1);
+      }
+    }
+    return nodes == 0 ? uint64_t(1) : nodes;
+  }();
+  return mask;
+}
+
+void Bind(void *begin, uint64_t bytes, int policy, uint64_t nodes) {
+  unsigned long mask = nodes;
+  syscall(SYS_mbind, begin, bytes, policy, &mask, kMaxMemoryNodes + 1,
+          kMoveFlag);
+}
+} // namespace
+
+uint32_t NumMemoryNodes() { return __builtin_popcountll(OnlineNodeMask()); }
+
+uint32_t MemoryNodeIdLimit() {
+  return 64 - __builtin_clzll(OnlineNodeMask());
+}
+
+bool MemoryNodeOnline(uint32_t node) {
+  return node < kMaxMemoryNodes && (OnlineNodeMask() >> node & 1);
+}
+
+uint32_t CurrentMemoryNode() {
+  if (NumMemoryNodes() == 1)
+    return 0;
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    return 0;
+  return node;
+}
+
+void PlaceMemory(const void *data, uint64_t bytes, MemoryPlacement placement,
+                 bool huge_pages, uint32_t node) {
+  // Only whole pages of the array are placed, the ones at its ends may be
+  // shared with other allocations
+  uint64_t page = sysconf(_SC_PAGESIZE);
+  uint64_t address = reinterpret_cast<uint64_t>(data);
+  uint64_t begin = (address + page - 1) / page * page;
+  uint64_t end = (address + bytes) / page * page;
+  if (end <= begin)
+    return;
+  void *pages = reinterpret_cast<void *>(begin);
+
+  if (NumMemoryNodes() > 1 && placement == INTERLEAVE_PLACEMENT)
+    Bind(pages, end - begin, kPolicyInterleave, OnlineNodeMask());
+  if (NumMemoryNodes() > 1 && placement == REPLICATE_PLACEMENT &&
+      node < kMaxMemoryNodes)
+    Bind(pages, end - begin, kPolicyBind, uint64_t(1) << node);
+
+  // Huge pages need aligned 2MB ranges, collapsing right away spares
+  // waiting for the background collapse of the kernel
+  uint64_t huge_begin = (address + kHugePageBytes - 1) / kHugePageBytes *
+                        kHugePageBytes;
+  uint64_t huge_end = (address + bytes) / kHugePageBytes * kHugePageBytes;
+  if (huge_pages && huge_end > huge_begin) {
+    void *huge = reinterpret_cast<void *>(huge_begin);
+    madvise(huge, huge_end - huge_begin, MADV_HUGEPAGE);
+    madvise(huge, huge_end - huge_begin, kAdviseCollapse);
+  }
+}
+
+uint64_t HugePageBytes() {
+  std::ifstream in("/proc/self/smaps_rollup");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 14, "AnonHugePages:") == 0)
+      return std::stoull(line.substr(14)) << 10;
+  }
+  return 0;
+}
+
+const char *PlacementName(MemoryPlacement placement) {
+  switch (placement) {
+  case INTERLEAVE_PLACEMENT:
+    return "interleave";
+  case REPLICATE_PLACEMENT:
+    return "replicate";
+  default:
+    return "local";
+  }
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,220 @@
+#include "src/include/node_order.h"
+#include <algorithm>
+#include <queue>
+
+namespace GraphQueryEngine {
+
+namespace {
+// Number of most recently placed nodes Gorder scores candidates against
+constexpr uint32_t kGorderWindow = 5;
+// In-neighbors with more out-going edges are not used to score siblings,
+// a hub would make every placement touch a large part of the graph
+constexpr uint32_t kGorderHubDegree = 256;
+
+std::vector<uint32_t> RcmOrder(const CsrAdjacency &adjacency,
+                               const CsrAdjacency &reverse) {
+  uint32_t num_nodes = adjacency.NumNodes();
+  auto degree = [&](uint32_t u) {
+    return adjacency.Degree(u) + reverse.Degree(u);
+  };
+  std::vector<uint32_t> by_degree(num_nodes);
+  for (uint32_t u = 0; u < num_nodes; u++)
+    by_degree[u] = u;
+  std::stable_sort(by_degree.begin(), by_degree.end(),
+                   [&](uint32_t a, uint32_t b) { return degree(a) < degree(b); });
+
+  // BFS over the undirected view, every component from its lowest degree node
+  std::vector<uint32_t> order;
+  order.reserve(num_nodes);
+  std::vector<bool> visited(num_nodes, false);
+  std::vector<uint32_t> neighbors;
+  for (uint32_t start : by_degree) {
+    if (visited[start])
+      continue;
+    visited[start] = true;
+    size_t head = order.size();
+    order.push_back(start);
+    while (head < order.size()) {
+      uint32_t u = order[head++];
+      neighbors.clear();
+      for (const CsrAdjacency *side : {&adjacency, &reverse}) {
+        for (const uint32_t *it = side->Begin(u); it != side->End(u); ++it) {
+          if (!visited[*it]) {
+            visited[*it] = true;
+            neighbors.push_back(*it);
+          }
+        }
+      }
+      std::stable_sort(
+          neighbors.begin(), neighbors.end(),
+          [&](uint32_t a, uint32_t b) { return degree(a) < degree(b); });
+      order.insert(order.end(), neighbors.begin(), neighbors.end());
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+std::vector<uint32_t> DegreeOrder(const CsrAdjacency &adjacency,
+                                  const CsrAdjacency &reverse) {
+  uint32_t num_nodes = adjacency.NumNodes();
+  std::vector<uint32_t> order(num_nodes);
+  for (uint32_t u = 0; u < num_nodes; u++)
+    order[u] = u;
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return adjacency.Degree(a) + reverse.Degree(a) >
+           adjacency.Degree(b) + reverse.Degree(b);
+  });
+  return order;
+}
+
+/*
+ * Nodes bucketed by score in doubly linked lists, score changes by one and
+ * popping the highest score are O(1) amortized (the unit heap of Gorder)
+ */
+class UnitHeap {
+  public:
+    explicit UnitHeap(uint32_t num_nodes)
+      : score(num_nodes, 0), prev(num_nodes), next(num_nodes),
+        placed(num_nodes, false), heads(1, kNone) {
+      for (uint32_t u = num_nodes; u-- > 0;)
+        Link(u);
+    }
+
+    void Increment(uint32_t u) {
+      if (placed[u])
+        return;
+      Unlink(u);
+      score[u]++;
+      if (score[u] >= heads.size())
+        heads.push_back(kNone);
+      top = std::max(top, score[u]);
+      Link(u);
+    }
+
+    void Decrement(uint32_t u) {
+      if (placed[u] || score[u] == 0)
+        return;
+      Unlink(u);
+      score[u]--;
+      Link(u);
+    }
+
+    // Take a node out of the heap for good
+    void Remove(uint32_t u) {
+      Unlink(u);
+      placed[u] = true;
+    }
+
+    // Node of highest score, kNone once all nodes are placed
+    uint32_t Top() {
+      while (top > 0 && heads[top] == kNone)
+        top--;
+      return heads[top];
+    }
+
+    static constexpr uint32_t kNone = 0xffffffff;
+
+  private:
+    void Link(uint32_t u) {
+      prev[u] = kNone;
+      next[u] = heads[score[u]];
+      if (next[u] != kNone)
+        prev[next[u]] = u;
+      heads[score[u]] = u;
+    }
+    void Unlink(uint32_t u) {
+      if (prev[u] != kNone)
+        next[prev[u]] = next[u];
+      else
+        heads[score[u]] = next[u];
+      if (next[u] != kNone)
+        prev[next[u]] = prev[u];
+    }
+
+    std::vector<uint32_t> score;
+    std::vector<uint32_t> prev;
+    std::vector<uint32_t> next;
+    std::vector<bool> placed;
+    // First node of every score bucket
+    std::vector<uint32_t> heads;
+    // Highest score that may have a node
+    uint32_t top = 0;
+};
+
+constexpr uint32_t UnitHeap::kNone;
+
+std::vector<uint32_t> Gorder(const CsrAdjacency &adjacency,
+                             const CsrAdjacency &reverse) {
+  uint32_t num_nodes = adjacency.NumNodes();
+  UnitHeap heap(num_nodes);
+
+  // Score of a candidate: edges to or from window nodes plus in-neighbors
+  // shared with window nodes
+  auto update = [&](uint32_t u, bool enter) {
+    auto apply = [&](uint32_t v) {
+      if (enter)
+        heap.Increment(v);
+      else
+        heap.Decrement(v);
+    };
+    for (const uint32_t *it = adjacency.Begin(u); it != adjacency.End(u); ++it)
+      apply(*it);
+    for (const uint32_t *it = reverse.Begin(u); it != reverse.End(u); ++it) {
+      apply(*it);
+      if (adjacency.Degree(*it) > kGorderHubDegree)
+        continue;
+      for (const uint32_t *sibling = adjacency.Begin(*it);
+           sibling != adjacency.End(*it); ++sibling) {
+        if (*sibling != u)
+          apply(*sibling);
+      }
+    }
+  };
+
+  std::vector<uint32_t> order;
+  order.reserve(num_nodes);
+  // Start from the node with most in-going edges
+  uint32_t start = 0;
+  for (uint32_t u = 1; u < num_nodes; u++) {
+    if (reverse.Degree(u) > reverse.Degree(start))
+      start = u;
+  }
+  for (uint32_t u = num_nodes == 0 ? UnitHeap::kNone : start;
+       u != UnitHeap::kNone; u = heap.Top()) {
+    heap.Remove(u);
+    order.push_back(u);
+    update(u, true);
+    if (order.size() > kGorderWindow)
+      update(order[order.size() - kGorderWindow - 1], false);
+  }
+  return order;
+}
+} // namespace
+
+NodePermutation ComputeNodeOrder(const CsrAdjacency &adjacency,
+                                 NodeOrder order) {
+  NodePermutation permutation;
+  if (order == ORIGINAL_ORDER)
+    return permutation;
+
+  // The adjacency of an undirected graph is its own reverse
+  CsrAdjacency transposed;
+  if (!adjacency.Symmetric())
+    transposed = adjacency.Transpose();
+  const CsrAdjacency &reverse =
+      adjacency.Symmetric() ? adjacency : transposed;
+  if (order == RCM_ORDER)
+    permutation.to_external = RcmOrder(adjacency, reverse);
+  else if (order == DEGREE_ORDER)
+    permutation.to_external = DegreeOrder(adjacency, reverse);
+  else
+    permutation.to_external = Gorder(adjacency, reverse);
+
+  permutation.to_internal.resize(permutation.to_external.size());
+  for (uint32_t i = 0; i < permutation.to_external.size(); i++)
+    permutation.to_internal[permutation.to_external[i]] = i;
+  return permutation;
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,149 @@
+#include "src/include/property_columns.h"
+#include "src/include/binary_io.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace GraphQueryEngine {
+
+constexpr uint32_t PropertyColumn::kMaxBitmaps;
+
+void Bitmap::Or(const Bitmap &other) {
+  uint64_t *out = words.data();
+  const uint64_t *in = other.words.data();
+  for (size_t i = 0; i < words.size(); i++)
+    out[i] |= in[i];
+}
+
+void Bitmap::Flip() {
+  for (uint64_t &word : words)
+    word = ~word;
+  if (num_rows % 64 != 0)
+    words.back() &= ~(~uint64_t(0) << (num_rows % 64));
+}
+
+uint64_t Bitmap::Count() const {
+  uint64_t count = 0;
+  for (uint64_t word : words)
+    count += __builtin_popcountll(word);
+  return count;
+}
+
+void Bitmap::Place(MemoryPlacement placement, bool huge_pages,
+                   uint32_t node) const {
+  PlaceMemory(words.data(), Bytes(), placement, huge_pages, node);
+}
+
+void Bitmap::Save(std::ostream &out) const {
+  WriteValue(out, num_rows);
+  WriteVector(out, words);
+}
+
+bool Bitmap::Load(std::istream &in) {
+  return ReadValue(in, &num_rows) && ReadVector(in, &words);
+}
+
+PropertyColumn::PropertyColumn(const std::vector<uint32_t> &row_values)
+    : num_rows(row_values.size()), values(row_values) {
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  if (values.size() > std::numeric_limits<uint16_t>::max())
+    width = sizeof(uint32_t);
+  else if (values.size() > std::numeric_limits<uint8_t>::max())
+    width = sizeof(uint16_t);
+
+  codes.resize(num_rows * width);
+  if (values.size() <= kMaxBitmaps)
+    bitmaps.assign(values.size(), Bitmap(num_rows));
+  for (uint64_t row = 0; row < num_rows; row++) {
+    uint32_t code = std::lower_bound(values.begin(), values.end(),
+                                     row_values[row]) -
+                    values.begin();
+    std::memcpy(&codes[row * width], &code, width);
+    if (!bitmaps.empty())
+      bitmaps[code].Set(row);
+  }
+}
+
+uint32_t PropertyColumn::Code(uint64_t row) const {
+  if (width == sizeof(uint8_t))
+    return codes[row];
+  uint32_t code = 0;
+  std::memcpy(&code, &codes[row * width], width);
+  return code;
+}
+
+uint32_t PropertyColumn::Get(uint64_t row) const { return values[Code(row)]; }
+
+std::vector<uint32_t> PropertyColumn::Decode() const {
+  std::vector<uint32_t> row_values(num_rows);
+  for (uint64_t row = 0; row < num_rows; row++)
+    row_values[row] = Get(row);
+  return row_values;
+}
+
+Bitmap PropertyColumn::Select(const std::vector<uint32_t> &selected,
+                              bool exclude) const {
+  std::vector<bool> chosen(values.size(), false);
+  for (uint32_t value : selected) {
+    auto it = std::lower_bound(values.begin(), values.end(), value);
+    if (it != values.end() && *it == value)
+      chosen[it - values.begin()] = true;
+  }
+
+  Bitmap rows(num_rows);
+  if (Indexed()) {
+    for (uint32_t code = 0; code < values.size(); code++) {
+      if (chosen[code])
+        rows.Or(bitmaps[code]);
+    }
+  } else {
+    for (uint64_t row = 0; row < num_rows; row++) {
+      if (chosen[Code(row)])
+        rows.Set(row);
+    }
+  }
+  if (exclude)
+    rows.Flip();
+  return rows;
+}
+
+size_t PropertyColumn::Bytes() const {
+  size_t bytes = codes.size() + values.size() * sizeof(uint32_t);
+  for (const Bitmap &bitmap : bitmaps)
+    bytes += bitmap.Bytes();
+  return bytes;
+}
+
+void PropertyColumn::Place(MemoryPlacement placement, bool huge_pages,
+                           uint32_t node) const {
+  PlaceMemory(codes.data(), codes.size(), placement, huge_pages, node);
+  for (const Bitmap &bitmap : bitmaps)
+    bitmap.Place(placement, huge_pages, node);
+}
+
+void PropertyColumn::Save(std::ostream &out) const {
+  WriteValue(out, num_rows);
+  WriteValue(out, width);
+  WriteVector(out, codes);
+  WriteVector(out, values);
+  WriteValue<uint64_t>(out, bitmaps.size());
+  for (const Bitmap &bitmap : bitmaps)
+    bitmap.Save(out);
+}
+
+bool PropertyColumn::Load(std::istream &in) {
+  uint64_t num_bitmaps;
+  if (!ReadValue(in, &num_rows) || !ReadValue(in, &width) ||
+      !ReadVector(in, &codes) || !ReadVector(in, &values) ||
+      !ReadValue(in, &num_bitmaps))
+    return false;
+  bitmaps.assign(num_bitmaps, Bitmap());
+  for (Bitmap &bitmap : bitmaps) {
+    if (!bitmap.Load(in))
+      return false;
+  }
+  return true;
+}
+
+} // namespace GraphQueryEngine
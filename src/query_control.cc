@@ -0,0 +1,54 @@
+#include "src/include/query_control.h"
+#include <algorithm>
+
+namespace GraphQueryEngine {
+
+namespace {
+thread_local QueryControl *current_control = nullptr;
+} // namespace
+
+constexpr uint32_t QueryCheckpoint::kCheckInterval;
+
+QueryStop QueryControl::Check() {
+  QueryStop reason = stop.load(std::memory_order_relaxed);
+  if (reason != QUERY_RUNNING)
+    return reason;
+  if (cancelled.load(std::memory_order_relaxed))
+    reason = QUERY_CANCELLED;
+  else if (has_deadline && Clock::now() >= deadline)
+    reason = QUERY_DEADLINE_EXCEEDED;
+  else
+    return QUERY_RUNNING;
+
+  QueryStop running = QUERY_RUNNING;
+  if (!stop.compare_exchange_strong(running, reason))
+    return running;
+  return reason;
+}
+
+void QueryControl::RecordStop(uint64_t expanded, uint64_t unexpanded) {
+  stopped_traversals++;
+  expanded_nodes += expanded;
+  unexpanded_nodes += unexpanded;
+}
+
+QueryControl *QueryControl::Current() { return current_control; }
+
+ScopedQueryControl::ScopedQueryControl(QueryControl *control)
+    : previous(current_control) {
+  current_control = control;
+}
+
+ScopedQueryControl::~ScopedQueryControl() { current_control = previous; }
+
+bool QueryCheckpoint::Poll() {
+  if (control->Check() == QUERY_RUNNING) {
+    next_check = expanded + kCheckInterval;
+    return false;
+  }
+  stopped = true;
+  control->RecordStop(expanded, total - std::min(total, expanded));
+  return true;
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,190 @@
+#include "src/include/query_planner.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+namespace GraphQueryEngine {
+
+namespace {
+// Nodes the growth profile is sampled from
+constexpr uint32_t kProfileSamples = 8;
+// Neighborhood size at which a sample stops growing
+constexpr uint32_t kProfileNodes = 1 << 14;
+
+/*
+ * Nodes within every number of hops of src, until the neighborhood reached
+ * kProfileNodes or the profile depth
+ * @param capped, set if the neighborhood was still growing at the end
+ */
+std::vector<uint32_t> BallSizes(const CsrAdjacency &adjacency, uint32_t src,
+                                bool *capped) {
+  std::unordered_set<uint32_t> visited{src};
+  std::vector<uint32_t> frontier(1, src);
+  std::vector<uint32_t> next_frontier;
+  std::vector<uint32_t> sizes(1, 1);
+  while (!frontier.empty() && visited.size() < kProfileNodes &&
+         sizes.size() < kProfileDepths) {
+    next_frontier.clear();
+    for (uint32_t x : frontier) {
+      for (const uint32_t *it = adjacency.Begin(x); it != adjacency.End(x);
+           ++it) {
+        if (visited.insert(*it).second)
+          next_frontier.push_back(*it);
+      }
+    }
+    frontier.swap(next_frontier);
+    sizes.push_back(visited.size());
+  }
+  *capped = !frontier.empty();
+  return sizes;
+}
+} // namespace
+
+constexpr double QueryPlanner::kArrayNodeCost;
+constexpr double QueryPlanner::kHashNodeCost;
+constexpr double QueryPlanner::kDagPruning;
+
+GraphStatistics CollectStatistics(const CsrAdjacency &adjacency,
+                                  const ReachabilityIndex &reachability_index,
+                                  const LandmarkSketch &landmark_sketch) {
+  GraphStatistics statistics;
+  statistics.num_nodes = adjacency.NumNodes();
+  statistics.num_edges = adjacency.NumEdges();
+  statistics.average_degree =
+      double(statistics.num_edges) / std::max(1u, statistics.num_nodes);
+  for (uint32_t node = 0; node < statistics.num_nodes; node++)
+    statistics.max_degree =
+        std::max(statistics.max_degree, adjacency.Degree(node));
+  statistics.diameter_estimate = landmark_sketch.Eccentricity();
+
+  statistics.num_components = reachability_index.NumComponents();
+  std::vector<uint32_t> sizes(statistics.num_components, 0);
+  for (uint32_t node = 0; node < statistics.num_nodes; node++) {
+    uint32_t size = ++sizes[reachability_index.Component(node)];
+    statistics.largest_component = std::max(statistics.largest_component, size);
+  }
+
+  // The profile ends where the first sample stopped growing, samples that
+  // ran out of nodes keep their size at every further depth
+  if (statistics.num_nodes == 0)
+    return statistics;
+  std::mt19937 rng(statistics.num_nodes);
+  std::vector<std::vector<uint32_t>> samples;
+  uint32_t depth = kProfileDepths - 1;
+  for (uint32_t i = 0; i < kProfileSamples; i++) {
+    bool capped = false;
+    samples.push_back(
+        BallSizes(adjacency, rng() % statistics.num_nodes, &capped));
+    if (capped)
+      depth = std::min<uint32_t>(depth, samples.back().size() - 1);
+  }
+  statistics.profile_depth = depth;
+  for (uint32_t hops = 0; hops <= depth; hops++) {
+    double sum = 0;
+    for (const std::vector<uint32_t> &sample : samples)
+      sum += sample[std::min<size_t>(hops, sample.size() - 1)];
+    statistics.ball_sizes[hops] = sum / samples.size();
+  }
+  return statistics;
+}
+
+const char *PlanName(QueryPlan plan) {
+  switch (plan) {
+  case SAME_NODE_PLAN:
+    return "same_node";
+  case FOREST_PLAN:
+    return "forest";
+  case REACHABILITY_PLAN:
+    return "reachability";
+  case CACHED_PLAN:
+    return "cached";
+  case LANDMARK_PLAN:
+    return "landmark";
+  case CACHE_FILL_PLAN:
+    return "cache_fill";
+  case BOUNDED_BFS_PLAN:
+    return "bounded_bfs";
+  case DAG_BFS_PLAN:
+    return "dag_bfs";
+  case BIDIRECTIONAL_BFS_PLAN:
+    return "bidirectional_bfs";
+  default:
+    return "bfs";
+  }
+}
+
+double QueryPlanner::BallSize(const GraphStatistics &statistics, double hops,
+                              bool symmetric) {
+  // Undirected graphs only reach the nodes of one component
+  double reachable = symmetric && statistics.largest_component > 0
+                         ? statistics.largest_component
+                         : statistics.num_nodes;
+  // Interpolated within the profile. Past it small world graphs keep
+  // growing by about the degree at every hop, graphs with a long diameter
+  // such as road networks by a rate close to 1.
+  const float *sizes = statistics.ball_sizes;
+  uint32_t depth = statistics.profile_depth;
+  double ball;
+  if (hops <= depth) {
+    uint32_t below = uint32_t(hops);
+    uint32_t above = std::min(below + 1, depth);
+    ball = sizes[below] + (hops - below) * (sizes[above] - sizes[below]);
+  } else if (depth == 0) {
+    ball = 1;
+  } else {
+    double rate = sizes[depth] / std::max(1.0f, sizes[depth - 1]);
+    ball = sizes[depth] * std::pow(rate, hops - depth);
+  }
+  return std::max(1.0, std::min(ball, reachable));
+}
+
+PlanChoice QueryPlanner::Choose(const GraphStatistics &statistics,
+                                const TraversalQuery &query) {
+  const uint32_t kUnknown = std::numeric_limits<uint32_t>::max();
+  double node_cost = 1 + statistics.average_degree;
+
+  // Expected distance, from the landmark bounds if there are any. Either
+  // traversal stops once it reaches the destination or the hop limit.
+  double distance;
+  if (query.upper != kUnknown) {
+    distance = (double(query.lower) + query.upper) / 2;
+  } else if (statistics.diameter_estimate > 0) {
+    distance = statistics.diameter_estimate / 2.0;
+  } else {
+    distance = std::log(std::max(2u, statistics.num_nodes)) /
+               std::log(std::max(2.0, statistics.average_degree));
+  }
+  if (query.max_hops != 0)
+    distance = std::min(distance, double(query.max_hops));
+  double explored = BallSize(statistics, distance, query.symmetric) * node_cost;
+  double arrays = statistics.num_nodes * kArrayNodeCost;
+
+  PlanChoice choice;
+  if (query.symmetric) {
+    choice.plan = BIDIRECTIONAL_BFS_PLAN;
+    choice.cost =
+        arrays + 2 * BallSize(statistics, distance / 2, true) * node_cost;
+  } else if (query.dag) {
+    choice.plan = DAG_BFS_PLAN;
+    choice.cost = arrays + explored * kDagPruning;
+  } else {
+    choice.plan = BFS_PLAN;
+    choice.cost = arrays + explored;
+  }
+
+  // The bounded traversal needs a depth to stop at, the hop limit or the
+  // upper bound of the distance
+  uint32_t max_hops = query.max_hops != 0 ? query.max_hops : kUnknown;
+  max_hops = std::min(max_hops, query.upper);
+  if (max_hops != kUnknown && explored * kHashNodeCost < choice.cost) {
+    choice.plan = BOUNDED_BFS_PLAN;
+    choice.cost = explored * kHashNodeCost;
+    choice.max_hops = max_hops;
+  }
+  return choice;
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,210 @@
+#include "src/include/reachability.h"
+#include "src/include/binary_io.h"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <utility>
+
+namespace GraphQueryEngine {
+
+namespace {
+// Marker for nodes not yet discovered by Tarjan's traversal
+constexpr uint32_t kUnvisited = std::numeric_limits<uint32_t>::max();
+// Fixed seed so that labels are reproducible across server runs
+constexpr uint32_t kLabelSeed = 0x5eed;
+} // namespace
+
+void ReachabilityIndex::Build(const CsrAdjacency &adjacency) {
+  BuildComponents(adjacency);
+  BuildCondensedDag(adjacency);
+  BuildIntervalLabels();
+}
+
+void ReachabilityIndex::BuildComponents(const CsrAdjacency &adjacency) {
+  uint32_t num_nodes = adjacency.NumNodes();
+  component.assign(num_nodes, kUnvisited);
+  num_components = 0;
+
+  // Iterative Tarjan, recursion would overflow the stack on long paths
+  std::vector<uint32_t> index(num_nodes, kUnvisited);
+  std::vector<uint32_t> lowlink(num_nodes, 0);
+  std::vector<bool> on_stack(num_nodes, false);
+  std::vector<uint32_t> scc_stack;
+  // Call stack of (node, position of next out-going edge to explore)
+  std::vector<std::pair<uint32_t, uint32_t>> call_stack;
+  uint32_t counter = 0;
+
+  for (uint32_t root = 0; root < num_nodes; root++) {
+    if (index[root] != kUnvisited)
+      continue;
+
+    index[root] = lowlink[root] = counter++;
+    scc_stack.push_back(root);
+    on_stack[root] = true;
+    call_stack.push_back(std::make_pair(root, 0));
+
+    while (!call_stack.empty()) {
+      uint32_t u = call_stack.back().first;
+      uint32_t next = call_stack.back().second;
+
+      if (next < adjacency.Degree(u)) {
+        call_stack.back().second++;
+        uint32_t v = adjacency.Begin(u)[next];
+        if (index[v] == kUnvisited) {
+          index[v] = lowlink[v] = counter++;
+          scc_stack.push_back(v);
+          on_stack[v] = true;
+          call_stack.push_back(std::make_pair(v, 0));
+        } else if (on_stack[v]) {
+          lowlink[u] = std::min(lowlink[u], index[v]);
+        }
+        continue;
+      }
+
+      // All edges of u explored, propagate lowlink to the caller
+      call_stack.pop_back();
+      if (!call_stack.empty()) {
+        uint32_t parent = call_stack.back().first;
+        lowlink[parent] = std::min(lowlink[parent], lowlink[u]);
+      }
+
+      // u is the root of a component, pop it off the stack
+      if (lowlink[u] == index[u]) {
+        uint32_t w;
+        do {
+          w = scc_stack.back();
+          scc_stack.pop_back();
+          on_stack[w] = false;
+          component[w] = num_components;
+        } while (w != u);
+        num_components++;
+      }
+    }
+  }
+}
+
+void ReachabilityIndex::BuildCondensedDag(const CsrAdjacency &adjacency) {
+  // Collect inter-component edges grouped by source component
+  std::vector<std::vector<uint32_t>> dag(num_components);
+  for (uint32_t u = 0; u < adjacency.NumNodes(); u++) {
+    for (const uint32_t *it = adjacency.Begin(u); it != adjacency.End(u); ++it) {
+      if (component[u] != component[*it])
+        dag[component[u]].push_back(component[*it]);
+    }
+  }
+
+  dag_offsets.assign(num_components + 1, 0);
+  dag_targets.clear();
+  for (uint32_t c = 0; c < num_components; c++) {
+    std::sort(dag[c].begin(), dag[c].end());
+    dag[c].erase(std::unique(dag[c].begin(), dag[c].end()), dag[c].end());
+    dag_targets.insert(dag_targets.end(), dag[c].begin(), dag[c].end());
+    dag_offsets[c + 1] = dag_targets.size();
+  }
+}
+
+void ReachabilityIndex::BuildIntervalLabels() {
+  label_low.assign(num_components * kNumIntervalLabels, 0);
+  label_post.assign(num_components * kNumIntervalLabels, 0);
+
+  // Traversals start from the sources of the condensed DAG
+  std::vector<bool> has_parent(num_components, false);
+  for (uint32_t target : dag_targets)
+    has_parent[target] = true;
+  std::vector<uint32_t> roots;
+  for (uint32_t c = 0; c < num_components; c++) {
+    if (!has_parent[c])
+      roots.push_back(c);
+  }
+
+  std::mt19937 rng(kLabelSeed);
+  std::vector<uint32_t> children;
+  std::vector<bool> visited;
+  std::vector<std::pair<uint32_t, uint32_t>> call_stack;
+
+  for (uint32_t t = 0; t < kNumIntervalLabels; t++) {
+    // Every traversal after the first visits roots and children in a
+    // different random order, which is what makes the labels complementary
+    children = dag_targets;
+    if (t > 0) {
+      std::shuffle(roots.begin(), roots.end(), rng);
+      for (uint32_t c = 0; c < num_components; c++) {
+        std::shuffle(children.begin() + dag_offsets[c],
+                     children.begin() + dag_offsets[c + 1], rng);
+      }
+    }
+
+    visited.assign(num_components, false);
+    uint32_t rank = 0;
+    for (uint32_t root : roots) {
+      visited[root] = true;
+      call_stack.push_back(std::make_pair(root, dag_offsets[root]));
+
+      while (!call_stack.empty()) {
+        uint32_t c = call_stack.back().first;
+        uint32_t next = call_stack.back().second;
+
+        if (next < dag_offsets[c + 1]) {
+          call_stack.back().second++;
+          uint32_t child = children[next];
+          if (!visited[child]) {
+            visited[child] = true;
+            call_stack.push_back(std::make_pair(child, dag_offsets[child]));
+          }
+          continue;
+        }
+
+        // Post-order: the interval spans the lowest rank of all descendants
+        call_stack.pop_back();
+        uint32_t post = rank++;
+        uint32_t low = post;
+        for (uint32_t i = dag_offsets[c]; i < dag_offsets[c + 1]; i++)
+          low = std::min(low, label_low[children[i] * kNumIntervalLabels + t]);
+        label_low[c * kNumIntervalLabels + t] = low;
+        label_post[c * kNumIntervalLabels + t] = post;
+      }
+    }
+  }
+}
+
+bool ReachabilityIndex::MayReach(uint32_t src, uint32_t dest) const {
+  uint32_t src_comp = component[src];
+  uint32_t dest_comp = component[dest];
+  if (src_comp == dest_comp)
+    return true;
+
+  // Inter-component edges only go from higher to lower component ids
+  if (src_comp < dest_comp)
+    return false;
+
+  for (uint32_t t = 0; t < kNumIntervalLabels; t++) {
+    uint32_t s = src_comp * kNumIntervalLabels + t;
+    uint32_t d = dest_comp * kNumIntervalLabels + t;
+    if (label_low[d] < label_low[s] || label_post[d] > label_post[s])
+      return false;
+  }
+  return true;
+}
+
+uint64_t ReachabilityIndex::Bytes() const {
+  return (component.size() + dag_offsets.size() + dag_targets.size() +
+          label_low.size() + label_post.size()) *
+         sizeof(uint32_t);
+}
+
+void ReachabilityIndex::Save(std::ostream &out) const {
+  WriteValue(out, num_components);
+  WriteVector(out, component);
+  WriteVector(out, dag_offsets);
+  WriteVector(out, dag_targets);
+  WriteVector(out, label_low);
+  WriteVector(out, label_post);
+}
+
+bool ReachabilityIndex::Load(std::istream &in) {
+  return ReadValue(in, &num_components) && ReadVector(in, &component) &&
+         ReadVector(in, &dag_offsets) && ReadVector(in, &dag_targets) &&
+         ReadVector(in, &label_low) && ReadVector(in, &label_post);
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,210 @@
+#include "src/include/structure_index.h"
+#include "src/include/binary_io.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace GraphQueryEngine {
+
+void StructureIndex::Build(const CsrAdjacency &adjacency,
+                           const ReachabilityIndex &reachability_index) {
+  uint32_t num_nodes = adjacency.NumNodes();
+  structure = GENERAL_GRAPH;
+  depth.clear();
+  tree_root.clear();
+  first_visit.clear();
+  sparse_table.clear();
+
+  // Duplicate edges and self-loops do not change hop distances, classify
+  // on the distinct neighbors of every node
+  std::vector<std::vector<uint32_t>> neighbors(num_nodes);
+  for (uint32_t u = 0; u < num_nodes; u++) {
+    for (const uint32_t *it = adjacency.Begin(u); it != adjacency.End(u); ++it) {
+      if (*it != u)
+        neighbors[u].push_back(*it);
+    }
+    std::sort(neighbors[u].begin(), neighbors[u].end());
+    neighbors[u].erase(std::unique(neighbors[u].begin(), neighbors[u].end()),
+                       neighbors[u].end());
+  }
+
+  // Only singleton components means there is no cycle
+  if (reachability_index.NumComponents() == num_nodes) {
+    std::vector<uint32_t> in_degree(num_nodes, 0);
+    bool single_parent = true;
+    for (uint32_t u = 0; u < num_nodes && single_parent; u++) {
+      for (uint32_t v : neighbors[u]) {
+        if (++in_degree[v] > 1) {
+          single_parent = false;
+          break;
+        }
+      }
+    }
+    if (!single_parent) {
+      structure = DAG;
+      return;
+    }
+
+    std::vector<uint32_t> roots;
+    for (uint32_t u = 0; u < num_nodes; u++) {
+      if (in_degree[u] == 0)
+        roots.push_back(u);
+    }
+    BuildForest(neighbors, roots);
+    structure = DIRECTED_FOREST;
+    return;
+  }
+
+  // Undirected forests are posted with both directions of every edge
+  uint64_t num_edges = 0;
+  for (uint32_t u = 0; u < num_nodes; u++) {
+    for (uint32_t v : neighbors[u]) {
+      if (!std::binary_search(neighbors[v].begin(), neighbors[v].end(), u))
+        return;
+      num_edges++;
+    }
+  }
+
+  // Root every tree at its lowest node and orient edges away from the root
+  std::vector<std::vector<uint32_t>> children(num_nodes);
+  std::vector<uint32_t> roots;
+  std::vector<bool> visited(num_nodes, false);
+  std::vector<uint32_t> stack;
+  for (uint32_t root = 0; root < num_nodes; root++) {
+    if (visited[root])
+      continue;
+    roots.push_back(root);
+    visited[root] = true;
+    stack.push_back(root);
+    while (!stack.empty()) {
+      uint32_t u = stack.back();
+      stack.pop_back();
+      for (uint32_t v : neighbors[u]) {
+        if (visited[v])
+          continue;
+        visited[v] = true;
+        children[u].push_back(v);
+        stack.push_back(v);
+      }
+    }
+  }
+
+  // A spanning forest uses every undirected edge only if there is no cycle
+  if (num_edges != 2 * (uint64_t(num_nodes) - roots.size()))
+    return;
+
+  BuildForest(children, roots);
+  structure = UNDIRECTED_FOREST;
+}
+
+void StructureIndex::BuildForest(
+    const std::vector<std::vector<uint32_t>> &children,
+    const std::vector<uint32_t> &roots) {
+  uint32_t num_nodes = children.size();
+  depth.assign(num_nodes, 0);
+  tree_root.assign(num_nodes, 0);
+  first_visit.assign(num_nodes, 0);
+
+  // Euler tour, every node is recorded on entry and after each child
+  std::vector<uint32_t> euler;
+  euler.reserve(2 * num_nodes);
+  std::vector<std::pair<uint32_t, uint32_t>> call_stack;
+  for (uint32_t root : roots) {
+    tree_root[root] = root;
+    first_visit[root] = euler.size();
+    euler.push_back(root);
+    call_stack.push_back(std::make_pair(root, 0));
+
+    while (!call_stack.empty()) {
+      uint32_t u = call_stack.back().first;
+      uint32_t next = call_stack.back().second;
+      if (next < children[u].size()) {
+        call_stack.back().second++;
+        uint32_t v = children[u][next];
+        depth[v] = depth[u] + 1;
+        tree_root[v] = root;
+        first_visit[v] = euler.size();
+        euler.push_back(v);
+        call_stack.push_back(std::make_pair(v, 0));
+      } else {
+        call_stack.pop_back();
+        if (!call_stack.empty())
+          euler.push_back(call_stack.back().first);
+      }
+    }
+  }
+
+  // Sparse table of minimum depth nodes over windows of the tour
+  size_t tour_length = euler.size();
+  sparse_table.push_back(std::move(euler));
+  for (uint32_t j = 1; (size_t(1) << j) <= tour_length; j++) {
+    const std::vector<uint32_t> &prev = sparse_table[j - 1];
+    size_t half = size_t(1) << (j - 1);
+    std::vector<uint32_t> level(tour_length - (size_t(1) << j) + 1);
+    for (size_t i = 0; i < level.size(); i++) {
+      uint32_t a = prev[i];
+      uint32_t b = prev[i + half];
+      level[i] = depth[a] <= depth[b] ? a : b;
+    }
+    sparse_table.push_back(std::move(level));
+  }
+}
+
+uint32_t StructureIndex::Lca(uint32_t u, uint32_t v) const {
+  uint32_t left = first_visit[u];
+  uint32_t right = first_visit[v];
+  if (left > right)
+    std::swap(left, right);
+  uint32_t level = 31 - __builtin_clz(right - left + 1);
+  uint32_t a = sparse_table[level][left];
+  uint32_t b = sparse_table[level][right - (1u << level) + 1];
+  return depth[a] <= depth[b] ? a : b;
+}
+
+uint32_t StructureIndex::ForestDistance(uint32_t src, uint32_t dest) const {
+  if (tree_root[src] != tree_root[dest])
+    return std::numeric_limits<uint32_t>::max();
+
+  uint32_t lca = Lca(src, dest);
+  if (structure == DIRECTED_FOREST) {
+    // Edges point away from the root, dest must be below src
+    if (lca != src)
+      return std::numeric_limits<uint32_t>::max();
+    return depth[dest] - depth[src];
+  }
+  return depth[src] + depth[dest] - 2 * depth[lca];
+}
+
+uint64_t StructureIndex::Bytes() const {
+  uint64_t entries = depth.size() + tree_root.size() + first_visit.size();
+  for (const std::vector<uint32_t> &level : sparse_table)
+    entries += level.size();
+  return entries * sizeof(uint32_t);
+}
+
+void StructureIndex::Save(std::ostream &out) const {
+  WriteValue<uint32_t>(out, structure);
+  WriteVector(out, depth);
+  WriteVector(out, tree_root);
+  WriteVector(out, first_visit);
+  WriteValue<uint32_t>(out, sparse_table.size());
+  for (const std::vector<uint32_t> &level : sparse_table)
+    WriteVector(out, level);
+}
+
+bool StructureIndex::Load(std::istream &in) {
+  uint32_t stored_structure, levels;
+  if (!ReadValue(in, &stored_structure) || !ReadVector(in, &depth) ||
+      !ReadVector(in, &tree_root) || !ReadVector(in, &first_visit) ||
+      !ReadValue(in, &levels))
+    return false;
+  structure = GraphStructure(stored_structure);
+  sparse_table.resize(levels);
+  for (std::vector<uint32_t> &level : sparse_table) {
+    if (!ReadVector(in, &level))
+      return false;
+  }
+  return true;
+}
+
+} // namespace GraphQueryEngine
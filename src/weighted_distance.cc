@@ -0,0 +1,230 @@
+#include "src/include/graph.h"
+#include "src/include/radix_heap.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <queue>
+#include <type_traits>
+
+namespace GraphQueryEngine {
+
+namespace {
+// Weights of the out-going edges of a node, picked by the weight type
+const uint32_t *NodeWeights(const CsrAdjacency &adjacency, uint32_t node,
+                            uint32_t) {
+  return adjacency.IntegerWeights(node);
+}
+const float *NodeWeights(const CsrAdjacency &adjacency, uint32_t node, float) {
+  return adjacency.FloatWeights(node);
+}
+
+// Lower an atomic distance, true if this call lowered it
+template <typename Distance>
+bool RelaxAtomic(std::atomic<Distance> &distance, Distance candidate) {
+  Distance current = distance.load(std::memory_order_relaxed);
+  while (candidate < current) {
+    if (distance.compare_exchange_weak(current, candidate,
+                                       std::memory_order_relaxed))
+      return true;
+  }
+  return false;
+}
+} // namespace
+
+template <typename Weight, typename Visit>
+void GraphVersion::ForEachWeightedNeighbor(uint32_t node, Visit visit) const {
+  // Weighted graphs take no inserted edges, only removals are merged in
+  bool removals = delta.HasRemovals(node);
+  const Weight *weights = NodeWeights(*adjacency, node, Weight());
+  adjacency->ForEachNeighbor(node, [&](uint32_t next) {
+    Weight weight = *weights++;
+    if (!removals || !delta.Removed(node, next))
+      visit(next, weight);
+    return true;
+  });
+}
+
+double GraphVersion::WeightedDistance(uint32_t src, uint32_t dest,
+                                      ThreadTeam *team) const {
+  if (!MayReach(src, dest))
+    return std::numeric_limits<double>::infinity();
+  if (Weights() == INTEGER_WEIGHTS) {
+    if (team != nullptr)
+      return DeltaStepping<uint32_t>(src, dest, *team);
+    uint64_t distance = IntegerDijkstra(src, dest);
+    return distance == std::numeric_limits<uint64_t>::max()
+               ? std::numeric_limits<double>::infinity()
+               : double(distance);
+  }
+  if (team != nullptr)
+    return DeltaStepping<float>(src, dest, *team);
+  return FloatDijkstra(src, dest);
+}
+
+uint64_t GraphVersion::IntegerDijkstra(uint32_t src, uint32_t dest) const {
+  std::vector<uint64_t> distance(NumNodes(),
+                                 std::numeric_limits<uint64_t>::max());
+  RadixHeap<uint32_t> heap;
+  distance[src] = 0;
+  heap.Push(0, src);
+  QueryCheckpoint checkpoint(NumNodes());
+  while (!heap.Empty()) {
+    std::pair<uint64_t, uint32_t> top = heap.Pop();
+    if (top.first != distance[top.second])
+      continue;
+    // Distances are final once a node is popped, stop at dest. A stopped
+    // query discards the distance.
+    if (top.second == dest || checkpoint.Stop())
+      break;
+    ForEachWeightedNeighbor<uint32_t>(
+        top.second, [&](uint32_t next, uint32_t weight) {
+          uint64_t candidate = top.first + weight;
+          if (candidate < distance[next]) {
+            distance[next] = candidate;
+            heap.Push(candidate, next);
+          }
+        });
+  }
+  return distance[dest];
+}
+
+double GraphVersion::FloatDijkstra(uint32_t src, uint32_t dest) const {
+  std::vector<double> distance(NumNodes(),
+                               std::numeric_limits<double>::infinity());
+  typedef std::pair<double, uint32_t> QueueEntry;
+  std::priority_queue<QueueEntry, std::vector<QueueEntry>,
+                      std::greater<QueueEntry>>
+      Q;
+  distance[src] = 0;
+  Q.push(std::make_pair(0.0, src));
+  QueryCheckpoint checkpoint(NumNodes());
+  while (!Q.empty()) {
+    QueueEntry top = Q.top();
+    Q.pop();
+    if (top.first != distance[top.second])
+      continue;
+    // Distances are final once a node is popped, stop at dest. A stopped
+    // query discards the distance.
+    if (top.second == dest || checkpoint.Stop())
+      break;
+    ForEachWeightedNeighbor<float>(top.second,
+                                   [&](uint32_t next, float weight) {
+                                     double candidate = top.first + weight;
+                                     if (candidate < distance[next]) {
+                                       distance[next] = candidate;
+                                       Q.push(std::make_pair(candidate, next));
+                                     }
+                                   });
+  }
+  return distance[dest];
+}
+
+template <typename Weight>
+double GraphVersion::DeltaStepping(uint32_t src, uint32_t dest,
+                                   ThreadTeam &team) const {
+  typedef typename std::conditional<std::is_integral<Weight>::value, uint64_t,
+                                    double>::type Distance;
+  const Distance kInfinity = std::numeric_limits<Distance>::has_infinity
+                                 ? std::numeric_limits<Distance>::infinity()
+                                 : std::numeric_limits<Distance>::max();
+  uint32_t num_nodes = NumNodes();
+
+  // Bucket width: edges up to delta are light and relaxed until the bucket
+  // settles, heavier edges once per bucket. Max weight over average degree
+  // keeps the number of re-relaxations low on random graphs.
+  double average_degree =
+      std::max(1.0, double(adjacency->NumEdges()) / std::max(1u, num_nodes));
+  Distance delta = Distance(adjacency->MaxWeight() / average_degree);
+  if (delta <= 0)
+    delta = std::is_integral<Weight>::value ? 1 : adjacency->MaxWeight();
+  if (delta <= 0)
+    delta = 1;
+  auto bucket_of = [&](Distance distance) {
+    return uint64_t(distance / delta);
+  };
+
+  std::unique_ptr<std::atomic<Distance>[]> distance(
+      new std::atomic<Distance>[num_nodes]);
+  for (uint32_t node = 0; node < num_nodes; node++)
+    distance[node].store(kInfinity, std::memory_order_relaxed);
+  distance[src].store(0, std::memory_order_relaxed);
+
+  // Buckets are only touched between phases, by the calling thread
+  std::map<uint64_t, std::vector<uint32_t>> buckets;
+  buckets[0].push_back(src);
+  // Phase in which a node was last taken from a bucket, to drop duplicates
+  std::vector<uint64_t> taken(num_nodes, 0);
+  uint64_t stamp = 0;
+  // Nodes lowered by every member during a phase
+  std::vector<std::vector<uint32_t>> lowered(team.Size());
+
+  auto relax_phase = [&](const std::vector<uint32_t> &frontier, bool light) {
+    team.Run([&](uint32_t member) {
+      std::vector<uint32_t> &out = lowered[member];
+      for (size_t i = member; i < frontier.size(); i += team.Size()) {
+        uint32_t node = frontier[i];
+        Distance base = distance[node].load(std::memory_order_relaxed);
+        ForEachWeightedNeighbor<Weight>(node, [&](uint32_t next,
+                                                  Weight weight) {
+          if ((Distance(weight) <= delta) != light)
+            return;
+          if (RelaxAtomic(distance[next], Distance(base + weight)))
+            out.push_back(next);
+        });
+      }
+    });
+    for (std::vector<uint32_t> &out : lowered) {
+      for (uint32_t node : out) {
+        buckets[bucket_of(distance[node].load(std::memory_order_relaxed))]
+            .push_back(node);
+      }
+      out.clear();
+    }
+  };
+
+  std::vector<uint32_t> frontier;
+  std::vector<uint32_t> settled;
+  // Counted a phase at a time, members do not poll
+  QueryCheckpoint checkpoint(num_nodes);
+  while (!buckets.empty()) {
+    uint64_t current = buckets.begin()->first;
+    settled.clear();
+    // Light edges may put nodes back into the current bucket
+    while (!buckets.empty() && buckets.begin()->first == current) {
+      std::vector<uint32_t> candidates = std::move(buckets.begin()->second);
+      buckets.erase(buckets.begin());
+      stamp++;
+      frontier.clear();
+      for (uint32_t node : candidates) {
+        // Skip duplicates and nodes that moved to a lower bucket since
+        if (taken[node] == stamp ||
+            bucket_of(distance[node].load(std::memory_order_relaxed)) !=
+                current)
+          continue;
+        taken[node] = stamp;
+        frontier.push_back(node);
+      }
+      settled.insert(settled.end(), frontier.begin(), frontier.end());
+      relax_phase(frontier, true);
+      if (checkpoint.Stop(frontier.size()))
+        return std::numeric_limits<double>::infinity();
+    }
+    std::sort(settled.begin(), settled.end());
+    settled.erase(std::unique(settled.begin(), settled.end()), settled.end());
+    relax_phase(settled, false);
+
+    // Every bucket up to the current one is final
+    Distance reached = distance[dest].load(std::memory_order_relaxed);
+    if (reached != kInfinity && bucket_of(reached) <= current)
+      break;
+  }
+
+  Distance result = distance[dest].load(std::memory_order_relaxed);
+  return result == kInfinity ? std::numeric_limits<double>::infinity()
+                             : double(result);
+}
+
+} // namespace GraphQueryEngine
@@ -0,0 +1,118 @@
+#include "src/include/worker_pool.h"
+#include "src/include/query_control.h"
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace GraphQueryEngine {
+
+void SetThreadNice(int nice) {
+  if (nice != 0)
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice);
+}
+
+WorkerPool::WorkerPool(uint32_t num_threads, int nice) {
+  if (num_threads == 0)
+    num_threads = 1;
+  for (uint32_t i = 0; i < num_threads; i++)
+    workers.emplace_back(&WorkerPool::WorkerLoop, this, nice);
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> guard(queue_mutex);
+    stopping = true;
+  }
+  queue_cv.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void WorkerPool::Submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(queue_mutex);
+    tasks.push_back(std::move(task));
+  }
+  queue_cv.notify_one();
+}
+
+void WorkerPool::WorkerLoop(int nice) {
+  SetThreadNice(nice);
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      queue_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+        return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+ThreadTeam::ThreadTeam(uint32_t num_threads, int nice) {
+  for (uint32_t i = 1; i < num_threads; i++)
+    members.emplace_back(&ThreadTeam::MemberLoop, this, i, nice);
+}
+
+ThreadTeam::~ThreadTeam() {
+  {
+    std::lock_guard<std::mutex> guard(phase_mutex);
+    stopping = true;
+  }
+  start_cv.notify_all();
+  for (auto &member : members)
+    member.join();
+}
+
+void ThreadTeam::Run(const std::function<void(uint32_t)> &phase_task) {
+  if (members.empty()) {
+    phase_task(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(phase_mutex);
+    task = &phase_task;
+    control = QueryControl::Current();
+    running = members.size();
+    phase++;
+  }
+  start_cv.notify_all();
+  phase_task(0);
+
+  std::unique_lock<std::mutex> lock(phase_mutex);
+  done_cv.wait(lock, [this] { return running == 0; });
+  task = nullptr;
+}
+
+void ThreadTeam::MemberLoop(uint32_t member, int nice) {
+  SetThreadNice(nice);
+  uint64_t seen_phase = 0;
+  while (true) {
+    const std::function<void(uint32_t)> *phase_task;
+    QueryControl *phase_control;
+    {
+      std::unique_lock<std::mutex> lock(phase_mutex);
+      start_cv.wait(lock,
+                    [&] { return stopping || phase != seen_phase; });
+      if (stopping)
+        return;
+      seen_phase = phase;
+      phase_task = task;
+      phase_control = control;
+    }
+    {
+      ScopedQueryControl scope(phase_control);
+      (*phase_task)(member);
+    }
+    {
+      std::lock_guard<std::mutex> guard(phase_mutex);
+      if (--running == 0)
+        done_cv.notify_one();
+    }
+  }
+}
+
+} // namespace GraphQueryEngine
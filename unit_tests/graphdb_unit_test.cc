@@ -1,6 +1,15 @@
 #include "src/include/graph.h"
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
 
 #ifdef BAZEL_BUILD
 #include "protos/graph.grpc.pb.h"
@@ -13,6 +22,22 @@ using graph::Request;
 
 using namespace GraphQueryEngine;
 
+// Value of a key of the server statistics, the largest value if the key is
+// missing
+uint64_t StatValue(const std::string &stats, const std::string &key) {
+  size_t pos = stats.find(" " + key + "=");
+  if (pos == std::string::npos)
+    return std::numeric_limits<uint64_t>::max();
+  return std::stoull(stats.substr(pos + key.size() + 2));
+}
+
+// Value of a key of the statistics an engine replies to GET_SERVER_STATS
+uint64_t StatValue(const GraphEngineSharedPtr &engine, const std::string &key) {
+  Request stats_request;
+  stats_request.set_request_type(graph::GET_SERVER_STATS);
+  return StatValue(engine->ProcessRequest(stats_request), key);
+}
+
 int main() {
   // Create a test graph engine client
   GraphEngineSharedPtr test_graph_engine =
@@ -147,4 +172,2941 @@ int main() {
                 << std::endl;
     }
   }
+
+  {
+    /*
+     * Testcase-5 Minimum distance against edge direction is unreachable
+     */
+    Request request;
+    request.set_graph_name("directed_cycle_graph");
+    request.set_graph_total_nodes(5);
+    request.set_request_type(graph::POST_GRAPH);
+    // Cycle 0 -> 1 -> 2 -> 0 with a tail 2 -> 3 and 4 -> 3
+    uint32_t edges[][2] = {{0, 1}, {1, 2}, {2, 0}, {2, 3}, {4, 3}};
+    for (auto &e : edges) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(e[0]);
+      edge->set_dest(e[1]);
+    }
+
+    std::string result = test_graph_engine->ProcessRequest(request);
+    uint64_t graph_id = std::stoull(result);
+
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(graph_id);
+
+    // 3 has no out-going edges and 4 is not reachable from the cycle
+    min_request.mutable_min_distance()->set_begin_node(3);
+    min_request.mutable_min_distance()->set_end_node(0);
+    std::string back_result = test_graph_engine->ProcessRequest(min_request);
+    min_request.mutable_min_distance()->set_begin_node(0);
+    min_request.mutable_min_distance()->set_end_node(4);
+    std::string side_result = test_graph_engine->ProcessRequest(min_request);
+    // Reachable pairs must still be answered by the traversal
+    min_request.mutable_min_distance()->set_begin_node(1);
+    min_request.mutable_min_distance()->set_end_node(3);
+    std::string path_result = test_graph_engine->ProcessRequest(min_request);
+
+    if (back_result.compare(
+            "OK, found minimum distance between 3 0 to be 4294967295") == 0 &&
+        side_result.compare(
+            "OK, found minimum distance between 0 4 to be 4294967295") == 0 &&
+        path_result.compare("OK, found minimum distance between 1 3 to be 2") ==
+            0) {
+      std::cout << "Testcase-5, Minimum distance against edge direction passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-5, Minimum distance against edge direction failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-6 Minimum distance in an undirected tree
+     */
+    Request request;
+    request.set_graph_name("site_rack_host_tree");
+    request.set_graph_total_nodes(7);
+    request.set_request_type(graph::POST_GRAPH);
+    // Site 0 with racks 1 and 2, hosts 3, 4 in rack 1 and host 5 in rack 2,
+    // every link posted in both directions. Node 6 is a separate tree.
+    uint32_t links[][2] = {{0, 1}, {0, 2}, {1, 3}, {1, 4}, {2, 5}};
+    for (auto &l : links) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(l[0]);
+      edge->set_dest(l[1]);
+      edge = request.add_adjacency_list();
+      edge->set_src(l[1]);
+      edge->set_dest(l[0]);
+    }
+
+    std::string result = test_graph_engine->ProcessRequest(request);
+    uint64_t graph_id = std::stoull(result);
+
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(graph_id);
+
+    min_request.mutable_min_distance()->set_begin_node(3);
+    min_request.mutable_min_distance()->set_end_node(5);
+    std::string cross_rack = test_graph_engine->ProcessRequest(min_request);
+    min_request.mutable_min_distance()->set_begin_node(4);
+    min_request.mutable_min_distance()->set_end_node(3);
+    std::string same_rack = test_graph_engine->ProcessRequest(min_request);
+    min_request.mutable_min_distance()->set_begin_node(3);
+    min_request.mutable_min_distance()->set_end_node(6);
+    std::string other_tree = test_graph_engine->ProcessRequest(min_request);
+
+    if (cross_rack.compare("OK, found minimum distance between 3 5 to be 4") ==
+            0 &&
+        same_rack.compare("OK, found minimum distance between 4 3 to be 2") ==
+            0 &&
+        other_tree.compare(
+            "OK, found minimum distance between 3 6 to be 4294967295") == 0) {
+      std::cout << "Testcase-6, Minimum distance in an undirected tree passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-6, Minimum distance in an undirected tree failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-7 Minimum distance in a directed tree and a DAG
+     */
+    Request tree_request;
+    tree_request.set_graph_name("directed_tree");
+    tree_request.set_graph_total_nodes(4);
+    tree_request.set_request_type(graph::POST_GRAPH);
+    uint32_t tree_edges[][2] = {{0, 1}, {0, 2}, {1, 3}};
+    for (auto &e : tree_edges) {
+      graph::Edges *edge = tree_request.add_adjacency_list();
+      edge->set_src(e[0]);
+      edge->set_dest(e[1]);
+    }
+
+    // Diamond 0 -> {1, 2} -> 3 with a shortcut 0 -> 3 and a tail 3 -> 4
+    Request dag_request;
+    dag_request.set_graph_name("diamond_dag");
+    dag_request.set_graph_total_nodes(5);
+    dag_request.set_request_type(graph::POST_GRAPH);
+    uint32_t dag_edges[][2] = {{0, 1}, {0, 2}, {1, 3}, {2, 3}, {0, 3}, {3, 4}};
+    for (auto &e : dag_edges) {
+      graph::Edges *edge = dag_request.add_adjacency_list();
+      edge->set_src(e[0]);
+      edge->set_dest(e[1]);
+    }
+
+    uint64_t tree_id =
+        std::stoull(test_graph_engine->ProcessRequest(tree_request));
+    uint64_t dag_id = std::stoull(test_graph_engine->ProcessRequest(dag_request));
+
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(tree_id);
+    min_request.mutable_min_distance()->set_begin_node(0);
+    min_request.mutable_min_distance()->set_end_node(3);
+    std::string tree_down = test_graph_engine->ProcessRequest(min_request);
+    min_request.mutable_min_distance()->set_begin_node(2);
+    min_request.mutable_min_distance()->set_end_node(3);
+    std::string tree_sibling = test_graph_engine->ProcessRequest(min_request);
+
+    min_request.mutable_min_distance()->set_map_id(dag_id);
+    min_request.mutable_min_distance()->set_begin_node(0);
+    min_request.mutable_min_distance()->set_end_node(4);
+    std::string dag_shortcut = test_graph_engine->ProcessRequest(min_request);
+    min_request.mutable_min_distance()->set_begin_node(1);
+    min_request.mutable_min_distance()->set_end_node(2);
+    std::string dag_sibling = test_graph_engine->ProcessRequest(min_request);
+
+    if (tree_down.compare("OK, found minimum distance between 0 3 to be 2") ==
+            0 &&
+        tree_sibling.compare(
+            "OK, found minimum distance between 2 3 to be 4294967295") == 0 &&
+        dag_shortcut.compare(
+            "OK, found minimum distance between 0 4 to be 2") == 0 &&
+        dag_sibling.compare(
+            "OK, found minimum distance between 1 2 to be 4294967295") == 0) {
+      std::cout << "Testcase-7, Minimum distance in a directed tree and a DAG "
+                   "passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-7, Minimum distance in a directed tree and a DAG "
+                   "failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-8 One-to-many distances streamed in chunks
+     */
+    const uint32_t path_nodes = 40000;
+    Request request;
+    request.set_graph_name("long_path_graph");
+    request.set_graph_total_nodes(path_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    // Path 0 -> 1 -> ... -> 39999 with a back edge 39999 -> 0
+    for (uint32_t i = 0; i < path_nodes; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest((i + 1) % path_nodes);
+    }
+    uint64_t graph_id = std::stoull(test_graph_engine->ProcessRequest(request));
+
+    // Distances from node 5 to all nodes, larger than a single chunk
+    Request all_request;
+    all_request.set_request_type(graph::GET_DISTANCES);
+    all_request.mutable_multi_distance()->set_map_id(graph_id);
+    all_request.mutable_multi_distance()->set_begin_node(5);
+    all_request.mutable_multi_distance()->set_all_nodes(true);
+    StreamResultSharedPtr all_result =
+        test_graph_engine->ProcessStreamRequest(all_request);
+
+    bool all_passed = true;
+    uint32_t num_chunks = 0;
+    uint64_t num_entries = 0;
+    graph::Response chunk;
+    while (all_result->NextChunk(&chunk)) {
+      if (num_chunks == 0 &&
+          chunk.message().compare("OK, found 40000 distances from 5") != 0)
+        all_passed = false;
+      for (int i = 0; i < chunk.distances_size(); i++) {
+        uint64_t node = chunk.chunk_offset() + i;
+        if (chunk.distances(i) != (node + path_nodes - 5) % path_nodes)
+          all_passed = false;
+        num_entries++;
+      }
+      num_chunks++;
+    }
+    if (num_chunks < 2 || num_entries != path_nodes)
+      all_passed = false;
+
+    // Distances to a list of targets come back in the requested order
+    Request list_request;
+    list_request.set_request_type(graph::GET_DISTANCES);
+    list_request.mutable_multi_distance()->set_map_id(graph_id);
+    list_request.mutable_multi_distance()->set_begin_node(0);
+    list_request.mutable_multi_distance()->add_end_nodes(7);
+    list_request.mutable_multi_distance()->add_end_nodes(0);
+    list_request.mutable_multi_distance()->add_end_nodes(3);
+    StreamResultSharedPtr list_result =
+        test_graph_engine->ProcessStreamRequest(list_request);
+    bool list_passed = list_result->NextChunk(&chunk) &&
+                       chunk.distances_size() == 3 && chunk.distances(0) == 7 &&
+                       chunk.distances(1) == 0 && chunk.distances(2) == 3 &&
+                       !list_result->NextChunk(&chunk);
+
+    // Out of range targets are rejected
+    list_request.mutable_multi_distance()->add_end_nodes(path_nodes);
+    StreamResultSharedPtr bad_result =
+        test_graph_engine->ProcessStreamRequest(list_request);
+    bool bad_passed =
+        bad_result->message.compare("ERROR: Node not present in graph") == 0;
+
+    if (all_passed && list_passed && bad_passed) {
+      std::cout << "Testcase-8, One-to-many distances passed" << std::endl;
+    } else {
+      std::cout << "Testcase-8, One-to-many distances failed" << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-9 Distance cache hits and invalidation on delete
+     */
+    // No landmarks, they would answer every query on so small a graph
+    // before a traversal is cached
+    GraphEngineOptions cache_options;
+    cache_options.num_landmarks = 0;
+    GraphEngineSharedPtr cache_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(cache_options);
+
+    // Directed ring 0 -> 1 -> ... -> 5 -> 0
+    Request request;
+    request.set_graph_name("cached_ring_graph");
+    request.set_graph_total_nodes(6);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < 6; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest((i + 1) % 6);
+    }
+    uint64_t graph_id = std::stoull(cache_engine->ProcessRequest(request));
+    uint64_t hits_before = StatValue(cache_engine, "distance_cache_hits");
+    uint64_t entries_before = StatValue(cache_engine, "distance_cache_entries");
+
+    // The second miss of a source admits it, later queries hit the cache
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(graph_id);
+    min_request.mutable_min_distance()->set_begin_node(1);
+    std::string results[4];
+    for (uint32_t dest = 2; dest < 6; dest++) {
+      min_request.mutable_min_distance()->set_end_node(dest);
+      results[dest - 2] = cache_engine->ProcessRequest(min_request);
+    }
+    bool cached_passed =
+        results[3].compare("OK, found minimum distance between 1 5 to be 4") ==
+            0 &&
+        StatValue(cache_engine, "distance_cache_hits") == hits_before + 2 &&
+        StatValue(cache_engine, "distance_cache_entries") == entries_before + 1;
+
+    // Deleting the graph drops its entries, a graph posted again under the
+    // same id must not see the old distances
+    Request delete_request;
+    delete_request.set_request_type(graph::DELETE_GRAPH);
+    delete_request.mutable_delete_graph()->set_map_id(graph_id);
+    cache_engine->ProcessRequest(delete_request);
+    bool invalidated_passed =
+        StatValue(cache_engine, "distance_cache_entries") == entries_before;
+
+    graph::Edges *shortcut = request.add_adjacency_list();
+    shortcut->set_src(1);
+    shortcut->set_dest(5);
+    cache_engine->ProcessRequest(request);
+    std::string fresh = cache_engine->ProcessRequest(min_request);
+    bool fresh_passed =
+        fresh.compare("OK, found minimum distance between 1 5 to be 1") == 0;
+
+    if (cached_passed && invalidated_passed && fresh_passed) {
+      std::cout << "Testcase-9, Distance cache and invalidation passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-9, Distance cache and invalidation failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-10 Identical queries in flight are coalesced
+     */
+    // Single compute thread, so that queries queue up behind a large post
+    GraphEngineOptions options;
+    options.compute_threads = 1;
+    GraphEngineSharedPtr async_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(options);
+
+    Request small_request;
+    small_request.set_graph_name("coalesced_graph");
+    small_request.set_graph_total_nodes(3);
+    small_request.set_request_type(graph::POST_GRAPH);
+    uint32_t edges[][2] = {{0, 1}, {1, 2}, {2, 0}};
+    for (auto &e : edges) {
+      graph::Edges *edge = small_request.add_adjacency_list();
+      edge->set_src(e[0]);
+      edge->set_dest(e[1]);
+    }
+    uint64_t graph_id = std::stoull(async_engine->ProcessRequest(small_request));
+
+    Request large_request;
+    large_request.set_graph_name("busy_graph");
+    large_request.set_graph_total_nodes(200000);
+    large_request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < 200000; i++) {
+      graph::Edges *edge = large_request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest((i + 1) % 200000);
+    }
+
+    const uint32_t num_queries = 10;
+    Request min_requests[num_queries];
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    uint32_t num_done = 0;
+    uint32_t num_correct = 0;
+    async_engine->ProcessRequestAsync(large_request,
+                                      [](const std::string &) {});
+    for (uint32_t i = 0; i < num_queries; i++) {
+      min_requests[i].set_request_type(graph::GET_MIN_DISTANCE);
+      min_requests[i].mutable_min_distance()->set_map_id(graph_id);
+      min_requests[i].mutable_min_distance()->set_begin_node(0);
+      min_requests[i].mutable_min_distance()->set_end_node(2);
+      async_engine->ProcessRequestAsync(
+          min_requests[i], [&](const std::string &message) {
+            std::lock_guard<std::mutex> guard(done_mutex);
+            if (message.compare(
+                    "OK, found minimum distance between 0 2 to be 2") == 0)
+              num_correct++;
+            num_done++;
+            done_cv.notify_all();
+          });
+    }
+    {
+      std::unique_lock<std::mutex> lock(done_mutex);
+      done_cv.wait(lock, [&] { return num_done == num_queries; });
+    }
+
+    // One-to-many requests for all nodes share one traversal of their
+    // source. Requests for targets only do once the source is admitted to
+    // the cache, until then each stops at its own targets.
+    // The post runs first in the class of the requests queued behind it
+    large_request.set_graph_name("busy_graph_2");
+    large_request.set_priority(graph::INTERACTIVE_PRIORITY);
+    bool min_passed = num_correct == num_queries;
+    num_done = 0;
+    num_correct = 0;
+    async_engine->ProcessRequestAsync(large_request,
+                                      [&](const std::string &) {
+                                        std::lock_guard<std::mutex> guard(
+                                            done_mutex);
+                                        num_done++;
+                                        done_cv.notify_all();
+                                      });
+    Request distance_requests[6];
+    for (uint32_t i = 0; i < 6; i++) {
+      graph::MultiDistance *query =
+          distance_requests[i].mutable_multi_distance();
+      distance_requests[i].set_request_type(graph::GET_DISTANCES);
+      query->set_map_id(graph_id);
+      query->set_begin_node(i < 3 ? 1 : 0);
+      if (i < 3)
+        query->add_end_nodes(0);
+      else
+        query->set_all_nodes(true);
+      uint32_t expected = i < 3 ? 1 : 3;
+      async_engine->ProcessStreamRequestAsync(
+          distance_requests[i], [&, expected](StreamResultSharedPtr result) {
+            std::lock_guard<std::mutex> guard(done_mutex);
+            if (result->distances.size() == expected)
+              num_correct++;
+            num_done++;
+            done_cv.notify_all();
+          });
+    }
+    {
+      std::unique_lock<std::mutex> lock(done_mutex);
+      done_cv.wait(lock, [&] { return num_done == 7; });
+    }
+
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = async_engine->ProcessRequest(stats_request);
+    if (min_passed && num_correct == 6 &&
+        stats.find(" coalesced_queries=9 ") != std::string::npos &&
+        stats.find(" coalesced_source_traversals=2 ") != std::string::npos) {
+      std::cout << "Testcase-10, Coalescing identical queries passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-10, Coalescing identical queries failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-11 Edge inserts and removals, and background compaction
+     */
+    // Directed ring 0 -> 1 -> ... -> 1999 -> 0
+    const uint32_t ring_nodes = 2000;
+    Request request;
+    request.set_graph_name("edited_ring_graph");
+    request.set_graph_total_nodes(ring_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < ring_nodes; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest((i + 1) % ring_nodes);
+    }
+    uint64_t graph_id = std::stoull(test_graph_engine->ProcessRequest(request));
+    std::string id = std::to_string(graph_id);
+
+    auto edit = [&](graph::RequestType type, uint32_t src, uint32_t dest) {
+      Request edit_request;
+      edit_request.set_request_type(type);
+      edit_request.mutable_update_graph()->set_map_id(graph_id);
+      graph::Edges *edge = edit_request.add_adjacency_list();
+      edge->set_src(src);
+      edge->set_dest(dest);
+      return test_graph_engine->ProcessRequest(edit_request);
+    };
+    // Expected reply to an edit
+    auto edited = [&](const std::string &verb, uint32_t count,
+                      uint64_t version) {
+      return "OK, " + verb + " " + std::to_string(count) +
+             " edges of graph with ID: " + id + ", version " +
+             std::to_string(version);
+    };
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(graph_id);
+    min_request.mutable_min_distance()->set_begin_node(0);
+    min_request.mutable_min_distance()->set_end_node(1000);
+    std::string prefix = "OK, found minimum distance between 0 1000 to be ";
+
+    // Inserting a shortcut, again, and removing it
+    bool added_passed =
+        edit(graph::ADD_EDGES, 0, 1000).compare(edited("added", 1, 2)) == 0 &&
+        test_graph_engine->ProcessRequest(min_request).compare(prefix + "1") ==
+            0 &&
+        edit(graph::ADD_EDGES, 0, 1000).compare(edited("added", 0, 2)) == 0;
+    bool removed_passed =
+        edit(graph::REMOVE_EDGES, 0, 1000).compare(edited("removed", 1, 3)) == 0 &&
+        test_graph_engine->ProcessRequest(min_request)
+                .compare(prefix + "1000") == 0 &&
+        edit(graph::REMOVE_EDGES, 999, 1000).compare(edited("removed", 1, 4)) == 0 &&
+        test_graph_engine->ProcessRequest(min_request)
+                .compare(prefix +
+                         std::to_string(std::numeric_limits<uint32_t>::max())) ==
+            0;
+    bool bad_passed = edit(graph::ADD_EDGES, 0, ring_nodes)
+                          .compare("ERROR: Node not present in graph") == 0;
+
+    // A large batch of chords i -> i + 2 triggers a compaction
+    uint64_t compactions_before = StatValue(test_graph_engine, "compactions");
+    Request batch_request;
+    batch_request.set_request_type(graph::ADD_EDGES);
+    batch_request.mutable_update_graph()->set_map_id(graph_id);
+    for (uint32_t i = 0; i < 1100; i++) {
+      graph::Edges *edge = batch_request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest(i + 2);
+    }
+    test_graph_engine->ProcessRequest(batch_request);
+    for (uint32_t i = 0;
+         i < 1000 &&
+         StatValue(test_graph_engine, "compactions") == compactions_before;
+         i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    bool compacted_passed =
+        StatValue(test_graph_engine, "compactions") == compactions_before + 1 &&
+        test_graph_engine->ProcessRequest(min_request)
+                .compare(prefix + "500") == 0 &&
+        edit(graph::REMOVE_EDGES, 998, 1000).compare(edited("removed", 1, 6)) == 0 &&
+        edit(graph::ADD_EDGES, 999, 1000).compare(edited("added", 1, 7)) == 0 &&
+        test_graph_engine->ProcessRequest(min_request)
+                .compare(prefix + "501") == 0;
+
+    if (added_passed && removed_passed && bad_passed && compacted_passed) {
+      std::cout << "Testcase-11, Edge inserts, removals and compaction passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-11, Edge inserts, removals and compaction failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-12 Queries on a named version of an edited graph
+     */
+    // Directed path 0 -> 1 -> 2 -> 3
+    Request request;
+    request.set_graph_name("versioned_path_graph");
+    request.set_graph_total_nodes(4);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < 3; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest(i + 1);
+    }
+    uint64_t graph_id = std::stoull(test_graph_engine->ProcessRequest(request));
+
+    // Version 2 adds the shortcut 0 -> 3
+    Request edit_request;
+    edit_request.set_request_type(graph::ADD_EDGES);
+    edit_request.mutable_update_graph()->set_map_id(graph_id);
+    graph::Edges *edge = edit_request.add_adjacency_list();
+    edge->set_src(0);
+    edge->set_dest(3);
+    test_graph_engine->ProcessRequest(edit_request);
+
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(graph_id);
+    min_request.mutable_min_distance()->set_begin_node(0);
+    min_request.mutable_min_distance()->set_end_node(3);
+    std::string latest = test_graph_engine->ProcessRequest(min_request);
+    min_request.mutable_min_distance()->set_version(1);
+    std::string first = test_graph_engine->ProcessRequest(min_request);
+    min_request.mutable_min_distance()->set_version(3);
+    std::string missing = test_graph_engine->ProcessRequest(min_request);
+
+    Request list_request;
+    list_request.set_request_type(graph::GET_DISTANCES);
+    list_request.mutable_multi_distance()->set_map_id(graph_id);
+    list_request.mutable_multi_distance()->set_begin_node(0);
+    list_request.mutable_multi_distance()->set_all_nodes(true);
+    list_request.mutable_multi_distance()->set_version(1);
+    StreamResultSharedPtr list_result =
+        test_graph_engine->ProcessStreamRequest(list_request);
+
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = test_graph_engine->ProcessRequest(stats_request);
+
+    if (latest.compare("OK, found minimum distance between 0 3 to be 1") == 0 &&
+        first.compare("OK, found minimum distance between 0 3 to be 3") == 0 &&
+        missing.compare("ERROR: Graph version not available") == 0 &&
+        list_result->distances == std::vector<uint32_t>({0, 1, 2, 3}) &&
+        stats.find(std::to_string(graph_id) + ":2") != std::string::npos) {
+      std::cout << "Testcase-12, Queries on a named graph version passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-12, Queries on a named graph version failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-13 Cached distances repaired after edits match a new BFS
+     */
+    // Sparse random graph, edges are mirrored in a set for the reference
+    const uint32_t num_nodes = 300;
+    std::mt19937 rng(42);
+    std::set<std::pair<uint32_t, uint32_t>> edges;
+    Request request;
+    request.set_graph_name("repaired_random_graph");
+    request.set_graph_total_nodes(num_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    while (edges.size() < 450) {
+      uint32_t src = rng() % num_nodes;
+      uint32_t dest = rng() % num_nodes;
+      if (!edges.insert(std::make_pair(src, dest)).second)
+        continue;
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(src);
+      edge->set_dest(dest);
+    }
+    uint64_t graph_id = std::stoull(test_graph_engine->ProcessRequest(request));
+    uint64_t repairs_before =
+        StatValue(test_graph_engine, "distance_cache_repairs");
+
+    // Distances to all nodes from the engine, cached after the first request
+    auto engine_distances = [&](uint32_t src) {
+      Request list_request;
+      list_request.set_request_type(graph::GET_DISTANCES);
+      list_request.mutable_multi_distance()->set_map_id(graph_id);
+      list_request.mutable_multi_distance()->set_begin_node(src);
+      list_request.mutable_multi_distance()->set_all_nodes(true);
+      return test_graph_engine->ProcessStreamRequest(list_request)->distances;
+    };
+    // Distances from a from-scratch BFS on the same edges
+    auto reference_distances = [&](uint32_t src) {
+      std::vector<std::vector<uint32_t>> adj_list(num_nodes);
+      for (const auto &edge : edges)
+        adj_list[edge.first].push_back(edge.second);
+      Graph reference(adj_list, "reference");
+      std::vector<uint32_t> distances(num_nodes);
+      for (uint32_t dest = 0; dest < num_nodes; dest++)
+        distances[dest] = reference.Current()->MinEdgeBfs(src, dest);
+      return distances;
+    };
+
+    const uint32_t num_sources = 4;
+    bool matched = true;
+    for (uint32_t src = 0; src < num_sources; src++)
+      engine_distances(src);
+    for (uint32_t round = 0; round < 20; round++) {
+      // A few inserts and one removal per round
+      Request edit_request;
+      edit_request.mutable_update_graph()->set_map_id(graph_id);
+      edit_request.set_request_type(graph::ADD_EDGES);
+      for (uint32_t i = 0; i < 5; i++) {
+        uint32_t src = rng() % num_nodes;
+        uint32_t dest = rng() % num_nodes;
+        edges.insert(std::make_pair(src, dest));
+        graph::Edges *edge = edit_request.add_adjacency_list();
+        edge->set_src(src);
+        edge->set_dest(dest);
+      }
+      test_graph_engine->ProcessRequest(edit_request);
+
+      auto removed = edges.begin();
+      std::advance(removed, rng() % edges.size());
+      edit_request.clear_adjacency_list();
+      edit_request.set_request_type(graph::REMOVE_EDGES);
+      graph::Edges *edge = edit_request.add_adjacency_list();
+      edge->set_src(removed->first);
+      edge->set_dest(removed->second);
+      edges.erase(removed);
+      test_graph_engine->ProcessRequest(edit_request);
+
+      for (uint32_t src = 0; src < num_sources; src++)
+        matched = matched && engine_distances(src) == reference_distances(src);
+    }
+
+    if (matched && StatValue(test_graph_engine, "distance_cache_repairs") >
+                       repairs_before) {
+      std::cout << "Testcase-13, Repaired cached distances passed" << std::endl;
+    } else {
+      std::cout << "Testcase-13, Repaired cached distances failed" << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-14 Weighted distances on integer and float weighted graphs
+     */
+    // 0 -> 1 -> 2 -> 3 is cheap, the direct edge 0 -> 3 is expensive
+    auto weighted_request = [](graph::WeightType weight_type,
+                               const std::string &name) {
+      Request request;
+      request.set_graph_name(name);
+      request.set_graph_total_nodes(5);
+      request.set_request_type(graph::POST_GRAPH);
+      request.set_weight_type(weight_type);
+      const uint32_t edges[4][3] = {{0, 1, 2}, {1, 2, 3}, {2, 3, 4}, {0, 3, 20}};
+      for (const auto &e : edges) {
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(e[0]);
+        edge->set_dest(e[1]);
+        if (weight_type == graph::INTEGER_WEIGHTS)
+          edge->set_weight(e[2]);
+        else if (weight_type == graph::FLOAT_WEIGHTS)
+          edge->set_float_weight(e[2] + 0.5f);
+      }
+      return request;
+    };
+    auto weighted_distance = [](GraphEngineSharedPtr engine, uint64_t graph_id,
+                                uint32_t src, uint32_t dest) {
+      Request request;
+      request.set_request_type(graph::GET_WEIGHTED_DISTANCE);
+      request.mutable_weighted_distance()->set_map_id(graph_id);
+      request.mutable_weighted_distance()->set_begin_node(src);
+      request.mutable_weighted_distance()->set_end_node(dest);
+      return engine->ProcessRequest(request);
+    };
+    std::string prefix = "OK, found weighted distance between 0 3 to be ";
+
+    Request integer_request =
+        weighted_request(graph::INTEGER_WEIGHTS, "integer_weighted_graph");
+    uint64_t integer_id =
+        std::stoull(test_graph_engine->ProcessRequest(integer_request));
+    Request float_request =
+        weighted_request(graph::FLOAT_WEIGHTS, "float_weighted_graph");
+    uint64_t float_id =
+        std::stoull(test_graph_engine->ProcessRequest(float_request));
+    bool dijkstra_passed =
+        weighted_distance(test_graph_engine, integer_id, 0, 3)
+                .compare(prefix + "9") == 0 &&
+        weighted_distance(test_graph_engine, float_id, 0, 3)
+                .compare(prefix + std::to_string(10.5)) == 0 &&
+        weighted_distance(test_graph_engine, integer_id, 0, 4)
+                .compare("OK, found weighted distance between 0 4 to be inf") ==
+            0;
+
+    // The same graphs through the parallel delta-stepping engine
+    GraphEngineOptions options;
+    options.delta_stepping_min_edges = 0;
+    options.delta_stepping_threads = 4;
+    GraphEngineSharedPtr parallel_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(options);
+    uint64_t parallel_integer_id =
+        std::stoull(parallel_engine->ProcessRequest(integer_request));
+    uint64_t parallel_float_id =
+        std::stoull(parallel_engine->ProcessRequest(float_request));
+    bool delta_stepping_passed =
+        weighted_distance(parallel_engine, parallel_integer_id, 0, 3)
+                .compare(prefix + "9") == 0 &&
+        weighted_distance(parallel_engine, parallel_float_id, 0, 3)
+                .compare(prefix + std::to_string(10.5)) == 0;
+    // Both queries borrowed the one team of the engine, an engine without
+    // teams runs Dijkstra
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = parallel_engine->ProcessRequest(stats_request);
+    options.delta_stepping_teams = 0;
+    GraphEngineSharedPtr teamless_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(options);
+    uint64_t teamless_id =
+        std::stoull(teamless_engine->ProcessRequest(integer_request));
+    delta_stepping_passed =
+        delta_stepping_passed &&
+        stats.find(" delta_stepping_queries=2 ") != std::string::npos &&
+        stats.find(" delta_stepping_fallbacks=0 ") != std::string::npos &&
+        weighted_distance(teamless_engine, teamless_id, 0, 3)
+                .compare(prefix + "9") == 0 &&
+        teamless_engine->ProcessRequest(stats_request)
+                .find(" delta_stepping_fallbacks=1 ") != std::string::npos;
+
+    // Removing the cheap path leaves the expensive edge
+    Request remove_request;
+    remove_request.set_request_type(graph::REMOVE_EDGES);
+    remove_request.mutable_update_graph()->set_map_id(integer_id);
+    graph::Edges *edge = remove_request.add_adjacency_list();
+    edge->set_src(1);
+    edge->set_dest(2);
+    test_graph_engine->ProcessRequest(remove_request);
+    Request unweighted_request =
+        weighted_request(graph::UNWEIGHTED, "unweighted_graph");
+    uint64_t unweighted_id =
+        std::stoull(test_graph_engine->ProcessRequest(unweighted_request));
+    Request add_request = remove_request;
+    add_request.set_request_type(graph::ADD_EDGES);
+    bool edit_passed =
+        weighted_distance(test_graph_engine, integer_id, 0, 3)
+                .compare(prefix + "20") == 0 &&
+        test_graph_engine->ProcessRequest(add_request)
+                .compare("ERROR: Edges cannot be added to a weighted graph") ==
+            0 &&
+        weighted_distance(test_graph_engine, unweighted_id, 0, 1)
+                .compare("ERROR: Graph has no edge weights") == 0;
+
+    if (dijkstra_passed && delta_stepping_passed && edit_passed) {
+      std::cout << "Testcase-14, Weighted distances passed" << std::endl;
+    } else {
+      std::cout << "Testcase-14, Weighted distances failed" << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-15 Depth-bounded distances and k-hop neighborhoods
+     */
+    // Ring 0 -> 1 -> ... -> 99 -> 0 with a chord 0 -> 50
+    const uint32_t ring_nodes = 100;
+    Request request;
+    request.set_graph_name("bounded_ring_graph");
+    request.set_graph_total_nodes(ring_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < ring_nodes; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest((i + 1) % ring_nodes);
+    }
+    graph::Edges *chord = request.add_adjacency_list();
+    chord->set_src(0);
+    chord->set_dest(50);
+    uint64_t graph_id = std::stoull(test_graph_engine->ProcessRequest(request));
+
+    auto min_distance = [&](uint32_t dest, uint32_t max_hops) {
+      Request min_request;
+      min_request.set_request_type(graph::GET_MIN_DISTANCE);
+      min_request.mutable_min_distance()->set_map_id(graph_id);
+      min_request.mutable_min_distance()->set_begin_node(0);
+      min_request.mutable_min_distance()->set_end_node(dest);
+      min_request.mutable_min_distance()->set_max_hops(max_hops);
+      return test_graph_engine->ProcessRequest(min_request);
+    };
+    std::string prefix = "OK, found minimum distance between 0 ";
+    bool bounded_passed =
+        min_distance(52, 3).compare(prefix + "52 to be 3") == 0 &&
+        min_distance(53, 3).compare(
+            prefix + "53 to be " +
+            std::to_string(std::numeric_limits<uint32_t>::max())) == 0 &&
+        min_distance(53, 0).compare(prefix + "53 to be 4") == 0;
+
+    auto neighborhood = [&](uint32_t max_hops, uint32_t max_nodes,
+                            std::vector<uint32_t> *nodes,
+                            std::vector<uint32_t> *distances) {
+      Request neighborhood_request;
+      neighborhood_request.set_request_type(graph::GET_NEIGHBORHOOD);
+      neighborhood_request.mutable_neighborhood()->set_map_id(graph_id);
+      neighborhood_request.mutable_neighborhood()->set_begin_node(0);
+      neighborhood_request.mutable_neighborhood()->set_max_hops(max_hops);
+      neighborhood_request.mutable_neighborhood()->set_max_nodes(max_nodes);
+      StreamResultSharedPtr result =
+          test_graph_engine->ProcessStreamRequest(neighborhood_request);
+      std::string message;
+      graph::Response chunk;
+      while (result->NextChunk(&chunk)) {
+        if (!chunk.message().empty())
+          message = chunk.message();
+        nodes->insert(nodes->end(), chunk.nodes().begin(), chunk.nodes().end());
+        distances->insert(distances->end(), chunk.distances().begin(),
+                          chunk.distances().end());
+      }
+      return message;
+    };
+    std::vector<uint32_t> nodes, distances;
+    bool neighborhood_passed =
+        neighborhood(2, 0, &nodes, &distances)
+                .compare("OK, found 5 nodes within 2 hops of 0") == 0 &&
+        std::set<uint32_t>(nodes.begin(), nodes.end()) ==
+            std::set<uint32_t>({0, 1, 2, 50, 51}) &&
+        distances == std::vector<uint32_t>({0, 1, 1, 2, 2});
+    nodes.clear();
+    distances.clear();
+    bool truncated_passed =
+        neighborhood(2, 3, &nodes, &distances)
+                .compare("OK, found 3 nodes within 2 hops of 0, truncated") ==
+            0 &&
+        nodes.size() == 3 && distances.size() == 3;
+
+    if (bounded_passed && neighborhood_passed && truncated_passed) {
+      std::cout << "Testcase-15, Depth-bounded distances and neighborhoods passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-15, Depth-bounded distances and neighborhoods failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-16 Approximate distances from the landmark sketch
+     */
+    // Two directed rings of 50 nodes joined by 0 -> 50, every node is on a
+    // cycle so no forest or DAG engine answers exactly
+    const uint32_t ring_nodes = 50;
+    Request request;
+    request.set_graph_name("sketched_rings_graph");
+    request.set_graph_total_nodes(2 * ring_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t ring = 0; ring < 2; ring++) {
+      for (uint32_t i = 0; i < ring_nodes; i++) {
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(ring * ring_nodes + i);
+        edge->set_dest(ring * ring_nodes + (i + 1) % ring_nodes);
+      }
+    }
+    graph::Edges *bridge = request.add_adjacency_list();
+    bridge->set_src(0);
+    bridge->set_dest(ring_nodes);
+    uint64_t graph_id = std::stoull(test_graph_engine->ProcessRequest(request));
+
+    auto approximate = [&](uint32_t src, uint32_t dest, uint32_t width,
+                           uint32_t *lower, uint32_t *upper) {
+      Request min_request;
+      min_request.set_request_type(graph::GET_MIN_DISTANCE);
+      min_request.mutable_min_distance()->set_map_id(graph_id);
+      min_request.mutable_min_distance()->set_begin_node(src);
+      min_request.mutable_min_distance()->set_end_node(dest);
+      min_request.mutable_min_distance()->set_approximate(true);
+      min_request.mutable_min_distance()->set_max_bound_width(width);
+      std::string reply = test_graph_engine->ProcessRequest(min_request);
+      size_t pos = reply.find(", bounds ");
+      if (pos == std::string::npos)
+        return false;
+      size_t used = 0;
+      std::string bounds = reply.substr(pos + 9);
+      *lower = std::stoul(bounds, &used);
+      *upper = std::stoul(bounds.substr(used));
+      return true;
+    };
+
+    // Bounds hold the exact distance for every pair of the first ring and
+    // from the first ring into the second
+    bool bounds_passed =
+        StatValue(test_graph_engine, "landmark_sketch_bytes") > 0;
+    uint64_t escalations =
+        StatValue(test_graph_engine, "approximate_escalations");
+    for (uint32_t src = 0; src < ring_nodes && bounds_passed; src += 7) {
+      for (uint32_t dest = 0; dest < 2 * ring_nodes; dest += 3) {
+        uint32_t exact = dest < ring_nodes
+                             ? (dest + ring_nodes - src) % ring_nodes
+                             : (ring_nodes - src) % ring_nodes + 1 +
+                                   dest - ring_nodes;
+        uint32_t lower = 0, upper = 0;
+        if (!approximate(src, dest, 0, &lower, &upper) || lower > exact ||
+            upper < exact) {
+          bounds_passed = false;
+          break;
+        }
+      }
+    }
+    bounds_passed =
+        bounds_passed &&
+        StatValue(test_graph_engine, "approximate_escalations") == escalations;
+
+    // The second ring never reaches the first
+    uint32_t lower = 0, upper = 0;
+    bool unreachable_passed =
+        approximate(ring_nodes, 0, 0, &lower, &upper) &&
+        lower == std::numeric_limits<uint32_t>::max() &&
+        upper == std::numeric_limits<uint32_t>::max();
+
+    // A width of 1 cannot hold for every pair, escalations answer exactly
+    bool escalated_passed = true;
+    for (uint32_t dest = 0; dest < ring_nodes; dest++) {
+      if (!approximate(25, dest, 1, &lower, &upper) || upper - lower > 1)
+        escalated_passed = false;
+    }
+    escalated_passed =
+        escalated_passed &&
+        StatValue(test_graph_engine, "approximate_escalations") > escalations;
+
+    if (bounds_passed && unreachable_passed && escalated_passed) {
+      std::cout << "Testcase-16, Approximate distances from landmarks passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-16, Approximate distances from landmarks failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-17 Node reordering keeps client node ids
+     */
+    // Random graph posted once per node order, every order must give the
+    // same answers in client ids
+    std::mt19937 rng(17);
+    const uint32_t num_nodes = 300;
+    Request request;
+    request.set_graph_total_nodes(num_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < 3 * num_nodes; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(rng() % num_nodes);
+      edge->set_dest(rng() % num_nodes);
+    }
+
+    const graph::NodeOrder orders[] = {graph::ORIGINAL_ORDER, graph::RCM_ORDER,
+                                       graph::DEGREE_ORDER, graph::GORDER};
+    std::vector<std::string> answers;
+    for (graph::NodeOrder order : orders) {
+      request.set_graph_name("reordered_graph_" + std::to_string(order));
+      request.set_node_order(order);
+      uint64_t graph_id =
+          std::stoull(test_graph_engine->ProcessRequest(request));
+
+      std::string answer;
+      std::mt19937 query_rng(7);
+      for (uint32_t i = 0; i < 50; i++) {
+        Request min_request;
+        min_request.set_request_type(graph::GET_MIN_DISTANCE);
+        min_request.mutable_min_distance()->set_map_id(graph_id);
+        min_request.mutable_min_distance()->set_begin_node(query_rng() %
+                                                           num_nodes);
+        min_request.mutable_min_distance()->set_end_node(query_rng() %
+                                                         num_nodes);
+        answer += test_graph_engine->ProcessRequest(min_request) + "\n";
+      }
+
+      // Distances to all nodes, and a neighborhood sorted by node id
+      Request all_request;
+      all_request.set_request_type(graph::GET_DISTANCES);
+      all_request.mutable_multi_distance()->set_map_id(graph_id);
+      all_request.mutable_multi_distance()->set_begin_node(5);
+      all_request.mutable_multi_distance()->set_all_nodes(true);
+      Request neighborhood_request;
+      neighborhood_request.set_request_type(graph::GET_NEIGHBORHOOD);
+      neighborhood_request.mutable_neighborhood()->set_map_id(graph_id);
+      neighborhood_request.mutable_neighborhood()->set_begin_node(5);
+      neighborhood_request.mutable_neighborhood()->set_max_hops(2);
+      std::set<std::pair<uint32_t, uint32_t>> neighborhood;
+      for (Request *stream_request : {&all_request, &neighborhood_request}) {
+        StreamResultSharedPtr result =
+            test_graph_engine->ProcessStreamRequest(*stream_request);
+        graph::Response chunk;
+        while (result->NextChunk(&chunk)) {
+          for (int i = 0; i < chunk.distances_size(); i++) {
+            if (chunk.nodes_size() != 0)
+              neighborhood.insert(
+                  std::make_pair(chunk.nodes(i), chunk.distances(i)));
+            else
+              answer += std::to_string(chunk.distances(i)) + " ";
+          }
+        }
+      }
+      for (const auto &entry : neighborhood)
+        answer += std::to_string(entry.first) + ":" +
+                  std::to_string(entry.second) + " ";
+      answers.push_back(answer);
+    }
+
+    bool passed = true;
+    for (const std::string &answer : answers)
+      passed = passed && answer == answers[0];
+    if (passed) {
+      std::cout << "Testcase-17, Node reordering keeps client node ids passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-17, Node reordering keeps client node ids failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-18 Posted edges are validated, sorted and deduplicated
+     */
+    // An edge to a node outside the graph rejects the whole graph
+    Request invalid_request;
+    invalid_request.set_graph_name("invalid_edge_graph");
+    invalid_request.set_graph_total_nodes(3);
+    invalid_request.set_request_type(graph::POST_GRAPH);
+    graph::Edges *invalid_edge = invalid_request.add_adjacency_list();
+    invalid_edge->set_src(0);
+    invalid_edge->set_dest(3);
+    bool invalid_passed =
+        test_graph_engine->ProcessRequest(invalid_request)
+                .compare("ERROR: Node not present in graph") == 0;
+    invalid_edge->set_dest(2);
+    invalid_passed = invalid_passed &&
+                     test_graph_engine->ProcessRequest(invalid_request)
+                             .compare("ERROR: Graph already in DB") != 0;
+
+    // Duplicate edges keep their lowest weight
+    Request duplicate_request;
+    duplicate_request.set_graph_name("duplicate_edge_graph");
+    duplicate_request.set_graph_total_nodes(3);
+    duplicate_request.set_request_type(graph::POST_GRAPH);
+    duplicate_request.set_weight_type(graph::INTEGER_WEIGHTS);
+    const uint32_t duplicates[4][3] = {{0, 1, 7}, {1, 2, 1}, {0, 1, 2}, {0, 1, 5}};
+    for (const auto &e : duplicates) {
+      graph::Edges *edge = duplicate_request.add_adjacency_list();
+      edge->set_src(e[0]);
+      edge->set_dest(e[1]);
+      edge->set_weight(e[2]);
+    }
+    uint64_t duplicate_id =
+        std::stoull(test_graph_engine->ProcessRequest(duplicate_request));
+    Request weighted_request;
+    weighted_request.set_request_type(graph::GET_WEIGHTED_DISTANCE);
+    weighted_request.mutable_weighted_distance()->set_map_id(duplicate_id);
+    weighted_request.mutable_weighted_distance()->set_begin_node(0);
+    weighted_request.mutable_weighted_distance()->set_end_node(2);
+    bool duplicate_passed =
+        test_graph_engine->ProcessRequest(weighted_request)
+            .compare("OK, found weighted distance between 0 2 to be 3") == 0;
+
+    // Self-loops are not stored when the engine drops them
+    GraphEngineOptions loop_options;
+    loop_options.drop_self_loops = true;
+    GraphEngineSharedPtr loop_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(loop_options);
+    Request loop_request;
+    loop_request.set_graph_name("self_loop_graph");
+    loop_request.set_graph_total_nodes(2);
+    loop_request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t dest : {0, 1}) {
+      graph::Edges *edge = loop_request.add_adjacency_list();
+      edge->set_src(0);
+      edge->set_dest(dest);
+    }
+    uint64_t loop_id = std::stoull(loop_engine->ProcessRequest(loop_request));
+    Request remove_request;
+    remove_request.set_request_type(graph::REMOVE_EDGES);
+    remove_request.mutable_update_graph()->set_map_id(loop_id);
+    graph::Edges *loop_edge = remove_request.add_adjacency_list();
+    loop_edge->set_src(0);
+    loop_edge->set_dest(0);
+    bool loop_passed =
+        loop_engine->ProcessRequest(remove_request)
+            .compare("OK, removed 0 edges of graph with ID: " +
+                     std::to_string(loop_id) + ", version 1") == 0;
+
+    // A random multigraph ingested in parallel answers like the default
+    // engine, which ingests it on one thread
+    GraphEngineOptions parallel_options;
+    parallel_options.parallel_ingest_min_edges = 0;
+    parallel_options.ingest_threads = 4;
+    GraphEngineSharedPtr parallel_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(parallel_options);
+    std::mt19937 rng(18);
+    const uint32_t num_nodes = 500;
+    Request random_request;
+    random_request.set_graph_name("parallel_ingest_graph");
+    random_request.set_graph_total_nodes(num_nodes);
+    random_request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < 4 * num_nodes; i++) {
+      graph::Edges *edge = random_request.add_adjacency_list();
+      edge->set_src(rng() % num_nodes);
+      edge->set_dest(rng() % 50);
+    }
+    uint64_t serial_id =
+        std::stoull(test_graph_engine->ProcessRequest(random_request));
+    uint64_t parallel_id =
+        std::stoull(parallel_engine->ProcessRequest(random_request));
+    bool parallel_passed = true;
+    for (uint32_t i = 0; i < 100; i++) {
+      Request min_request;
+      min_request.set_request_type(graph::GET_MIN_DISTANCE);
+      min_request.mutable_min_distance()->set_begin_node(rng() % num_nodes);
+      min_request.mutable_min_distance()->set_end_node(rng() % num_nodes);
+      min_request.mutable_min_distance()->set_map_id(serial_id);
+      std::string serial = test_graph_engine->ProcessRequest(min_request);
+      min_request.mutable_min_distance()->set_map_id(parallel_id);
+      parallel_passed =
+          parallel_passed &&
+          serial.compare(parallel_engine->ProcessRequest(min_request)) == 0;
+    }
+
+    if (invalid_passed && duplicate_passed && loop_passed && parallel_passed) {
+      std::cout << "Testcase-18, Edge validation and deduplication on ingest "
+                   "passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-18, Edge validation and deduplication on ingest "
+                   "failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-19 Compressed adjacencies answer like plain ones
+     */
+    GraphEngineOptions plain_options;
+    plain_options.adjacency_encoding = GraphQueryEngine::PLAIN_ADJACENCY;
+    GraphEngineSharedPtr plain_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(plain_options);
+    GraphEngineOptions compressed_options;
+    compressed_options.adjacency_encoding =
+        GraphQueryEngine::COMPRESSED_ADJACENCY;
+    GraphEngineSharedPtr compressed_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(compressed_options);
+
+    // Random graph with a hub of high degree, unweighted and weighted
+    std::mt19937 rng(19);
+    const uint32_t num_nodes = 400;
+    Request request;
+    request.set_graph_total_nodes(num_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < 4 * num_nodes; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(i < 300 ? 7 : rng() % num_nodes);
+      edge->set_dest(rng() % num_nodes);
+      edge->set_weight(1 + rng() % 20);
+    }
+    request.set_graph_name("compressed_graph");
+    uint64_t plain_id = std::stoull(plain_engine->ProcessRequest(request));
+    uint64_t compressed_id =
+        std::stoull(compressed_engine->ProcessRequest(request));
+    request.set_graph_name("compressed_weighted_graph");
+    request.set_weight_type(graph::INTEGER_WEIGHTS);
+    uint64_t plain_weighted_id =
+        std::stoull(plain_engine->ProcessRequest(request));
+    uint64_t compressed_weighted_id =
+        std::stoull(compressed_engine->ProcessRequest(request));
+
+    // Edits on top of the compressed adjacency
+    for (graph::RequestType type : {graph::ADD_EDGES, graph::REMOVE_EDGES}) {
+      Request edit_request;
+      edit_request.set_request_type(type);
+      for (uint32_t i = 0; i < 50; i++) {
+        graph::Edges *edge = edit_request.add_adjacency_list();
+        edge->set_src(rng() % num_nodes);
+        edge->set_dest(rng() % num_nodes);
+      }
+      edit_request.mutable_update_graph()->set_map_id(plain_id);
+      plain_engine->ProcessRequest(edit_request);
+      edit_request.mutable_update_graph()->set_map_id(compressed_id);
+      compressed_engine->ProcessRequest(edit_request);
+    }
+
+    bool passed = true;
+    for (uint32_t i = 0; i < 100; i++) {
+      uint32_t src = i < 10 ? 7 : rng() % num_nodes;
+      uint32_t dest = rng() % num_nodes;
+      Request min_request;
+      min_request.set_request_type(graph::GET_MIN_DISTANCE);
+      min_request.mutable_min_distance()->set_begin_node(src);
+      min_request.mutable_min_distance()->set_end_node(dest);
+      min_request.mutable_min_distance()->set_map_id(plain_id);
+      std::string plain = plain_engine->ProcessRequest(min_request);
+      min_request.mutable_min_distance()->set_map_id(compressed_id);
+      passed = passed &&
+               plain.compare(compressed_engine->ProcessRequest(min_request)) == 0;
+
+      Request weighted_request;
+      weighted_request.set_request_type(graph::GET_WEIGHTED_DISTANCE);
+      weighted_request.mutable_weighted_distance()->set_begin_node(src);
+      weighted_request.mutable_weighted_distance()->set_end_node(dest);
+      weighted_request.mutable_weighted_distance()->set_map_id(
+          plain_weighted_id);
+      plain = plain_engine->ProcessRequest(weighted_request);
+      weighted_request.mutable_weighted_distance()->set_map_id(
+          compressed_weighted_id);
+      passed = passed && plain.compare(compressed_engine->ProcessRequest(
+                             weighted_request)) == 0;
+    }
+
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = compressed_engine->ProcessRequest(stats_request);
+    passed = passed &&
+             stats.find(std::to_string(compressed_id) + ":compressed:") !=
+                 std::string::npos &&
+             plain_engine->ProcessRequest(stats_request)
+                     .find(std::to_string(plain_id) + ":plain:") !=
+                 std::string::npos;
+    if (passed) {
+      std::cout << "Testcase-19, Compressed adjacencies answer like plain ones "
+                   "passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-19, Compressed adjacencies answer like plain ones "
+                   "failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-20 Graphs with 16 bit node ids
+     */
+    // Directed paths with the most nodes 16 bit ids allow, and one more
+    std::string answers[2];
+    std::string stats_entries[2];
+    const uint32_t path_nodes[2] = {65534, 65535};
+    for (uint32_t i = 0; i < 2; i++) {
+      Request request;
+      request.set_graph_name("long_path_graph_" + std::to_string(i));
+      request.set_graph_total_nodes(path_nodes[i]);
+      request.set_request_type(graph::POST_GRAPH);
+      for (uint32_t u = 0; u + 1 < path_nodes[i]; u++) {
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(u);
+        edge->set_dest(u + 1);
+      }
+      uint64_t graph_id =
+          std::stoull(test_graph_engine->ProcessRequest(request));
+
+      for (uint32_t dest : {path_nodes[i] - 1, 0u}) {
+        Request min_request;
+        min_request.set_request_type(graph::GET_MIN_DISTANCE);
+        min_request.mutable_min_distance()->set_map_id(graph_id);
+        min_request.mutable_min_distance()->set_begin_node(path_nodes[i] - 1 - dest);
+        min_request.mutable_min_distance()->set_end_node(dest);
+        answers[i] += test_graph_engine->ProcessRequest(min_request) + "\n";
+      }
+      Request all_request;
+      all_request.set_request_type(graph::GET_DISTANCES);
+      all_request.mutable_multi_distance()->set_map_id(graph_id);
+      all_request.mutable_multi_distance()->set_begin_node(1);
+      all_request.mutable_multi_distance()->set_all_nodes(true);
+      StreamResultSharedPtr result =
+          test_graph_engine->ProcessStreamRequest(all_request);
+      answers[i] += std::to_string(result->distances.front()) + " " +
+                    std::to_string(result->distances.back());
+      stats_entries[i] = std::to_string(graph_id) + ":plain:";
+    }
+
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = test_graph_engine->ProcessRequest(stats_request);
+    auto id_bits = [&](const std::string &entry) {
+      size_t pos = stats.find(entry);
+      if (pos == std::string::npos)
+        return std::string();
+      pos = stats.find(':', pos + entry.size());
+      return stats.substr(pos + 1, 2);
+    };
+
+    std::string unreachable =
+        std::to_string(std::numeric_limits<uint32_t>::max());
+    bool passed =
+        answers[0].compare("OK, found minimum distance between 0 65533 to be "
+                           "65533\nOK, found minimum distance between 65533 0 "
+                           "to be " + unreachable + "\n" + unreachable +
+                           " 65532") == 0 &&
+        answers[1].compare("OK, found minimum distance between 0 65534 to be "
+                           "65534\nOK, found minimum distance between 65534 0 "
+                           "to be " + unreachable + "\n" + unreachable +
+                           " 65533") == 0 &&
+        id_bits(stats_entries[0]) == "16" && id_bits(stats_entries[1]) == "32";
+    if (passed) {
+      std::cout << "Testcase-20, Graphs with 16 bit node ids passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-20, Graphs with 16 bit node ids failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-21 Undirected graphs stored once
+     */
+    // The same random graph posted undirected, and directed with both
+    // directions of every edge
+    std::mt19937 rng(21);
+    const uint32_t num_nodes = 300;
+    Request undirected_request;
+    undirected_request.set_graph_total_nodes(num_nodes);
+    undirected_request.set_request_type(graph::POST_GRAPH);
+    undirected_request.set_undirected(true);
+    Request directed_request = undirected_request;
+    directed_request.set_undirected(false);
+    for (uint32_t i = 0; i < 3 * num_nodes; i++) {
+      uint32_t src = rng() % num_nodes;
+      uint32_t dest = rng() % num_nodes;
+      graph::Edges *edge = undirected_request.add_adjacency_list();
+      edge->set_src(src);
+      edge->set_dest(dest);
+      for (uint32_t direction = 0; direction < 2; direction++) {
+        edge = directed_request.add_adjacency_list();
+        edge->set_src(direction == 0 ? src : dest);
+        edge->set_dest(direction == 0 ? dest : src);
+      }
+    }
+    undirected_request.set_graph_name("undirected_graph");
+    directed_request.set_graph_name("undirected_twin_graph");
+    uint64_t undirected_id =
+        std::stoull(test_graph_engine->ProcessRequest(undirected_request));
+    uint64_t directed_id =
+        std::stoull(test_graph_engine->ProcessRequest(directed_request));
+
+    auto same_answers = [&]() {
+      bool same = true;
+      for (uint32_t i = 0; i < 50 && same; i++) {
+        Request min_request;
+        min_request.set_request_type(graph::GET_MIN_DISTANCE);
+        min_request.mutable_min_distance()->set_begin_node(rng() % num_nodes);
+        min_request.mutable_min_distance()->set_end_node(rng() % num_nodes);
+        min_request.mutable_min_distance()->set_map_id(undirected_id);
+        std::string undirected =
+            test_graph_engine->ProcessRequest(min_request);
+        min_request.mutable_min_distance()->set_map_id(directed_id);
+        same = undirected.compare(
+                   test_graph_engine->ProcessRequest(min_request)) == 0;
+      }
+      for (uint32_t i = 0; i < 5 && same; i++) {
+        Request all_request;
+        all_request.set_request_type(graph::GET_DISTANCES);
+        all_request.mutable_multi_distance()->set_begin_node(rng() % num_nodes);
+        all_request.mutable_multi_distance()->set_all_nodes(true);
+        all_request.mutable_multi_distance()->set_map_id(undirected_id);
+        StreamResultSharedPtr undirected =
+            test_graph_engine->ProcessStreamRequest(all_request);
+        all_request.mutable_multi_distance()->set_map_id(directed_id);
+        StreamResultSharedPtr directed =
+            test_graph_engine->ProcessStreamRequest(all_request);
+        same = undirected->distances == directed->distances;
+      }
+      return same;
+    };
+    bool passed = same_answers();
+
+    // Edits of the undirected graph apply to both directions
+    for (graph::RequestType type : {graph::REMOVE_EDGES, graph::ADD_EDGES}) {
+      Request undirected_edit;
+      undirected_edit.set_request_type(type);
+      undirected_edit.mutable_update_graph()->set_map_id(undirected_id);
+      Request directed_edit = undirected_edit;
+      directed_edit.mutable_update_graph()->set_map_id(directed_id);
+      for (uint32_t i = 0; i < 40; i++) {
+        const graph::Edges &posted =
+            undirected_request.adjacency_list(rng() % num_nodes);
+        uint32_t src = type == graph::ADD_EDGES ? rng() % num_nodes
+                                                : posted.src();
+        uint32_t dest = type == graph::ADD_EDGES ? rng() % num_nodes
+                                                 : posted.dest();
+        graph::Edges *edge = undirected_edit.add_adjacency_list();
+        edge->set_src(dest);
+        edge->set_dest(src);
+        for (uint32_t direction = 0; direction < 2; direction++) {
+          edge = directed_edit.add_adjacency_list();
+          edge->set_src(direction == 0 ? src : dest);
+          edge->set_dest(direction == 0 ? dest : src);
+        }
+      }
+      test_graph_engine->ProcessRequest(undirected_edit);
+      test_graph_engine->ProcessRequest(directed_edit);
+    }
+    passed = passed && same_answers();
+
+    // Only one side of every landmark is kept for the undirected graph
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = test_graph_engine->ProcessRequest(stats_request);
+    auto sketch_bytes = [&](uint64_t graph_id) -> uint64_t {
+      std::string entry = std::to_string(graph_id) + ":";
+      size_t pos = stats.find(" landmark_sketches=");
+      pos = stats.find(entry, pos);
+      while (pos != std::string::npos && stats[pos - 1] != '=' &&
+             stats[pos - 1] != ',')
+        pos = stats.find(entry, pos + 1);
+      if (pos == std::string::npos)
+        return 0;
+      return std::stoull(stats.substr(pos + entry.size()));
+    };
+    passed = passed && sketch_bytes(undirected_id) > 0 &&
+             2 * sketch_bytes(undirected_id) == sketch_bytes(directed_id);
+
+    // An undirected path posted once is still answered as a forest
+    Request path_request;
+    path_request.set_graph_name("undirected_path_graph");
+    path_request.set_graph_total_nodes(100);
+    path_request.set_request_type(graph::POST_GRAPH);
+    path_request.set_undirected(true);
+    for (uint32_t u = 0; u + 1 < 100; u++) {
+      graph::Edges *edge = path_request.add_adjacency_list();
+      edge->set_src(u + 1);
+      edge->set_dest(u);
+    }
+    uint64_t path_id =
+        std::stoull(test_graph_engine->ProcessRequest(path_request));
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(path_id);
+    min_request.mutable_min_distance()->set_begin_node(10);
+    min_request.mutable_min_distance()->set_end_node(90);
+    passed = passed && test_graph_engine->ProcessRequest(min_request).compare(
+                           "OK, found minimum distance between 10 90 to be "
+                           "80") == 0;
+    if (passed) {
+      std::cout << "Testcase-21, Undirected graphs stored once passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-21, Undirected graphs stored once failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-22 Graphs spilled over the memory budget
+     */
+    // A budget no graph fits in keeps only the graph queried last in memory
+    GraphEngineOptions budget_options;
+    budget_options.memory_budget_bytes = 1;
+    budget_options.adjacency_encoding = GraphQueryEngine::COMPRESSED_ADJACENCY;
+    GraphEngineSharedPtr budget_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(budget_options);
+    GraphEngineSharedPtr reference_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>();
+
+    // Unweighted, weighted, undirected and reordered graphs
+    std::mt19937 rng(22);
+    const uint32_t num_nodes = 500;
+    const uint32_t num_graphs = 4;
+    uint64_t graph_ids[num_graphs];
+    for (uint32_t g = 0; g < num_graphs; g++) {
+      Request request;
+      request.set_graph_name("spilled_graph_" + std::to_string(g));
+      request.set_graph_total_nodes(num_nodes);
+      request.set_request_type(graph::POST_GRAPH);
+      if (g == 1)
+        request.set_weight_type(graph::INTEGER_WEIGHTS);
+      request.set_undirected(g == 2);
+      if (g == 3)
+        request.set_node_order(graph::RCM_ORDER);
+      for (uint32_t i = 0; i < 3 * num_nodes; i++) {
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(rng() % num_nodes);
+        edge->set_dest(rng() % num_nodes);
+        edge->set_weight(1 + rng() % 9);
+      }
+      graph_ids[g] = std::stoull(budget_engine->ProcessRequest(request));
+      reference_engine->ProcessRequest(request);
+    }
+
+    bool passed = true;
+    for (uint32_t round = 0; round < 40; round++) {
+      uint32_t g = rng() % num_graphs;
+      uint32_t src = rng() % num_nodes;
+      uint32_t dest = rng() % num_nodes;
+      Request query;
+      if (round % 10 == 9) {
+        // Edits land on the graph read back from disk
+        query.set_request_type(graph::ADD_EDGES);
+        query.mutable_update_graph()->set_map_id(graph_ids[g == 1 ? 0 : g]);
+        graph::Edges *edge = query.add_adjacency_list();
+        edge->set_src(src);
+        edge->set_dest(dest);
+      } else if (g == 1) {
+        query.set_request_type(graph::GET_WEIGHTED_DISTANCE);
+        query.mutable_weighted_distance()->set_map_id(graph_ids[g]);
+        query.mutable_weighted_distance()->set_begin_node(src);
+        query.mutable_weighted_distance()->set_end_node(dest);
+      } else if (g == 2) {
+        query.set_request_type(graph::GET_DISTANCES);
+        query.mutable_multi_distance()->set_map_id(graph_ids[g]);
+        query.mutable_multi_distance()->set_begin_node(src);
+        query.mutable_multi_distance()->set_all_nodes(true);
+        StreamResultSharedPtr spilled =
+            budget_engine->ProcessStreamRequest(query);
+        StreamResultSharedPtr resident =
+            reference_engine->ProcessStreamRequest(query);
+        passed = passed && spilled->distances == resident->distances;
+        continue;
+      } else {
+        query.set_request_type(graph::GET_MIN_DISTANCE);
+        query.mutable_min_distance()->set_map_id(graph_ids[g]);
+        query.mutable_min_distance()->set_begin_node(src);
+        query.mutable_min_distance()->set_end_node(dest);
+      }
+      passed = passed && budget_engine->ProcessRequest(query).compare(
+                             reference_engine->ProcessRequest(query)) == 0;
+    }
+
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = budget_engine->ProcessRequest(stats_request);
+    passed = passed && StatValue(stats, "spilled_graphs") == num_graphs - 1 &&
+             StatValue(stats, "spilled_graph_bytes") > 0 &&
+             StatValue(stats, "graph_spills") >= num_graphs - 1 &&
+             StatValue(stats, "graph_fault_ins") > 0;
+    if (passed) {
+      std::cout << "Testcase-22, Graphs spilled over the memory budget passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-22, Graphs spilled over the memory budget failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-23 Graphs traversed out of core
+     */
+    // Graphs that alone exceed the budget are read from their spill file by
+    // every traversal, with narrow, wide and compressed neighbor lists
+    bool passed = true;
+    std::mt19937 rng(23);
+    const GraphQueryEngine::AdjacencyEncoding encodings[] = {
+        GraphQueryEngine::PLAIN_ADJACENCY,
+        GraphQueryEngine::COMPRESSED_ADJACENCY};
+    for (GraphQueryEngine::AdjacencyEncoding encoding : encodings) {
+      GraphEngineOptions external_options;
+      external_options.memory_budget_bytes = 1;
+      external_options.out_of_core = true;
+      external_options.adjacency_encoding = encoding;
+      GraphEngineSharedPtr external_engine =
+          std::make_shared<GraphQueryEngine::GraphEngine>(external_options);
+      GraphEngineOptions reference_options;
+      reference_options.adjacency_encoding = encoding;
+      GraphEngineSharedPtr reference_engine =
+          std::make_shared<GraphQueryEngine::GraphEngine>(reference_options);
+
+      // Node ids past 16 bits keep the plain lists 32 bit wide
+      const uint32_t sizes[] = {500, 70000};
+      uint64_t graph_ids[2];
+      for (uint32_t g = 0; g < 2; g++) {
+        Request request;
+        request.set_graph_name("out_of_core_graph_" + std::to_string(g));
+        request.set_graph_total_nodes(sizes[g]);
+        request.set_request_type(graph::POST_GRAPH);
+        request.set_undirected(g == 1);
+        for (uint32_t i = 0; i < 3 * sizes[g]; i++) {
+          graph::Edges *edge = request.add_adjacency_list();
+          edge->set_src(rng() % sizes[g]);
+          edge->set_dest(rng() % sizes[g]);
+        }
+        graph_ids[g] = std::stoull(external_engine->ProcessRequest(request));
+        reference_engine->ProcessRequest(request);
+      }
+
+      for (uint32_t round = 0; round < 20; round++) {
+        uint32_t g = round % 2;
+        uint32_t src = rng() % sizes[g];
+        uint32_t dest = rng() % sizes[g];
+        Request query;
+        query.set_request_type(graph::GET_MIN_DISTANCE);
+        query.mutable_min_distance()->set_map_id(graph_ids[g]);
+        query.mutable_min_distance()->set_begin_node(src);
+        query.mutable_min_distance()->set_end_node(dest);
+        query.mutable_min_distance()->set_max_hops(round % 4 == 3 ? 3 : 0);
+        passed = passed && external_engine->ProcessRequest(query).compare(
+                               reference_engine->ProcessRequest(query)) == 0;
+
+        query.set_request_type(graph::GET_DISTANCES);
+        query.mutable_multi_distance()->set_map_id(graph_ids[g]);
+        query.mutable_multi_distance()->set_begin_node(src);
+        query.mutable_multi_distance()->set_all_nodes(round % 2 == 0);
+        query.mutable_multi_distance()->add_end_nodes(dest);
+        StreamResultSharedPtr external =
+            external_engine->ProcessStreamRequest(query);
+        StreamResultSharedPtr resident =
+            reference_engine->ProcessStreamRequest(query);
+        passed = passed && external->distances == resident->distances &&
+                 !external->distances.empty();
+      }
+
+      // Only hop distances are answered from disk
+      Request edit;
+      edit.set_request_type(graph::ADD_EDGES);
+      edit.mutable_update_graph()->set_map_id(graph_ids[0]);
+      graph::Edges *edge = edit.add_adjacency_list();
+      edge->set_src(0);
+      edge->set_dest(1);
+      passed = passed &&
+               external_engine->ProcessRequest(edit).compare(
+                   "ERROR: Request not supported on graphs traversed out of "
+                   "core") == 0;
+
+      Request stats_request;
+      stats_request.set_request_type(graph::GET_SERVER_STATS);
+      std::string stats = external_engine->ProcessRequest(stats_request);
+      passed = passed && StatValue(stats, "out_of_core_graphs") == 2 &&
+               StatValue(stats, "out_of_core_traversals") > 0 &&
+               StatValue(stats, "out_of_core_reads") > 0 &&
+               StatValue(stats, "out_of_core_read_bytes") > 0 &&
+               StatValue(stats, "graph_fault_ins") == 0;
+    }
+    if (passed) {
+      std::cout << "Testcase-23, Graphs traversed out of core passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-23, Graphs traversed out of core failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-24 NUMA and huge page placement of large graphs
+     */
+    // Every graph is large enough to be placed. Machines with a single
+    // memory node fall back to huge pages alone.
+    bool passed = true;
+    std::mt19937 rng(24);
+    const GraphQueryEngine::MemoryPlacement placements[] = {
+        GraphQueryEngine::INTERLEAVE_PLACEMENT,
+        GraphQueryEngine::REPLICATE_PLACEMENT};
+    for (GraphQueryEngine::MemoryPlacement placement : placements) {
+      GraphEngineOptions placed_options;
+      placed_options.placement.placement = placement;
+      placed_options.placement.huge_pages = true;
+      placed_options.placement.min_bytes = 0;
+      GraphEngineSharedPtr placed_engine =
+          std::make_shared<GraphQueryEngine::GraphEngine>(placed_options);
+      GraphEngineSharedPtr reference_engine =
+          std::make_shared<GraphQueryEngine::GraphEngine>();
+
+      const uint32_t num_nodes = 2000;
+      Request request;
+      request.set_graph_name("placed_graph");
+      request.set_graph_total_nodes(num_nodes);
+      request.set_request_type(graph::POST_GRAPH);
+      for (uint32_t i = 0; i < 4 * num_nodes; i++) {
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(rng() % num_nodes);
+        edge->set_dest(rng() % num_nodes);
+      }
+      uint64_t graph_id = std::stoull(placed_engine->ProcessRequest(request));
+      reference_engine->ProcessRequest(request);
+
+      // Edits go to the delta on top of the replicas, enough of them fold
+      // into a new adjacency that is placed again
+      for (uint32_t round = 0; round < 30; round++) {
+        Request query;
+        if (round % 10 == 5) {
+          query.set_request_type(graph::ADD_EDGES);
+          query.mutable_update_graph()->set_map_id(graph_id);
+          for (uint32_t i = 0; i < 1000; i++) {
+            graph::Edges *edge = query.add_adjacency_list();
+            edge->set_src(rng() % num_nodes);
+            edge->set_dest(rng() % num_nodes);
+          }
+        } else {
+          query.set_request_type(graph::GET_MIN_DISTANCE);
+          query.mutable_min_distance()->set_map_id(graph_id);
+          query.mutable_min_distance()->set_begin_node(rng() % num_nodes);
+          query.mutable_min_distance()->set_end_node(rng() % num_nodes);
+        }
+        passed = passed && placed_engine->ProcessRequest(query).compare(
+                               reference_engine->ProcessRequest(query)) == 0;
+      }
+
+      Request stats_request;
+      stats_request.set_request_type(graph::GET_SERVER_STATS);
+      std::string stats = placed_engine->ProcessRequest(stats_request);
+      uint64_t memory_nodes = StatValue(stats, "memory_nodes");
+      uint64_t replicas =
+          placement == GraphQueryEngine::REPLICATE_PLACEMENT
+              ? memory_nodes - 1
+              : 0;
+      passed = passed && memory_nodes >= 1 &&
+               StatValue(stats, "adjacency_replicas") == replicas &&
+               stats.find(std::string(" memory_placement=") +
+                          GraphQueryEngine::PlacementName(placement)) !=
+                   std::string::npos;
+    }
+    if (passed) {
+      std::cout << "Testcase-24, NUMA and huge page placement of large graphs "
+                   "passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-24, NUMA and huge page placement of large graphs "
+                   "failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-25 Graphs built in the background
+     */
+    bool passed = true;
+    GraphEngineSharedPtr async_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>();
+    GraphEngineSharedPtr reference_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>();
+
+    const uint32_t num_nodes = 200000;
+    Request request;
+    request.set_graph_name("async_graph");
+    request.set_graph_total_nodes(num_nodes);
+    request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t i = 0; i < num_nodes; i++) {
+      graph::Edges *edge = request.add_adjacency_list();
+      edge->set_src(i);
+      edge->set_dest((i + 1) % num_nodes);
+    }
+    std::string expected_id = reference_engine->ProcessRequest(request);
+    Request async_request = request;
+    async_request.set_async_build(true);
+    std::string graph_id = async_engine->ProcessRequest(async_request);
+    passed = passed && graph_id.compare(expected_id) == 0 &&
+             async_request.adjacency_list_size() == 0;
+    // The id is reserved while the graph is being built
+    Request duplicate = request;
+    duplicate.set_async_build(true);
+    passed = passed && async_engine->ProcessRequest(duplicate).compare(
+                           "ERROR: Graph already in DB") == 0;
+
+    // Queries either wait for the build or are told it is not ready
+    Request waiting;
+    waiting.set_request_type(graph::GET_MIN_DISTANCE);
+    waiting.set_wait_ready(true);
+    waiting.mutable_min_distance()->set_map_id(std::stoull(graph_id));
+    waiting.mutable_min_distance()->set_begin_node(0);
+    waiting.mutable_min_distance()->set_end_node(num_nodes - 1);
+    std::string expected = reference_engine->ProcessRequest(waiting);
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    std::string waited;
+    async_engine->ProcessRequestAsync(
+        waiting, [&](const std::string &message) {
+          std::lock_guard<std::mutex> guard(done_mutex);
+          waited = message;
+          done_cv.notify_all();
+        });
+    Request early = waiting;
+    early.set_wait_ready(false);
+    std::string early_result = async_engine->ProcessRequest(early);
+    passed = passed &&
+             (early_result.compare("NOT_READY: Graph is still being built") ==
+                  0 ||
+              early_result.compare(expected) == 0);
+    {
+      std::unique_lock<std::mutex> lock(done_mutex);
+      done_cv.wait(lock, [&] { return !waited.empty(); });
+    }
+    passed = passed && waited.compare(expected) == 0;
+
+    Request status;
+    status.set_request_type(graph::GET_GRAPH_STATUS);
+    status.mutable_graph_status()->set_map_id(std::stoull(graph_id));
+    passed = passed &&
+             async_engine->ProcessRequest(status).compare(
+                 "OK, graph " + graph_id + " is ready") == 0 &&
+             async_engine->ProcessRequest(early).compare(expected) == 0;
+
+    // A build that fails is reported by the status request, the graph can
+    // then be posted again
+    Request bad = request;
+    bad.set_graph_name("async_bad_graph");
+    bad.mutable_adjacency_list(7)->set_dest(num_nodes);
+    Request bad_async = bad;
+    bad_async.set_async_build(true);
+    uint64_t bad_id = std::stoull(async_engine->ProcessRequest(bad_async));
+    status.mutable_graph_status()->set_map_id(bad_id);
+    std::string bad_status;
+    for (uint32_t i = 0; i < 1000; i++) {
+      bad_status = async_engine->ProcessRequest(status);
+      if (bad_status.compare(0, 10, "NOT_READY:") != 0)
+        break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    passed = passed &&
+             bad_status.compare(0, 27, "ERROR: Graph build failed, ") == 0;
+    bad.mutable_adjacency_list(7)->set_dest(0);
+    passed = passed &&
+             async_engine->ProcessRequest(bad).compare(std::to_string(bad_id)) ==
+                 0;
+
+    // A graph deleted while it is being built is dropped once built
+    Request deleted = request;
+    deleted.set_graph_name("async_deleted_graph");
+    deleted.set_async_build(true);
+    uint64_t deleted_id = std::stoull(async_engine->ProcessRequest(deleted));
+    Request delete_request;
+    delete_request.set_request_type(graph::DELETE_GRAPH);
+    delete_request.mutable_delete_graph()->set_map_id(deleted_id);
+    passed = passed && async_engine->ProcessRequest(delete_request).compare(
+                           "OK, deleted graph with ID: " +
+                           std::to_string(deleted_id)) == 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    status.mutable_graph_status()->set_map_id(deleted_id);
+    passed = passed && async_engine->ProcessRequest(status).compare(
+                           "ERROR: Graph not present in DB") == 0;
+
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = async_engine->ProcessRequest(stats_request);
+    passed = passed &&
+             stats.find(" async_graph_builds=3 ") != std::string::npos &&
+             stats.find(" graph_builds_pending=0 ") != std::string::npos &&
+             stats.find(" graph_build_failures=1 ") != std::string::npos;
+    if (passed) {
+      std::cout << "Testcase-25, Graphs built in the background passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-25, Graphs built in the background failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-26 Connected components, PageRank and degree histogram jobs
+     */
+    bool passed = true;
+    GraphEngineOptions job_options;
+    job_options.analytics_threads = 3;
+    GraphEngineSharedPtr job_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(job_options);
+    std::mt19937 rng(26);
+
+    // Run a job to its end and collect its streamed result
+    auto run_job = [&](uint64_t graph_id, graph::JobType type,
+                       graph::Response *all) {
+      Request submit;
+      submit.set_request_type(graph::SUBMIT_JOB);
+      submit.mutable_job()->set_map_id(graph_id);
+      submit.mutable_job()->set_job_type(type);
+      submit.mutable_job()->set_max_iterations(30);
+      submit.mutable_job()->set_tolerance(1e-12);
+      std::string reply = job_engine->ProcessRequest(submit);
+      uint64_t job_id = std::stoull(reply.substr(reply.rfind(' ') + 1));
+      Request status;
+      status.set_request_type(graph::GET_JOB_STATUS);
+      status.mutable_job()->set_job_id(job_id);
+      std::string state = job_engine->ProcessRequest(status);
+      while (state.compare(0, 10, "NOT_READY:") == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        state = job_engine->ProcessRequest(status);
+      }
+      Request fetch;
+      fetch.set_request_type(graph::GET_JOB_RESULT);
+      fetch.mutable_job()->set_job_id(job_id);
+      StreamResultSharedPtr result = job_engine->ProcessStreamRequest(fetch);
+      graph::Response chunk;
+      all->Clear();
+      while (result->NextChunk(&chunk)) {
+        if (!chunk.message().empty())
+          all->set_message(chunk.message());
+        all->mutable_distances()->MergeFrom(chunk.distances());
+        all->mutable_nodes()->MergeFrom(chunk.nodes());
+        all->mutable_scores()->MergeFrom(chunk.scores());
+      }
+      return state.compare(0, 4, "OK, ") == 0;
+    };
+
+    // Clusters of nodes linked within, a few clusters linked to each other
+    const uint32_t num_nodes = 20000;
+    std::set<std::pair<uint32_t, uint32_t>> edge_set;
+    for (uint32_t i = 0; i < 3 * num_nodes; i++) {
+      uint32_t src = rng() % num_nodes;
+      uint32_t dest = src / 100 * 100 + rng() % 100;
+      if (rng() % 500 == 0)
+        dest = rng() % num_nodes;
+      if (src / 100 % 7 != 3 && dest < num_nodes)
+        edge_set.insert(std::make_pair(src, dest));
+    }
+    const graph::NodeOrder orders[] = {graph::ORIGINAL_ORDER, graph::RCM_ORDER};
+    for (bool undirected : {false, true}) {
+      std::vector<std::vector<uint32_t>> out(num_nodes);
+      std::vector<std::vector<uint32_t>> in(num_nodes);
+      for (const auto &e : edge_set) {
+        if (undirected && e.first > e.second &&
+            edge_set.count(std::make_pair(e.second, e.first)) != 0)
+          continue;
+        out[e.first].push_back(e.second);
+        in[e.second].push_back(e.first);
+        if (undirected && e.first != e.second) {
+          out[e.second].push_back(e.first);
+          in[e.first].push_back(e.second);
+        }
+      }
+
+      // Components from a sequential union-find, named by their smallest
+      // node
+      std::vector<uint32_t> parent(num_nodes);
+      for (uint32_t node = 0; node < num_nodes; node++)
+        parent[node] = node;
+      std::function<uint32_t(uint32_t)> find = [&](uint32_t node) {
+        return parent[node] == node ? node : parent[node] = find(parent[node]);
+      };
+      for (uint32_t node = 0; node < num_nodes; node++) {
+        for (uint32_t next : out[node]) {
+          uint32_t a = find(node), b = find(next);
+          parent[std::max(a, b)] = std::min(a, b);
+        }
+      }
+      // PageRank from a sequential power iteration
+      std::vector<double> rank(num_nodes, 1.0 / num_nodes);
+      for (uint32_t iteration = 0; iteration < 30; iteration++) {
+        double dangling = 0;
+        for (uint32_t node = 0; node < num_nodes; node++)
+          dangling += out[node].empty() ? rank[node] : 0;
+        std::vector<double> next(num_nodes,
+                                 (0.15 + 0.85 * dangling) / num_nodes);
+        for (uint32_t node = 0; node < num_nodes; node++) {
+          for (uint32_t source : in[node])
+            next[node] += 0.85 * rank[source] / out[source].size();
+        }
+        rank.swap(next);
+      }
+
+      for (graph::NodeOrder order : orders) {
+        Request request;
+        request.set_graph_name("job_graph_" + std::to_string(undirected) +
+                               "_" + std::to_string(order));
+        request.set_graph_total_nodes(num_nodes);
+        request.set_request_type(graph::POST_GRAPH);
+        request.set_undirected(undirected);
+        request.set_node_order(order);
+        for (const auto &e : edge_set) {
+          graph::Edges *edge = request.add_adjacency_list();
+          edge->set_src(e.first);
+          edge->set_dest(e.second);
+        }
+        uint64_t graph_id = std::stoull(job_engine->ProcessRequest(request));
+
+        graph::Response components;
+        passed = passed &&
+                 run_job(graph_id, graph::CONNECTED_COMPONENTS, &components) &&
+                 components.distances_size() == int(num_nodes);
+        for (uint32_t node = 0; node < num_nodes && passed; node++)
+          passed = components.distances(node) == find(node);
+
+        graph::Response ranks;
+        passed = passed && run_job(graph_id, graph::PAGERANK, &ranks) &&
+                 ranks.scores_size() == int(num_nodes) &&
+                 ranks.message().compare(
+                     "OK, computed PageRank in 30 iterations") == 0;
+        for (uint32_t node = 0; node < num_nodes && passed; node++)
+          passed = std::fabs(ranks.scores(node) - rank[node]) < 1e-6;
+
+        graph::Response degrees;
+        passed = passed && run_job(graph_id, graph::DEGREE_HISTOGRAM, &degrees);
+        std::map<uint32_t, uint32_t> histogram;
+        for (uint32_t node = 0; node < num_nodes; node++)
+          histogram[out[node].size()]++;
+        passed = passed && degrees.nodes_size() == int(histogram.size());
+        for (int i = 0; i < degrees.nodes_size() && passed; i++)
+          passed = histogram[degrees.nodes(i)] == degrees.distances(i);
+      }
+    }
+
+    // Jobs run on the latest version, an inserted edge joins two components
+    Request request;
+    request.set_graph_name("job_edit_graph");
+    request.set_graph_total_nodes(4);
+    request.set_request_type(graph::POST_GRAPH);
+    graph::Edges *edge = request.add_adjacency_list();
+    edge->set_src(0);
+    edge->set_dest(1);
+    edge = request.add_adjacency_list();
+    edge->set_src(3);
+    edge->set_dest(2);
+    uint64_t graph_id = std::stoull(job_engine->ProcessRequest(request));
+    Request add;
+    add.set_request_type(graph::ADD_EDGES);
+    add.mutable_update_graph()->set_map_id(graph_id);
+    edge = add.add_adjacency_list();
+    edge->set_src(2);
+    edge->set_dest(1);
+    job_engine->ProcessRequest(add);
+    graph::Response components;
+    passed = passed &&
+             run_job(graph_id, graph::CONNECTED_COMPONENTS, &components) &&
+             components.message().compare(
+                 "OK, found 1 connected components, the largest has 4 "
+                 "nodes") == 0;
+
+    Request missing;
+    missing.set_request_type(graph::GET_JOB_STATUS);
+    missing.mutable_job()->set_job_id(12345);
+    Request unary_fetch;
+    unary_fetch.set_request_type(graph::GET_JOB_RESULT);
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = job_engine->ProcessRequest(stats_request);
+    passed = passed &&
+             job_engine->ProcessRequest(missing).compare(
+                 "ERROR: Job not present") == 0 &&
+             job_engine->ProcessRequest(unary_fetch).compare(0, 6, "ERROR:") ==
+                 0 &&
+             stats.find(" analytics_jobs=13 ") != std::string::npos &&
+             stats.find(" analytics_jobs_pending=0 ") != std::string::npos;
+    if (passed) {
+      std::cout << "Testcase-26, Connected components, PageRank and degree "
+                   "histogram jobs passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-26, Connected components, PageRank and degree "
+                   "histogram jobs failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-27 Cost based query plans agree with a plain traversal
+     */
+    bool passed = true;
+    GraphEngineSharedPtr plan_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>();
+    std::mt19937 rng(27);
+    const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+
+    // Hop distance from src to dest over out-going lists
+    auto reference_distance = [&](const std::vector<std::vector<uint32_t>> &out,
+                                  uint32_t src, uint32_t dest) {
+      std::vector<uint32_t> distance(out.size(), kUnreachable);
+      std::vector<uint32_t> frontier(1, src);
+      distance[src] = 0;
+      for (size_t i = 0; i < frontier.size(); i++) {
+        for (uint32_t next : out[frontier[i]]) {
+          if (distance[next] == kUnreachable) {
+            distance[next] = distance[frontier[i]] + 1;
+            frontier.push_back(next);
+          }
+        }
+      }
+      return distance[dest];
+    };
+
+    // Grid, sparse random, DAG and forest shapes, undirected ones listing
+    // every edge in one direction
+    const uint32_t num_nodes = 2500;
+    for (uint32_t shape = 0; shape < 4; shape++) {
+      bool undirected = shape == 0 || shape == 3;
+      std::vector<std::vector<uint32_t>> out(num_nodes);
+      Request request;
+      request.set_graph_name("planned_graph_" + std::to_string(shape));
+      request.set_graph_total_nodes(num_nodes);
+      request.set_request_type(graph::POST_GRAPH);
+      request.set_undirected(undirected);
+      std::set<std::pair<uint32_t, uint32_t>> edge_set;
+      auto add_edge = [&](uint32_t src, uint32_t dest) {
+        // Repeated edges are stored once
+        if (!edge_set.insert(std::make_pair(src, dest)).second)
+          return;
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(src);
+        edge->set_dest(dest);
+        out[src].push_back(dest);
+        if (undirected)
+          out[dest].push_back(src);
+      };
+      for (uint32_t node = 0; node < num_nodes; node++) {
+        if (shape == 0) {
+          if (node % 50 != 49)
+            add_edge(node, node + 1);
+          if (node + 50 < num_nodes)
+            add_edge(node, node + 50);
+        } else if (shape == 1) {
+          for (uint32_t i = 0; i < 2; i++)
+            add_edge(node, rng() % num_nodes);
+        } else if (shape == 2) {
+          uint32_t span = std::min(40u, num_nodes - node - 1);
+          for (uint32_t i = 0; i < 3 && span > 0; i++)
+            add_edge(node, node + 1 + rng() % span);
+        } else if (node % 500 != 0) {
+          add_edge(node, node - 1 - rng() % std::min(3u, node % 500));
+        }
+      }
+      uint64_t graph_id = std::stoull(plan_engine->ProcessRequest(request));
+
+      Request min_request;
+      min_request.set_request_type(graph::GET_MIN_DISTANCE);
+      min_request.mutable_min_distance()->set_map_id(graph_id);
+      for (uint32_t query = 0; query < 200; query++) {
+        uint32_t src = rng() % num_nodes;
+        // Half the queries stay close to the source
+        uint32_t dest = query % 2 == 0 ? rng() % num_nodes
+                                       : (src + rng() % 60) % num_nodes;
+        uint32_t max_hops = query % 3 == 0 ? 1 + rng() % 8 : 0;
+        uint32_t expected = reference_distance(out, src, dest);
+        if (max_hops != 0 && expected != kUnreachable && expected > max_hops)
+          expected = kUnreachable;
+        min_request.mutable_min_distance()->set_begin_node(src);
+        min_request.mutable_min_distance()->set_end_node(dest);
+        min_request.mutable_min_distance()->set_max_hops(max_hops);
+        min_request.mutable_min_distance()->set_explain(query % 4 == 0);
+        std::string reply = plan_engine->ProcessRequest(min_request);
+        std::string answer = "OK, found minimum distance between " +
+                             std::to_string(src) + " " + std::to_string(dest) +
+                             " to be " + std::to_string(expected);
+        if (query % 4 != 0) {
+          passed = passed && reply.compare(answer) == 0;
+        } else {
+          // Explained replies name the plan and its estimated cost
+          passed = passed && reply.compare(0, answer.size(), answer) == 0 &&
+                   reply.find(", plan ", answer.size()) == answer.size() &&
+                   reply.find(", estimated cost ") != std::string::npos;
+        }
+      }
+
+      // Statistics list the nodes, edges and components of the graph
+      Request stats_request;
+      stats_request.set_request_type(graph::GET_SERVER_STATS);
+      std::string stats = plan_engine->ProcessRequest(stats_request);
+      std::string prefix = std::to_string(graph_id) + ":" +
+                           std::to_string(num_nodes) + ":" +
+                           std::to_string(request.adjacency_list_size() *
+                                          (undirected ? 2 : 1)) +
+                           ":";
+      passed = passed && stats.find(prefix, stats.find(" graph_statistics=")) !=
+                             std::string::npos;
+    }
+
+    // Hop limits turn into bounded traversals, long unbounded queries use
+    // the traversal suited to the shape of the graph
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = plan_engine->ProcessRequest(stats_request);
+    passed = passed && stats.find("bounded_bfs:") != std::string::npos &&
+             stats.find("bidirectional_bfs:") != std::string::npos &&
+             stats.find("dag_bfs:") != std::string::npos &&
+             stats.find("forest:") != std::string::npos;
+
+    // The planner itself: a near destination on a large grid is worth a
+    // bounded traversal, a far one is not
+    GraphStatistics statistics;
+    statistics.num_nodes = 10000000;
+    statistics.num_edges = 40000000;
+    statistics.average_degree = 4;
+    statistics.max_degree = 4;
+    statistics.diameter_estimate = 6000;
+    statistics.num_components = 1;
+    statistics.largest_component = statistics.num_nodes;
+    statistics.profile_depth = kProfileDepths - 1;
+    for (uint32_t hops = 0; hops < kProfileDepths; hops++)
+      statistics.ball_sizes[hops] = 2 * hops * hops + 2 * hops + 1;
+    TraversalQuery near_query;
+    near_query.symmetric = true;
+    near_query.lower = 2;
+    near_query.upper = 4;
+    TraversalQuery far_query = near_query;
+    far_query.lower = 2000;
+    far_query.upper = 5000;
+    PlanChoice near_choice = QueryPlanner::Choose(statistics, near_query);
+    PlanChoice far_choice = QueryPlanner::Choose(statistics, far_query);
+    passed = passed && near_choice.plan == BOUNDED_BFS_PLAN &&
+             near_choice.max_hops == 4 &&
+             far_choice.plan == BIDIRECTIONAL_BFS_PLAN;
+
+    if (passed) {
+      std::cout << "Testcase-27, Cost based query plans passed" << std::endl;
+    } else {
+      std::cout << "Testcase-27, Cost based query plans failed" << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-28 Label constrained distances over property columns
+     */
+    bool passed = true;
+    const uint32_t kUnreachable = std::numeric_limits<uint32_t>::max();
+    std::mt19937 rng(28);
+
+    // Plain, compressed, and spilled lists read back from disk
+    GraphEngineOptions plain_options;
+    plain_options.adjacency_encoding = GraphQueryEngine::PLAIN_ADJACENCY;
+    GraphEngineOptions compressed_options;
+    compressed_options.adjacency_encoding =
+        GraphQueryEngine::COMPRESSED_ADJACENCY;
+    GraphEngineOptions spilled_options = compressed_options;
+    spilled_options.memory_budget_bytes = 1;
+    std::vector<GraphEngineSharedPtr> engines = {
+        std::make_shared<GraphQueryEngine::GraphEngine>(plain_options),
+        std::make_shared<GraphQueryEngine::GraphEngine>(compressed_options),
+        std::make_shared<GraphQueryEngine::GraphEngine>(spilled_options)};
+
+    // Columns answer filters from bitmaps up to 64 values, past that by
+    // scanning the codes
+    std::vector<uint32_t> values;
+    for (uint32_t row = 0; row < 1000; row++)
+      values.push_back(row % 7 == 0 ? 70000 : row % 3);
+    PropertyColumn small_column(values);
+    for (uint32_t row = 0; row < 1000; row++)
+      values[row] = row % 100;
+    PropertyColumn large_column(values);
+    passed = passed && small_column.Indexed() && !large_column.Indexed() &&
+             small_column.NumValues() == 4 && small_column.Get(7) == 70000 &&
+             small_column.Select({70000, 5}, false).Count() == 143 &&
+             small_column.Select({70000}, true).Count() == 857 &&
+             large_column.Select({3, 98}, false).Count() == 20 &&
+             large_column.Select({3, 98}, true).Count() == 980;
+
+    // Directed, reordered, undirected with many edge labels, and node
+    // labels only
+    const uint32_t num_nodes = 600;
+    const uint32_t num_graphs = 4;
+    const uint32_t edge_values[num_graphs] = {4, 4, 100, 0};
+    struct Edge {
+      uint32_t dest;
+      uint32_t label;
+    };
+    std::vector<std::vector<Edge>> out[num_graphs];
+    std::vector<uint32_t> node_labels[num_graphs];
+    uint64_t graph_ids[num_graphs];
+    for (uint32_t g = 0; g < num_graphs; g++) {
+      bool undirected = g == 2;
+      out[g].resize(num_nodes);
+      Request request;
+      request.set_graph_name("labeled_graph_" + std::to_string(g));
+      request.set_graph_total_nodes(num_nodes);
+      request.set_request_type(graph::POST_GRAPH);
+      request.set_undirected(undirected);
+      request.set_labeled_edges(edge_values[g] != 0);
+      if (g == 1)
+        request.set_node_order(graph::RCM_ORDER);
+      for (uint32_t node = 0; node < num_nodes; node++) {
+        node_labels[g].push_back(rng() % 3);
+        request.add_node_labels(node_labels[g].back());
+      }
+      std::set<std::pair<uint32_t, uint32_t>> edge_set;
+      for (uint32_t i = 0; i < 4 * num_nodes; i++) {
+        uint32_t src = rng() % num_nodes;
+        uint32_t dest = i < num_nodes ? (src + 1) % num_nodes
+                                      : rng() % num_nodes;
+        uint32_t label = edge_values[g] == 0 ? 0 : rng() % edge_values[g];
+        // Duplicates would have to agree on the label
+        if (!edge_set.insert(std::make_pair(src, dest)).second ||
+            (undirected && !edge_set.insert(std::make_pair(dest, src)).second))
+          continue;
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(src);
+        edge->set_dest(dest);
+        edge->set_label(label);
+        out[g][src].push_back(Edge{dest, label});
+        if (undirected && src != dest)
+          out[g][dest].push_back(Edge{src, label});
+      }
+      for (const GraphEngineSharedPtr &engine : engines)
+        graph_ids[g] = std::stoull(engine->ProcessRequest(request));
+    }
+
+    // Hop distance over the edges and nodes whose labels pass the filters
+    auto reference_distance = [&](uint32_t g, uint32_t src, uint32_t dest,
+                                  const std::set<uint32_t> &edge_set,
+                                  bool edges_constrained, bool avoid_edges,
+                                  const std::set<uint32_t> &node_set,
+                                  bool nodes_constrained, bool avoid_nodes,
+                                  uint32_t max_hops) {
+      auto node_allowed = [&](uint32_t node) {
+        return !nodes_constrained ||
+               (node_set.count(node_labels[g][node]) != 0) != avoid_nodes;
+      };
+      if (!node_allowed(src) || !node_allowed(dest))
+        return kUnreachable;
+      std::vector<uint32_t> distance(num_nodes, kUnreachable);
+      std::vector<uint32_t> frontier(1, src);
+      distance[src] = 0;
+      for (size_t i = 0; i < frontier.size(); i++) {
+        uint32_t x = frontier[i];
+        if (max_hops != 0 && distance[x] == max_hops)
+          continue;
+        for (const Edge &edge : out[g][x]) {
+          if (edges_constrained &&
+              (edge_set.count(edge.label) != 0) == avoid_edges)
+            continue;
+          if (distance[edge.dest] == kUnreachable && node_allowed(edge.dest)) {
+            distance[edge.dest] = distance[x] + 1;
+            frontier.push_back(edge.dest);
+          }
+        }
+      }
+      return distance[dest];
+    };
+
+    auto run_queries = [&](uint32_t g, uint32_t num_queries) {
+      for (uint32_t query = 0; query < num_queries; query++) {
+        Request constrained_request;
+        constrained_request.set_request_type(graph::GET_CONSTRAINED_DISTANCE);
+        graph::ConstrainedDistance *constraint =
+            constrained_request.mutable_constrained_distance();
+        uint32_t src = rng() % num_nodes;
+        uint32_t dest = rng() % num_nodes;
+        constraint->set_map_id(graph_ids[g]);
+        constraint->set_begin_node(src);
+        constraint->set_end_node(dest);
+        uint32_t max_hops = query % 4 == 0 ? 1 + rng() % 6 : 0;
+        constraint->set_max_hops(max_hops);
+        std::set<uint32_t> edge_set, node_set;
+        bool edges_constrained = edge_values[g] != 0 && query % 3 != 2;
+        bool nodes_constrained = query % 3 != 0;
+        bool avoid_edges = edges_constrained && rng() % 2 == 0;
+        bool avoid_nodes = nodes_constrained && rng() % 2 == 0;
+        if (edges_constrained) {
+          // Many labels for the wide column, values it lacks included
+          uint32_t count = edge_values[g] > 4 ? 60 : 1 + rng() % 3;
+          for (uint32_t i = 0; i < count; i++) {
+            uint32_t label = rng() % (edge_values[g] + 2);
+            edge_set.insert(label);
+            constraint->add_edge_labels(label);
+          }
+          constraint->set_avoid_edge_labels(avoid_edges);
+        }
+        if (nodes_constrained) {
+          node_set.insert(rng() % 3);
+          constraint->add_node_labels(*node_set.begin());
+          constraint->set_avoid_node_labels(avoid_nodes);
+        }
+        uint32_t expected = reference_distance(
+            g, src, dest, edge_set, edges_constrained, avoid_edges, node_set,
+            nodes_constrained, avoid_nodes, max_hops);
+        std::string answer = "OK, found constrained minimum distance between " +
+                             std::to_string(src) + " " + std::to_string(dest) +
+                             " to be " + std::to_string(expected);
+        for (const GraphEngineSharedPtr &engine : engines) {
+          passed = passed &&
+                   engine->ProcessRequest(constrained_request).compare(answer) ==
+                       0;
+        }
+      }
+    };
+    for (uint32_t g = 0; g < num_graphs; g++)
+      run_queries(g, 150);
+
+    // Edge labeled graphs only take removals, graphs with node labels only
+    // take inserts too
+    for (uint32_t g = 0; g < num_graphs; g += 3) {
+      Request remove_request;
+      remove_request.set_request_type(graph::REMOVE_EDGES);
+      remove_request.mutable_update_graph()->set_map_id(graph_ids[g]);
+      Request add_request = remove_request;
+      add_request.set_request_type(graph::ADD_EDGES);
+      for (uint32_t i = 0; i < 200; i++) {
+        uint32_t src = rng() % num_nodes;
+        if (out[g][src].empty())
+          continue;
+        graph::Edges *edge = remove_request.add_adjacency_list();
+        edge->set_src(src);
+        edge->set_dest(out[g][src].back().dest);
+        out[g][src].pop_back();
+      }
+      for (uint32_t i = 0; i < 100; i++) {
+        graph::Edges *edge = add_request.add_adjacency_list();
+        edge->set_src(rng() % num_nodes);
+        edge->set_dest(rng() % num_nodes);
+      }
+      for (const GraphEngineSharedPtr &engine : engines) {
+        std::string removed = engine->ProcessRequest(remove_request);
+        std::string added = engine->ProcessRequest(add_request);
+        passed = passed && removed.compare(0, 2, "OK") == 0 &&
+                 (edge_values[g] != 0
+                      ? added.compare("ERROR: Edges cannot be added to a graph "
+                                      "with edge labels") == 0
+                      : added.compare(0, 2, "OK") == 0);
+      }
+      if (edge_values[g] == 0) {
+        for (int i = 0; i < add_request.adjacency_list_size(); i++) {
+          const graph::Edges &edge = add_request.adjacency_list(i);
+          bool present = false;
+          for (const Edge &next : out[g][edge.src()])
+            present = present || next.dest == edge.dest();
+          if (!present)
+            out[g][edge.src()].push_back(Edge{edge.dest(), 0});
+        }
+      }
+      run_queries(g, 150);
+    }
+
+    // Constraints on columns the graph lacks, and malformed posts
+    Request constrained_request;
+    constrained_request.set_request_type(graph::GET_CONSTRAINED_DISTANCE);
+    constrained_request.mutable_constrained_distance()->set_map_id(
+        graph_ids[3]);
+    constrained_request.mutable_constrained_distance()->set_avoid_edge_labels(
+        true);
+    Request bad_request;
+    bad_request.set_graph_name("labeled_graph_bad");
+    bad_request.set_graph_total_nodes(3);
+    bad_request.set_request_type(graph::POST_GRAPH);
+    bad_request.set_labeled_edges(true);
+    for (uint32_t i = 0; i < 2; i++) {
+      graph::Edges *edge = bad_request.add_adjacency_list();
+      edge->set_src(0);
+      edge->set_dest(1);
+      edge->set_label(i);
+    }
+    std::string conflicting = engines[0]->ProcessRequest(bad_request);
+    bad_request.mutable_adjacency_list()->RemoveLast();
+    bad_request.add_node_labels(1);
+    std::string mismatched = engines[0]->ProcessRequest(bad_request);
+    passed = passed &&
+             engines[0]->ProcessRequest(constrained_request)
+                     .compare("ERROR: Graph has no edge labels") == 0 &&
+             conflicting.compare(
+                 "ERROR: Duplicate edges with different labels") == 0 &&
+             mismatched.compare(
+                 "ERROR: Node labels must match the number of nodes") == 0;
+
+    // STATS lists the columns of every labeled graph
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = engines[0]->ProcessRequest(stats_request);
+    passed = passed &&
+             stats.find(std::to_string(graph_ids[2]) + ":100:3:",
+                        stats.find(" label_columns=")) != std::string::npos &&
+             stats.find(" constrained_queries=0") == std::string::npos;
+
+    if (passed) {
+      std::cout << "Testcase-28, Label constrained distances passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-28, Label constrained distances failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-29 Query deadlines and cooperative cancellation
+     */
+    bool passed = true;
+    GraphEngineOptions stop_options;
+    stop_options.num_landmarks = 0;
+    stop_options.delta_stepping_min_edges = 1;
+    stop_options.delta_stepping_threads = 3;
+    GraphEngineSharedPtr stop_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(stop_options);
+
+    // Directed and undirected cycles, and a weighted directed cycle, long
+    // enough for every traversal to reach a checkpoint
+    const uint32_t num_nodes = 100000;
+    const uint32_t half = num_nodes / 2;
+    uint64_t graph_ids[3];
+    for (uint32_t g = 0; g < 3; g++) {
+      Request request;
+      request.set_graph_name("stopped_graph_" + std::to_string(g));
+      request.set_graph_total_nodes(num_nodes);
+      request.set_request_type(graph::POST_GRAPH);
+      request.set_undirected(g == 1);
+      if (g == 2)
+        request.set_weight_type(graph::INTEGER_WEIGHTS);
+      for (uint32_t node = 0; node < num_nodes; node++) {
+        graph::Edges *edge = request.add_adjacency_list();
+        edge->set_src(node);
+        edge->set_dest((node + 1) % num_nodes);
+        edge->set_weight(2);
+      }
+      graph_ids[g] = std::stoull(stop_engine->ProcessRequest(request));
+    }
+
+    Request min_request;
+    min_request.set_request_type(graph::GET_MIN_DISTANCE);
+    min_request.mutable_min_distance()->set_map_id(graph_ids[0]);
+    min_request.mutable_min_distance()->set_begin_node(0);
+    min_request.mutable_min_distance()->set_end_node(half);
+    Request bounded_request = min_request;
+    bounded_request.mutable_min_distance()->set_max_hops(num_nodes);
+    Request ring_request = min_request;
+    ring_request.mutable_min_distance()->set_map_id(graph_ids[1]);
+    ring_request.mutable_min_distance()->set_end_node(half + 1);
+    Request weighted_request;
+    weighted_request.set_request_type(graph::GET_WEIGHTED_DISTANCE);
+    weighted_request.mutable_weighted_distance()->set_map_id(graph_ids[2]);
+    weighted_request.mutable_weighted_distance()->set_begin_node(0);
+    weighted_request.mutable_weighted_distance()->set_end_node(half);
+    Request distances_request;
+    distances_request.set_request_type(graph::GET_DISTANCES);
+    distances_request.mutable_multi_distance()->set_map_id(graph_ids[1]);
+    distances_request.mutable_multi_distance()->set_begin_node(0);
+    distances_request.mutable_multi_distance()->set_all_nodes(true);
+    Request neighborhood_request;
+    neighborhood_request.set_request_type(graph::GET_NEIGHBORHOOD);
+    neighborhood_request.mutable_neighborhood()->set_map_id(graph_ids[0]);
+    neighborhood_request.mutable_neighborhood()->set_begin_node(0);
+    neighborhood_request.mutable_neighborhood()->set_max_hops(num_nodes);
+
+    // Every traversal gives up at its first checkpoint under a cancelled
+    // control: BFS, its cache fill on the second query of a source, the
+    // bounded BFS, the bidirectional BFS, delta-stepping, the direction
+    // optimizing BFS and the neighborhood
+    auto stops = [&](Request &request, bool stream) {
+      QueryControl control;
+      control.Cancel();
+      ScopedQueryControl scope(&control);
+      if (stream)
+        stop_engine->ProcessStreamRequest(request);
+      else
+        stop_engine->ProcessRequest(request);
+      return control.Stopped() == GraphQueryEngine::QUERY_CANCELLED &&
+             control.StoppedTraversals() == 1 &&
+             control.ExpandedNodes() >= QueryCheckpoint::kCheckInterval &&
+             control.ExpandedNodes() <= 4 * QueryCheckpoint::kCheckInterval &&
+             control.UnexpandedNodes() >= half;
+    };
+    passed = passed && stops(min_request, false) &&
+             stops(min_request, false) && stops(bounded_request, false) &&
+             stops(ring_request, false) && stops(weighted_request, false) &&
+             stops(distances_request, true) &&
+             stops(neighborhood_request, true);
+
+    // Stopped traversals leave nothing in the distance cache, the same
+    // queries without a control are answered in full
+    passed = passed && StatValue(stop_engine, "distance_cache_insertions") == 0;
+    std::string to_half = " to be " + std::to_string(half);
+    passed = passed &&
+             stop_engine->ProcessRequest(min_request).find(to_half) !=
+                 std::string::npos &&
+             stop_engine->ProcessRequest(bounded_request).find(to_half) !=
+                 std::string::npos &&
+             stop_engine->ProcessRequest(ring_request)
+                     .find(" to be " + std::to_string(half - 1)) !=
+                 std::string::npos &&
+             stop_engine->ProcessRequest(weighted_request)
+                     .find(" to be " + std::to_string(2 * half)) !=
+                 std::string::npos &&
+             stop_engine->ProcessStreamRequest(distances_request)
+                     ->distances[half] == half &&
+             stop_engine->ProcessStreamRequest(neighborhood_request)
+                     ->nodes.size() == num_nodes &&
+             StatValue(stop_engine, "distance_cache_insertions") == 1;
+
+    // Members of a team inherit the control, each one stops on its own
+    // range and the later phases are skipped
+    std::vector<std::vector<uint32_t>> adj_list(num_nodes);
+    for (uint32_t node = 0; node < num_nodes; node++)
+      adj_list[node].push_back((node + 1) % num_nodes);
+    Graph cycle(adj_list, "stopped_cycle");
+    ThreadTeam team(3);
+    {
+      QueryControl control;
+      control.Cancel();
+      ScopedQueryControl scope(&control);
+      cycle.Current()->ConnectedComponents(team);
+      passed = passed && control.StoppedTraversals() == 3;
+    }
+    std::vector<uint32_t> labels = cycle.Current()->ConnectedComponents(team);
+    passed = passed && labels[num_nodes - 1] == 0;
+
+    // Requests whose control stopped before they ran are answered with the
+    // reason. Writes and lookups ignore the control.
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    uint32_t num_done = 0;
+    std::vector<std::string> replies(6);
+    auto record = [&](uint32_t i) {
+      return [&, i](const std::string &message) {
+        std::lock_guard<std::mutex> guard(done_mutex);
+        replies[i] = message;
+        num_done++;
+        done_cv.notify_all();
+      };
+    };
+    auto record_stream = [&](uint32_t i) {
+      return [&, i](StreamResultSharedPtr result) {
+        record(i)(result->message);
+      };
+    };
+    QueryControlSharedPtr cancelled = std::make_shared<QueryControl>();
+    cancelled->Cancel();
+    QueryControlSharedPtr expired = std::make_shared<QueryControl>(
+        QueryControl::Clock::now() - std::chrono::milliseconds(1));
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    // The second query may attach to the flight of the cancelled one, it
+    // then starts over under its own control
+    Request follower_request = ring_request;
+    stop_engine->ProcessRequestAsync(ring_request, record(0), cancelled);
+    stop_engine->ProcessRequestAsync(follower_request, record(1));
+    stop_engine->ProcessRequestAsync(min_request, record(2), expired);
+    stop_engine->ProcessStreamRequestAsync(distances_request,
+                                           record_stream(3), expired);
+    stop_engine->ProcessStreamRequestAsync(neighborhood_request,
+                                           record_stream(4), cancelled);
+    stop_engine->ProcessRequestAsync(stats_request, record(5), cancelled);
+    {
+      std::unique_lock<std::mutex> lock(done_mutex);
+      done_cv.wait(lock, [&] { return num_done == replies.size(); });
+    }
+    passed = passed && replies[0].compare("ERROR: Request cancelled") == 0 &&
+             replies[1].find(" to be " + std::to_string(half - 1)) !=
+                 std::string::npos &&
+             replies[2].compare("ERROR: Deadline exceeded") == 0 &&
+             replies[3].compare("ERROR: Deadline exceeded") == 0 &&
+             replies[4].compare("ERROR: Request cancelled") == 0 &&
+             replies[5].find("cancelled_queries=") != std::string::npos &&
+             GraphQueryEngine::GraphEngine::StopOf(replies[2]) ==
+                 GraphQueryEngine::QUERY_DEADLINE_EXCEEDED &&
+             GraphQueryEngine::GraphEngine::StopOf(replies[1]) ==
+                 GraphQueryEngine::QUERY_RUNNING &&
+             StatValue(stop_engine, "cancelled_queries") == 2 &&
+             StatValue(stop_engine, "deadline_exceeded_queries") == 2 &&
+             StatValue(stop_engine, "queries_stopped_before_start") == 4;
+
+    // A full traversal shared by one-to-many requests runs under the control
+    // of its leader. On a single compute thread, the leader is cancelled
+    // while a request ahead of it runs, after the follower attached to it:
+    // the leader gives up, the follower starts over and is answered in full.
+    GraphEngineOptions flight_options;
+    flight_options.compute_threads = 1;
+    GraphEngineSharedPtr flight_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(flight_options);
+    Request path_request;
+    path_request.set_graph_name("flight_path");
+    path_request.set_graph_total_nodes(3);
+    path_request.set_request_type(graph::POST_GRAPH);
+    for (uint32_t node = 0; node < 2; node++) {
+      graph::Edges *edge = path_request.add_adjacency_list();
+      edge->set_src(node);
+      edge->set_dest(node + 1);
+    }
+    uint64_t path_id = std::stoull(flight_engine->ProcessRequest(path_request));
+    Request blocker_request;
+    blocker_request.set_request_type(graph::GET_NEIGHBORHOOD);
+    blocker_request.mutable_neighborhood()->set_map_id(path_id);
+    blocker_request.mutable_neighborhood()->set_begin_node(0);
+    blocker_request.mutable_neighborhood()->set_max_hops(2);
+    Request leader_request;
+    leader_request.set_request_type(graph::GET_DISTANCES);
+    leader_request.mutable_multi_distance()->set_map_id(path_id);
+    leader_request.mutable_multi_distance()->set_begin_node(0);
+    leader_request.mutable_multi_distance()->set_all_nodes(true);
+    Request attached_request = leader_request;
+    QueryControlSharedPtr leader_control = std::make_shared<QueryControl>();
+    bool attached = false;
+    std::vector<StreamResultSharedPtr> flight_results(2);
+    num_done = 0;
+    flight_engine->ProcessStreamRequestAsync(
+        blocker_request, [&](StreamResultSharedPtr) {
+          std::unique_lock<std::mutex> lock(done_mutex);
+          done_cv.wait(lock, [&] { return attached; });
+          leader_control->Cancel();
+        });
+    for (uint32_t i = 0; i < 2; i++) {
+      flight_engine->ProcessStreamRequestAsync(
+          i == 0 ? leader_request : attached_request,
+          [&, i](StreamResultSharedPtr result) {
+            std::lock_guard<std::mutex> guard(done_mutex);
+            flight_results[i] = result;
+            num_done++;
+            done_cv.notify_all();
+          },
+          i == 0 ? leader_control : nullptr);
+    }
+    {
+      std::unique_lock<std::mutex> lock(done_mutex);
+      attached = true;
+      done_cv.notify_all();
+      done_cv.wait(lock, [&] { return num_done == 2; });
+    }
+    Request flight_stats;
+    flight_stats.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = flight_engine->ProcessRequest(flight_stats);
+    passed = passed &&
+             flight_results[0]->message.compare("ERROR: Request cancelled") ==
+                 0 &&
+             flight_results[1]->message.compare(
+                 "OK, found 3 distances from 0") == 0 &&
+             flight_results[1]->distances.size() == 3 &&
+             flight_results[1]->distances[2] == 2 &&
+             stats.find(" coalesced_source_traversals=1 ") !=
+                 std::string::npos &&
+             stats.find(" cancelled_queries=1 ") != std::string::npos &&
+             stats.find(" queries_stopped_before_start=1 ") !=
+                 std::string::npos;
+
+    // Jobs fail once past their time budget, a PageRank that never
+    // converges included
+    auto run_job = [&](graph::JobType type, uint32_t time_budget_ms) {
+      Request submit;
+      submit.set_request_type(graph::SUBMIT_JOB);
+      submit.mutable_job()->set_map_id(graph_ids[1]);
+      submit.mutable_job()->set_job_type(type);
+      submit.mutable_job()->set_max_iterations(1000000);
+      submit.mutable_job()->set_tolerance(1e-300);
+      submit.mutable_job()->set_time_budget_ms(time_budget_ms);
+      std::string reply = stop_engine->ProcessRequest(submit);
+      uint64_t job_id = std::stoull(reply.substr(reply.rfind(' ') + 1));
+      Request status;
+      status.set_request_type(graph::GET_JOB_STATUS);
+      status.mutable_job()->set_job_id(job_id);
+      std::string state = stop_engine->ProcessRequest(status);
+      while (state.compare(0, 10, "NOT_READY:") == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        state = stop_engine->ProcessRequest(status);
+      }
+      return state;
+    };
+    passed = passed &&
+             run_job(graph::PAGERANK, 1)
+                     .find(" failed, Time budget of 1 ms exceeded") !=
+                 std::string::npos &&
+             run_job(graph::CONNECTED_COMPONENTS, 600000)
+                     .find(" is done, found 1 connected components") !=
+                 std::string::npos;
+
+    if (passed) {
+      std::cout << "Testcase-29, Query deadlines and cancellation passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-29, Query deadlines and cancellation failed"
+                << std::endl;
+    }
+  }
+
+  {
+    /*
+     * Testcase-30 Priority classes and fair queuing across tenants
+     */
+    bool passed = true;
+    // Tasks blocked until released, to fill the threads of a pool
+    std::mutex gate_mutex;
+    std::condition_variable gate_cv;
+    bool released = false;
+    uint32_t finished = 0;
+    auto blocked = [&] {
+      std::unique_lock<std::mutex> lock(gate_mutex);
+      gate_cv.wait(lock, [&] { return released; });
+      finished++;
+      gate_cv.notify_all();
+    };
+    auto release = [&](uint32_t tasks) {
+      std::unique_lock<std::mutex> lock(gate_mutex);
+      released = true;
+      gate_cv.notify_all();
+      gate_cv.wait(lock, [&] { return finished == tasks; });
+      released = false;
+      finished = 0;
+    };
+
+    // Bulk tasks queued before interactive ones on a single thread: fair
+    // queuing starts four interactive tasks for every bulk one, submission
+    // order starts every bulk task first
+    auto run_order = [&](bool fair_queuing) {
+      SchedulingPolicy policy;
+      policy.fair_queuing = fair_queuing;
+      policy.interactive_weight = 4;
+      policy.bulk_weight = 1;
+      std::vector<TaskClass> order;
+      std::unique_ptr<WorkerPool> pool(new WorkerPool(1));
+      FairScheduler scheduler(pool.get(), policy);
+      scheduler.Submit(INTERACTIVE_TASK, "gate", 1, blocked);
+      for (uint32_t i = 0; i < 10; i++) {
+        scheduler.Submit(BULK_TASK, "loader", 1, [&order] {
+          order.push_back(BULK_TASK);
+        });
+      }
+      for (uint32_t i = 0; i < 10; i++) {
+        scheduler.Submit(INTERACTIVE_TASK, "app", 1, [&order] {
+          order.push_back(INTERACTIVE_TASK);
+        });
+      }
+      release(1);
+      // Joining the thread runs the tasks still queued
+      pool.reset();
+      return order;
+    };
+    auto bulk_before_queries = [](const std::vector<TaskClass> &order) {
+      uint32_t bulk = 0;
+      uint32_t queries = 0;
+      for (TaskClass task_class : order) {
+        if (task_class == INTERACTIVE_TASK && ++queries == 10)
+          return bulk;
+        if (task_class == BULK_TASK)
+          bulk++;
+      }
+      return bulk;
+    };
+    std::vector<TaskClass> fair_order = run_order(true);
+    std::vector<TaskClass> fifo_order = run_order(false);
+    passed = passed && fair_order.size() == 20 && fifo_order.size() == 20 &&
+             fair_order[0] == INTERACTIVE_TASK &&
+             bulk_before_queries(fair_order) == 3 &&
+             bulk_before_queries(fifo_order) == 10;
+
+    // Bulk tasks leave the reserved thread to interactive ones, tenants
+    // at their limit wait while other tenants run
+    {
+      SchedulingPolicy policy;
+      policy.interactive_reserved_threads = 1;
+      policy.tenant_max_running = 1;
+      std::unique_ptr<WorkerPool> pool(new WorkerPool(2));
+      FairScheduler scheduler(pool.get(), policy);
+      std::mutex done_mutex;
+      std::condition_variable done_cv;
+      uint32_t num_done = 0;
+      auto done = [&] {
+        std::lock_guard<std::mutex> guard(done_mutex);
+        num_done++;
+        done_cv.notify_all();
+      };
+      auto wait_done = [&](uint32_t tasks) {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        return done_cv.wait_for(lock, std::chrono::seconds(10),
+                                [&] { return num_done == tasks; });
+      };
+      scheduler.Submit(BULK_TASK, "loader", 1, blocked);
+      scheduler.Submit(BULK_TASK, "other_loader", 1, blocked);
+      passed = passed && scheduler.Queued() == 1 &&
+               scheduler.Stats(BULK_TASK).started == 1;
+      scheduler.Submit(INTERACTIVE_TASK, "app", 1, done);
+      passed = passed && wait_done(1);
+      release(2);
+
+      scheduler.Submit(INTERACTIVE_TASK, "app", 1, blocked);
+      scheduler.Submit(INTERACTIVE_TASK, "app", 1, blocked);
+      passed = passed && scheduler.Queued() == 1 &&
+               scheduler.TenantLimited() == 1;
+      scheduler.Submit(INTERACTIVE_TASK, "other_app", 1, done);
+      passed = passed && wait_done(2);
+      release(2);
+      pool.reset();
+      passed = passed && scheduler.Queued() == 0 &&
+               scheduler.Stats(INTERACTIVE_TASK).started == 4 &&
+               scheduler.Stats(BULK_TASK).started == 2;
+    }
+
+    // The engine classes posts and edits as bulk and other requests as
+    // interactive, unless the request names its class
+    GraphEngineOptions fair_options;
+    fair_options.compute_threads = 1;
+    GraphEngineSharedPtr fair_engine =
+        std::make_shared<GraphQueryEngine::GraphEngine>(fair_options);
+    std::mutex reply_mutex;
+    std::condition_variable reply_cv;
+    std::string reply;
+    auto process = [&](Request &request) {
+      std::unique_lock<std::mutex> lock(reply_mutex);
+      reply.clear();
+      fair_engine->ProcessRequestAsync(
+          request, [&](const std::string &message) {
+            std::lock_guard<std::mutex> guard(reply_mutex);
+            reply = message.empty() ? " " : message;
+            reply_cv.notify_all();
+          });
+      reply_cv.wait(lock, [&] { return !reply.empty(); });
+      return reply;
+    };
+    Request post_request;
+    post_request.set_graph_name("fair_graph");
+    post_request.set_graph_total_nodes(3);
+    post_request.set_request_type(graph::POST_GRAPH);
+    post_request.set_tenant("loader");
+    for (uint32_t node = 0; node < 2; node++) {
+      graph::Edges *edge = post_request.add_adjacency_list();
+      edge->set_src(node);
+      edge->set_dest(node + 1);
+    }
+    std::string graph_id = process(post_request);
+    Request query_request;
+    query_request.set_request_type(graph::GET_MIN_DISTANCE);
+    query_request.set_tenant("app");
+    query_request.mutable_min_distance()->set_map_id(std::stoull(graph_id));
+    query_request.mutable_min_distance()->set_begin_node(0);
+    query_request.mutable_min_distance()->set_end_node(2);
+    passed = passed && process(query_request).find(" to be 2") !=
+                           std::string::npos;
+    query_request.set_priority(graph::BULK_PRIORITY);
+    query_request.mutable_min_distance()->set_end_node(1);
+    passed = passed && process(query_request).find(" to be 1") !=
+                           std::string::npos;
+    Request stats_request;
+    stats_request.set_request_type(graph::GET_SERVER_STATS);
+    std::string stats = fair_engine->ProcessRequest(stats_request);
+    passed = passed && stats.find(" fair_queuing=on") != std::string::npos &&
+             stats.find(" interactive_tasks=1 ") != std::string::npos &&
+             stats.find(" bulk_tasks=2 ") != std::string::npos &&
+             stats.find(" scheduler_queued=0 ") != std::string::npos;
+
+    if (passed) {
+      std::cout << "Testcase-30, Priority classes and fair queuing passed"
+                << std::endl;
+    } else {
+      std::cout << "Testcase-30, Priority classes and fair queuing failed"
+                << std::endl;
+    }
+  }
 }